@@ -0,0 +1,161 @@
+/* hdr/Archive.h
+ *
+ * Block compressed archive of pre-generated boards.  All
+ * boards in an archive share a size, mine count and
+ * topology; board `id` was generated with seed
+ * base_seed + id, so it is the same board Board() would
+ * deal for that seed.
+ *
+ * File layout:
+ *   archive_header
+ *   blocks, each up to block_boards boards:
+ *     varint 3BV of every board in the block, then
+ *     the mine layouts, either as packed bitplanes back to
+ *     back (ARCHIVE_CODEC_RAW) or as one bit stream of
+ *     Rice coded gaps between mines (ARCHIVE_CODEC_RICE),
+ *     whichever is smaller for that block
+ *   index: one archive_block per block
+ *
+ * Any board is found by id with one index lookup and at
+ * most one block decode.  Every block carries a checksum
+ * that is checked when it is read.
+ *
+ */
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define ARCHIVE_MAGIC           "MSWPARC1"
+/* 2: boards dealt by mines_place (hdr/Mines.h) */
+#define ARCHIVE_VERSION         2
+#define ARCHIVE_BLOCK_BOARDS    64
+
+/* Block codecs */
+#define ARCHIVE_CODEC_RAW       0
+#define ARCHIVE_CODEC_RICE      1
+
+/* Largest Rice parameter tried */
+#define ARCHIVE_MAX_RICE_K      15
+
+/* Blocks are gathered up to this size before each write() */
+#define ARCHIVE_WRITE_BUFFER    (4 << 20)
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* On-disk header, little endian */
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t  rows;
+    int32_t  columns;
+    int32_t  mines;
+    uint32_t topology;
+    uint32_t base_seed;
+    uint32_t block_boards;
+    uint64_t boards;
+    uint64_t blocks;
+    uint64_t index_offset;
+} archive_header;
+
+/* On-disk index entry, one per block */
+typedef struct
+{
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t boards;
+    uint64_t checksum;
+    uint8_t  codec;
+    uint8_t  rice_k;
+    uint8_t  pad[6];
+} archive_block;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+
+/* Appends encoded blocks to a new archive, in order */
+struct ArchiveWriter
+{
+ private:
+    int fd;
+    std::string path, temp_path;
+    archive_header header;
+    std::vector<archive_block> index;
+    std::vector<uint8_t> pending;
+    uint64_t offset;
+
+    bool flush();
+
+ public:
+    // Constructions
+    ArchiveWriter();
+
+    // Destructor
+    ~ArchiveWriter();
+
+    // Methods
+    bool open(const char* _path, int rows, int columns, int mines,
+              board_topology topology, uint32_t base_seed,
+              int block_boards);
+    bool write_block(const std::vector<uint8_t>& payload,
+                     archive_block entry);
+    bool close();
+    uint64_t get_bytes();
+};
+
+/* Random access to the boards of an archive */
+struct ArchiveReader
+{
+ private:
+    const uint8_t* image;
+    size_t size;
+    const archive_header* header;
+    const archive_block* index;
+    int cells, plane_bytes;
+
+    const archive_block* find_block(uint64_t block);
+
+ public:
+    // Constructions
+    ArchiveReader();
+
+    // Destructor
+    ~ArchiveReader();
+
+    // Methods
+    bool open(const char* path);
+    void close();
+
+    const archive_header* get_header();
+    bool read_board(uint64_t id, uint8_t* plane, int* bbbv);
+    int read_block_3bv(uint64_t block, int* bbbv);
+    Board* load_board(uint64_t id);
+    bool verify(uint64_t* bad_blocks);
+};
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+void archive_encode_block(const uint8_t* planes, const int* bbbv,
+                          int boards, int cells, int mines,
+                          std::vector<uint8_t>* payload,
+                          archive_block* entry);
+uint64_t archive_checksum(const uint8_t* data, size_t bytes);
+
+#endif /* ARCHIVE_H */
@@ -3,13 +3,67 @@
  * Struct containing all board-level information
  *
  */
+#ifndef BOARD_H
+#define BOARD_H
 
 /******************************************************
                         INCLUDES
 *******************************************************/
 #include <string>
+#include <stdint.h>
 
 #include "Square.h"
+#include "Topology.h"
+#include "Journal.h"
+#include "EventLog.h"
+#include "MemStats.h"
+#include "CellStore.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define GAME_FLAG_OVER  0x1
+#define GAME_FLAG_WON   0x2
+
+/* Revealed squares are also counted per block of
+ * (1 << BOARD_BLOCK_SHIFT) x (1 << BOARD_BLOCK_SHIFT) squares,
+ * for overviews that must not walk the whole board */
+#define BOARD_BLOCK_SHIFT   3
+
+struct SpectatorFeed;
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef enum
+{
+    MOVE_REVEAL = 0,    /* reveal a square (and cascade) */
+    MOVE_MARK,          /* mark an unknown square as a mine */
+    MOVE_UNMARK,        /* take a mark off */
+    MOVE_CHORD,         /* reveal the unmarked neighbors of a number
+                           that has as many marks around it */
+    NUM_MOVE_TYPES
+} move_type;
+
+/* One move for apply_moves, row and column 0 based */
+typedef struct
+{
+    int row, column;
+    move_type type;
+} board_move;
+
+/* What a batch of moves did */
+typedef struct
+{
+    int applied;        /* moves that changed the board */
+    int ignored;        /* repeats, no-ops, off the board, after the end */
+    int revealed;       /* squares revealed */
+    int marked;
+    int unmarked;
+    bool hit_mine;
+    bool game_over;
+    bool game_won;
+} move_result;
 
 /******************************************************
                     CLASS DEFINITION
@@ -19,25 +73,133 @@ struct Board
  private:
     int rows, columns, mines;
     int squares_revealed;
+    board_topology topology;
+    unsigned int seed;
     struct Square* squares;
+    cell_plane square_plane;
     bool game_over;
     bool game_won;
+    Journal journal;
+    mem_vector<square_change, MEM_BOARD> move_changes;
+    std::vector<cell_change> journal_changes;
+    EventLog* event_log;
+    uint32_t game_id;
+    bool verbose;
+    mem_vector<int, MEM_BOARD> block_revealed;
+    int block_rows, block_columns;
+    
+    /* Each block is also counted in one cell of a coarser
+     * overview grid (see set_overview), block_overview[block]
+     * being that cell */
+    mem_vector<int, MEM_BOARD> block_overview;
+    mem_vector<int, MEM_BOARD> overview_revealed;
+    int overview_rows, overview_columns;
+    
+    /* Scratch space for apply_moves */
+    mem_vector<uint8_t, MEM_BOARD> move_seen;
+    mem_vector<int, MEM_BOARD> move_touched;
+    mem_vector<int, MEM_BOARD> reveal_seeds;
+    mem_vector<int, MEM_BOARD> chord_targets;
+    
+    /* Openings: cell_opening[i] is the opening a zero belongs
+     * to (-1 for others); opening k is opening_cells
+     * [opening_start[k], opening_start[k+1]) */
+    mem_vector<int, MEM_BOARD> cell_opening;
+    mem_vector<int, MEM_BOARD> opening_start;
+    mem_vector<int, MEM_BOARD> opening_cells;
+    int bbbv;
+    
+    /* Zobrist style hashes: state_hash is the XOR of a key
+     * per (square, state) over squares that are not UNKNOWN,
+     * kept up to date as squares change */
+    uint64_t state_hash;
+    uint64_t mine_hash;
+    
+    /* Live view for spectators, told about every square
+     * that changes (see hdr/Spectate.h) */
+    SpectatorFeed* spectators;
+    
+    /* Per-move messages go here instead of stdout if set */
+    std::string* messages;
+
+    void init( int _rows, int _columns, int _mines, 
+               board_topology _topology, unsigned int _seed,
+               const uint8_t* mine_plane );
+    template <class Topology> void link_neighbors();
+    void index_openings();
+    int border_openings( int index, int* out );
+    bool is_zero( int index );
+    int block_of( int index );
+    void count_revealed( int index, int delta );
+    void set_square_state( int index, square_state state );
+    int flood_reveal( int index );
+    int chord_reveal( int index );
+    void journal_move( move_delta delta );
+    uint8_t game_flags();
+    void set_game_flags( uint8_t flags );
+    void log_state_hash();
+    void move_info( const char* format, ... );
 
  public:
     // Constructions
     Board( int _rows, int _columns, int _mines ); 
+    Board( int _rows, int _columns, int _mines, 
+           board_topology _topology );
+    Board( int _rows, int _columns, int _mines, 
+           board_topology _topology, unsigned int _seed );
+    Board( int _rows, int _columns, int _mines, 
+           board_topology _topology, unsigned int _seed,
+           const uint8_t* mine_plane );
     
     // Destructor
     ~Board();
     
     // Methods
     void print_board();
+    char square_char(int row, int column);
+    int row_indent(int row);
+    void set_verbose(bool _verbose);
+    void set_messages(std::string* out);
+    void set_overview(int rows, int columns);
+    void set_event_log(EventLog* log, uint32_t _game_id);
+    void set_spectators(SpectatorFeed* feed);
     void populate_neighbors();
     bool parse_input(std::string user_input);
     
+    void pack_mines(uint8_t* plane);
+    void pack_states(uint8_t* plane);
+    void restore_states(const uint8_t* plane, int _revealed,
+                        bool _over, bool _won);
+    void restore_states(const uint8_t* plane, int _revealed,
+                        bool _over, bool _won, const uint8_t* current);
+    void swap_journal(Journal* other);
+    void trim_history(size_t max_bytes);
+    
     int get_rows();
     int get_columns();
+    int get_mines();
+    board_topology get_topology();
+    unsigned int get_seed();
+    int get_squares_revealed();
+    bool is_game_over();
+    square_state get_square_state(int row, int column);
+    int get_square_number(int row, int column);
+    int get_3bv();
+    int get_openings();
+    uint64_t get_state_hash();
+    uint64_t get_mine_hash();
+    const std::vector<cell_change>& get_last_changes();
+    size_t get_memory_bytes();
+    int get_block_rows();
+    int get_block_columns();
+    int get_block_revealed(int block_row, int block_column);
+    int get_overview_revealed(int row, int column);
     bool make_move(int move_row, int move_col, bool mark_square);
+    move_result apply_moves(const board_move* moves, int count);
+    bool undo();
+    bool redo();
     
     bool did_we_win();
-}; 
\ No newline at end of file
+}; 
+
+#endif /* BOARD_H */
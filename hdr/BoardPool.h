@@ -0,0 +1,115 @@
+/* hdr/BoardPool.h
+ *
+ * Boards built ahead of time, so starting a game does not
+ * wait for a board to be dealt, linked and indexed.
+ *
+ * The pool keeps up to `depth` ready boards of each preset
+ * (size, mines and topology) for each consumer, e.g. each
+ * server worker.  Every (consumer, preset) pair has its own
+ * SPSC queue: the consumer is its only reader and one
+ * refill thread its only writer, so take() is a scan of
+ * the few presets and a pop, with no locks.  A consumer
+ * that takes a board wakes the refill thread that owns the
+ * queue, which builds a replacement in the background.
+ * Refill threads top up their queues round robin, one
+ * board at a time, so one busy preset cannot starve the
+ * others.
+ *
+ * A request for a preset the pool does not keep, or whose
+ * queue is empty, is a miss and the caller builds its own
+ * board.
+ *
+ */
+#ifndef BOARD_POOL_H
+#define BOARD_POOL_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <semaphore.h>
+
+#include "Board.h"
+#include "SpscQueue.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+/* Most boards of one preset kept for one consumer */
+#define POOL_MAX_DEPTH      64
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef struct
+{
+    int rows, columns, mines;
+    board_topology topology;
+    int depth;                  /* boards kept per consumer */
+} pool_preset;
+
+typedef struct
+{
+    uint64_t hits;              /* takes served from the pool */
+    uint64_t misses;            /* takes the caller had to build */
+    uint64_t built;             /* boards built by refill threads */
+    uint64_t build_ns;          /* time spent building them */
+    uint64_t max_build_ns;
+    uint64_t refill_ns;         /* take to next board ready, summed */
+    uint64_t max_refill_ns;
+    uint64_t refills;
+    uint64_t ready;             /* boards waiting now */
+} pool_stats;
+
+/* One (consumer, preset) queue */
+typedef struct
+{
+    SpscQueue<Board*, POOL_MAX_DEPTH> boards;
+    const pool_preset* preset;
+
+    /* Time of the oldest take not refilled yet, 0 if none */
+    std::atomic<uint64_t> taken_ns;
+    int refiller;                     /* refill thread that owns it */
+} pool_queue;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct BoardPool
+{
+ private:
+    std::vector<pool_preset> presets;
+    std::vector<pool_queue*> queues;    /* consumer * presets + preset */
+    int consumers;
+
+    std::vector<std::thread> refillers;
+    std::vector<sem_t*> wakeups;
+    std::atomic<bool> stopping;
+
+    std::atomic<uint64_t> hits, misses, built;
+    std::atomic<uint64_t> build_ns, max_build_ns;
+    std::atomic<uint64_t> refill_ns, max_refill_ns, refills;
+
+    void refill_thread(int refiller, unsigned int seed);
+
+ public:
+    // Constructions
+    BoardPool();
+
+    // Destructor
+    ~BoardPool();
+
+    // Methods
+    bool add_preset(int rows, int columns, int mines,
+                    board_topology topology, int depth);
+    void start(int _consumers, int threads);
+    void stop();
+    Board* take(int consumer, int rows, int columns, int mines,
+                board_topology topology);
+    void get_stats(pool_stats* stats);
+};
+
+#endif /* BOARD_POOL_H */
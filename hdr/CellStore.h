@@ -0,0 +1,108 @@
+/* hdr/CellStore.h
+ *
+ * Storage for a board's squares.  Big boards get their own
+ * mmap, aligned to and advised for transparent huge pages
+ * so a multi-gigabyte board is not spread over millions of
+ * 4 KB TLB entries.  Nothing is touched when the planes are
+ * mapped: pages are faulted in by whoever writes them first,
+ * which cells_parallel spreads over worker threads (and so,
+ * on NUMA machines, over the nodes those threads run on).
+ *
+ * With cells_set_backing, big planes live in an unlinked
+ * file in the given directory instead of anonymous memory,
+ * so the kernel can write cold parts of a huge board out
+ * instead of needing swap.
+ *
+ * Small boards (the common case) come from the heap and are
+ * built on the calling thread.
+ *
+ */
+#ifndef CELL_STORE_H
+#define CELL_STORE_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stddef.h>
+#include <thread>
+#include <vector>
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define CELLS_HUGE_PAGE     (2 << 20)
+
+/* Planes smaller than this come from the heap */
+#define CELLS_MAP_MIN_BYTES CELLS_HUGE_PAGE
+
+/* Fewest cells worth handing to another thread */
+#define CELLS_MIN_GRAIN     (1 << 16)
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef struct
+{
+    void* base;
+    size_t bytes;
+    bool mapped;        /* false for heap storage */
+} cell_plane;
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+bool cells_map(size_t bytes, cell_plane* plane);
+void cells_unmap(cell_plane* plane);
+void cells_set_backing(const char* dir);
+void cells_set_threads(int threads);
+int cells_threads();
+
+/******************************************************
+                   TEMPLATE FUNCTIONS
+*******************************************************/
+
+/* cells_parallel
+ *
+ * Runs work(begin, end) over [0, count) in contiguous
+ * chunks, one per thread.  Chunks start on multiples of
+ * grain, so when grain cells span whole huge pages no two
+ * threads fault in the same page.
+ *
+ * Inputs:  count - cells to cover
+ *          grain - chunk alignment, in cells
+ *          work  - callable taking (size_t begin, size_t end)
+ * Outputs: (none)
+ * Returns: void
+ */
+template <class Work>
+void cells_parallel(size_t count, size_t grain, Work work)
+{
+    std::vector<std::thread> workers;
+    size_t threads = cells_threads();
+    size_t chunk, begin, end, i;
+
+    if (grain < CELLS_MIN_GRAIN)
+    {
+        grain = CELLS_MIN_GRAIN;
+    }
+    if ( (threads < 2) || (count < 2 * grain) )
+    {
+        work((size_t) 0, count);
+        return;
+    }
+
+    chunk = (count + threads - 1) / threads;
+    chunk = (chunk + grain - 1) / grain * grain;
+    for (begin = chunk; begin < count; begin += chunk)
+    {
+        end = (begin + chunk < count) ? begin + chunk : count;
+        workers.emplace_back(work, begin, end);
+    }
+    work((size_t) 0, (chunk < count) ? chunk : count);
+    for (i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+#endif /* CELL_STORE_H */
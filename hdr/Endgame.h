@@ -0,0 +1,121 @@
+/* hdr/Endgame.h
+ *
+ * Exact endgame advisor.  Once few enough squares are left
+ * unknown, it lists every mine layout that agrees with what
+ * the player can see (all equally likely) and runs an
+ * expectimax over reveals: the value of a position is the
+ * chance of winning from it with best play, a reveal is
+ * worth the chance-weighted value of each number it could
+ * show.  Positions are memoized in a transposition table
+ * keyed by a Zobrist hash of the (square, number) pairs
+ * revealed since the root, and root moves are searched on
+ * several threads sharing that table.
+ *
+ * Only what the player sees is used: revealed numbers and
+ * the mine count.  Marks are treated as unknown squares.
+ * Squares that are plainly mines are set aside first, so
+ * "unknown" below means squares still in doubt.
+ *
+ */
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+#include "Board.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+
+/* Squares in doubt are kept as bits of a uint64_t */
+#define ENDGAME_MAX_UNKNOWN     64
+
+/* Default limit for advise(), and the layout count past
+ * which it gives up */
+#define ENDGAME_DEFAULT_UNKNOWN 24
+#define ENDGAME_MAX_LAYOUTS     (1 << 20)
+
+/* Transposition table is split to keep threads apart */
+#define ENDGAME_TT_STRIPES      64
+#define ENDGAME_TT_MIN_SLOTS    256
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+/* Mine layouts, one bit per unknown square */
+typedef mem_vector<uint64_t, MEM_SOLVER> layout_list;
+
+typedef struct
+{
+    int row, column;            /* square to reveal, 0 based */
+    double win_probability;     /* with best play from here */
+    double safe_probability;    /* of this reveal */
+    int unknown;                /* squares searched over */
+    uint64_t layouts;           /* consistent mine layouts */
+    uint64_t positions;         /* positions in the table */
+    double milliseconds;
+} endgame_advice;
+
+/* One stripe of the transposition table, open addressed
+ * (key 0 marks a free entry) */
+typedef struct
+{
+    std::mutex lock;
+    std::vector<uint64_t> keys;
+    std::vector<double> values;
+    size_t used;
+} endgame_stripe;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct EndgameSolver
+{
+ private:
+    int threads;
+    int max_unknown;
+
+    /* The position being searched.  Unknown squares are
+     * slots 0..unknown-1. */
+    int unknown;
+    int mines;
+    std::vector<int> slot_cells;
+    uint64_t slot_neighbors[ENDGAME_MAX_UNKNOWN];
+    uint64_t zobrist[ENDGAME_MAX_UNKNOWN][NUM_NEIGHBORS + 1];
+    std::vector<uint64_t> constraint_masks;
+    std::vector<int> constraint_values;
+    std::vector< std::vector<int> > slot_constraints;
+    layout_list layouts;
+    endgame_stripe table[ENDGAME_TT_STRIPES];
+
+    bool read_board( Board* board );
+    bool enumerate( int slot, uint64_t assigned, uint64_t layout,
+                    int placed );
+    double solve( const layout_list& candidates,
+                  uint64_t revealed, uint64_t key );
+    double reveal_value( const layout_list& candidates,
+                         uint64_t revealed, uint64_t key, int slot );
+    double reveal_sure( const layout_list& candidates,
+                        uint64_t revealed, uint64_t key, uint64_t slots );
+    int rank_reveals( const layout_list& candidates,
+                      uint64_t revealed, int* order, int* safe );
+    bool lookup( uint64_t key, double* value );
+    void store( uint64_t key, double value );
+    void clear_table();
+
+ public:
+    // Constructions
+    EndgameSolver( int _threads );
+
+    // Methods
+    void set_max_unknown( int _max_unknown );
+    bool advise( Board* board, endgame_advice* advice );
+};
+
+#endif /* ENDGAME_H */
@@ -0,0 +1,87 @@
+/* hdr/Epoch.h
+ *
+ * Epoch based reclamation for data with one writer and many
+ * lock-free readers.  The writer publishes a new version
+ * with an atomic pointer store and retires what the new
+ * version no longer uses; readers never wait and never
+ * write to the data.
+ *
+ * Readers take a slot with join() and bracket every read
+ * with enter() and exit().  enter() announces the epoch the
+ * reader started in.  After each publish the writer calls
+ * advance() and then retire() on what it replaced: those
+ * items are tagged with the new epoch, and reclaim() frees
+ * an item once every reader inside a read started in its
+ * epoch or later, so it cannot have seen the old pointer.
+ *
+ * The writer side (advance, retire, reclaim) must stay on
+ * one thread at a time.  A reader that stays inside a read
+ * only holds back the memory, never the writer.
+ *
+ */
+#ifndef EPOCH_H
+#define EPOCH_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define EPOCH_MAX_READERS   64
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* Something waiting for the readers to move on */
+typedef struct
+{
+    uint64_t epoch;
+    void* item;
+    void (*release)(void* item);
+} epoch_retired;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct EpochDomain
+{
+ private:
+    /* One cache line per reader, so announcing an epoch
+     * does not slow the other readers down */
+    struct alignas(64) reader_slot
+    {
+        std::atomic<uint64_t> epoch;    /* 0 outside a read */
+        std::atomic<bool> taken;
+    };
+
+    reader_slot slots[EPOCH_MAX_READERS];
+    alignas(64) std::atomic<uint64_t> current;
+    std::vector<epoch_retired> limbo;   /* oldest first */
+
+ public:
+    // Constructions
+    EpochDomain();
+
+    // Destructor
+    ~EpochDomain();
+
+    // Methods
+    int join();
+    void leave(int reader);
+    void enter(int reader);
+    void exit(int reader);
+
+    uint64_t advance();
+    void retire(void* item, void (*release)(void* item));
+    size_t reclaim();
+    size_t get_pending();
+};
+
+#endif /* EPOCH_H */
@@ -0,0 +1,177 @@
+/* hdr/EventLog.h
+ *
+ * Binary, append-only event log of games: creation, moves,
+ * marks, cascade sizes and outcomes.
+ *
+ * The engine appends varint/delta encoded records into an
+ * in-memory buffer; full buffers are handed to a background
+ * thread that writes them out, so logging never waits on the
+ * disk.  An EventLog has a single producer: give each engine
+ * thread its own log.
+ *
+ * File layout: EVENTLOG_MAGIC, then records of
+ *   type byte, varint microseconds since previous record,
+ *   payload (see event_type)
+ *
+ * With set_hashes(true), boards also log the hash of their
+ * mine layout after creating a game and the hash of their
+ * square states after every move (see Board::get_state_hash),
+ * so a replay can tell which move it first went wrong on.
+ *
+ */
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "MemStats.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define EVENTLOG_MAGIC         "MSWPELG1"
+#define EVENTLOG_MAGIC_BYTES   8
+#define EVENTLOG_BUFFER_BYTES  (1 << 20)
+#define EVENTLOG_MAX_BUFFERS   16
+#define EVENTLOG_MAX_RECORD    64
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef enum
+{
+    EVENT_GAME_CREATE = 1,  /* game, rows, columns, mines, topology, seed */
+    EVENT_GAME_SWITCH,      /* game: following records belong to it */
+    EVENT_MOVE,             /* zigzag row delta, zigzag column delta,
+                               squares revealed by the cascade */
+    EVENT_MARK,             /* zigzag row delta, zigzag column delta */
+    EVENT_OUTCOME,          /* 1 if won, 0 if lost */
+    EVENT_UNDO,             /* (none) */
+    EVENT_REDO,             /* (none) */
+    EVENT_DROPPED,          /* number of records lost to back pressure */
+    EVENT_UNMARK,           /* zigzag row delta, zigzag column delta */
+    EVENT_CHORD,            /* zigzag row delta, zigzag column delta,
+                               squares revealed around it */
+    EVENT_MINE_HASH,        /* 8 byte little endian layout hash */
+    EVENT_STATE_HASH,       /* 8 byte little endian hash of the square
+                               states after the previous record */
+    EVENT_BATCH,            /* number of moves: the last ones logged were
+                               applied (and are undone) together */
+    NUM_EVENT_TYPES
+} event_type;
+
+/* A decoded record.  Rows and columns are absolute. */
+typedef struct
+{
+    event_type type;
+    uint64_t time_us;
+    uint32_t game;
+    int row, column;
+    uint64_t count;
+    int rows, columns, mines;
+    int topology;
+    uint32_t seed;
+    bool won;
+    uint64_t hash;
+} game_event;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct EventLog
+{
+ private:
+    int fd;
+    uint8_t* active;
+    size_t used;
+    uint64_t last_us;
+    uint32_t current_game;
+    int last_row, last_column;
+    uint64_t dropped, events;
+    int buffers_allocated;
+    bool hashes;
+
+    std::vector<uint8_t*> full;
+    std::vector<size_t> full_used;
+    std::vector<uint8_t*> free_buffers;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread writer;
+
+    void writer_loop();
+    bool begin_record(event_type type, uint32_t game);
+    void put_varint(uint64_t value);
+    void put_hash(uint64_t hash);
+    void flush_active();
+
+ public:
+    // Constructions
+    EventLog();
+
+    // Destructor
+    ~EventLog();
+
+    // Methods
+    bool open(const char* path);
+    void close();
+
+    void game_created(uint32_t game, int rows, int columns, int mines,
+                      int topology, uint32_t seed);
+    void move(uint32_t game, int row, int column, int revealed);
+    void mark(uint32_t game, int row, int column);
+    void unmark(uint32_t game, int row, int column);
+    void chord(uint32_t game, int row, int column, int revealed);
+    void outcome(uint32_t game, bool won);
+    void undo(uint32_t game);
+    void redo(uint32_t game);
+    void mine_hash(uint32_t game, uint64_t hash);
+    void state_hash(uint32_t game, uint64_t hash);
+    void batch(uint32_t game, int moves);
+
+    void set_hashes(bool _hashes);
+    bool get_hashes();
+    uint64_t get_events();
+    uint64_t get_dropped();
+};
+
+/* Streams records back out of a log file */
+struct EventReader
+{
+ private:
+    FILE* file;
+    mem_vector<uint8_t, MEM_LOG> buffer;
+    size_t start, end;
+    bool eof;
+    uint64_t time_us;
+    uint32_t current_game;
+    int last_row, last_column;
+
+    bool fill(size_t want);
+    bool get_varint(uint64_t* value);
+
+ public:
+    // Constructions
+    EventReader();
+
+    // Destructor
+    ~EventReader();
+
+    // Methods
+    bool open(const char* path);
+    bool next(game_event* event);
+    void close();
+};
+
+const char* event_type_name(event_type type);
+
+#endif /* EVENTLOG_H */
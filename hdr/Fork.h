@@ -0,0 +1,129 @@
+/* hdr/Fork.h
+ *
+ * Cheap forks of a game, for solvers and analysis that try
+ * moves out ("what if I click here?") and throw them away.
+ *
+ * A BoardFork never points into a Board.  Everything that
+ * can't change during a game (mines, numbers, neighbors)
+ * sits in one shared fork_layout.  Square states sit in
+ * tiles of FORK_TILE_SIDE x FORK_TILE_SIDE squares, reached
+ * through pages of FORK_PAGE_TILES tiles.  Layout, tile
+ * table, pages and tiles are all reference counted and
+ * shared between forks, so copying a fork is O(1).  The
+ * first write to a shared piece copies just that piece:
+ * a move copies the tiles its cascade touches, and the
+ * pages and table on the way to them.  The last fork to
+ * let go of a piece frees it.
+ *
+ * A single fork is not thread safe, but forks sharing
+ * pieces can be used and dropped on different threads.
+ *
+ */
+#ifndef FORK_H
+#define FORK_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#include "Board.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+
+/* Tiles line up with the Board's revealed count blocks */
+#define FORK_TILE_SHIFT     BOARD_BLOCK_SHIFT
+#define FORK_TILE_SIDE      (1 << FORK_TILE_SHIFT)
+#define FORK_TILE_CELLS     (FORK_TILE_SIDE * FORK_TILE_SIDE)
+
+/* Tiles per page */
+#define FORK_PAGE_SHIFT     6
+#define FORK_PAGE_TILES     (1 << FORK_PAGE_SHIFT)
+
+/* fork_layout.number of a mine */
+#define FORK_MINE           0xff
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* What never changes during a game, shared by every fork */
+typedef struct
+{
+    std::atomic<int> refs;
+    int rows, columns, mines;
+    board_topology topology;
+    int tile_columns, tiles, pages;
+    mem_vector<int, MEM_SOLVER> neighbors;  /* cells x NUM_NEIGHBORS */
+    mem_vector<uint8_t, MEM_SOLVER> neighbor_count;
+    mem_vector<uint8_t, MEM_SOLVER> number; /* FORK_MINE for mines */
+} fork_layout;
+
+/* Square states of one tile, row by row */
+typedef struct
+{
+    std::atomic<int> refs;
+    uint8_t state[FORK_TILE_CELLS];
+} fork_tile;
+
+typedef struct
+{
+    std::atomic<int> refs;
+    fork_tile* tiles[FORK_PAGE_TILES];
+} fork_page;
+
+typedef struct
+{
+    std::atomic<int> refs;
+    mem_vector<fork_page*, MEM_SOLVER> pages;
+} fork_table;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct BoardFork
+{
+ private:
+    fork_layout* layout;
+    fork_table* table;
+    int squares_revealed;
+    bool game_over;
+    bool game_won;
+    uint64_t tiles_copied;
+
+    void release();
+    uint8_t* writable_state( int index );
+    int flood_reveal( int index );
+    void finish_move();
+
+ public:
+    // Constructions
+    BoardFork( Board* board );
+    BoardFork( const BoardFork& other );
+    BoardFork& operator=( const BoardFork& other );
+
+    // Destructor
+    ~BoardFork();
+
+    // Methods
+    int reveal( int row, int column );
+    bool mark( int row, int column, bool on );
+    int chord( int row, int column );
+
+    int get_rows();
+    int get_columns();
+    int get_mines();
+    int get_squares_revealed();
+    bool is_game_over();
+    bool did_we_win();
+    square_state get_square_state( int row, int column );
+    int get_square_number( int row, int column );
+    bool is_mine( int row, int column );
+    uint64_t get_tiles_copied();
+};
+
+#endif /* FORK_H */
@@ -0,0 +1,121 @@
+/* hdr/GameLoop.h
+ *
+ * Pipelined interactive game loop.  Three threads, each
+ * only talking to the next through lock-free SPSC queues:
+ *
+ *   input  - reads the player's lines, queues them
+ *   engine - applies them to the board (the caller's thread)
+ *   render - draws frames captured by the engine
+ *
+ * The engine captures the viewport into one of two frame
+ * buffers and hands it over; the renderer hands it back
+ * when it's drawn.  If both buffers are out the engine just
+ * keeps going and captures once one comes back, and the
+ * renderer only draws the newest frame it has, so a slow
+ * terminal never holds up moves.
+ *
+ * Only the renderer writes to stdout.  Messages from the
+ * board, the viewport and hints are collected by the engine
+ * and go out with the next frame.  The input thread waits
+ * on stdin and on a pipe that run() writes to when the game
+ * ends, so it can be joined.
+ *
+ * Hints and autosaves don't hold up moves either.  The
+ * engine only packs the board's planes (see snapshot_pack)
+ * and hands them to a job thread: the hint job searches a
+ * copy of the position and its answer goes out with the
+ * frame after it is done, the save job writes the snapshot.
+ * Each has at most one job running.  A save starts once
+ * the input has gone idle after a move, so a burst of moves
+ * costs one save.
+ *
+ */
+#ifndef GAME_LOOP_H
+#define GAME_LOOP_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <semaphore.h>
+
+#include "Board.h"
+#include "Viewport.h"
+#include "Endgame.h"
+#include "SpscQueue.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define GAME_LOOP_INPUT_QUEUE   64
+#define GAME_LOOP_FRAMES        2
+#define GAME_LOOP_READ_CHUNK    4096
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct GameLoop
+{
+ private:
+    Board* board;
+    Viewport* viewport;
+    const char* snapshot_path;
+
+    /* input -> engine, NULL once input is closed */
+    SpscQueue<std::string*, GAME_LOOP_INPUT_QUEUE> input_queue;
+    /* engine -> render, and back */
+    SpscQueue<view_frame*, GAME_LOOP_FRAMES> ready_queue;
+    SpscQueue<view_frame*, GAME_LOOP_FRAMES> free_queue;
+    view_frame frames[GAME_LOOP_FRAMES];
+
+    /* Only for sleeping when there's nothing to do */
+    sem_t engine_wake;
+    sem_t render_wake;
+
+    /* Tells the input thread to stop waiting for input */
+    int quit_pipe[2];
+    std::atomic<bool> stopping;
+
+    /* Messages for the next frame (engine only) */
+    std::string messages;
+
+    uint64_t frames_drawn, frames_skipped;
+
+    /* Answers H once few squares are in doubt */
+    EndgameSolver advisor;
+
+    /* Jobs: the image is the job's own until it says done,
+     * the hint's text too */
+    std::thread hint_job, save_job;
+    std::atomic<bool> hint_done, save_done;
+    std::vector<uint8_t> hint_image, save_image;
+    std::string hint_text;
+    bool unsaved;           /* moves since the last save began */
+
+    void input_thread();
+    bool queue_words(std::string* pending, bool all);
+    bool queue_line(std::string* line);
+    void render_thread();
+    void hint();
+    void hint_thread();
+    void save();
+    void save_thread();
+    bool finish_jobs(bool wait);
+
+ public:
+    // Constructions
+    GameLoop(Board* _board, Viewport* _viewport, const char* _snapshot_path);
+
+    // Destructor
+    ~GameLoop();
+
+    // Methods
+    bool run();
+    uint64_t get_frames_drawn();
+    uint64_t get_frames_skipped();
+};
+
+#endif /* GAME_LOOP_H */
@@ -0,0 +1,75 @@
+/* hdr/Journal.h
+ *
+ * Append-only journal of per-move board deltas, used for
+ * undo and redo.  Each entry only holds the squares whose
+ * state a move changed, so memory per move is proportional
+ * to what the move (or its cascade) touched.
+ *
+ * Its bytes count under MEM_BOARD, except while the board
+ * is parked (see hdr/ParkedBoard.h), when they count under
+ * MEM_PARKED.
+ *
+ */
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "MemStats.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* One square whose state changed */
+typedef struct
+{
+    int index;
+    uint8_t old_state;
+    uint8_t new_state;
+} cell_change;
+
+/* Everything about a move except the squares */
+typedef struct
+{
+    int revealed_delta;
+    uint8_t flags_before;
+    uint8_t flags_after;
+} move_delta;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct Journal
+{
+ private:
+    mem_vector<uint8_t, MEM_BOARD> bytes;
+    mem_vector<size_t, MEM_BOARD> entry_offsets;
+    size_t cursor;
+
+    bool decode(size_t entry, std::vector<cell_change>& changes,
+                move_delta* delta);
+
+ public:
+    // Constructions
+    Journal();
+
+    // Methods
+    void record(std::vector<cell_change>& changes, move_delta delta);
+    bool step_back(std::vector<cell_change>& changes, move_delta* delta);
+    bool step_forward(std::vector<cell_change>& changes, move_delta* delta);
+    void clear();
+    void swap(Journal& other);
+    void trim(size_t max_bytes);
+
+    bool can_undo();
+    bool can_redo();
+    size_t memory_bytes();
+};
+
+#endif /* JOURNAL_H */
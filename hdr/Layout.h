@@ -0,0 +1,51 @@
+/* hdr/Layout.h
+ *
+ * Mine layouts without a Board.  Generates the exact layout
+ * Board(rows, columns, mines, topology, seed) would, straight
+ * into a packed bitplane (see Board::pack_mines), and scores
+ * it, on flat arrays that can be reused from board to board.
+ * Meant for tools that churn through millions of boards.
+ *
+ */
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <vector>
+
+#include "Topology.h"
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct LayoutGenerator
+{
+ private:
+    int rows, columns, mines, cells;
+    std::vector<int> neighbors;             /* cells x NUM_NEIGHBORS */
+    std::vector<uint8_t> neighbor_count;
+    std::vector<uint8_t> mine;
+    std::vector<uint8_t> number;
+    std::vector<uint8_t> covered;
+    std::vector<int> stack;
+    int bbbv;
+    int openings;
+
+    void score();
+
+ public:
+    // Constructions
+    LayoutGenerator(int _rows, int _columns, int _mines,
+                    board_topology topology);
+
+    // Methods
+    void generate(unsigned int seed, uint8_t* plane);
+    void load(const uint8_t* plane);
+    int get_3bv();
+    int get_openings();
+};
+
+#endif /* LAYOUT_H */
@@ -0,0 +1,126 @@
+/* hdr/MemStats.h
+ *
+ * Opt-in memory accounting.  Allocations are tagged with
+ * the subsystem that made them, either through
+ * TrackedAllocator (for containers) or by calling
+ * mem_note_alloc / mem_note_free next to new and malloc.
+ * Per tag it keeps live bytes, peak live bytes and the
+ * number of allocations; Board counts moves, so
+ * allocations per move can be watched for regressions.
+ *
+ * Nothing is counted until mem_enable(true).  Turn it on
+ * at startup, before anything to be counted is allocated,
+ * or frees of earlier allocations will be counted against
+ * later ones.
+ *
+ */
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef enum
+{
+    MEM_BOARD = 0,      /* squares, openings, journal */
+    MEM_PARSER,         /* move parsing */
+    MEM_RENDER,         /* viewport frames */
+    MEM_SOLVER,         /* forks and endgame search */
+    MEM_LOG,            /* event log buffers */
+    MEM_PARKED,         /* idle boards packed by the server */
+    NUM_MEM_TAGS
+} mem_tag;
+
+typedef struct
+{
+    int64_t live_bytes;
+    int64_t peak_bytes;
+    uint64_t allocations;
+    uint64_t frees;
+} mem_usage;
+
+typedef struct
+{
+    mem_usage tag[NUM_MEM_TAGS];
+    uint64_t moves;
+} mem_stats;
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+void mem_enable(bool on);
+bool mem_enabled();
+void mem_note_alloc(mem_tag tag, size_t bytes);
+void mem_note_free(mem_tag tag, size_t bytes);
+void mem_note_retag(mem_tag from, mem_tag to, size_t bytes);
+void mem_note_move();
+void mem_get_stats(mem_stats* stats);
+void mem_set_budget(mem_tag tag, int64_t bytes);
+bool mem_over_budget(mem_tag tag);
+const char* mem_tag_name(mem_tag tag);
+void mem_report(std::string* text);
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+
+/* std::allocator that counts against a tag */
+template <class T, mem_tag TAG>
+struct TrackedAllocator
+{
+    typedef T value_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef TrackedAllocator<U, TAG> other;
+    };
+
+    TrackedAllocator() {}
+
+    template <class U>
+    TrackedAllocator(const TrackedAllocator<U, TAG>&) {}
+
+    T* allocate(size_t n)
+    {
+        mem_note_alloc(TAG, n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        mem_note_free(TAG, n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <class U>
+    bool operator==(const TrackedAllocator<U, TAG>&) const
+    {
+        return true;
+    }
+
+    template <class U>
+    bool operator!=(const TrackedAllocator<U, TAG>&) const
+    {
+        return false;
+    }
+};
+
+/* Containers counted against a tag */
+template <class T, mem_tag TAG>
+using mem_vector = std::vector<T, TrackedAllocator<T, TAG> >;
+
+template <mem_tag TAG>
+using mem_string = std::basic_string<char, std::char_traits<char>,
+                                     TrackedAllocator<char, TAG> >;
+
+#endif /* MEM_STATS_H */
@@ -0,0 +1,43 @@
+/* hdr/Mines.h
+ *
+ * Mine placement that can run on many threads and still
+ * deal the same board for a seed on any number of them.
+ *
+ * The board's squares, in row major order, are cut into
+ * tiles of MINES_TILE_CELLS.  How many mines each tile gets
+ * is decided top down: a range of tiles is halved and the
+ * left half's share of the range's mines is drawn from the
+ * hypergeometric distribution, so the counts follow the
+ * multivariate hypergeometric split and always add up to
+ * the board's mine count.  Each tile then places its mines
+ * with its own stream of a counter based generator
+ * (Philox4x32-10) keyed by the seed and the tile number.
+ * No draw depends on which thread makes it or in which
+ * order, and tiles own whole bytes of the packed plane, so
+ * tiles are filled in parallel without locks.
+ *
+ */
+#ifndef MINES_H
+#define MINES_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define MINES_TILE_SHIFT    12
+#define MINES_TILE_CELLS    (1 << MINES_TILE_SHIFT)
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+void philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                uint32_t out[4]);
+int64_t mines_hypergeometric(int64_t total, int64_t good, int64_t draws,
+                             double u);
+void mines_place(int cells, int mines, uint32_t seed, uint8_t* plane);
+
+#endif /* MINES_H */
@@ -0,0 +1,71 @@
+/* hdr/ParkedBoard.h
+ *
+ * A board put away while nobody plays it.  A live Board
+ * holds a Square (with its neighbor links) per cell, plus
+ * openings and scratch space; a parked one only keeps:
+ *
+ *   - the mines, one bit per square (see Board::pack_mines)
+ *   - the square states, run length encoded: a varint
+ *     ((run - 1) << 2 | state) per run of equal states in
+ *     row-major order
+ *   - the undo history, handed over as is (it is already
+ *     a compact journal, see hdr/Journal.h).  Its bytes
+ *     are counted under MEM_PARKED while parked and go back
+ *     to MEM_BOARD on wake, so parking frees room in a
+ *     board budget.
+ *   - size, topology, seed, revealed count and game flags
+ *
+ * Waking it builds a new Board on the same mines, which
+ * recomputes the numbers, neighbors and openings, then
+ * restores the states and gives the history back.  The
+ * board's state hash comes back the same.
+ *
+ * What a board does not keep across parking: its event
+ * log, spectators and verbose setting, which belong to its
+ * owner.
+ *
+ */
+#ifndef PARKED_BOARD_H
+#define PARKED_BOARD_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Board.h"
+#include "Journal.h"
+#include "MemStats.h"
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct ParkedBoard
+{
+ private:
+    int rows, columns, mines;
+    board_topology topology;
+    unsigned int seed;
+    int squares_revealed;
+    bool game_over, game_won;
+
+    /* Mine plane, then the state runs from runs_offset on */
+    mem_vector<uint8_t, MEM_PARKED> bytes;
+    size_t runs_offset;
+    Journal journal;
+
+ public:
+    // Constructions
+    ParkedBoard( Board* board );
+
+    // Destructor
+    ~ParkedBoard();
+
+    // Methods
+    Board* wake();
+    bool is_game_over();
+    size_t get_bytes();
+};
+
+#endif /* PARKED_BOARD_H */
@@ -0,0 +1,164 @@
+/* hdr/ReplayIndex.h
+ *
+ * Random access to the moves of one recorded game.  An
+ * event log only holds the moves, so looking at move
+ * 50,000 means replaying the 49,999 before it.  A replay
+ * index holds, for every move, the squares it changed, and
+ * every `interval` moves a checkpoint of the whole board.
+ * Any move is then reached from the checkpoint at or before
+ * it plus at most interval - 1 moves, however long the
+ * game is.  Undos and redos are moves like any other, so
+ * seeking never needs the journal.
+ *
+ * File layout:
+ *   replay_index_header
+ *   the moves, in order, with a checkpoint before move 1
+ *   and after every interval moves.  A checkpoint is the
+ *   packed 2 bit state plane (see Board::pack_states).  A
+ *   move is:
+ *     varint number of squares it changed
+ *     per square, in index order, varint
+ *       (index - previous index) << 2 | new state
+ *     varint zigzag(revealed after - before) << 2 | flags
+ *       after (GAME_FLAG_OVER, GAME_FLAG_WON)
+ *   table: one replay_checkpoint per checkpoint
+ *
+ * A bigger interval means fewer planes to store and more
+ * moves to replay per seek: a checkpoint costs
+ * (rows*columns+3)/4 bytes, a move a few bytes per square.
+ *
+ */
+#ifndef REPLAY_INDEX_H
+#define REPLAY_INDEX_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "Board.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define REPLAY_INDEX_MAGIC      "MSWPRIDX"
+#define REPLAY_INDEX_VERSION    1
+#define REPLAY_INDEX_INTERVAL   1024
+
+/* Moves are gathered up to this size before each write() */
+#define REPLAY_INDEX_WRITE_BUFFER   (4 << 20)
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* On-disk header, little endian */
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t  rows;
+    int32_t  columns;
+    int32_t  mines;
+    uint32_t topology;
+    uint32_t seed;
+    uint32_t game;              /* id in the event log */
+    uint32_t interval;          /* moves between checkpoints */
+    uint32_t pad;
+    uint64_t moves;
+    uint64_t checkpoints;
+    uint64_t table_offset;
+} replay_index_header;
+
+/* On-disk table entry; checkpoint i is the board after
+ * move i * interval */
+typedef struct
+{
+    uint64_t offset;            /* of the plane; the next move follows it */
+    int32_t  squares_revealed;
+    uint8_t  flags;
+    uint8_t  pad[3];
+} replay_checkpoint;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+
+/* Builds the index of a game as it is replayed */
+struct ReplayIndexWriter
+{
+ private:
+    int fd;
+    std::string path, temp_path;
+    replay_index_header header;
+    std::vector<replay_checkpoint> table;
+    std::vector<uint8_t> pending;
+    uint64_t offset;
+    uint64_t plane_bytes;
+
+    /* Squares changed by the move so far, marked in seen */
+    std::vector<int> changed;
+    std::vector<uint8_t> seen;
+    int revealed;
+
+    void checkpoint(Board* board);
+    bool flush();
+
+ public:
+    // Constructions
+    ReplayIndexWriter();
+
+    // Destructor
+    ~ReplayIndexWriter();
+
+    // Methods
+    bool open(const char* _path, Board* board, uint32_t game,
+              int interval);
+    void note_changes(Board* board);
+    bool add_move(Board* board);
+    bool close();
+    uint64_t get_bytes();
+    uint64_t get_checkpoint_bytes();
+    uint64_t get_moves();
+};
+
+/* Seeks to any move of an indexed game */
+struct ReplayIndex
+{
+ private:
+    const uint8_t* image;
+    size_t size;
+    const replay_index_header* header;
+    const replay_checkpoint* table;
+    int cells, plane_bytes;
+    std::vector<uint8_t> plane;
+
+    /* What the last seek left a board in, so the next seek
+     * on it only sets the squares that differ */
+    std::vector<uint8_t> shown;
+    Board* shown_board;
+    uint64_t shown_hash;
+
+ public:
+    // Constructions
+    ReplayIndex();
+
+    // Destructor
+    ~ReplayIndex();
+
+    // Methods
+    bool open(const char* path);
+    void close();
+
+    const replay_index_header* get_header();
+    Board* new_board();
+    bool read_state(uint64_t move, uint8_t* out, int* revealed,
+                    bool* over, bool* won, int* replayed);
+    bool seek(uint64_t move, Board* board, int* replayed);
+};
+
+#endif /* REPLAY_INDEX_H */
@@ -0,0 +1,159 @@
+/* hdr/Sampler.h
+ *
+ * Approximate mine probabilities for positions too big to
+ * enumerate (see hdr/Endgame.h for the exact advisor).
+ *
+ * Every unrevealed square is either on the frontier (next
+ * to a revealed number) or in the interior.  A layout puts
+ * the board's mines on the unrevealed squares; it is
+ * consistent if every revealed number sees as many mines as
+ * it shows.  All consistent layouts are equally likely, so a
+ * square's chance of being a mine is the share of them it
+ * is a mine in.
+ *
+ * Several Markov chains, one per thread, walk over layouts
+ * by swapping a mine with a free square, which keeps the
+ * mine count.  Interior squares are interchangeable, so a
+ * chain only keeps which frontier squares are mines and how
+ * many interior ones are.  A chain may pass through
+ * layouts that break some numbers: a swap that adds d to the
+ * total amount the numbers are off by is accepted with
+ * chance exp(-SAMPLER_PENALTY * d) (Metropolis).  Within the
+ * consistent layouts the chain's stationary distribution is
+ * still uniform, and only consistent layouts are counted.
+ *
+ * Every chain is split into halves for the diagnostic: the
+ * potential scale reduction (R-hat) of every frontier
+ * square's mine frequency over all half chains.  Values
+ * near 1 mean the chains agree.
+ *
+ * Only what the player sees is used: revealed numbers and
+ * the mine count.  Marks are treated as unknown squares.
+ *
+ */
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <vector>
+
+#include "Board.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+/* Cost of each mine a number is off by, in the exponent:
+ * while looking for a first consistent layout, then to
+ * start burn in from.  Burn in moves it by steps within the
+ * bounds, up while less than SAMPLER_CONSISTENT of every
+ * SAMPLER_TUNE_STEPS steps are consistent, down otherwise,
+ * and it stays put while counting. */
+#define SAMPLER_SEARCH_PENALTY  1.5
+#define SAMPLER_PENALTY         4.0
+#define SAMPLER_MIN_PENALTY     1.0
+#define SAMPLER_MAX_PENALTY     16.0
+#define SAMPLER_PENALTY_STEP    0.25
+#define SAMPLER_CONSISTENT      0.10
+#define SAMPLER_TUNE_STEPS      1024
+
+/* Swaps change how far off the numbers are by at most
+ * 2 * NUM_NEIGHBORS */
+#define SAMPLER_MAX_DELTA       (2 * NUM_NEIGHBORS)
+
+/* Quarters of the steps that swap two squares next to the
+ * same number; the rest swap any two (see run_chain) */
+#define SAMPLER_LOCAL_QUARTERS  3
+
+/* Steps a chain makes between looks at the clock */
+#define SAMPLER_CLOCK_STEPS     1024
+
+/* A chain that has found a consistent layout makes this
+ * many sweeps (steps per frontier square), and at least
+ * this many tuning rounds, before counting */
+#define SAMPLER_BURN_IN_SWEEPS  20
+#define SAMPLER_BURN_IN_TUNES   64
+
+/* cell_slot of squares that are not on the frontier */
+#define SAMPLER_REVEALED        -1
+#define SAMPLER_INTERIOR        -2
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef struct
+{
+    int frontier;               /* unrevealed squares next to a number */
+    int interior;               /* other unrevealed squares */
+    int constraints;            /* numbers next to the frontier */
+    int chains;
+    int mixed;                  /* chains that found a consistent layout */
+    uint64_t steps;             /* over all chains */
+    uint64_t accepted;          /* swaps made */
+    uint64_t samples;           /* consistent layouts counted */
+    double consistent;          /* share of steps spent consistent */
+    double max_rhat;            /* worst frontier square */
+    double interior_probability;
+    int row, column;            /* least likely mine, 0 based */
+    double safest;              /* its chance of being a mine */
+    double milliseconds;
+} sampler_result;
+
+/* One chain's counts, for each half of its run */
+typedef struct
+{
+    std::vector<uint64_t> mine_counts[2];   /* per frontier square */
+    uint64_t interior_mines[2];             /* summed over samples */
+    uint64_t samples[2];
+    uint64_t steps, accepted, consistent_steps;
+    double penalty;                         /* what burn in settled on */
+    bool mixed;
+} sampler_chain;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct MineSampler
+{
+ private:
+    int threads;
+    int columns;
+
+    /* The position.  Frontier squares are slots
+     * 0..frontier-1; slot_constraints[slot_start[s] ..
+     * slot_start[s+1]) are the numbers next to slot s, and
+     * constraint_slots[constraint_start[c] ..
+     * constraint_start[c+1]) the slots next to number c. */
+    int frontier, interior, mines;
+    std::vector<int> cell_slot;
+    std::vector<int> slot_cells;
+    std::vector<int> slot_start;
+    std::vector<int> slot_constraints;
+    std::vector<int> constraint_values;
+    std::vector<int> constraint_start;
+    std::vector<int> constraint_slots;
+    std::vector<int> near_start;
+    std::vector<int> near_slots;
+    std::vector<sampler_chain> chains;
+
+    /* Chance of each unrevealed square being a mine, by
+     * square (row major), 0 for revealed ones */
+    std::vector<double> probabilities;
+
+    bool read_board( Board* board );
+    void run_chain( int chain, uint64_t seed, uint64_t deadline_ns );
+    void merge( sampler_result* result );
+
+ public:
+    // Constructions
+    MineSampler( int _threads );
+
+    // Methods
+    bool sample( Board* board, double budget_ms, uint64_t seed,
+                 sampler_result* result );
+    double get_probability( int row, int column );
+};
+
+#endif /* SAMPLER_H */
@@ -0,0 +1,255 @@
+/* hdr/Server.h
+ *
+ * Multi-session game server.  Hosts many boards keyed by
+ * session id and speaks a line based protocol over a local
+ * TCP or Unix socket:
+ *
+ *   NEW <rows> <columns> <mines> [topology]  -> OK <session>
+ *   ATTACH <session>                         -> OK <session>
+ *   <moves, as typed in the game>            -> OK <status> <revealed>
+ *   BOARD                                    -> <rows> lines, then END
+ *   CLOSE                                    -> OK
+ *   WATCH <session>                          -> OK <session>
+ *   VIEW                                     -> <rows> lines, then
+ *                                               END <status> <revealed> <frame>
+ *   UNWATCH                                  -> OK
+ *
+ * where <status> is PLAYING, WON or LOST.  Errors are
+ * answered with "ERR <reason>".  Two memory budgets can be
+ * set:
+ *
+ *   - a process wide one for all boards (MEM_BOARD, see
+ *     hdr/MemStats.h): while it is used up, every NEW is
+ *     refused with "ERR memory budget"
+ *   - a per session one (set_session_budget): NEW for a
+ *     board whose squares alone would not fit is refused
+ *     with "ERR session memory budget".  A board whose
+ *     squares, undo history and tables (see
+ *     Board::get_memory_bytes) outgrow it forgets its oldest
+ *     undo steps (see Board::trim_history); only if that is
+ *     not enough are its moves refused the same way.  CLOSE
+ *     or NEW still work.
+ *
+ * Sessions are sharded across worker threads, each with its
+ * own epoll loop and session table, so there is no global
+ * lock.  A session id names the worker that owns it.  A
+ * connection that attaches to a session owned by another
+ * worker is handed over to that worker once, through the
+ * owner's inbox.
+ *
+ * With set_spectating, every session also publishes a
+ * frame after each move (see hdr/Spectate.h).  WATCH finds
+ * the session's feed through a table shared by the workers
+ * and does not move the connection; VIEW then reads the
+ * latest frame on the watcher's own worker, without ever
+ * waiting for (or holding up) the player's worker.  A
+ * watcher can still VIEW the last frame of a closed game.
+ *
+ * With set_pool, NEW takes a ready board from a BoardPool
+ * (see hdr/BoardPool.h) when it keeps that size, and only
+ * builds one itself on a miss.
+ *
+ * With set_park_after, a session nobody has moved in (or
+ * asked for the BOARD of) for that long is parked: its
+ * board is packed into a ParkedBoard (see hdr/ParkedBoard.h)
+ * and freed.  The next request that needs the board wakes
+ * it, which the client only sees as a slower answer.  Wake
+ * times are counted in the stats.
+ *
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "Board.h"
+#include "Spectate.h"
+#include "BoardPool.h"
+#include "ParkedBoard.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define SERVER_MAX_WORKERS      256
+#define SERVER_MAX_LINE         4096
+#define SERVER_MAX_BOARD_SIDE   1000
+
+/* Idle sessions are looked for this many times per
+ * parking period, so one is parked at most a quarter
+ * period late */
+#define SERVER_PARK_CHECKS      4
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* One hosted game */
+typedef struct
+{
+    uint64_t id;
+    Board* board;           /* NULL while parked */
+    ParkedBoard* parked;    /* NULL unless parked */
+    uint64_t last_used_ns;  /* last time the board was needed */
+    SpectatorFeed* feed;    /* NULL unless spectating is on */
+} server_session;
+
+/* One client connection */
+typedef struct
+{
+    int fd;
+    std::string in;
+    std::string out;
+    uint64_t session;
+    bool want_write;
+    SpectatorFeed* watching;    /* WATCHed feed, or NULL */
+    int reader;                 /* reader slot in it */
+    uint64_t attaching;         /* session to attach to once handed over */
+} server_connection;
+
+/* Counters kept by each worker */
+typedef enum
+{
+    STAT_CONNECTIONS = 0,   /* connections accepted */
+    STAT_SESSIONS,          /* sessions currently hosted */
+    STAT_REQUESTS,          /* lines handled */
+    STAT_MOVES,             /* move lines applied */
+    STAT_HANDOFFS,          /* connections handed to another worker */
+    STAT_WATCHERS,          /* connections currently watching */
+    STAT_VIEWS,             /* frames sent to watchers */
+    STAT_PARKED,            /* sessions currently parked */
+    STAT_PARKED_BYTES,      /* memory they hold */
+    STAT_PARKS,             /* sessions parked */
+    STAT_WAKES,             /* parked sessions woken */
+    STAT_WAKE_NS,           /* time spent waking them */
+    STAT_MAX_WAKE_NS,       /* slowest wake (max over workers) */
+    STAT_OVER_BUDGET,       /* requests refused by the session budget */
+    NUM_SERVER_STATS
+} server_stat;
+
+/* Counters summed over workers by GameServer::get_stats */
+typedef struct
+{
+    uint64_t value[NUM_SERVER_STATS];
+    mem_stats memory;       /* whole process, if accounting is on */
+    pool_stats pool;        /* board pool, if there is one */
+} server_stats;
+
+struct GameServer;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct ServerWorker
+{
+ private:
+    GameServer* server;
+    int index;
+    int epoll_fd;
+    int inbox_fd;
+    uint64_t next_session;
+    std::unordered_map<uint64_t, server_session*> sessions;
+    std::unordered_map<int, server_connection*> connections;
+
+    std::mutex inbox_lock;
+    std::vector<server_connection*> inbox;
+
+    std::atomic<uint64_t> stats[NUM_SERVER_STATS];
+    unsigned int rand_state;
+    uint64_t next_park_check_ns;
+
+    void accept_connections();
+    void drain_inbox();
+    void handle_input(server_connection* conn);
+    bool handle_line(server_connection* conn, std::string& line,
+                     size_t consumed);
+    void handle_new(server_connection* conn, const char* args);
+    bool handle_attach(server_connection* conn, const char* args,
+                       size_t consumed);
+    void attach(server_connection* conn, uint64_t id);
+    void handle_moves(server_connection* conn, std::string& line);
+    void handle_board(server_connection* conn);
+    void handle_close(server_connection* conn);
+    void handle_watch(server_connection* conn, const char* args);
+    void handle_view(server_connection* conn);
+    void unwatch(server_connection* conn);
+    void end_session(uint64_t id);
+    void flush_output(server_connection* conn);
+    void drop_connection(server_connection* conn);
+    void watch(server_connection* conn, int op);
+    server_session* find_session(uint64_t id);
+    Board* board_of(server_session* session);
+    void park_idle();
+    void park(server_session* session);
+
+ public:
+    // Constructions
+    ServerWorker(GameServer* _server, int _index);
+
+    // Destructor
+    ~ServerWorker();
+
+    // Methods
+    void run();
+    void wake();
+    void hand_over(server_connection* conn);
+    server_stats get_stats();
+};
+
+struct GameServer
+{
+ private:
+    int listen_fd;
+    int num_workers;
+    std::vector<ServerWorker*> workers;
+    std::vector<std::thread> threads;
+    
+    BoardPool* pool;
+    int pool_threads;
+    
+    bool spectating;
+    uint64_t park_after_ns;
+    size_t session_budget;
+    std::mutex feeds_lock;
+    std::unordered_map<uint64_t, SpectatorFeed*> feeds;
+
+ public:
+    std::atomic<bool> stopping;
+
+    // Constructions
+    GameServer();
+
+    // Destructor
+    ~GameServer();
+
+    // Methods
+    bool listen_tcp(int port);
+    bool listen_unix(const char* path);
+    void start(int _num_workers);
+    void stop();
+    void set_spectating(bool on);
+    void set_pool(BoardPool* _pool, int threads);
+    BoardPool* get_pool();
+    void set_park_after(double seconds);
+    uint64_t get_park_after_ns();
+    void set_session_budget(size_t bytes);
+    size_t get_session_budget();
+    bool get_spectating();
+    void share_feed(uint64_t session, SpectatorFeed* feed);
+    void unshare_feed(uint64_t session);
+    SpectatorFeed* find_feed(uint64_t session);
+
+    int get_listen_fd();
+    ServerWorker* owner_of(uint64_t session);
+    server_stats get_stats();
+};
+
+#endif /* SERVER_H */
@@ -0,0 +1,64 @@
+/* hdr/Snapshot.h
+ *
+ * Binary snapshot of a board.  The file is a fixed header
+ * followed by a packed mine bitplane and a packed 2 bit
+ * state plane, so it can be written in one write() and
+ * mapped back in without any parsing.
+ *
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "Board.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define SNAPSHOT_MAGIC    "MSWPSNAP"
+#define SNAPSHOT_VERSION  1
+
+/* Flags */
+#define SNAPSHOT_GAME_OVER  0x1
+#define SNAPSHOT_GAME_WON   0x2
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* On-disk header.  All fields little endian, planes start
+ * on 8 byte boundaries relative to the start of the file */
+typedef struct
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t  rows;
+    int32_t  columns;
+    int32_t  mines;
+    uint32_t topology;
+    uint32_t seed;
+    uint32_t flags;
+    int64_t  squares_revealed;
+    uint64_t mine_plane_offset;
+    uint64_t mine_plane_bytes;
+    uint64_t state_plane_offset;
+    uint64_t state_plane_bytes;
+} snapshot_header;
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+bool snapshot_save(Board* board, const char* path);
+void snapshot_pack(Board* board, std::vector<uint8_t>* image);
+bool snapshot_write(const std::vector<uint8_t>& image, const char* path);
+Board* snapshot_load(const char* path);
+Board* snapshot_board(const uint8_t* image, size_t bytes);
+
+#endif /* SNAPSHOT_H */
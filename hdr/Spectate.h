@@ -0,0 +1,160 @@
+/* hdr/Spectate.h
+ *
+ * Live views of a game for spectators, read without ever
+ * blocking the player or being blocked by them.
+ *
+ * A SpectatorFeed belongs to one board (see
+ * Board::set_spectators).  After every move the board
+ * publishes an immutable spectate_frame: what the player
+ * sees, one char per square (see Board::square_char), cut
+ * into tiles of SPECTATE_TILE_SIDE x SPECTATE_TILE_SIDE,
+ * reached through pages of SPECTATE_PAGE_TILES tiles (as a
+ * BoardFork's are, see hdr/Fork.h).  Only the tiles the
+ * move changed are copied, and only its squares drawn
+ * again; the rest are shared with the previous frame, as
+ * are the pages with no changed tile in them.  So a move
+ * costs its squares, a copy of each tile they are in and
+ * of each page on the way to those, and one pointer per
+ * page.
+ *
+ * Readers, on any thread, join the feed once and then
+ * bracket every look at a frame with enter() and exit().
+ * Old frames and tiles are freed through an EpochDomain
+ * once no reader can still be looking at them.
+ *
+ * The feed is reference counted: the board's owner holds
+ * one reference and every reader another, so readers can
+ * keep looking at the last frame after the game is gone.
+ *
+ */
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "Board.h"
+#include "Epoch.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define SPECTATE_TILE_SHIFT     5
+#define SPECTATE_TILE_SIDE      (1 << SPECTATE_TILE_SHIFT)
+#define SPECTATE_TILE_CELLS     (SPECTATE_TILE_SIDE * SPECTATE_TILE_SIDE)
+
+/* Tiles per page.  A 1000x1000 board has 1024 tiles in 32
+ * pages, so a move copies 32 page pointers plus 32 tile
+ * pointers per page it changes. */
+#define SPECTATE_PAGE_SHIFT     5
+#define SPECTATE_PAGE_TILES     (1 << SPECTATE_PAGE_SHIFT)
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* Squares of one tile, row major; squares past the edge
+ * of the board are ' ' */
+typedef struct
+{
+    char squares[SPECTATE_TILE_CELLS];
+} spectate_tile;
+
+/* Tiles number (page << SPECTATE_PAGE_SHIFT) on; NULL past
+ * the last tile */
+typedef struct
+{
+    const spectate_tile* tiles[SPECTATE_PAGE_TILES];
+} spectate_page;
+
+/* One published view of the board.  Never changes once
+ * published. */
+typedef struct
+{
+    uint64_t version;           /* frames published before this one */
+    int rows, columns;
+    int tile_rows, tile_columns;
+    int num_pages;
+    int squares_revealed;
+    bool game_over;
+    bool game_won;
+    const spectate_page** pages;    /* tiles, row major, in pages */
+} spectate_frame;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct SpectatorFeed
+{
+ private:
+    std::atomic<int> refs;
+    std::atomic<spectate_frame*> latest;
+    EpochDomain epochs;
+
+    /* Writer only: squares changed since the last publish,
+     * and the tiles they are in */
+    std::vector<int> touched;
+    std::vector<uint8_t> dirty;
+    std::vector<int> dirty_tiles;
+    std::vector<uint8_t> page_dirty;
+    std::vector<int> dirty_pages;
+    
+    /* Writer only: marks drawn in each tile of the latest
+     * frame, the only squares that look different once the
+     * game is over */
+    std::vector<int> tile_marks;
+    int columns, tile_columns;
+    uint64_t reclaimed;
+
+    ~SpectatorFeed();
+    void build_tile(Board* board, spectate_frame* frame, int tile);
+    void copy_tile(const spectate_frame* old, spectate_frame* frame,
+                   int tile);
+    void copy_page(const spectate_frame* old, spectate_frame* frame,
+                   int page);
+    void draw_square(Board* board, spectate_frame* frame, int index);
+
+ public:
+    // Constructions
+    SpectatorFeed(Board* board);
+
+    // Methods (board owner)
+    void touch(int index)
+    {
+        int tile = ( (index / columns) >> SPECTATE_TILE_SHIFT ) * tile_columns +
+                   ( (index % columns) >> SPECTATE_TILE_SHIFT );
+
+        touched.push_back(index);
+        if (!dirty[tile])
+        {
+            dirty[tile] = 1;
+            dirty_tiles.push_back(tile);
+        }
+    }
+    void publish(Board* board);
+    uint64_t get_reclaimed();
+    size_t get_pending();
+
+    // Methods (anyone)
+    void retain();
+    void release();
+
+    // Methods (readers)
+    int join();
+    void leave(int reader);
+    const spectate_frame* enter(int reader);
+    void exit(int reader);
+};
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+char spectate_square(const spectate_frame* frame, int row, int column);
+void spectate_text(const spectate_frame* frame, std::string* text);
+
+#endif /* SPECTATE_H */
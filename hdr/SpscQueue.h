@@ -0,0 +1,89 @@
+/* hdr/SpscQueue.h
+ *
+ * Bounded lock-free queue for exactly one producer thread
+ * and one consumer thread.  Neither side ever blocks: push
+ * fails when the queue is full and pop fails when it is
+ * empty, and the caller decides whether to wait.
+ *
+ */
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <atomic>
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+template <class T, unsigned int SIZE>
+struct SpscQueue
+{
+    static_assert( (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2" );
+
+ private:
+    T items[SIZE];
+
+    /* Free running counters, on their own cache lines so
+     * the two threads don't fight over them */
+    alignas(64) std::atomic<unsigned int> head;     /* next pop */
+    alignas(64) std::atomic<unsigned int> tail;     /* next push */
+
+ public:
+    // Constructions
+    SpscQueue()
+    {
+        head = 0;
+        tail = 0;
+    }
+
+    // Methods
+
+    /* push (producer only)
+     *
+     * Returns: false if the queue is full
+     */
+    bool push(const T& item)
+    {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+
+        if (t - head.load(std::memory_order_acquire) == SIZE)
+        {
+            return false;
+        }
+        items[t & (SIZE - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* pop (consumer only)
+     *
+     * Returns: false if the queue is empty
+     */
+    bool pop(T* item)
+    {
+        unsigned int h = head.load(std::memory_order_relaxed);
+
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        *item = items[h & (SIZE - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* size (either side)
+     *
+     * Returns: items queued; only a hint while the other
+     *          side is running
+     */
+    unsigned int size()
+    {
+        return tail.load(std::memory_order_acquire) -
+               head.load(std::memory_order_acquire);
+    }
+};
+
+#endif /* SPSC_QUEUE_H */
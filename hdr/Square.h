@@ -4,6 +4,8 @@
  * on the board
  *
  */
+#ifndef SQUARE_H
+#define SQUARE_H
 
 /******************************************************
                         INCLUDES
@@ -20,6 +22,15 @@ typedef enum
     MARKED
 } square_state;
 
+struct Square;
+
+/* A square whose state was changed, and what it was before */
+typedef struct
+{
+    struct Square* square;
+    square_state old_state;
+} square_change;
+
 /******************************************************
                     CLASS DEFINITION
 *******************************************************/
@@ -33,7 +44,6 @@ struct Square
 #ifdef DEBUG_PRINTS
     int my_row, my_column;
 #endif    
-    int reveal_recurse(int num_revealed);
 
  public:
     // Constructions
@@ -47,24 +57,20 @@ struct Square
     void set_mine();
     
     square_state get_state();
+    void set_state( square_state s );
     
-    void set_top( Square* s );
-    void set_bottom( Square* s );
-    void set_left( Square* s );
-    void set_right( Square* s );
-    void set_top_left( Square* s );
-    void set_top_right( Square* s );
-    void set_bottom_left( Square* s );
-    void set_bottom_right( Square* s );
+    void set_neighbor( int direction, Square* s );
+    Square* get_neighbor( int direction );
 
     int get_neighbor_mines();
     void calc_neighbor_mines();
     
     void mark();
-    int reveal();
 
 #ifdef DEBUG_PRINTS
     void set_row(int _row);
     void set_column(int _col);
 #endif
-}; 
\ No newline at end of file
+}; 
+
+#endif /* SQUARE_H */
@@ -0,0 +1,240 @@
+/* hdr/Topology.h
+ *
+ * Board topology policies.  Each policy supplies the
+ * neighbor offsets and edge handling of one board shape
+ * at compile time, so code templated on a policy pays
+ * no virtual call or runtime branch per neighbor visit.
+ *
+ */
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include "common.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef enum
+{
+    TOPOLOGY_SQUARE = 0,
+    TOPOLOGY_TORUS,
+    TOPOLOGY_HEX,
+    NUM_TOPOLOGIES
+} board_topology;
+
+/******************************************************
+                   TOPOLOGY POLICIES
+*******************************************************/
+
+/* SquareTopology
+ *
+ * Classic board: 8 neighbors, edges are walls
+ */
+struct SquareTopology
+{
+    static const int num_offsets = 8;
+
+    /* Neighbor slot used for offset n */
+    static inline int direction(int n)
+    {
+        static const int dir[num_offsets] = { TOP, BOTTOM, LEFT, RIGHT,
+                                              TOP_LEFT, TOP_RIGHT,
+                                              BOTTOM_LEFT, BOTTOM_RIGHT };
+        return dir[n];
+    }
+
+    /* Index of neighbor n of (row,column), -1 if off the board */
+    static inline int neighbor(int rows, int columns,
+                               int row, int column, int n)
+    {
+        static const int row_off[num_offsets] = { -1, 1,  0, 0, -1, -1, 1, 1 };
+        static const int col_off[num_offsets] = {  0, 0, -1, 1, -1,  1,-1, 1 };
+
+        row += row_off[n];
+        column += col_off[n];
+        if ( (row < 0) || (row >= rows) ||
+             (column < 0) || (column >= columns)
+           )
+        {
+            return -1;
+        }
+        return row*columns + column;
+    }
+
+    /* Characters to shift a row by when rendering */
+    static inline int row_indent(int row)
+    {
+        return 0;
+    }
+};
+
+/* TorusTopology
+ *
+ * 8 neighbors, edges wrap around to the opposite side
+ */
+struct TorusTopology
+{
+    static const int num_offsets = 8;
+
+    static inline int direction(int n)
+    {
+        return SquareTopology::direction(n);
+    }
+
+    static inline int neighbor(int rows, int columns,
+                               int row, int column, int n)
+    {
+        static const int row_off[num_offsets] = { -1, 1,  0, 0, -1, -1, 1, 1 };
+        static const int col_off[num_offsets] = {  0, 0, -1, 1, -1,  1,-1, 1 };
+
+        row += row_off[n];
+        column += col_off[n];
+        if (row < 0)         row += rows;
+        if (row >= rows)     row -= rows;
+        if (column < 0)      column += columns;
+        if (column >= columns) column -= columns;
+        return row*columns + column;
+    }
+
+    static inline int row_indent(int row)
+    {
+        return 0;
+    }
+};
+
+/* HexTopology
+ *
+ * 6 neighbors on an "odd-r" offset layout: odd rows are
+ * shifted half a square to the right.  Edges are walls.
+ */
+struct HexTopology
+{
+    static const int num_offsets = 6;
+
+    static inline int direction(int n)
+    {
+        static const int dir[num_offsets] = { TOP_LEFT, TOP_RIGHT,
+                                              LEFT, RIGHT,
+                                              BOTTOM_LEFT, BOTTOM_RIGHT };
+        return dir[n];
+    }
+
+    static inline int neighbor(int rows, int columns,
+                               int row, int column, int n)
+    {
+        static const int row_off[num_offsets]      = { -1, -1,  0, 0, 1, 1 };
+        static const int even_col_off[num_offsets] = { -1,  0, -1, 1,-1, 0 };
+        static const int odd_col_off[num_offsets]  = {  0,  1, -1, 1, 0, 1 };
+
+        column += (row & 1) ? odd_col_off[n] : even_col_off[n];
+        row += row_off[n];
+        if ( (row < 0) || (row >= rows) ||
+             (column < 0) || (column >= columns)
+           )
+        {
+            return -1;
+        }
+        return row*columns + column;
+    }
+
+    static inline int row_indent(int row)
+    {
+        return (row & 1);
+    }
+};
+
+/******************************************************
+                   TEMPLATE FUNCTIONS
+*******************************************************/
+
+/* topology_neighbors
+ *
+ * Lists the distinct neighbors of a square.  On small
+ * wrapping boards several offsets can land on the same
+ * square (or the square itself), those are only listed once.
+ *
+ * Inputs:  rows, columns - board size
+ *          index         - square to look around
+ * Outputs: out           - neighbor indices (NUM_NEIGHBORS max)
+ *          dirs          - neighbor slot of each index (may be NULL)
+ * Returns: number of neighbors written
+ */
+template <class Topology>
+inline int topology_neighbors(int rows, int columns, int index,
+                              int* out, int* dirs)
+{
+    int n, k, count = 0;
+    int row = index / columns;
+    int column = index % columns;
+    int neighbor;
+    bool seen;
+
+    for (n = 0; n < Topology::num_offsets; n++)
+    {
+        neighbor = Topology::neighbor(rows, columns, row, column, n);
+        if ( (neighbor < 0) || (neighbor == index) )
+        {
+            continue;
+        }
+        seen = false;
+        for (k = 0; k < count; k++)
+        {
+            seen |= (out[k] == neighbor);
+        }
+        if (seen)
+        {
+            continue;
+        }
+        if (dirs != NULL)
+        {
+            dirs[count] = Topology::direction(n);
+        }
+        out[count++] = neighbor;
+    }
+    return count;
+}
+
+/* board_neighbors
+ *
+ * Runtime-dispatched version of topology_neighbors for code
+ * off the hot paths.  Hot loops should switch on the topology
+ * once and call the template directly.
+ */
+inline int board_neighbors(board_topology topology, int rows, int columns,
+                           int index, int* out)
+{
+    switch (topology)
+    {
+    case TOPOLOGY_TORUS:
+        return topology_neighbors<TorusTopology>(rows, columns, index,
+                                                 out, NULL);
+    case TOPOLOGY_HEX:
+        return topology_neighbors<HexTopology>(rows, columns, index,
+                                               out, NULL);
+    default:
+        return topology_neighbors<SquareTopology>(rows, columns, index,
+                                                  out, NULL);
+    }
+}
+
+/* topology_name
+ *
+ * Human readable name of a topology
+ */
+inline const char* topology_name(board_topology topology)
+{
+    switch (topology)
+    {
+    case TOPOLOGY_TORUS:
+        return "torus";
+    case TOPOLOGY_HEX:
+        return "hex";
+    default:
+        return "square";
+    }
+}
+
+#endif /* TOPOLOGY_H */
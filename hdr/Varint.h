@@ -0,0 +1,86 @@
+/* hdr/Varint.h
+ *
+ * LEB128 style variable length integers: 7 bits per byte,
+ * high bit set on every byte but the last.  Small values
+ * (index deltas, counts) take a single byte.
+ *
+ */
+#ifndef VARINT_H
+#define VARINT_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define VARINT_MAX_BYTES 10
+
+/******************************************************
+                   INLINE FUNCTIONS
+*******************************************************/
+
+/* varint_encode
+ *
+ * Inputs:  value - value to encode
+ * Outputs: out   - at least VARINT_MAX_BYTES bytes
+ * Returns: number of bytes written
+ */
+inline size_t varint_encode(uint64_t value, uint8_t* out)
+{
+    size_t n = 0;
+
+    while (value >= 0x80)
+    {
+        out[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t) value;
+    return n;
+}
+
+/* varint_decode
+ *
+ * Inputs:  in  - encoded bytes
+ *          end - end of the buffer
+ * Outputs: value - decoded value
+ * Returns: pointer past the varint, NULL if truncated
+ */
+inline const uint8_t* varint_decode(const uint8_t* in, const uint8_t* end,
+                                    uint64_t* value)
+{
+    uint64_t result = 0;
+    int shift = 0;
+
+    while ( (in < end) && (shift < 64) )
+    {
+        result |= (uint64_t) (*in & 0x7f) << shift;
+        if ( (*in++ & 0x80) == 0 )
+        {
+            *value = result;
+            return in;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+/* zigzag_encode / zigzag_decode
+ *
+ * Maps signed values onto unsigned ones so that small
+ * magnitudes of either sign stay small
+ */
+inline uint64_t zigzag_encode(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value)
+{
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+#endif /* VARINT_H */
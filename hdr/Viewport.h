@@ -0,0 +1,104 @@
+/* hdr/Viewport.h
+ *
+ * Window onto a board that is too big for the terminal.
+ * Only the squares in the window are drawn, so drawing
+ * costs the same on a 9x9 board and a 1000x1000 one.
+ * Boards that do not fit get a minimap of how much of
+ * each region has been revealed next to the window.
+ *
+ * Navigation (see parse_input):
+ *   W, A, S, D       scroll up, left, down, right by half
+ *                    a window (repeat letters to go further)
+ *   G(row,column)    center the window on a square
+ *
+ */
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <string>
+#include <vector>
+
+#include "Board.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+/* Used when the terminal size can't be read (pipes) */
+#define VIEWPORT_DEFAULT_ROWS       24
+#define VIEWPORT_DEFAULT_COLUMNS    80
+
+/* Lines kept free for the header, status and prompt */
+#define VIEWPORT_RESERVED_ROWS      6
+
+/* Widest the minimap gets */
+#define MINIMAP_MAX_COLUMNS         24
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* Everything needed to draw the window once, copied out
+ * of the board so it can be drawn on another thread */
+typedef struct
+{
+    int top, left;
+    int view_rows, view_columns;
+    int board_rows, board_columns;
+    int label_width, cell_width, max_indent;
+    int map_rows, map_columns;
+    mem_vector<char, MEM_RENDER> squares;   /* view_rows x view_columns */
+    mem_vector<int, MEM_RENDER> indents;    /* per window row */
+    mem_vector<char, MEM_RENDER> minimap;   /* map_rows x map_columns */
+    mem_string<MEM_RENDER> messages;        /* printed before the window */
+    bool last;                      /* final frame of the game */
+} view_frame;
+
+/******************************************************
+                    CLASS DEFINITION
+*******************************************************/
+struct Viewport
+{
+ private:
+    Board* board;
+    int top, left;
+    int view_rows, view_columns;
+    int term_rows, term_columns;
+    int label_width, cell_width;
+    int map_rows, map_columns;
+    view_frame snapshot;
+    std::string text;
+    std::string* messages;
+
+    void layout();
+    void clamp();
+    char minimap_char(int map_row, int map_column);
+
+ public:
+    // Constructions
+    Viewport(Board* _board);
+
+    // Methods
+    void fit_terminal();
+    void set_messages(std::string* out);
+    void resize(int _term_rows, int _term_columns);
+    void scroll(int d_rows, int d_columns);
+    void jump(int row, int column);
+    bool parse_input(std::string user_input);
+    void render();
+    void capture(view_frame* frame);
+
+    int get_top();
+    int get_left();
+    int get_view_rows();
+    int get_view_columns();
+};
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+void frame_text(const view_frame* frame, std::string* text);
+
+#endif /* VIEWPORT_H */
@@ -1,6 +1,8 @@
 /* hdr/common.h
  * Contains defines common to all applications
  */
+#ifndef COMMON_H
+#define COMMON_H
 
 // Define this #define if you want to enable debug prints
 //#define DEBUG_PRINTS
@@ -27,3 +29,5 @@ typedef enum
     BOTTOM_RIGHT,
     NUM_NEIGHBORS
 } neighbor_directions;
+
+#endif /* COMMON_H */
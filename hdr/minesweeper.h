@@ -0,0 +1,93 @@
+/* hdr/minesweeper.h
+ *
+ * C ABI of libminesweeper: batched Minesweeper environments
+ * for reinforcement learning.
+ *
+ * A batch holds N boards of the same size in structure-of-
+ * arrays form.  One call steps every board with an array of
+ * actions.  Observations are written straight into a buffer
+ * the caller hands over at creation, so nothing is copied
+ * per step.  Boards that finish are reset on the spot and
+ * reported through `dones`.
+ *
+ * Observation of board b, square i: observations[b*rows*columns + i]
+ *   0..8              revealed, number of neighboring mines
+ *   MS_OBS_UNKNOWN    not revealed
+ *   MS_OBS_MARKED     marked as a mine
+ *
+ * Action of board b: actions[b]
+ *   0 .. rows*columns-1                  reveal that square
+ *   rows*columns .. 2*rows*columns-1     toggle mark on square
+ *                                        (action - rows*columns)
+ *
+ * Reward per step: -1 on a mine, +1 on a win, otherwise the
+ * fraction of safe squares the move revealed.
+ *
+ */
+#ifndef MINESWEEPER_H
+#define MINESWEEPER_H
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define MS_OBS_UNKNOWN  (-1)
+#define MS_OBS_MARKED   (-2)
+
+/* Topologies, same values as board_topology in Topology.h */
+#define MS_TOPOLOGY_SQUARE  0
+#define MS_TOPOLOGY_TORUS   1
+#define MS_TOPOLOGY_HEX     2
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef struct ms_batch ms_batch;
+
+/******************************************************
+                  FUNCTION DECLARATIONS
+*******************************************************/
+
+/* Creates a batch.  observations must hold
+ * num_boards*rows*columns bytes and stay valid until
+ * ms_batch_destroy.  Returns NULL on bad arguments. */
+ms_batch* ms_batch_create(int num_boards, int rows, int columns, int mines,
+                          int topology, uint64_t seed,
+                          int8_t* observations);
+
+void ms_batch_destroy(ms_batch* batch);
+
+/* Starts a fresh game on every board */
+void ms_batch_reset(ms_batch* batch);
+
+/* Steps every board.  rewards and dones hold num_boards
+ * entries (either may be NULL).  With num_threads > 1 the
+ * boards are split over that many worker threads, which are
+ * kept alive between calls. */
+void ms_batch_step(ms_batch* batch, const int32_t* actions,
+                   float* rewards, uint8_t* dones, int num_threads);
+
+/* Steps boards [begin, end) only, for callers that bring
+ * their own threads.  Disjoint ranges may be stepped
+ * concurrently.  actions/rewards/dones are indexed by board. */
+void ms_batch_step_range(ms_batch* batch, int begin, int end,
+                         const int32_t* actions, float* rewards,
+                         uint8_t* dones);
+
+/* Number of games finished so far, and how many were won */
+uint64_t ms_batch_games_played(ms_batch* batch);
+uint64_t ms_batch_games_won(ms_batch* batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MINESWEEPER_H */
@@ -0,0 +1,868 @@
+/* src/Archive.cc
+ *
+ * Writing and reading board archives
+ * (see hdr/Archive.h for the format)
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Archive.h"
+#include "Varint.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+/* Longest Rice quotient read back.  Gaps are below the
+ * number of squares, so anything longer is corrupt. */
+#define MAX_UNARY   0x7fffffffu
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* Little endian bit stream, least significant bit first */
+typedef struct
+{
+    std::vector<uint8_t>* out;
+    uint64_t acc;
+    int bits;
+} bit_writer;
+
+typedef struct
+{
+    const uint8_t* p;
+    const uint8_t* end;
+    uint64_t acc;
+    int bits;
+    bool truncated;
+} bit_reader;
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static bool write_all(int fd, const uint8_t* data, size_t bytes);
+static void put_bits(bit_writer* w, uint32_t value, int n);
+static void put_unary(bit_writer* w, uint32_t q);
+static void finish_bits(bit_writer* w);
+static void refill(bit_reader* r);
+static uint32_t get_bits(bit_reader* r, int n);
+static uint32_t get_unary(bit_reader* r);
+static uint64_t rice_bits(const std::vector<uint32_t>& gaps, int k);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: ArchiveWriter struct
+ */
+ArchiveWriter::ArchiveWriter()
+{
+    fd = -1;
+    offset = 0;
+    memset(&header, 0, sizeof(header));
+}
+
+/* Destructor
+ *
+ * Throws away an archive that was never closed
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+ArchiveWriter::~ArchiveWriter()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        unlink(temp_path.c_str());
+    }
+}
+
+/* open
+ *
+ * Starts a new archive.  It is written under a temporary
+ * name and only renamed into place by close().
+ *
+ * Inputs:  _path          - archive to create
+ *          rows, columns  - size of every board
+ *          mines          - mines per board
+ *          topology       - shape of every board
+ *          base_seed      - seed of board 0
+ *          block_boards   - boards per block
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ArchiveWriter::open(const char* _path, int rows, int columns, int mines,
+                         board_topology topology, uint32_t base_seed,
+                         int block_boards)
+{
+    path = _path;
+    temp_path = path + ".tmp";
+    fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        PRINT_INFO("\nERROR: Cannot create %s: %s\n",
+                   temp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+    header.header_size = sizeof(header);
+    header.rows = rows;
+    header.columns = columns;
+    header.mines = mines;
+    header.topology = topology;
+    header.base_seed = base_seed;
+    header.block_boards = block_boards;
+
+    /* Counts and index offset are filled in by close() */
+    index.clear();
+    pending.assign((const uint8_t*) &header,
+                   (const uint8_t*) &header + sizeof(header));
+    offset = sizeof(header);
+    return true;
+}
+
+/* write_block
+ *
+ * Appends the next block
+ *
+ * Inputs:  payload - encoded block (see archive_encode_block)
+ *          entry   - its index entry, offset is filled in here
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ArchiveWriter::write_block(const std::vector<uint8_t>& payload,
+                                archive_block entry)
+{
+    entry.offset = offset;
+    index.push_back(entry);
+    header.boards += entry.boards;
+    pending.insert(pending.end(), payload.begin(), payload.end());
+    offset += payload.size();
+
+    if (pending.size() >= ARCHIVE_WRITE_BUFFER)
+    {
+        return flush();
+    }
+    return true;
+}
+
+/* close
+ *
+ * Writes the index, fills in the header and moves the
+ * archive into place
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ArchiveWriter::close()
+{
+    bool success;
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    header.blocks = index.size();
+    header.index_offset = offset;
+    pending.insert(pending.end(), (const uint8_t*) index.data(),
+                   (const uint8_t*) (index.data() + index.size()));
+    offset += index.size() * sizeof(archive_block);
+
+    success = flush() &&
+              (pwrite(fd, &header, sizeof(header), 0) == sizeof(header));
+    success = (::close(fd) == 0) && success;
+    fd = -1;
+    if (success)
+    {
+        success = (rename(temp_path.c_str(), path.c_str()) == 0);
+    }
+    if (!success)
+    {
+        PRINT_INFO("\nERROR: Cannot write %s: %s\n",
+                   path.c_str(), strerror(errno));
+        unlink(temp_path.c_str());
+    }
+    return success;
+}
+
+/* get_bytes
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: size of the archive so far
+ */
+uint64_t ArchiveWriter::get_bytes()
+{
+    return offset;
+}
+
+/* flush
+ *
+ * Writes out the gathered blocks
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ArchiveWriter::flush()
+{
+    bool success = write_all(fd, pending.data(), pending.size());
+
+    pending.clear();
+    return success;
+}
+
+/* Constructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: ArchiveReader struct
+ */
+ArchiveReader::ArchiveReader()
+{
+    image = NULL;
+    size = 0;
+    header = NULL;
+    index = NULL;
+    cells = 0;
+    plane_bytes = 0;
+}
+
+/* Destructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+ArchiveReader::~ArchiveReader()
+{
+    close();
+}
+
+/* open
+ *
+ * Maps an archive and checks its header and index
+ *
+ * Inputs:  path - archive to read
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ArchiveReader::open(const char* path)
+{
+    struct stat st;
+    uint64_t blocks;
+    int fd;
+
+    close();
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        PRINT_INFO("\nERROR: Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    if ( (fstat(fd, &st) != 0) ||
+         ((size_t) st.st_size < sizeof(archive_header))
+       )
+    {
+        PRINT_INFO("\nERROR: Archive %s is truncated\n", path);
+        ::close(fd);
+        return false;
+    }
+
+    size = st.st_size;
+    image = (const uint8_t*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (image == MAP_FAILED)
+    {
+        PRINT_INFO("\nERROR: Cannot map archive %s: %s\n",
+                   path, strerror(errno));
+        image = NULL;
+        return false;
+    }
+    /* Lookups jump around, don't read ahead */
+    madvise((void*) image, size, MADV_RANDOM);
+
+    header = (const archive_header*) image;
+    blocks = (header->block_boards == 0) ? 0 :
+             (header->boards + header->block_boards - 1) / header->block_boards;
+    if ( (memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0) ||
+         (header->version != ARCHIVE_VERSION) ||
+         (header->header_size != sizeof(archive_header)) ||
+         (header->rows < 1) || (header->columns < 1) ||
+         ((uint64_t) header->rows * header->columns > INT_MAX) ||
+         (header->mines < 0) ||
+         (header->mines >= header->rows * header->columns) ||
+         (header->topology >= NUM_TOPOLOGIES) ||
+         (header->block_boards == 0) ||
+         (header->blocks != blocks) ||
+         (header->index_offset > size) ||
+         (header->blocks > (size - header->index_offset) / sizeof(archive_block))
+       )
+    {
+        PRINT_INFO("\nERROR: %s is not a valid archive\n", path);
+        close();
+        return false;
+    }
+
+    index = (const archive_block*) (image + header->index_offset);
+    cells = header->rows * header->columns;
+    plane_bytes = (cells + 7) / 8;
+    return true;
+}
+
+/* close
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void ArchiveReader::close()
+{
+    if (image != NULL)
+    {
+        munmap((void*) image, size);
+    }
+    image = NULL;
+    header = NULL;
+    index = NULL;
+}
+
+/* get_header
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: header of the open archive, NULL if none
+ */
+const archive_header* ArchiveReader::get_header()
+{
+    return header;
+}
+
+/* read_board
+ *
+ * Decodes one board
+ *
+ * Inputs:  id    - board to read
+ * Outputs: plane - packed mine bitplane, (rows*columns+7)/8 bytes
+ *          bbbv  - 3BV of the board (may be NULL)
+ * Returns: true on success
+ *          false if the id is out of range or the block is bad
+ */
+bool ArchiveReader::read_board(uint64_t id, uint8_t* plane, int* bbbv)
+{
+    const archive_block* entry;
+    const uint8_t* p;
+    const uint8_t* end;
+    bit_reader reader;
+    uint64_t value, gap;
+    uint32_t i, slot;
+    int j, position;
+
+    if ( (header == NULL) || (id >= header->boards) )
+    {
+        return false;
+    }
+    entry = find_block(id / header->block_boards);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    slot = (uint32_t) (id % header->block_boards);
+    if (slot >= entry->boards)
+    {
+        return false;
+    }
+
+    p = image + entry->offset;
+    end = p + entry->bytes;
+    for (i = 0; i < entry->boards; i++)
+    {
+        p = varint_decode(p, end, &value);
+        if (p == NULL)
+        {
+            return false;
+        }
+        if ( (i == slot) && (bbbv != NULL) )
+        {
+            *bbbv = (int) value;
+        }
+    }
+
+    if (entry->codec == ARCHIVE_CODEC_RAW)
+    {
+        if ((size_t) (end - p) < (size_t) (slot + 1) * plane_bytes)
+        {
+            return false;
+        }
+        memcpy(plane, p + (size_t) slot * plane_bytes, plane_bytes);
+        return true;
+    }
+
+    /* Rice: skip the boards before this one, then rebuild it */
+    reader.p = p;
+    reader.end = end;
+    reader.acc = 0;
+    reader.bits = 0;
+    reader.truncated = false;
+    for (i = 0; i < slot * (uint32_t) header->mines; i++)
+    {
+        get_unary(&reader);
+        get_bits(&reader, entry->rice_k);
+    }
+
+    memset(plane, 0, plane_bytes);
+    position = -1;
+    for (j = 0; j < header->mines; j++)
+    {
+        gap = ( (uint64_t) get_unary(&reader) << entry->rice_k ) |
+              get_bits(&reader, entry->rice_k);
+        if ( reader.truncated || (gap >= (uint64_t) (cells - 1 - position)) )
+        {
+            return false;
+        }
+        position += 1 + (int) gap;
+        plane[position >> 3] |= (uint8_t) (1 << (position & 7));
+    }
+    return true;
+}
+
+/* read_block_3bv
+ *
+ * Reads the 3BV of every board in a block, without
+ * decoding any layouts.  Cheap way to filter boards.
+ *
+ * Inputs:  block - block to read
+ * Outputs: bbbv  - block_boards entries
+ * Returns: number of boards in the block, -1 on error
+ */
+int ArchiveReader::read_block_3bv(uint64_t block, int* bbbv)
+{
+    const archive_block* entry = find_block(block);
+    const uint8_t* p;
+    const uint8_t* end;
+    uint64_t value;
+    uint32_t i;
+
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    p = image + entry->offset;
+    end = p + entry->bytes;
+    for (i = 0; i < entry->boards; i++)
+    {
+        p = varint_decode(p, end, &value);
+        if (p == NULL)
+        {
+            return -1;
+        }
+        bbbv[i] = (int) value;
+    }
+    return (int) entry->boards;
+}
+
+/* load_board
+ *
+ * Builds a Board straight from an archived layout
+ *
+ * Inputs:  id - board to load
+ * Outputs: (none)
+ * Returns: new board (caller deletes), NULL on error
+ */
+Board* ArchiveReader::load_board(uint64_t id)
+{
+    std::vector<uint8_t> plane(plane_bytes);
+
+    if ( !read_board(id, plane.data(), NULL) )
+    {
+        return NULL;
+    }
+    return new Board(header->rows, header->columns, header->mines,
+                     (board_topology) header->topology,
+                     header->base_seed + (uint32_t) id, plane.data());
+}
+
+/* verify
+ *
+ * Checks every block against its checksum
+ *
+ * Inputs:  (none)
+ * Outputs: bad_blocks - number of blocks that failed (may be NULL)
+ * Returns: true if every block is intact
+ */
+bool ArchiveReader::verify(uint64_t* bad_blocks)
+{
+    uint64_t block, bad = 0;
+
+    if (header == NULL)
+    {
+        return false;
+    }
+    for (block = 0; block < header->blocks; block++)
+    {
+        bad += (find_block(block) == NULL) ? 1 : 0;
+    }
+    if (bad_blocks != NULL)
+    {
+        *bad_blocks = bad;
+    }
+    return bad == 0;
+}
+
+/* find_block
+ *
+ * Looks up a block and checks it lies within the file and
+ * matches its checksum
+ *
+ * Inputs:  block - block number
+ * Outputs: (none)
+ * Returns: index entry, NULL if missing or damaged
+ */
+const archive_block* ArchiveReader::find_block(uint64_t block)
+{
+    const archive_block* entry;
+
+    if ( (header == NULL) || (block >= header->blocks) )
+    {
+        return NULL;
+    }
+    entry = &index[block];
+    if ( (entry->offset > header->index_offset) ||
+         (entry->bytes > header->index_offset - entry->offset) ||
+         (entry->boards > header->block_boards) ||
+         (entry->rice_k > ARCHIVE_MAX_RICE_K) ||
+         (archive_checksum(image + entry->offset, entry->bytes) !=
+          entry->checksum)
+       )
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* archive_encode_block
+ *
+ * Encodes a block of boards, picking whichever of raw
+ * planes and Rice coded gaps comes out smaller
+ *
+ * Inputs:  planes  - packed mine planes, back to back
+ *          bbbv    - 3BV of each board
+ *          boards  - boards in the block
+ *          cells   - squares per board
+ *          mines   - mines per board (every plane has exactly this many)
+ * Outputs: payload - replaced with the encoded block
+ *          entry   - filled in, except the offset
+ * Returns: void
+ */
+void archive_encode_block(const uint8_t* planes, const int* bbbv,
+                          int boards, int cells, int mines,
+                          std::vector<uint8_t>* payload,
+                          archive_block* entry)
+{
+    static thread_local std::vector<uint32_t> gaps;
+    int plane_bytes = (cells + 7) / 8;
+    uint8_t buffer[VARINT_MAX_BYTES];
+    const uint8_t* plane;
+    bit_writer writer;
+    uint64_t raw_bits, best_bits, bits;
+    uint8_t byte;
+    int b, i, k, best_k, previous, position;
+    size_t n;
+
+    payload->clear();
+    for (b = 0; b < boards; b++)
+    {
+        n = varint_encode(bbbv[b], buffer);
+        payload->insert(payload->end(), buffer, buffer + n);
+    }
+
+    /* Gaps between consecutive mines, board by board */
+    gaps.clear();
+    for (b = 0; b < boards; b++)
+    {
+        plane = planes + (size_t) b * plane_bytes;
+        previous = -1;
+        for (i = 0; i < plane_bytes; i++)
+        {
+            byte = plane[i];
+            while (byte != 0)
+            {
+                position = (i << 3) + __builtin_ctz(byte);
+                gaps.push_back(position - previous - 1);
+                previous = position;
+                byte &= byte - 1;
+            }
+        }
+    }
+
+    /* Rice parameter: start near log2 of the mean gap */
+    best_k = 0;
+    if (!gaps.empty())
+    {
+        bits = (uint64_t) boards * cells / gaps.size();
+        while ( (best_k < ARCHIVE_MAX_RICE_K) && ((2ull << best_k) <= bits) )
+        {
+            best_k++;
+        }
+    }
+    best_bits = rice_bits(gaps, best_k);
+    for (k = (best_k > 0 ? best_k - 1 : 0); k <= best_k + 1; k++)
+    {
+        if (k > ARCHIVE_MAX_RICE_K)
+        {
+            break;
+        }
+        bits = rice_bits(gaps, k);
+        if (bits < best_bits)
+        {
+            best_bits = bits;
+            best_k = k;
+        }
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    entry->boards = boards;
+    raw_bits = (uint64_t) boards * plane_bytes * 8;
+    if ( (best_bits >= raw_bits) || (gaps.size() != (size_t) boards * mines) )
+    {
+        entry->codec = ARCHIVE_CODEC_RAW;
+        payload->insert(payload->end(), planes,
+                        planes + (size_t) boards * plane_bytes);
+    }
+    else
+    {
+        entry->codec = ARCHIVE_CODEC_RICE;
+        entry->rice_k = (uint8_t) best_k;
+        writer.out = payload;
+        writer.acc = 0;
+        writer.bits = 0;
+        for (i = 0; i < (int) gaps.size(); i++)
+        {
+            put_unary(&writer, gaps[i] >> best_k);
+            put_bits(&writer, gaps[i] & ((1u << best_k) - 1), best_k);
+        }
+        finish_bits(&writer);
+    }
+
+    entry->bytes = (uint32_t) payload->size();
+    entry->checksum = archive_checksum(payload->data(), payload->size());
+}
+
+/* archive_checksum
+ *
+ * 64 bit FNV-1a over a block
+ *
+ * Inputs:  data  - bytes to hash
+ *          bytes - how many
+ * Outputs: (none)
+ * Returns: checksum
+ */
+uint64_t archive_checksum(const uint8_t* data, size_t bytes)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t i;
+
+    for (i = 0; i < bytes; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* write_all
+ *
+ * write() until everything is out
+ */
+static bool write_all(int fd, const uint8_t* data, size_t bytes)
+{
+    ssize_t written;
+
+    while (bytes > 0)
+    {
+        written = write(fd, data, bytes);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        bytes -= written;
+    }
+    return true;
+}
+
+/* put_bits
+ *
+ * Appends the n (at most 32) low bits of value
+ */
+static void put_bits(bit_writer* w, uint32_t value, int n)
+{
+    w->acc |= (uint64_t) value << w->bits;
+    w->bits += n;
+    while (w->bits >= 8)
+    {
+        w->out->push_back((uint8_t) w->acc);
+        w->acc >>= 8;
+        w->bits -= 8;
+    }
+}
+
+/* put_unary
+ *
+ * Appends q one bits and a zero
+ */
+static void put_unary(bit_writer* w, uint32_t q)
+{
+    while (q >= 24)
+    {
+        put_bits(w, 0xffffff, 24);
+        q -= 24;
+    }
+    put_bits(w, (1u << q) - 1, q + 1);
+}
+
+/* finish_bits
+ *
+ * Pads the last byte with zeros
+ */
+static void finish_bits(bit_writer* w)
+{
+    if (w->bits > 0)
+    {
+        w->out->push_back((uint8_t) w->acc);
+    }
+    w->acc = 0;
+    w->bits = 0;
+}
+
+/* refill
+ *
+ * Tops the reader's bit buffer up from the stream
+ */
+static void refill(bit_reader* r)
+{
+    while ( (r->bits <= 56) && (r->p < r->end) )
+    {
+        r->acc |= (uint64_t) *r->p++ << r->bits;
+        r->bits += 8;
+    }
+}
+
+/* get_bits
+ *
+ * Reads n (at most 32) bits
+ */
+static uint32_t get_bits(bit_reader* r, int n)
+{
+    uint32_t value;
+
+    if (r->bits < n)
+    {
+        refill(r);
+        if (r->bits < n)
+        {
+            r->truncated = true;
+            r->bits = n;
+        }
+    }
+    value = (uint32_t) (r->acc & ((1ull << n) - 1));
+    r->acc >>= n;
+    r->bits -= n;
+    return value;
+}
+
+/* get_unary
+ *
+ * Reads a run of ones and the zero ending it
+ */
+static uint32_t get_unary(bit_reader* r)
+{
+    uint32_t q = 0;
+    int ones;
+
+    while (1)
+    {
+        if (r->bits == 0)
+        {
+            refill(r);
+            if (r->bits == 0)
+            {
+                r->truncated = true;
+                return q;
+            }
+        }
+        /* Bits above the valid ones are zero, so this stops
+         * at bits at the latest (all 64 bits may be ones) */
+        ones = (~r->acc == 0) ? 64 : __builtin_ctzll(~r->acc);
+        if (ones < r->bits)
+        {
+            r->acc = (ones == 63) ? 0 : (r->acc >> (ones + 1));
+            r->bits -= ones + 1;
+            return q + ones;
+        }
+        if ( (uint32_t) r->bits > MAX_UNARY - q )
+        {
+            r->truncated = true;
+            return q;
+        }
+        q += r->bits;
+        r->acc = 0;
+        r->bits = 0;
+    }
+}
+
+/* rice_bits
+ *
+ * Size of a list of gaps when Rice coded with parameter k
+ */
+static uint64_t rice_bits(const std::vector<uint32_t>& gaps, int k)
+{
+    uint64_t bits = 0;
+    size_t i;
+
+    for (i = 0; i < gaps.size(); i++)
+    {
+        bits += (gaps[i] >> k) + 1 + k;
+    }
+    return bits;
+}
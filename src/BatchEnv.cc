@@ -0,0 +1,580 @@
+/* src/BatchEnv.cc
+ *
+ * Implementation of the batched environment C ABI
+ * (see hdr/minesweeper.h)
+ *
+ * Boards are kept as flat planes indexed by
+ * board*cells + square: mines, neighbor counts, and the
+ * caller's observation buffer, which doubles as the state
+ * plane.  Neighbors come from a table built once per batch
+ * from the topology policy, so the step kernel has no
+ * topology branches at all.
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <new>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "minesweeper.h"
+#include "Topology.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+struct ms_batch
+{
+    int num_boards;
+    int rows, columns, cells, mines;
+    int8_t* observations;
+    uint8_t* mine;
+    uint8_t* number;
+    int32_t* revealed;
+    uint64_t* rng;
+
+    /* cells*NUM_NEIGHBORS, count per square */
+    int32_t* neighbors;
+    uint8_t* neighbor_count;
+
+    std::atomic<uint64_t> games_played;
+    std::atomic<uint64_t> games_won;
+
+    /* Worker threads for ms_batch_step */
+    std::vector<std::thread> pool;
+    std::mutex pool_lock;
+    std::condition_variable pool_wake;
+    std::condition_variable pool_done;
+    uint64_t generation;
+    bool quitting;
+    std::atomic<int> pending;
+    int job_threads;
+    const int32_t* job_actions;
+    float* job_rewards;
+    uint8_t* job_dones;
+};
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t next_random(uint64_t* state);
+static void reset_board(ms_batch* batch, int board);
+static void step_board(ms_batch* batch, int board, int32_t action,
+                       float* reward, uint8_t* done,
+                       std::vector<int32_t>& stack,
+                       uint64_t* played, uint64_t* won);
+static void chunk_bounds(ms_batch* batch, int chunk, int chunks,
+                         int* begin, int* end);
+static void pool_worker(ms_batch* batch, int chunk, uint64_t seen);
+static void stop_pool(ms_batch* batch);
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* ms_batch_create
+ *
+ * Allocates a batch and deals a game on every board
+ *
+ * Inputs:  num_boards      - boards in the batch
+ *          rows, columns   - size of every board
+ *          mines           - mines per board (less than rows*columns)
+ *          topology        - MS_TOPOLOGY_*
+ *          seed            - seed of the whole batch
+ *          observations    - caller's observation buffer
+ * Outputs: (none)
+ * Returns: new batch, NULL on bad arguments or when out of
+ *          memory
+ */
+ms_batch* ms_batch_create(int num_boards, int rows, int columns, int mines,
+                          int topology, uint64_t seed,
+                          int8_t* observations)
+{
+    ms_batch* batch;
+    int64_t cells = (int64_t) rows * columns;
+    size_t total;
+    int i;
+
+    /* Neighbor tables are indexed by int */
+    if ( (num_boards < 1) || (rows < 1) || (columns < 1) ||
+         (cells > INT_MAX / NUM_NEIGHBORS) ||
+         ((uint64_t) num_boards * cells > SIZE_MAX / sizeof(int32_t)) ||
+         (mines < 1) || (mines >= cells) ||
+         (topology < 0) || (topology >= NUM_TOPOLOGIES) ||
+         (observations == NULL)
+       )
+    {
+        return NULL;
+    }
+
+    batch = new (std::nothrow) ms_batch;
+    if (batch == NULL)
+    {
+        return NULL;
+    }
+    batch->num_boards = num_boards;
+    batch->rows = rows;
+    batch->columns = columns;
+    batch->cells = rows*columns;
+    batch->mines = mines;
+    batch->observations = observations;
+    batch->games_played = 0;
+    batch->games_won = 0;
+    batch->generation = 0;
+    batch->quitting = false;
+    batch->pending = 0;
+    batch->job_threads = 0;
+
+    total = (size_t) num_boards * batch->cells;
+    batch->mine = (uint8_t*) malloc(total);
+    batch->number = (uint8_t*) malloc(total);
+    batch->revealed = (int32_t*) malloc(num_boards * sizeof(int32_t));
+    batch->rng = (uint64_t*) malloc(num_boards * sizeof(uint64_t));
+    batch->neighbors = (int32_t*) malloc((size_t) batch->cells *
+                                         NUM_NEIGHBORS * sizeof(int32_t));
+    batch->neighbor_count = (uint8_t*) malloc(batch->cells);
+    if ( (batch->mine == NULL) || (batch->number == NULL) ||
+         (batch->revealed == NULL) || (batch->rng == NULL) ||
+         (batch->neighbors == NULL) || (batch->neighbor_count == NULL) )
+    {
+        /* Frees whichever ones were allocated */
+        ms_batch_destroy(batch);
+        return NULL;
+    }
+
+    for (i = 0; i < batch->cells; i++)
+    {
+        batch->neighbor_count[i] = (uint8_t)
+            board_neighbors((board_topology) topology, rows, columns, i,
+                            &batch->neighbors[i * NUM_NEIGHBORS]);
+    }
+
+    for (i = 0; i < num_boards; i++)
+    {
+        /* Distinct, well mixed stream per board */
+        batch->rng[i] = seed + (uint64_t) i * 0x9e3779b97f4a7c15ull;
+        next_random(&batch->rng[i]);
+    }
+
+    ms_batch_reset(batch);
+    return batch;
+}
+
+/* ms_batch_destroy
+ *
+ * Frees a batch (not the caller's observation buffer)
+ *
+ * Inputs:  batch - batch to free
+ * Outputs: (none)
+ * Returns: void
+ */
+void ms_batch_destroy(ms_batch* batch)
+{
+    if (batch == NULL)
+    {
+        return;
+    }
+    stop_pool(batch);
+    free(batch->mine);
+    free(batch->number);
+    free(batch->revealed);
+    free(batch->rng);
+    free(batch->neighbors);
+    free(batch->neighbor_count);
+    delete batch;
+}
+
+/* ms_batch_reset
+ *
+ * Deals a new game on every board
+ *
+ * Inputs:  batch - batch to reset
+ * Outputs: (none)
+ * Returns: void
+ */
+void ms_batch_reset(ms_batch* batch)
+{
+    int i;
+
+    for (i = 0; i < batch->num_boards; i++)
+    {
+        reset_board(batch, i);
+    }
+}
+
+/* ms_batch_step
+ *
+ * Steps every board, optionally on several threads
+ *
+ * Inputs:  batch       - batch to step
+ *          actions     - one action per board
+ *          num_threads - threads to use (the caller's included)
+ * Outputs: rewards     - one reward per board (may be NULL)
+ *          dones       - 1 where a game ended (may be NULL)
+ * Returns: void
+ */
+void ms_batch_step(ms_batch* batch, const int32_t* actions,
+                   float* rewards, uint8_t* dones, int num_threads)
+{
+    int begin, end, i;
+    uint64_t generation;
+
+    if (num_threads > batch->num_boards)
+    {
+        num_threads = batch->num_boards;
+    }
+    if (num_threads <= 1)
+    {
+        ms_batch_step_range(batch, 0, batch->num_boards,
+                            actions, rewards, dones);
+        return;
+    }
+
+    /* (Re)build the pool if the thread count changed */
+    if ((int) batch->pool.size() != num_threads - 1)
+    {
+        stop_pool(batch);
+        {
+            std::lock_guard<std::mutex> guard(batch->pool_lock);
+            batch->quitting = false;
+            generation = batch->generation;
+        }
+        /* New workers wait for the next job, not the last one */
+        for (i = 1; i < num_threads; i++)
+        {
+            batch->pool.push_back(std::thread(pool_worker, batch, i,
+                                              generation));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(batch->pool_lock);
+        batch->job_threads = num_threads;
+        batch->job_actions = actions;
+        batch->job_rewards = rewards;
+        batch->job_dones = dones;
+        batch->pending = num_threads - 1;
+        batch->generation++;
+    }
+    batch->pool_wake.notify_all();
+
+    /* The caller takes the first chunk */
+    chunk_bounds(batch, 0, num_threads, &begin, &end);
+    ms_batch_step_range(batch, begin, end, actions, rewards, dones);
+
+    {
+        std::unique_lock<std::mutex> guard(batch->pool_lock);
+        while (batch->pending > 0)
+        {
+            batch->pool_done.wait(guard);
+        }
+    }
+}
+
+/* ms_batch_step_range
+ *
+ * Steps boards [begin, end)
+ *
+ * Inputs:  batch      - batch to step
+ *          begin, end - boards to step
+ *          actions    - indexed by board
+ * Outputs: rewards    - indexed by board (may be NULL)
+ *          dones      - indexed by board (may be NULL)
+ * Returns: void
+ */
+void ms_batch_step_range(ms_batch* batch, int begin, int end,
+                         const int32_t* actions, float* rewards,
+                         uint8_t* dones)
+{
+    static thread_local std::vector<int32_t> stack;
+    uint64_t played = 0, won = 0;
+    float reward;
+    uint8_t done;
+    int i;
+
+    for (i = begin; i < end; i++)
+    {
+        step_board(batch, i, actions[i], &reward, &done, stack,
+                   &played, &won);
+        if (rewards != NULL)
+        {
+            rewards[i] = reward;
+        }
+        if (dones != NULL)
+        {
+            dones[i] = done;
+        }
+    }
+
+    if (played > 0)
+    {
+        batch->games_played += played;
+        batch->games_won += won;
+    }
+}
+
+/* ms_batch_games_played / ms_batch_games_won
+ *
+ * Inputs:  batch - batch to look at
+ * Outputs: (none)
+ * Returns: games finished (won) since creation
+ */
+uint64_t ms_batch_games_played(ms_batch* batch)
+{
+    return batch->games_played;
+}
+
+uint64_t ms_batch_games_won(ms_batch* batch)
+{
+    return batch->games_won;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* next_random
+ *
+ * splitmix64
+ */
+static uint64_t next_random(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* reset_board
+ *
+ * Deals a new game on one board
+ *
+ * Inputs:  batch - batch
+ *          board - board to deal
+ * Outputs: (none)
+ * Returns: void
+ */
+static void reset_board(ms_batch* batch, int board)
+{
+    uint8_t* mine = batch->mine + (size_t) board * batch->cells;
+    uint8_t* number = batch->number + (size_t) board * batch->cells;
+    const int32_t* neighbor;
+    uint8_t fill, target;
+    int placed, wanted, i, j, count;
+
+    /* Place whichever of mines and safe squares is rarer */
+    if (batch->mines * 2 <= batch->cells)
+    {
+        fill = 0;
+        wanted = batch->mines;
+    }
+    else
+    {
+        fill = 1;
+        wanted = batch->cells - batch->mines;
+    }
+    target = !fill;
+    memset(mine, fill, batch->cells);
+
+    placed = 0;
+    while (placed < wanted)
+    {
+        i = (int) (next_random(&batch->rng[board]) % batch->cells);
+        if (mine[i] != target)
+        {
+            mine[i] = target;
+            placed++;
+        }
+    }
+
+    for (i = 0; i < batch->cells; i++)
+    {
+        neighbor = &batch->neighbors[i * NUM_NEIGHBORS];
+        count = 0;
+        for (j = 0; j < batch->neighbor_count[i]; j++)
+        {
+            count += mine[neighbor[j]];
+        }
+        number[i] = (uint8_t) count;
+    }
+
+    memset(batch->observations + (size_t) board * batch->cells,
+           MS_OBS_UNKNOWN, batch->cells);
+    batch->revealed[board] = 0;
+}
+
+/* step_board
+ *
+ * Applies one action to one board.  Reveals cascade with an
+ * explicit stack (no recursion), writing numbers straight
+ * into the observation plane.
+ *
+ * Inputs:  batch  - batch
+ *          board  - board to step
+ *          action - see hdr/minesweeper.h
+ *          stack  - scratch space for the cascade
+ * Outputs: reward, done - result of the step
+ *          played, won  - bumped when a game ends
+ * Returns: void
+ */
+static void step_board(ms_batch* batch, int board, int32_t action,
+                       float* reward, uint8_t* done,
+                       std::vector<int32_t>& stack,
+                       uint64_t* played, uint64_t* won)
+{
+    int8_t* obs = batch->observations + (size_t) board * batch->cells;
+    const uint8_t* mine = batch->mine + (size_t) board * batch->cells;
+    const uint8_t* number = batch->number + (size_t) board * batch->cells;
+    int safe = batch->cells - batch->mines;
+    const int32_t* neighbor;
+    int square, next, j, count;
+
+    *reward = 0;
+    *done = 0;
+
+    if ( (action < 0) || (action >= 2 * batch->cells) )
+    {
+        return;
+    }
+
+    if (action >= batch->cells)
+    {
+        square = action - batch->cells;
+        if (obs[square] == MS_OBS_UNKNOWN)
+        {
+            obs[square] = MS_OBS_MARKED;
+        }
+        else if (obs[square] == MS_OBS_MARKED)
+        {
+            obs[square] = MS_OBS_UNKNOWN;
+        }
+        return;
+    }
+
+    square = action;
+    if (obs[square] != MS_OBS_UNKNOWN)
+    {
+        return;
+    }
+
+    if (mine[square])
+    {
+        *reward = -1;
+        *done = 1;
+        (*played)++;
+        reset_board(batch, board);
+        return;
+    }
+
+    count = 0;
+    stack.clear();
+    stack.push_back(square);
+    obs[square] = (int8_t) number[square];
+    while (!stack.empty())
+    {
+        square = stack.back();
+        stack.pop_back();
+        count++;
+        if (number[square] != 0)
+        {
+            continue;
+        }
+        neighbor = &batch->neighbors[square * NUM_NEIGHBORS];
+        for (j = 0; j < batch->neighbor_count[square]; j++)
+        {
+            next = neighbor[j];
+            if (obs[next] < 0)
+            {
+                obs[next] = (int8_t) number[next];
+                stack.push_back(next);
+            }
+        }
+    }
+
+    batch->revealed[board] += count;
+    *reward = (float) count / safe;
+    if (batch->revealed[board] == safe)
+    {
+        *reward = 1;
+        *done = 1;
+        (*played)++;
+        (*won)++;
+        reset_board(batch, board);
+    }
+}
+
+/* chunk_bounds
+ *
+ * Splits the boards into equal chunks
+ */
+static void chunk_bounds(ms_batch* batch, int chunk, int chunks,
+                         int* begin, int* end)
+{
+    *begin = (int) ((int64_t) batch->num_boards * chunk / chunks);
+    *end = (int) ((int64_t) batch->num_boards * (chunk + 1) / chunks);
+}
+
+/* pool_worker
+ *
+ * Worker thread: steps its chunk every time a new job is
+ * posted.  seen is the job generation when it was started.
+ */
+static void pool_worker(ms_batch* batch, int chunk, uint64_t seen)
+{
+    int begin, end;
+
+    while (1)
+    {
+        {
+            std::unique_lock<std::mutex> guard(batch->pool_lock);
+            while ( !batch->quitting && (batch->generation == seen) )
+            {
+                batch->pool_wake.wait(guard);
+            }
+            if (batch->quitting)
+            {
+                return;
+            }
+            seen = batch->generation;
+        }
+
+        chunk_bounds(batch, chunk, batch->job_threads, &begin, &end);
+        ms_batch_step_range(batch, begin, end, batch->job_actions,
+                            batch->job_rewards, batch->job_dones);
+
+        if (--batch->pending == 0)
+        {
+            std::lock_guard<std::mutex> guard(batch->pool_lock);
+            batch->pool_done.notify_one();
+        }
+    }
+}
+
+/* stop_pool
+ *
+ * Joins the worker threads
+ */
+static void stop_pool(ms_batch* batch)
+{
+    size_t i;
+
+    {
+        std::lock_guard<std::mutex> guard(batch->pool_lock);
+        batch->quitting = true;
+    }
+    batch->pool_wake.notify_all();
+    for (i = 0; i < batch->pool.size(); i++)
+    {
+        batch->pool[i].join();
+    }
+    batch->pool.clear();
+}
@@ -10,14 +10,40 @@
 *******************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <new>
+#include <atomic>
 
 #include "Board.h"
+#include "Mines.h"
+#include "Spectate.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+/* Per-move messages, silenced on quiet boards (see set_verbose) */
+#define MOVE_INFO(...) do { if (verbose) { move_info( __VA_ARGS__ ); } } while (0)
+
+/* move_seen bit for squares already in the journal entry */
+#define SEEN_JOURNALED  0x80
+
+/******************************************************
+                    LOCAL VARIABLES
+*******************************************************/
+static const char* move_names[NUM_MOVE_TYPES] = 
+{
+    "Move on", "Marked", "Unmarked", "Chord on"
+};
 
 /******************************************************
               LOCAL FUNCTIONS DEFINITION
 *******************************************************/
 bool string_valid(std::string user_input);
-bool string_valid_number(std::string user_input);
+bool string_valid_number(const mem_string<MEM_PARSER>& user_input);
+static int find_root(std::vector<int>& parent, int i);
+static uint64_t mix_key(uint64_t value);
+static uint64_t square_key(int index, square_state state);
 
 /******************************************************
              CLASS FUNCTION IMPLEMENTATION
@@ -25,7 +51,7 @@ bool string_valid_number(std::string user_input);
 
 /* Constructor
  * 
- * Sets up a board
+ * Sets up a classic (square topology) board
  *
  * Inputs:  _rows    - number of rows in board
  *          _columns - number of columns in board
@@ -35,45 +61,163 @@ bool string_valid_number(std::string user_input);
  */
 Board::Board( int _rows, int _columns, int _mines )
 {
-    int i, random;
+    init(_rows, _columns, _mines, TOPOLOGY_SQUARE, 1, NULL);
+}
+
+/* Constructor
+ * 
+ * Sets up a board with the given topology
+ *
+ * Inputs:  _rows     - number of rows in board
+ *          _columns  - number of columns in board
+ *          _mines    - number of mines in board
+ *          _topology - shape of the board (see hdr/Topology.h)
+ * Outputs: (none)
+ * Returns: Board struct
+ */
+Board::Board( int _rows, int _columns, int _mines, 
+              board_topology _topology )
+{
+    init(_rows, _columns, _mines, _topology, 1, NULL);
+}
+
+/* Constructor
+ * 
+ * Sets up a board whose mine layout is fully determined
+ * by a seed, so the same seed always gives the same game
+ *
+ * Inputs:  _rows     - number of rows in board
+ *          _columns  - number of columns in board
+ *          _mines    - number of mines in board
+ *          _topology - shape of the board (see hdr/Topology.h)
+ *          _seed     - seed for mine placement
+ * Outputs: (none)
+ * Returns: Board struct
+ */
+Board::Board( int _rows, int _columns, int _mines, 
+              board_topology _topology, unsigned int _seed )
+{
+    init(_rows, _columns, _mines, _topology, _seed, NULL);
+}
+
+/* Constructor
+ * 
+ * Sets up a board from a packed mine bitplane (see
+ * pack_mines) instead of placing mines randomly.
+ * Used to restore saved games.
+ *
+ * Inputs:  _rows      - number of rows in board
+ *          _columns   - number of columns in board
+ *          _mines     - number of mines in board
+ *          _topology  - shape of the board (see hdr/Topology.h)
+ *          _seed      - seed the layout was generated from
+ *          mine_plane - one bit per square, set for mines
+ * Outputs: (none)
+ * Returns: Board struct
+ */
+Board::Board( int _rows, int _columns, int _mines, 
+              board_topology _topology, unsigned int _seed,
+              const uint8_t* mine_plane )
+{
+    init(_rows, _columns, _mines, _topology, _seed, mine_plane);
+}
+
+/* init
+ * 
+ * Common constructor code.  Allocates the squares,
+ * places the mines and links up neighbors
+ *
+ * Inputs:  _rows      - number of rows in board
+ *          _columns   - number of columns in board
+ *          _mines     - number of mines in board
+ *          _topology  - shape of the board
+ *          _seed      - seed for mine placement
+ *          mine_plane - packed mine layout, NULL to deal one
+ *                       from the seed (see hdr/Mines.h)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::init( int _rows, int _columns, int _mines, 
+                  board_topology _topology, unsigned int _seed,
+                  const uint8_t* mine_plane )
+{
+    std::vector<uint8_t> dealt;
+    std::atomic<uint64_t> layout_hash(0);
     
     rows = _rows;
     columns = _columns,
     mines = _mines;
+    topology = _topology;
+    seed = _seed;
+    
+    /* Deal the mines unless the layout is given */
+    if (mine_plane == NULL)
+    {
+        dealt.resize(((size_t) rows * columns + 7) / 8);
+        mines_place(rows * columns, mines, seed, dealt.data());
+        mine_plane = dealt.data();
+    }
     
-    /* Set up array of squares */
-    squares = new Square[rows*columns];
+    /* Set up array of squares.  Big boards are mapped rather
+     * than allocated and built by several threads, so the
+     * page faults are spread over them too */
+    if ( !cells_map((size_t) rows * columns * sizeof(Square), &square_plane) )
+    {
+        throw std::bad_alloc();
+    }
+    squares = (Square*) square_plane.base;
+    cells_parallel(rows * columns, CELLS_HUGE_PAGE / sizeof(Square),
+                   [this, mine_plane, &layout_hash](size_t begin, size_t end)
+                   {
+                       uint64_t hash = 0;
+                       
+                       for (size_t n = begin; n < end; n++)
+                       {
+                           new (&squares[n]) Square();
+                           if ( mine_plane[n >> 3] & (1 << (n & 7)) )
+                           {
+                               squares[n].set_mine();
+                               hash ^= mix_key( ((uint64_t) n << 2) | 3 );
+                           }
+                       }
+                       layout_hash.fetch_xor(hash, std::memory_order_relaxed);
+                   });
+    mem_note_alloc(MEM_BOARD, rows * columns * sizeof(Square));
     
-    DEBUG_INFO("New board.  Rows %d, Columns %d, mines %d\n", 
-               rows, columns, mines);
+    DEBUG_INFO("New %s board.  Rows %d, Columns %d, mines %d, seed %u\n", 
+               topology_name(topology), rows, columns, mines, seed);
     
 #ifdef DEBUG_PRINTS
-    for (i = 0; i < (rows*columns); i++)
+    for (int i = 0; i < (rows*columns); i++)
     {
         squares[i].set_column(i%columns+1);
         squares[i].set_row( ( (i-(i%columns))/columns) + 1 );
     }
 #endif
-
-    i = 0;
-    while ( i < mines )
-    {
-        /* Randomly assigned mines */
-        random = rand() % (rows*columns);
-        if ( !squares[random].is_mine() )
-        {
-            squares[random].set_mine();
-            i++;
-        }
-    }
     
     /* Let squares know who their neighbors are */
     populate_neighbors();
+    index_openings();
     
     /* Initial values */
     game_over = false;
     game_won =  false;
     squares_revealed = 0;
+    block_rows = ( (rows - 1) >> BOARD_BLOCK_SHIFT ) + 1;
+    block_columns = ( (columns - 1) >> BOARD_BLOCK_SHIFT ) + 1;
+    block_revealed.assign(block_rows * block_columns, 0);
+    overview_rows = 0;
+    overview_columns = 0;
+    move_seen.assign(rows * columns, 0);
+    event_log = NULL;
+    game_id = 0;
+    verbose = true;
+    state_hash = 0;
+    spectators = NULL;
+    messages = NULL;
+    mine_hash = layout_hash.load() ^
+                mix_key( ((uint64_t) rows << 32) | (uint32_t) columns ) ^
+                mix_key( ((uint64_t) topology << 32) | (uint32_t) mines );
     
     return;
 }
@@ -88,7 +232,16 @@ Board::Board( int _rows, int _columns, int _mines )
  */
 Board::~Board()
 {
-    delete squares;
+    cells_parallel(rows * columns, CELLS_HUGE_PAGE / sizeof(Square),
+                   [this](size_t begin, size_t end)
+                   {
+                       for (size_t n = begin; n < end; n++)
+                       {
+                           squares[n].~Square();
+                       }
+                   });
+    cells_unmap(&square_plane);
+    mem_note_free(MEM_BOARD, rows * columns * sizeof(Square));
     return;
 }
 
@@ -115,347 +268,1645 @@ void Board::print_board()
     
     for (i = 0; i < rows; i++)
     {
-        PRINT_INFO("%2d   ", i+1);
+        PRINT_INFO("%2d   %*s", i+1, row_indent(i), "");
         for (j = 0; j < columns; j++)
         {
-            switch( squares[i*columns + j].get_state() )
-            {
-            case UNKNOWN:
-                PRINT_INFO("*");
-                break;
-            case REVEALED:
-                if ( squares[i*columns + j].is_mine() )
-                {
-                    PRINT_INFO("!");
-                }
-                else
-                {
-                    PRINT_INFO( "%d", 
-                                squares[i*columns + j].get_neighbor_mines() 
-                              );
-                }
-                break;
-            case MARKED:
-                if (game_over)
-                {
-                    if (squares[i*columns + j].is_mine() )
-                    {
-                        PRINT_INFO("m");
-                    }
-                    else
-                    {
-                        PRINT_INFO("x");
-                    }
-                }
-                else
-                {
-                    PRINT_INFO("m");
-                }
-                break;
-            }
-            PRINT_INFO("  ");
+            PRINT_INFO("%c  ", square_char(i, j));
         }
         PRINT_INFO("\n");
     }
 }
 
-/* populate_neighbors
+/* square_char
  * 
- * Let all the squares know who their neighbors are
+ * What a square looks like to the player
+ * If game is over, incorrectly marked squares 
+ * are shown as 'x'
  *
- * Inputs:  (none)
+ * Inputs:  row, column - square to draw (0 based)
  * Outputs: (none)
- * Returns: void
+ * Returns: '*' unknown, '!' revealed mine, '0'-'8' revealed
+ *          number, 'm' marked, 'x' wrongly marked
  */
-void Board::populate_neighbors()
+char Board::square_char(int row, int column)
 {
-    int i, j;
-    bool has_left, has_right, has_top, has_bottom;
-    
-    DEBUG_INFO("Populate num neighbors\n");
+    Square* square = &squares[row*columns + column];
     
-    for (i = 0; i < rows*columns; i++)
+    switch( square->get_state() )
     {
-        has_left = false;
-        has_right = false;
-        has_top = false;
-        has_bottom = false;
-        
-        if ( (i-columns) > 0)
-        {
-            has_top = true;
-        }
-        
-        if ( (i+columns) < (rows*columns) )
+    case REVEALED:
+        if ( square->is_mine() )
         {
-            has_bottom = true;
+            return '!';
         }
-        
-        if ( (i%columns) != 0)
-        {
-            has_left = true;
-        }
-        
-        if ( ( (i+1)%columns ) != 0)
-        {
-            has_right = true;
-        }
-        
-        /* Iterate through all neighbors */
-        for (j = 0; j < NUM_NEIGHBORS; j++)
+        return (char) ('0' + square->get_neighbor_mines());
+    case MARKED:
+        if ( game_over && !square->is_mine() )
         {
-            switch(j)
-            {
-            case TOP:
-                if (has_top)
-                {
-                    squares[i].set_top(&squares[i-columns]);
-                }
-                break;
-            
-            case BOTTOM:
-                if (has_bottom)
-                {
-                    squares[i].set_bottom(&squares[i+columns]);
-                }
-                break;
-            
-            case LEFT:
-                if (has_left)
-                {
-                    squares[i].set_left(&squares[i-1]);
-                }
-                break;
-            
-            case RIGHT:
-                if (has_right)
-                {
-                    squares[i].set_right(&squares[i+1]);
-                }
-                break;
-            
-            case TOP_LEFT:
-                if (has_top && has_left)
-                {
-                    squares[i].set_top_left(&squares[i-columns-1]);
-                }
-                break;
-            
-            case TOP_RIGHT:
-                if (has_top && has_right)
-                {
-                    squares[i].set_top_right(&squares[i-columns+1]);
-                }
-                break;
-            
-            case BOTTOM_LEFT:
-                if (has_bottom && has_left)
-                {
-                    squares[i].set_bottom_left(&squares[i+columns-1]);
-                }
-                break;
-            
-            case BOTTOM_RIGHT:
-                if (has_bottom && has_right)
-                {
-                    squares[i].set_bottom_right(&squares[i+columns+1]);
-                }
-                break;
-            
-            case NUM_NEIGHBORS:
-                /* Can't happen but makes the compiler happy :) */
-                break;
-            }
+            return 'x';
         }
-        squares[i].calc_neighbor_mines();
+        return 'm';
+    default:
+        return '*';
     }
 }
 
-/* parse_input
+/* set_verbose
  * 
- * Parses user input and makes correctly formatted moves 
- * In the case of incorrect format, any moves after the incorrect
- * format will be discarded.
+ * Turns the per-move messages on or off.  Headless users
+ * (simulators, servers) turn them off.
  *
- * Inputs:  user_input - string of moves
+ * Inputs:  _verbose - true to print a line per move
  * Outputs: (none)
- * Returns: true if game is over
- *          false otherwise
+ * Returns: void
  */
-bool Board::parse_input(std::string user_input)
+void Board::set_verbose(bool _verbose)
 {
-    size_t comma_index = -1, openp_index = -1, closep_index = -1;
-    char c;
-    bool mark_square;
-    std::string temp;
-    int move_row, move_col;
-    bool move_success;
+    verbose = _verbose;
+}
+
+/* set_overview
+ * 
+ * Sets the grid revealed squares are also counted in for
+ * an overview (e.g. a minimap).  Block rows are split
+ * evenly over its rows: row r holds block rows
+ * [r * block_rows / rows, (r + 1) * block_rows / rows), and
+ * the same for columns.  From then on every reveal keeps
+ * the cell's count up to date, so reading a cell costs the
+ * same whatever its size.  Setting the grid it already has
+ * costs nothing.
+ *
+ * Inputs:  rows, columns - size of the grid, at most the
+ *                          block grid's (0 for none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::set_overview(int rows, int columns)
+{
+    int r, c, i, j;
     
-    /* First make sure string has valid characters */
-    if ( !string_valid(user_input) )
+    if ( (rows == overview_rows) && (columns == overview_columns) )
     {
-        PRINT_ERROR("Invalid input!\n");
-        return false;
+        return;
     }
-    
-    DEBUG_INFO("String is valid!\n");
-    
-    while( 1 )
+    overview_rows = (columns > 0) ? rows : 0;
+    overview_columns = (rows > 0) ? columns : 0;
+    block_overview.assign(block_rows * block_columns, 0);
+    overview_revealed.assign(overview_rows * overview_columns, 0);
+    for (r = 0; r < overview_rows; r++)
     {
-        mark_square = false;
-        
-        openp_index = user_input.find("(", openp_index + 1);
-        if (openp_index == (size_t) -1)
+        for (i = r * block_rows / overview_rows;
+             i < (r + 1) * block_rows / overview_rows; i++)
         {
-            break;
-        }
-        
-        /* Is this marking a spot or making a move? */
-        if (openp_index > 0)
-        {
-            c = user_input.at(openp_index - 1);
-            if ( (c == 'm') ||
-                 (c == 'M')
-               )
-            {
-                DEBUG_INFO("Marking square\n");
-                mark_square = true;
-            }
-#ifdef DEBUG_PRINTS
-            else
+            for (c = 0; c < overview_columns; c++)
             {
-                DEBUG_INFO("Making move\n");
+                for (j = c * block_columns / overview_columns;
+                     j < (c + 1) * block_columns / overview_columns; j++)
+                {
+                    block_overview[i * block_columns + j] =
+                        r * overview_columns + c;
+                    overview_revealed[r * overview_columns + c] +=
+                        block_revealed[i * block_columns + j];
+                }
             }
-#endif            
-        }
-        
-        /* Found open parenthesis - Find comma to get row */
-        comma_index = user_input.find(",", openp_index);
-        if (comma_index == (size_t) -1)
-        {
-            PRINT_INFO("Move invalid (can't find comma)!\n");
-            break;
-        }
-        temp = user_input.substr(openp_index + 1, 
-                                 (comma_index - openp_index - 1)
-                                );
-        /* Make sure it's just a number in between */
-        if ( !string_valid_number(temp) )
-        {
-            PRINT_INFO("Move invalid (row not a number)!\n");
-            break;
-        }
-        
-        move_row = atoi(temp.c_str() ) - 1;
-        DEBUG_INFO("Move row %d\n", move_row + 1);
-        
-        /* Next find close parenthesis */
-        closep_index = user_input.find(")", comma_index);
-        if (closep_index == (size_t) -1)
-        {
-            PRINT_INFO("Move invalid (cannot find close parenthesis)!\n");
-            break;
-        }
-        temp = user_input.substr(comma_index + 1,
-                                 (closep_index - comma_index - 1)
-                                );
-        /* Make sure it's just a number in between */
-        if ( !string_valid_number(temp) )
-        {
-            PRINT_INFO("Move invalid (column not a number)!\n");
-            break;
-        }
-        move_col = atoi(temp.c_str()) - 1;
-        DEBUG_INFO("Move col %d\n", move_col + 1);
-        
-        move_success = this->make_move(move_row, move_col, mark_square);
-        if (!move_success)
-        {
-            DEBUG_INFO("Game over, didn't win\n");
-            game_over = true;
-            game_won = false;
-            return game_over;
         }
-        
-    }
-    
-    /* Made all moves - have we revealed all squares? */
-    if ( squares_revealed == ( (rows*columns) - mines ) )
-    {
-        DEBUG_INFO("Game over, won\n");
-        game_won = true;
-        game_over = true;
     }
+}
 
-    DEBUG_INFO("Game not over yet ... \n");
-    return game_over;
+/* set_messages
+ * 
+ * Collects the per-move messages in a string instead of
+ * printing them, for callers that print from another
+ * thread (see hdr/GameLoop.h)
+ *
+ * Inputs:  out - string to append to, NULL to print again
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::set_messages(std::string* out)
+{
+    messages = out;
 }
 
-/* make_move
+/* move_info
  * 
- * Makes the specified move
+ * Prints a per-move message, or adds it to the messages
+ * string if there is one
  *
- * Inputs:  move_row - Row is square affected
- *          move_col - Column of square affected
- *          mark_square - true if just marking square
- *                        false if making a move
+ * Inputs:  format - printf format, then its arguments
  * Outputs: (none)
- * Returns: true if moves successfully made
- *          false if selected a mine
+ * Returns: void
  */
-bool Board::make_move(int move_row, int move_col, bool mark_square)
+void Board::move_info(const char* format, ...)
 {
-    if ( mark_square )
+    char text[256];
+    va_list args;
+
+    va_start(args, format);
+    if (messages == NULL)
     {
-        PRINT_INFO("Marking (%d,%d)\n", move_row + 1, move_col + 1);
-        squares[move_row*columns + move_col].mark();
+        vprintf(format, args);
     }
     else
     {
-        PRINT_INFO("Making a move on (%d,%d)\n", move_row + 1, move_col + 1);
-        squares_revealed += squares[move_row*columns + move_col].reveal();
-        if (squares[move_row*columns + move_col].is_mine())
+        vsnprintf(text, sizeof(text), format, args);
+        messages->append(text);
+    }
+    va_end(args);
+}
+
+/* set_event_log
+ * 
+ * Starts logging this game's events.  The creation of the
+ * game is logged right away.
+ *
+ * Inputs:  log      - log to append to, NULL to stop logging
+ *          _game_id - id of this game within the log
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::set_event_log(EventLog* log, uint32_t _game_id)
+{
+    event_log = log;
+    game_id = _game_id;
+    if (event_log != NULL)
+    {
+        event_log->game_created(game_id, rows, columns, mines, 
+                                topology, seed);
+        if (event_log->get_hashes())
         {
-            DEBUG_INFO("Made a move on a mine!\n");
-            return false;
+            event_log->mine_hash(game_id, mine_hash);
         }
-        
     }
-    return true;
 }
 
-/* did_we_win
+/* set_spectators
  * 
- * Did we win? :)
+ * Starts (or stops) telling a spectator feed about every
+ * change, so it can publish a frame after each move.  The
+ * board does not own the feed.
  *
- * Inputs:  (none)
+ * Inputs:  feed - feed made for this board, NULL to stop
  * Outputs: (none)
- * Returns: true if we won the game
- *          false otherwise
+ * Returns: void
  */
-bool Board::did_we_win()
+void Board::set_spectators(SpectatorFeed* feed)
 {
-    return game_won;
+    spectators = feed;
 }
 
-/******************************************************
-             LOCAL FUNCTION IMPLEMENTATIONS
-*******************************************************/
-
-/* string_valid
+/* populate_neighbors
  * 
- * Checks if all characters are valid 
- * (Can only have white space, open parenthesis, 
- * close_parenthesis, commas, M/m, and numbers
+ * Let all the squares know who their neighbors are.
+ * The topology is resolved once here, the per-square
+ * work runs in a loop specialized for it.
  *
- * Inputs:  user_input - String from user
+ * Inputs:  (none)
  * Outputs: (none)
- * Returns: true if string is valid
- *          false otherwise
+ * Returns: void
  */
-bool string_valid(std::string user_input)
+void Board::populate_neighbors()
 {
-    size_t i;
+    DEBUG_INFO("Populate num neighbors\n");
+    
+    switch (topology)
+    {
+    case TOPOLOGY_TORUS:
+        link_neighbors<TorusTopology>();
+        break;
+    case TOPOLOGY_HEX:
+        link_neighbors<HexTopology>();
+        break;
+    default:
+        link_neighbors<SquareTopology>();
+        break;
+    }
+}
+
+/* link_neighbors
+ * 
+ * Fills in the neighbor slots of every square using the
+ * offsets and edge handling of a topology policy, then
+ * counts neighboring mines.  Each square only writes
+ * itself, so big boards are split over threads.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+template <class Topology>
+void Board::link_neighbors()
+{
+    cells_parallel(rows * columns, CELLS_HUGE_PAGE / sizeof(Square),
+                   [this](size_t begin, size_t end)
+                   {
+                       int i, j, count;
+                       int neighbor[NUM_NEIGHBORS];
+                       int direction[NUM_NEIGHBORS];
+                       
+                       for (i = (int) begin; i < (int) end; i++)
+                       {
+                           count = topology_neighbors<Topology>(
+                                       rows, columns, i, neighbor, direction);
+                           for (j = 0; j < count; j++)
+                           {
+                               squares[i].set_neighbor(direction[j],
+                                                       &squares[neighbor[j]]);
+                           }
+                           squares[i].calc_neighbor_mines();
+                       }
+                   });
+}
+
+/* index_openings
+ * 
+ * Labels every opening of the board: a connected region of
+ * zeros plus the numbers bordering it, which is exactly what
+ * clicking any of its zeros reveals.  Zeros are joined with
+ * a union-find pass, then each opening's squares are stored
+ * as one sorted range of opening_cells.  The board's 3BV
+ * (fewest clicks to clear it) falls out as the number of
+ * openings plus the numbers that border no zero.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::index_openings()
+{
+    int n = rows*columns;
+    std::vector<int> parent(n);
+    int i, j, k, root, other, count, found;
+    int seen[NUM_NEIGHBORS];
+    Square* neighbor;
+    
+    /* Join every zero with its zero neighbors */
+    for (i = 0; i < n; i++)
+    {
+        parent[i] = i;
+    }
+    for (i = 0; i < n; i++)
+    {
+        if ( !is_zero(i) )
+        {
+            continue;
+        }
+        for (j = 0; j < NUM_NEIGHBORS; j++)
+        {
+            neighbor = squares[i].get_neighbor(j);
+            if ( (neighbor == NULL) || !is_zero( (int) (neighbor - squares) ) )
+            {
+                continue;
+            }
+            root = find_root(parent, i);
+            other = find_root(parent, (int) (neighbor - squares));
+            /* Lower index wins, so each root is its set's
+             * first square */
+            if (root < other)
+            {
+                parent[other] = root;
+            }
+            else if (other < root)
+            {
+                parent[root] = other;
+            }
+        }
+    }
+    
+    /* Number the openings, by their first square */
+    cell_opening.assign(n, -1);
+    count = 0;
+    for (i = 0; i < n; i++)
+    {
+        if ( is_zero(i) )
+        {
+            root = find_root(parent, i);
+            cell_opening[i] = (root == i) ? count++ : cell_opening[root];
+        }
+    }
+    
+    /* Size each opening: its zeros plus its border numbers.
+     * A number can border several openings. */
+    opening_start.assign(count + 1, 0);
+    bbbv = count;
+    for (i = 0; i < n; i++)
+    {
+        if ( is_zero(i) )
+        {
+            opening_start[cell_opening[i] + 1]++;
+            continue;
+        }
+        if ( squares[i].is_mine() )
+        {
+            continue;
+        }
+        found = border_openings(i, seen);
+        for (k = 0; k < found; k++)
+        {
+            opening_start[seen[k] + 1]++;
+        }
+        if (found == 0)
+        {
+            bbbv++;
+        }
+    }
+    for (k = 0; k < count; k++)
+    {
+        opening_start[k + 1] += opening_start[k];
+    }
+    
+    /* Fill the ranges in board order */
+    opening_cells.resize(opening_start[count]);
+    std::vector<int> fill(opening_start.begin(), opening_start.end() - 1);
+    for (i = 0; i < n; i++)
+    {
+        if ( is_zero(i) )
+        {
+            opening_cells[fill[cell_opening[i]]++] = i;
+            continue;
+        }
+        if ( squares[i].is_mine() )
+        {
+            continue;
+        }
+        found = border_openings(i, seen);
+        for (k = 0; k < found; k++)
+        {
+            opening_cells[fill[seen[k]]++] = i;
+        }
+    }
+    
+    DEBUG_INFO("%d openings, 3BV %d\n", count, bbbv);
+}
+
+/* border_openings
+ * 
+ * Lists the openings a numbered square borders
+ *
+ * Inputs:  index - numbered square
+ * Outputs: out   - distinct opening ids (NUM_NEIGHBORS max)
+ * Returns: number of openings written
+ */
+int Board::border_openings( int index, int* out )
+{
+    int j, k, opening, found = 0;
+    Square* neighbor;
+    
+    for (j = 0; j < NUM_NEIGHBORS; j++)
+    {
+        neighbor = squares[index].get_neighbor(j);
+        if (neighbor == NULL)
+        {
+            continue;
+        }
+        opening = cell_opening[neighbor - squares];
+        if (opening < 0)
+        {
+            continue;
+        }
+        for (k = 0; (k < found) && (out[k] != opening); k++)
+        {
+        }
+        if (k == found)
+        {
+            out[found++] = opening;
+        }
+    }
+    return found;
+}
+
+/* is_zero
+ * 
+ * Inputs:  index - square
+ * Outputs: (none)
+ * Returns: true if the square is safe with no mines around it
+ */
+bool Board::is_zero( int index )
+{
+    return !squares[index].is_mine() && (squares[index].get_neighbor_mines() == 0);
+}
+
+/* row_indent
+ * 
+ * How far to shift a row when printing it, so
+ * hexagonal boards line up
+ *
+ * Inputs:  row - row being printed
+ * Outputs: (none)
+ * Returns: number of spaces
+ */
+int Board::row_indent( int row )
+{
+    switch (topology)
+    {
+    case TOPOLOGY_TORUS:
+        return TorusTopology::row_indent(row);
+    case TOPOLOGY_HEX:
+        return HexTopology::row_indent(row);
+    default:
+        return SquareTopology::row_indent(row);
+    }
+}
+
+/* parse_input
+ * 
+ * Parses user input and makes correctly formatted moves 
+ * In the case of incorrect format, any moves after the incorrect
+ * format will be discarded.
+ *
+ * Inputs:  user_input - string of moves
+ * Outputs: (none)
+ * Returns: true if game is over
+ *          false otherwise
+ */
+bool Board::parse_input(std::string user_input)
+{
+    size_t comma_index = -1, openp_index = -1, closep_index = -1;
+    char c;
+    mem_string<MEM_PARSER> temp;
+    mem_vector<board_move, MEM_PARSER> moves;
+    board_move move;
+    move_result result;
+    
+    /* First make sure string has valid characters */
+    if ( !string_valid(user_input) )
+    {
+        MOVE_INFO("\nERROR: Invalid input!\n\n");
+        return false;
+    }
+    
+    DEBUG_INFO("String is valid!\n");
+    
+    /* Undo (Z) and redo (Y) are given on their own */
+    if ( !user_input.empty() &&
+         (user_input.find_first_not_of("ZzYy") == std::string::npos)
+       )
+    {
+        for (comma_index = 0; comma_index < user_input.length(); comma_index++)
+        {
+            c = user_input.at(comma_index);
+            if ( (c == 'Z') || (c == 'z') )
+            {
+                if ( undo() )
+                {
+                    MOVE_INFO("Undid a move\n");
+                }
+                else
+                {
+                    MOVE_INFO("Nothing to undo!\n");
+                }
+            }
+            else
+            {
+                if ( redo() )
+                {
+                    MOVE_INFO("Redid a move\n");
+                }
+                else
+                {
+                    MOVE_INFO("Nothing to redo!\n");
+                }
+            }
+        }
+        return game_over;
+    }
+    
+    moves.clear();
+    while( 1 )
+    {
+        move.type = MOVE_REVEAL;
+        
+        openp_index = user_input.find("(", openp_index + 1);
+        if (openp_index == (size_t) -1)
+        {
+            break;
+        }
+        
+        /* Is this marking, unmarking or chording a spot, or
+         * making a move? */
+        if (openp_index > 0)
+        {
+            c = user_input.at(openp_index - 1);
+            if ( (c == 'm') ||
+                 (c == 'M')
+               )
+            {
+                DEBUG_INFO("Marking square\n");
+                move.type = MOVE_MARK;
+            }
+            else if ( (c == 'u') || (c == 'U') )
+            {
+                DEBUG_INFO("Unmarking square\n");
+                move.type = MOVE_UNMARK;
+            }
+            else if ( (c == 'c') || (c == 'C') )
+            {
+                DEBUG_INFO("Chording square\n");
+                move.type = MOVE_CHORD;
+            }
+#ifdef DEBUG_PRINTS
+            else
+            {
+                DEBUG_INFO("Making move\n");
+            }
+#endif            
+        }
+        
+        /* Found open parenthesis - Find comma to get row */
+        comma_index = user_input.find(",", openp_index);
+        if (comma_index == (size_t) -1)
+        {
+            MOVE_INFO("Move invalid (can't find comma)!\n");
+            break;
+        }
+        temp.assign(user_input, openp_index + 1,
+                    (comma_index - openp_index - 1)
+                   );
+        /* Make sure it's just a number in between */
+        if ( !string_valid_number(temp) )
+        {
+            MOVE_INFO("Move invalid (row not a number)!\n");
+            break;
+        }
+        
+        move.row = atoi(temp.c_str() ) - 1;
+        DEBUG_INFO("Move row %d\n", move.row + 1);
+        
+        /* Next find close parenthesis */
+        closep_index = user_input.find(")", comma_index);
+        if (closep_index == (size_t) -1)
+        {
+            MOVE_INFO("Move invalid (cannot find close parenthesis)!\n");
+            break;
+        }
+        temp.assign(user_input, comma_index + 1,
+                    (closep_index - comma_index - 1)
+                   );
+        /* Make sure it's just a number in between */
+        if ( !string_valid_number(temp) )
+        {
+            MOVE_INFO("Move invalid (column not a number)!\n");
+            break;
+        }
+        move.column = atoi(temp.c_str()) - 1;
+        DEBUG_INFO("Move col %d\n", move.column + 1);
+        
+        if ( (move.row < 0) || (move.row >= rows) ||
+             (move.column < 0) || (move.column >= columns)
+           )
+        {
+            MOVE_INFO("Move invalid (off the board)!\n");
+            break;
+        }
+        
+        moves.push_back(move);
+    }
+    
+    if (moves.empty())
+    {
+        return game_over;
+    }
+    
+    /* apply_moves keeps track of wins and losses */
+    result = apply_moves(&moves[0], (int) moves.size());
+    if (moves.size() == 1)
+    {
+        MOVE_INFO("%s (%d,%d)", move_names[moves[0].type],
+                  moves[0].row + 1, moves[0].column + 1);
+        if ( (moves[0].type == MOVE_REVEAL) || (moves[0].type == MOVE_CHORD) )
+        {
+            MOVE_INFO(", %d revealed", result.revealed);
+        }
+        MOVE_INFO("\n");
+    }
+    else
+    {
+        MOVE_INFO("%d moves (%d ignored): %d revealed, %d marked, "
+                  "%d unmarked\n", (int) moves.size(), result.ignored,
+                  result.revealed, result.marked, result.unmarked);
+    }
+
+    DEBUG_INFO("Game over? %d\n", game_over);
+    return game_over;
+}
+
+/* make_move
+ * 
+ * Makes the specified move and journals the squares it
+ * changed so it can be undone
+ *
+ * Inputs:  move_row - Row is square affected
+ *          move_col - Column of square affected
+ *          mark_square - true if just marking square
+ *                        false if making a move
+ * Outputs: (none)
+ * Returns: true if moves successfully made
+ *          false if selected a mine
+ */
+bool Board::make_move(int move_row, int move_col, bool mark_square)
+{
+    int index = move_row*columns + move_col;
+    square_change change;
+    move_delta delta;
+    bool hit_mine = false;
+    
+    mem_note_move();
+    delta.flags_before = game_flags();
+    delta.revealed_delta = 0;
+    move_changes.clear();
+    journal_changes.clear();
+    
+    if ( mark_square )
+    {
+        MOVE_INFO("Marking (%d,%d)\n", move_row + 1, move_col + 1);
+        /* Marking a revealed square would hide it */
+        if (squares[index].get_state() == UNKNOWN)
+        {
+            change.square = &squares[index];
+            change.old_state = UNKNOWN;
+            move_changes.push_back(change);
+            squares[index].mark();
+            state_hash ^= square_key(index, MARKED);
+            if (spectators != NULL)
+            {
+                spectators->touch(index);
+            }
+        }
+    }
+    else
+    {
+        MOVE_INFO("Making a move on (%d,%d)\n", move_row + 1, move_col + 1);
+        delta.revealed_delta = flood_reveal(index);
+        if (squares[index].is_mine())
+        {
+            DEBUG_INFO("Made a move on a mine!\n");
+            hit_mine = true;
+            game_over = true;
+            game_won = false;
+        }
+        else if ( squares_revealed == ( (rows*columns) - mines ) )
+        {
+            DEBUG_INFO("Game over, won\n");
+            game_won = true;
+            game_over = true;
+        }
+    }
+    
+    delta.flags_after = game_flags();
+    journal_move(delta);
+    
+    if (event_log != NULL)
+    {
+        if (mark_square)
+        {
+            event_log->mark(game_id, move_row, move_col);
+        }
+        else
+        {
+            event_log->move(game_id, move_row, move_col, 
+                            delta.revealed_delta);
+        }
+        log_state_hash();
+        if ( game_over && !(delta.flags_before & GAME_FLAG_OVER) )
+        {
+            event_log->outcome(game_id, game_won);
+        }
+    }
+    if (spectators != NULL)
+    {
+        spectators->publish(this);
+    }
+    return !hit_mine;
+}
+
+/* apply_moves
+ * 
+ * Applies a batch of moves as one step.  Repeated reveals
+ * and chords of a square are dropped.  Marks and unmarks
+ * are applied first, in order; then every reveal, then
+ * every chord (which sees what the reveals opened), all
+ * sharing one flood fill so no square is visited twice.
+ * The batch is journaled as a single move, and the game is
+ * checked for a win once at the end.
+ *
+ * Inputs:  moves - moves to apply
+ *          count - number of moves
+ * Outputs: (none)
+ * Returns: summary of what the batch did
+ */
+move_result Board::apply_moves(const board_move* moves, int count)
+{
+    move_result result;
+    move_delta delta;
+    const board_move* move;
+    square_change change;
+    int i, index, revealed;
+    uint8_t bit;
+    
+    memset(&result, 0, sizeof(result));
+    mem_note_move();
+    delta.flags_before = game_flags();
+    move_changes.clear();
+    journal_changes.clear();
+    reveal_seeds.clear();
+    chord_targets.clear();
+    
+    for (i = 0; i < count; i++)
+    {
+        move = &moves[i];
+        if ( game_over || 
+             (move->row < 0) || (move->row >= rows) ||
+             (move->column < 0) || (move->column >= columns) ||
+             (move->type < 0) || (move->type >= NUM_MOVE_TYPES)
+           )
+        {
+            result.ignored++;
+            continue;
+        }
+        
+        /* Repeated reveals and chords are dropped.  Marks and
+         * unmarks are cheap and order matters, so they stay. */
+        index = move->row*columns + move->column;
+        bit = (uint8_t) (1 << move->type);
+        if ( (move->type == MOVE_REVEAL) || (move->type == MOVE_CHORD) )
+        {
+            if (move_seen[index] & bit)
+            {
+                result.ignored++;
+                continue;
+            }
+            if (move_seen[index] == 0)
+            {
+                move_touched.push_back(index);
+            }
+            move_seen[index] |= bit;
+        }
+        
+        switch (move->type)
+        {
+        case MOVE_MARK:
+        case MOVE_UNMARK:
+            if (squares[index].get_state() != 
+                ( (move->type == MOVE_MARK) ? UNKNOWN : MARKED ) )
+            {
+                result.ignored++;
+                break;
+            }
+            change.square = &squares[index];
+            change.old_state = squares[index].get_state();
+            move_changes.push_back(change);
+            squares[index].set_state( (move->type == MOVE_MARK) ? 
+                                      MARKED : UNKNOWN );
+            state_hash ^= square_key(index, MARKED);
+            if (spectators != NULL)
+            {
+                spectators->touch(index);
+            }
+            if (move->type == MOVE_MARK)
+            {
+                result.marked++;
+            }
+            else
+            {
+                result.unmarked++;
+            }
+            result.applied++;
+            if (event_log != NULL)
+            {
+                if (move->type == MOVE_MARK)
+                {
+                    event_log->mark(game_id, move->row, move->column);
+                }
+                else
+                {
+                    event_log->unmark(game_id, move->row, move->column);
+                }
+                log_state_hash();
+            }
+            break;
+        case MOVE_REVEAL:
+            reveal_seeds.push_back(index);
+            break;
+        default:
+            chord_targets.push_back(index);
+            break;
+        }
+    }
+    
+    for (i = 0; i < (int) move_touched.size(); i++)
+    {
+        move_seen[move_touched[i]] = 0;
+    }
+    move_touched.clear();
+    
+    /* Reveals, then chords, through the shared flood fill */
+    for (i = 0; i < (int) reveal_seeds.size(); i++)
+    {
+        index = reveal_seeds[i];
+        if ( game_over || (squares[index].get_state() == REVEALED) )
+        {
+            result.ignored++;
+            continue;
+        }
+        revealed = flood_reveal(index);
+        result.revealed += revealed;
+        result.applied++;
+        if (event_log != NULL)
+        {
+            event_log->move(game_id, index / columns, index % columns, 
+                            revealed);
+            log_state_hash();
+        }
+    }
+    for (i = 0; i < (int) chord_targets.size(); i++)
+    {
+        index = chord_targets[i];
+        revealed = game_over ? -1 : chord_reveal(index);
+        if (revealed < 0)
+        {
+            result.ignored++;
+            continue;
+        }
+        result.revealed += revealed;
+        result.applied++;
+        if (event_log != NULL)
+        {
+            event_log->chord(game_id, index / columns, index % columns, 
+                             revealed);
+            log_state_hash();
+        }
+    }
+    
+    /* One completion check for the whole batch */
+    result.hit_mine = game_over && !(delta.flags_before & GAME_FLAG_OVER);
+    if ( !game_over && (squares_revealed == (rows*columns) - mines) )
+    {
+        DEBUG_INFO("Game over, won\n");
+        game_won = true;
+        game_over = true;
+    }
+    result.game_over = game_over;
+    result.game_won = game_won;
+    
+    delta.revealed_delta = result.revealed;
+    delta.flags_after = game_flags();
+    journal_move(delta);
+    
+    if ( (event_log != NULL) && (result.applied > 1) )
+    {
+        event_log->batch(game_id, result.applied);
+    }
+    if ( (event_log != NULL) && game_over && 
+         !(delta.flags_before & GAME_FLAG_OVER) 
+       )
+    {
+        event_log->outcome(game_id, game_won);
+    }
+    if (spectators != NULL)
+    {
+        spectators->publish(this);
+    }
+    return result;
+}
+
+/* flood_reveal
+ * 
+ * Reveals a square.  A zero reveals its whole opening
+ * (see index_openings) in one sweep over a precomputed
+ * range, instead of rediscovering it square by square.
+ * Squares are recorded in move_changes as they flip.
+ * Revealing a mine ends the game.
+ *
+ * Inputs:  index - square to reveal
+ * Outputs: (none)
+ * Returns: number of safe squares revealed
+ */
+int Board::flood_reveal( int index )
+{
+    square_change change;
+    const int* cells;
+    int revealed = 0, count, opening, i;
+    
+    opening = cell_opening[index];
+    if (opening < 0)
+    {
+        /* Number or mine, just this square */
+        cells = &index;
+        count = 1;
+    }
+    else
+    {
+        cells = &opening_cells[opening_start[opening]];
+        count = opening_start[opening + 1] - opening_start[opening];
+    }
+    
+    for (i = 0; i < count; i++)
+    {
+        change.square = &squares[cells[i]];
+        change.old_state = change.square->get_state();
+        if (change.old_state == REVEALED)
+        {
+            continue;
+        }
+        move_changes.push_back(change);
+        change.square->set_state(REVEALED);
+        count_revealed(cells[i], 1);
+        state_hash ^= square_key(cells[i], change.old_state) ^
+                      square_key(cells[i], REVEALED);
+        if (spectators != NULL)
+        {
+            spectators->touch(cells[i]);
+        }
+        
+        if (change.square->is_mine())
+        {
+            DEBUG_INFO("Made a move on a mine!\n");
+            game_over = true;
+            game_won = false;
+            continue;
+        }
+        revealed++;
+    }
+    squares_revealed += revealed;
+    return revealed;
+}
+
+/* chord_reveal
+ * 
+ * Chords on a revealed number: if it has exactly as many
+ * marked neighbors as its number, its unknown neighbors
+ * are revealed
+ *
+ * Inputs:  index - square to chord on
+ * Outputs: (none)
+ * Returns: number of squares revealed
+ *          -1 if the square can't be chorded
+ */
+int Board::chord_reveal( int index )
+{
+    Square* square = &squares[index];
+    Square* neighbor;
+    int marked = 0, revealed = 0, i;
+    
+    if ( (square->get_state() != REVEALED) || square->is_mine() ||
+         (square->get_neighbor_mines() == 0)
+       )
+    {
+        return -1;
+    }
+    for (i = 0; i < NUM_NEIGHBORS; i++)
+    {
+        neighbor = square->get_neighbor(i);
+        if ( (neighbor != NULL) && (neighbor->get_state() == MARKED) )
+        {
+            marked++;
+        }
+    }
+    if (marked != square->get_neighbor_mines())
+    {
+        return -1;
+    }
+    
+    for (i = 0; i < NUM_NEIGHBORS; i++)
+    {
+        neighbor = square->get_neighbor(i);
+        if ( (neighbor != NULL) && (neighbor->get_state() == UNKNOWN) )
+        {
+            revealed += flood_reveal( (int) (neighbor - squares) );
+        }
+    }
+    return revealed;
+}
+
+/* journal_move
+ * 
+ * Appends the squares changed by the last move to the
+ * journal.  Moves that changed nothing are not recorded.
+ *
+ * Inputs:  delta - counters and flags of the move
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::journal_move(move_delta delta)
+{
+    size_t i;
+    cell_change change;
+    
+    if ( move_changes.empty() && (delta.flags_before == delta.flags_after) )
+    {
+        return;
+    }
+    
+    /* A square changed twice in one batch (marked, then
+     * revealed) is journaled once, from its first old state */
+    journal_changes.clear();
+    for (i = 0; i < move_changes.size(); i++)
+    {
+        change.index = (int) (move_changes[i].square - squares);
+        if (move_seen[change.index] & SEEN_JOURNALED)
+        {
+            continue;
+        }
+        move_seen[change.index] |= SEEN_JOURNALED;
+        change.old_state = move_changes[i].old_state;
+        change.new_state = move_changes[i].square->get_state();
+        journal_changes.push_back(change);
+    }
+    for (i = 0; i < journal_changes.size(); i++)
+    {
+        move_seen[journal_changes[i].index] = 0;
+    }
+    journal.record(journal_changes, delta);
+}
+
+/* undo
+ * 
+ * Takes back the last move (or the last redone move)
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if a move was undone
+ *          false if there was nothing to undo
+ */
+bool Board::undo()
+{
+    size_t i;
+    move_delta delta;
+    
+    if ( !journal.step_back(journal_changes, &delta) )
+    {
+        journal_changes.clear();
+        return false;
+    }
+    for (i = 0; i < journal_changes.size(); i++)
+    {
+        set_square_state( journal_changes[i].index,
+                          (square_state) journal_changes[i].old_state );
+    }
+    squares_revealed -= delta.revealed_delta;
+    set_game_flags(delta.flags_before);
+    if (event_log != NULL)
+    {
+        event_log->undo(game_id);
+        log_state_hash();
+    }
+    if (spectators != NULL)
+    {
+        spectators->publish(this);
+    }
+    return true;
+}
+
+/* redo
+ * 
+ * Makes the last undone move again
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if a move was redone
+ *          false if there was nothing to redo
+ */
+bool Board::redo()
+{
+    size_t i;
+    move_delta delta;
+    
+    if ( !journal.step_forward(journal_changes, &delta) )
+    {
+        journal_changes.clear();
+        return false;
+    }
+    for (i = 0; i < journal_changes.size(); i++)
+    {
+        set_square_state( journal_changes[i].index,
+                          (square_state) journal_changes[i].new_state );
+    }
+    squares_revealed += delta.revealed_delta;
+    set_game_flags(delta.flags_after);
+    if (event_log != NULL)
+    {
+        event_log->redo(game_id);
+        log_state_hash();
+    }
+    if (spectators != NULL)
+    {
+        spectators->publish(this);
+    }
+    return true;
+}
+
+/* block_of
+ * 
+ * Which overview block a square is counted in
+ *
+ * Inputs:  index - square (row-major)
+ * Outputs: (none)
+ * Returns: index into block_revealed
+ */
+int Board::block_of( int index )
+{
+    return ( (index / columns) >> BOARD_BLOCK_SHIFT ) * block_columns +
+           ( (index % columns) >> BOARD_BLOCK_SHIFT );
+}
+
+/* count_revealed
+ * 
+ * Adds to the revealed count of a square's block, and of
+ * the overview cell the block is in
+ *
+ * Inputs:  index - square (row-major)
+ *          delta - +1 if it was revealed, -1 if hidden again
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::count_revealed( int index, int delta )
+{
+    int block = block_of(index);
+    
+    block_revealed[block] += delta;
+    if (overview_rows > 0)
+    {
+        overview_revealed[block_overview[block]] += delta;
+    }
+}
+
+/* set_square_state
+ * 
+ * Changes the state of a square without going through a
+ * move (undo, redo, restores), keeping the block counts
+ * in step
+ *
+ * Inputs:  index - square (row-major)
+ *          state - new state
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::set_square_state( int index, square_state state )
+{
+    square_state old_state = squares[index].get_state();
+    bool was_revealed = (old_state == REVEALED);
+    
+    if ( was_revealed != (state == REVEALED) )
+    {
+        count_revealed(index, was_revealed ? -1 : 1);
+    }
+    squares[index].set_state(state);
+    state_hash ^= square_key(index, old_state) ^ square_key(index, state);
+    if (spectators != NULL)
+    {
+        spectators->touch(index);
+    }
+}
+
+/* game_flags
+ * 
+ * Packs game_over and game_won for the journal
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: GAME_FLAG_* bits
+ */
+uint8_t Board::game_flags()
+{
+    return (game_over ? GAME_FLAG_OVER : 0) | (game_won ? GAME_FLAG_WON : 0);
+}
+
+/* set_game_flags
+ * 
+ * Unpacks game_over and game_won from the journal
+ *
+ * Inputs:  flags - GAME_FLAG_* bits
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::set_game_flags(uint8_t flags)
+{
+    game_over = (flags & GAME_FLAG_OVER) != 0;
+    game_won = (flags & GAME_FLAG_WON) != 0;
+}
+
+/* log_state_hash
+ * 
+ * Logs the state hash after a logged move, if the log
+ * wants hashes
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::log_state_hash()
+{
+    if ( (event_log != NULL) && event_log->get_hashes() )
+    {
+        event_log->state_hash(game_id, state_hash);
+    }
+}
+
+/* pack_mines
+ * 
+ * Writes the mine layout as a bitplane, one bit per
+ * square in row-major order (bit i&7 of byte i>>3)
+ *
+ * Inputs:  (none)
+ * Outputs: plane - at least (rows*columns+7)/8 bytes
+ * Returns: void
+ */
+void Board::pack_mines(uint8_t* plane)
+{
+    int i;
+    int n = rows*columns;
+    
+    memset(plane, 0, (n + 7) / 8);
+    for (i = 0; i < n; i++)
+    {
+        if (squares[i].is_mine())
+        {
+            plane[i >> 3] |= (uint8_t) (1 << (i & 7));
+        }
+    }
+}
+
+/* pack_states
+ * 
+ * Writes the state of every square as a 2 bit plane
+ * (see square_state in hdr/Square.h), four squares per
+ * byte in row-major order
+ *
+ * Inputs:  (none)
+ * Outputs: plane - at least (rows*columns+3)/4 bytes
+ * Returns: void
+ */
+void Board::pack_states(uint8_t* plane)
+{
+    int i;
+    int n = rows*columns;
+    
+    memset(plane, 0, (n + 3) / 4);
+    for (i = 0; i < n; i++)
+    {
+        plane[i >> 2] |= (uint8_t) (squares[i].get_state() << ((i & 3) * 2));
+    }
+}
+
+/* restore_states
+ * 
+ * Puts the board back into a previously packed state
+ *
+ * Inputs:  plane     - 2 bit state plane (see pack_states)
+ *          _revealed - number of squares revealed in that state
+ *          _over     - was the game over
+ *          _won      - was the game won
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::restore_states(const uint8_t* plane, int _revealed,
+                           bool _over, bool _won)
+{
+    restore_states(plane, _revealed, _over, _won, NULL);
+}
+
+/* restore_states
+ * 
+ * Same, for a caller that knows the state the board is in
+ *
+ * Inputs:  plane     - 2 bit state plane (see pack_states)
+ *          _revealed - number of squares revealed in that state
+ *          _over     - was the game over
+ *          _won      - was the game won
+ *          current   - plane of the state the board is in now,
+ *                      if the caller knows it (may be NULL).
+ *                      Only squares whose byte differs in the
+ *                      two planes are looked at.
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::restore_states(const uint8_t* plane, int _revealed,
+                           bool _over, bool _won, const uint8_t* current)
+{
+    int i, byte;
+    int n = rows*columns;
+    int bytes = (n + 3) / 4;
+    square_state state;
+    
+    /* Only squares that differ are set, so going back to a
+     * nearby state costs what changed, plus the scan */
+    for (byte = 0; byte < bytes; byte++)
+    {
+        if ( (current != NULL) && (plane[byte] == current[byte]) )
+        {
+            continue;
+        }
+        for (i = byte * 4; (i < byte * 4 + 4) && (i < n); i++)
+        {
+            state = (square_state) ( (plane[byte] >> ((i & 3) * 2)) & 3 );
+            if (squares[i].get_state() != state)
+            {
+                set_square_state(i, state);
+            }
+        }
+    }
+    squares_revealed = _revealed;
+    game_over = _over;
+    game_won = _won;
+    if (spectators != NULL)
+    {
+        spectators->publish(this);
+    }
+}
+
+/* swap_journal
+ * 
+ * Trades the undo history with a journal kept elsewhere,
+ * e.g. while the board is parked (see hdr/ParkedBoard.h)
+ *
+ * Inputs:  other - journal to trade with
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::swap_journal(Journal* other)
+{
+    journal.swap(*other);
+}
+
+/* trim_history
+ * 
+ * Forgets the oldest undo steps until the board fits in
+ * max_bytes (see get_memory_bytes).  The history is cut to
+ * half of what is left for it, so a board that keeps
+ * growing is not trimmed again on every move.
+ *
+ * Inputs:  max_bytes - memory the board may hold
+ * Outputs: (none)
+ * Returns: void
+ */
+void Board::trim_history(size_t max_bytes)
+{
+    size_t rest;
+
+    if (get_memory_bytes() <= max_bytes)
+    {
+        return;
+    }
+    rest = get_memory_bytes() - journal.memory_bytes();
+    journal.trim( (max_bytes > rest) ? (max_bytes - rest) / 2 : 0 );
+}
+
+/* get_rows
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of rows in the board
+ */
+int Board::get_rows()
+{
+    return rows;
+}
+
+/* get_columns
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of columns in the board
+ */
+int Board::get_columns()
+{
+    return columns;
+}
+
+/* get_topology
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: shape of the board (see hdr/Topology.h)
+ */
+board_topology Board::get_topology()
+{
+    return topology;
+}
+
+/* get_mines
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of mines in the board
+ */
+int Board::get_mines()
+{
+    return mines;
+}
+
+/* get_seed
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: seed the mine layout was generated from
+ */
+unsigned int Board::get_seed()
+{
+    return seed;
+}
+
+/* get_squares_revealed
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of squares revealed so far
+ */
+int Board::get_squares_revealed()
+{
+    return squares_revealed;
+}
+
+/* is_game_over
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if the game has ended, won or lost
+ */
+bool Board::is_game_over()
+{
+    return game_over;
+}
+
+/* get_square_state
+ * 
+ * Inputs:  row, column - square to look at (0 based)
+ * Outputs: (none)
+ * Returns: state of the square
+ */
+square_state Board::get_square_state(int row, int column)
+{
+    return squares[row*columns + column].get_state();
+}
+
+/* get_square_number
+ * 
+ * Only meaningful for revealed squares, the number is
+ * what the player sees
+ *
+ * Inputs:  row, column - square to look at (0 based)
+ * Outputs: (none)
+ * Returns: number of neighboring mines
+ */
+int Board::get_square_number(int row, int column)
+{
+    return squares[row*columns + column].get_neighbor_mines();
+}
+
+/* get_3bv
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: 3BV of the board: fewest reveals that clear it
+ */
+int Board::get_3bv()
+{
+    return bbbv;
+}
+
+/* get_openings
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of openings (zero regions) on the board
+ */
+int Board::get_openings()
+{
+    return (int) opening_start.size() - 1;
+}
+
+/* get_state_hash
+ * 
+ * Hash of every square's state, updated as squares change
+ * (so O(squares changed) per move).  Two boards with the
+ * same squares in the same states have the same hash.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: state hash, 0 when nothing is revealed or marked
+ */
+uint64_t Board::get_state_hash()
+{
+    return state_hash;
+}
+
+/* get_last_changes
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: squares the last move, batch, undo or redo
+ *          changed (empty if it changed none), with their
+ *          states before and after the move.  For an undo
+ *          the states are the other way round: the square
+ *          went from new_state back to old_state.
+ */
+const std::vector<cell_change>& Board::get_last_changes()
+{
+    return journal_changes;
+}
+
+/* get_memory_bytes
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: bytes the board holds: its squares, the undo
+ *          history and the per-square tables
+ */
+size_t Board::get_memory_bytes()
+{
+    return (size_t) rows * columns * sizeof(Square) +
+           journal.memory_bytes() +
+           move_changes.capacity() * sizeof(square_change) +
+           move_seen.capacity() +
+           ( block_revealed.capacity() + block_overview.capacity() +
+             overview_revealed.capacity() + move_touched.capacity() +
+             reveal_seeds.capacity() + chord_targets.capacity() +
+             cell_opening.capacity() + opening_start.capacity() +
+             opening_cells.capacity() ) * sizeof(int);
+}
+
+/* get_mine_hash
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: hash of the board's size, topology and mine layout
+ */
+uint64_t Board::get_mine_hash()
+{
+    return mine_hash;
+}
+
+/* get_block_rows / get_block_columns
+ * 
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: size of the grid of overview blocks
+ *          (see BOARD_BLOCK_SHIFT)
+ */
+int Board::get_block_rows()
+{
+    return block_rows;
+}
+
+int Board::get_block_columns()
+{
+    return block_columns;
+}
+
+/* get_block_revealed
+ * 
+ * Inputs:  block_row, block_column - block to look at
+ * Outputs: (none)
+ * Returns: number of revealed squares in the block
+ */
+int Board::get_block_revealed(int block_row, int block_column)
+{
+    return block_revealed[block_row * block_columns + block_column];
+}
+
+/* get_overview_revealed
+ * 
+ * Inputs:  row, column - overview cell (see set_overview)
+ * Outputs: (none)
+ * Returns: number of revealed squares in the cell's blocks
+ */
+int Board::get_overview_revealed(int row, int column)
+{
+    return overview_revealed[row * overview_columns + column];
+}
+
+/* did_we_win
+ * 
+ * Did we win? :)
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if we won the game
+ *          false otherwise
+ */
+bool Board::did_we_win()
+{
+    return game_won;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* string_valid
+ * 
+ * Checks if all characters are valid 
+ * (Can only have white space, open parenthesis, 
+ * close_parenthesis, commas, M/m, Z/z, Y/y and numbers
+ *
+ * Inputs:  user_input - String from user
+ * Outputs: (none)
+ * Returns: true if string is valid
+ *          false otherwise
+ */
+bool string_valid(std::string user_input)
+{
+    size_t i;
     char c;
     
     for (i = 0; i < user_input.length(); i++)
@@ -468,6 +1919,14 @@ bool string_valid(std::string user_input)
              ( c != ',' ) &&
              ( c != 'M' ) &&
              ( c != 'm' ) &&
+             ( c != 'Z' ) &&
+             ( c != 'z' ) &&
+             ( c != 'Y' ) &&
+             ( c != 'y' ) &&
+             ( c != 'U' ) &&
+             ( c != 'u' ) &&
+             ( c != 'C' ) &&
+             ( c != 'c' ) &&
              ( ( c <  '0' ) ||
                ( c >  '9' )
              )
@@ -491,7 +1950,7 @@ bool string_valid(std::string user_input)
  * Returns: true if string is valid
  *          false otherwise
  */
-bool string_valid_number(std::string user_input)
+bool string_valid_number(const mem_string<MEM_PARSER>& user_input)
 {
     size_t i;
     char c;
@@ -512,4 +1971,56 @@ bool string_valid_number(std::string user_input)
     
     return true;
 
-}
\ No newline at end of file
+}
+
+/* find_root
+ * 
+ * Union-find lookup with path halving
+ *
+ * Inputs:  parent - union-find forest
+ *          i      - element to look up
+ * Outputs: parent - paths shortened
+ * Returns: root of i's set
+ */
+static int find_root(std::vector<int>& parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/* mix_key
+ * 
+ * SplitMix64 finalizer: spreads a small number over all
+ * 64 bits.  Keys are computed rather than stored, so huge
+ * boards need no key table.
+ *
+ * Inputs:  value - number to mix
+ * Outputs: (none)
+ * Returns: its key
+ */
+static uint64_t mix_key(uint64_t value)
+{
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+/* square_key
+ * 
+ * Zobrist key of a square in a state.  UNKNOWN squares
+ * count for nothing, so a fresh board hashes to 0.
+ *
+ * Inputs:  index - square (row-major)
+ *          state - its state
+ * Outputs: (none)
+ * Returns: key to XOR into the state hash
+ */
+static uint64_t square_key(int index, square_state state)
+{
+    return (state == UNKNOWN) ? 0 : mix_key( ((uint64_t) index << 2) | state );
+}
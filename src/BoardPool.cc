@@ -0,0 +1,364 @@
+/* src/BoardPool.cc
+ *
+ * Implementation of the pool of ready boards
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdlib.h>
+#include <time.h>
+
+#include "BoardPool.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t now_ns();
+static void note_max(std::atomic<uint64_t>& max, uint64_t value);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Sets up an empty pool.  Add presets, then start it.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: BoardPool struct
+ */
+BoardPool::BoardPool()
+{
+    consumers = 0;
+    stopping = false;
+    hits = 0;
+    misses = 0;
+    built = 0;
+    build_ns = 0;
+    max_build_ns = 0;
+    refill_ns = 0;
+    max_refill_ns = 0;
+    refills = 0;
+}
+
+/* Destructor
+ *
+ * Stops the refill threads and frees every ready board
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+BoardPool::~BoardPool()
+{
+    stop();
+}
+
+/* add_preset
+ *
+ * Keeps boards of a size ready.  Only before start.
+ *
+ * Inputs:  rows, columns, mines, topology - the boards
+ *          depth - boards to keep per consumer
+ *                  (1 to POOL_MAX_DEPTH)
+ * Outputs: (none)
+ * Returns: true if the preset is valid and new
+ */
+bool BoardPool::add_preset(int rows, int columns, int mines,
+                           board_topology topology, int depth)
+{
+    pool_preset preset;
+    size_t i;
+
+    if ( !queues.empty() ||
+         (rows < 1) || (columns < 1) || (mines < 1) ||
+         (mines > rows*columns) ||
+         (topology < 0) || (topology >= NUM_TOPOLOGIES) ||
+         (depth < 1) || (depth > POOL_MAX_DEPTH)
+       )
+    {
+        return false;
+    }
+    for (i = 0; i < presets.size(); i++)
+    {
+        if ( (presets[i].rows == rows) && (presets[i].columns == columns) &&
+             (presets[i].mines == mines) && (presets[i].topology == topology) )
+        {
+            return false;
+        }
+    }
+
+    preset.rows = rows;
+    preset.columns = columns;
+    preset.mines = mines;
+    preset.topology = topology;
+    preset.depth = depth;
+    presets.push_back(preset);
+    return true;
+}
+
+/* start
+ *
+ * Sets up a queue per consumer and preset and starts
+ * filling them
+ *
+ * Inputs:  _consumers - threads that will take boards,
+ *                       numbered from 0
+ *          threads    - refill threads
+ * Outputs: (none)
+ * Returns: void
+ */
+void BoardPool::start(int _consumers, int threads)
+{
+    pool_queue* queue;
+    int i, count;
+
+    if ( presets.empty() || !queues.empty() || (_consumers < 1) )
+    {
+        return;
+    }
+    consumers = _consumers;
+    count = consumers * (int) presets.size();
+    threads = (threads < 1) ? 1 : (threads > count) ? count : threads;
+
+    for (i = 0; i < count; i++)
+    {
+        queue = new pool_queue;
+        queue->preset = &presets[i % presets.size()];
+        queue->taken_ns = 0;
+        queue->refiller = i % threads;
+        queues.push_back(queue);
+    }
+
+    stopping = false;
+    for (i = 0; i < threads; i++)
+    {
+        wakeups.push_back(new sem_t);
+        sem_init(wakeups[i], 0, 0);
+    }
+    for (i = 0; i < threads; i++)
+    {
+        refillers.push_back(std::thread(&BoardPool::refill_thread, this, i,
+                                        (unsigned int) time(NULL) ^
+                                        (i * 0x9e3779b9u)));
+    }
+}
+
+/* stop
+ *
+ * Stops the refill threads and frees every ready board
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void BoardPool::stop()
+{
+    Board* board;
+    size_t i;
+
+    stopping = true;
+    for (i = 0; i < wakeups.size(); i++)
+    {
+        sem_post(wakeups[i]);
+    }
+    for (i = 0; i < refillers.size(); i++)
+    {
+        refillers[i].join();
+    }
+    for (i = 0; i < wakeups.size(); i++)
+    {
+        sem_destroy(wakeups[i]);
+        delete wakeups[i];
+    }
+    for (i = 0; i < queues.size(); i++)
+    {
+        while (queues[i]->boards.pop(&board))
+        {
+            delete board;
+        }
+        delete queues[i];
+    }
+    refillers.clear();
+    wakeups.clear();
+    queues.clear();
+    consumers = 0;
+}
+
+/* take
+ *
+ * Hands out a ready board and has it replaced.  Only the
+ * given consumer may take from its queues.
+ *
+ * Inputs:  consumer - which consumer is asking
+ *          rows, columns, mines, topology - board wanted
+ * Outputs: (none)
+ * Returns: a fresh board, NULL on a miss
+ */
+Board* BoardPool::take(int consumer, int rows, int columns, int mines,
+                       board_topology topology)
+{
+    pool_queue* queue = NULL;
+    Board* board = NULL;
+    uint64_t none = 0;
+    size_t i;
+
+    if ( (consumer >= 0) && (consumer < consumers) )
+    {
+        for (i = 0; i < presets.size(); i++)
+        {
+            if ( (presets[i].rows == rows) &&
+                 (presets[i].columns == columns) &&
+                 (presets[i].mines == mines) &&
+                 (presets[i].topology == topology) )
+            {
+                queue = queues[consumer * presets.size() + i];
+                break;
+            }
+        }
+    }
+    if (queue == NULL)
+    {
+        misses++;
+        return NULL;
+    }
+
+    if (queue->boards.pop(&board))
+    {
+        hits++;
+    }
+    else
+    {
+        misses++;
+    }
+    queue->taken_ns.compare_exchange_strong(none, now_ns());
+    sem_post(wakeups[queue->refiller]);
+    return board;
+}
+
+/* get_stats
+ *
+ * Inputs:  (none)
+ * Outputs: stats - counters so far, and boards ready now
+ * Returns: void
+ */
+void BoardPool::get_stats(pool_stats* stats)
+{
+    size_t i;
+
+    stats->hits = hits;
+    stats->misses = misses;
+    stats->built = built;
+    stats->build_ns = build_ns;
+    stats->max_build_ns = max_build_ns;
+    stats->refill_ns = refill_ns;
+    stats->max_refill_ns = max_refill_ns;
+    stats->refills = refills;
+    stats->ready = 0;
+    for (i = 0; i < queues.size(); i++)
+    {
+        stats->ready += queues[i]->boards.size();
+    }
+}
+
+/* refill_thread
+ *
+ * Tops up this thread's queues one board at a time, round
+ * robin, and sleeps when they are all full.  Refill
+ * latency runs from the oldest take a queue has not had a
+ * board back for to the next board pushed to it.
+ *
+ * Inputs:  refiller - this thread's number
+ *          seed     - for board seeds
+ * Outputs: (none)
+ * Returns: void
+ */
+void BoardPool::refill_thread(int refiller, unsigned int seed)
+{
+    pool_queue* queue;
+    const pool_preset* preset;
+    Board* board;
+    uint64_t start, took, taken, waited;
+    bool progress;
+    size_t i;
+
+    while (!stopping)
+    {
+        progress = false;
+        for (i = 0; (i < queues.size()) && !stopping; i++)
+        {
+            queue = queues[i];
+            preset = queue->preset;
+            if ( (queue->refiller != refiller) ||
+                 ((int) queue->boards.size() >= preset->depth) )
+            {
+                continue;
+            }
+
+            start = now_ns();
+            board = new Board(preset->rows, preset->columns, preset->mines,
+                              preset->topology, rand_r(&seed));
+            board->set_verbose(false);
+            took = now_ns() - start;
+            queue->boards.push(board);
+            progress = true;
+
+            built++;
+            build_ns += took;
+            note_max(max_build_ns, took);
+            taken = queue->taken_ns.exchange(0);
+            if (taken != 0)
+            {
+                waited = now_ns() - taken;
+                refills++;
+                refill_ns += waited;
+                note_max(max_refill_ns, waited);
+            }
+        }
+        if (!progress)
+        {
+            sem_wait(wakeups[refiller]);
+        }
+    }
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* now_ns
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: CLOCK_MONOTONIC in nanoseconds
+ */
+static uint64_t now_ns()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/* note_max
+ *
+ * Raises an atomic maximum
+ *
+ * Inputs:  max   - the maximum
+ *          value - new sample
+ * Outputs: max   - raised if value is bigger
+ * Returns: void
+ */
+static void note_max(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t seen = max.load(std::memory_order_relaxed);
+
+    while ( (value > seen) &&
+            !max.compare_exchange_weak(seen, value,
+                                       std::memory_order_relaxed) )
+    {
+    }
+}
@@ -0,0 +1,219 @@
+/* src/CellStore.cc
+ *
+ * Implementation of board square storage
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <string>
+
+#include "common.h"
+#include "CellStore.h"
+
+/******************************************************
+                    LOCAL VARIABLES
+*******************************************************/
+static std::string backing_dir;
+static std::atomic<int> worker_threads(0);
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static void* map_anonymous(size_t bytes);
+static void* map_backed(size_t bytes);
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* cells_map
+ *
+ * Reserves storage for a plane of cells.  Mapped planes are
+ * zero filled and not yet touched; a mapping that fails
+ * falls back to the heap.
+ *
+ * Inputs:  bytes - size of the plane
+ * Outputs: plane - where it is and how to free it
+ * Returns: true if storage was found
+ */
+bool cells_map(size_t bytes, cell_plane* plane)
+{
+    size_t size = (bytes + CELLS_HUGE_PAGE - 1) & ~((size_t) CELLS_HUGE_PAGE - 1);
+
+    plane->base = NULL;
+    plane->bytes = bytes;
+    plane->mapped = false;
+
+    if (bytes >= CELLS_MAP_MIN_BYTES)
+    {
+        plane->base = backing_dir.empty() ? map_anonymous(size)
+                                          : map_backed(size);
+        if (plane->base != NULL)
+        {
+            plane->bytes = size;
+            plane->mapped = true;
+            return true;
+        }
+    }
+
+    plane->base = malloc(bytes);
+    return plane->base != NULL;
+}
+
+/* cells_unmap
+ *
+ * Inputs:  plane - storage from cells_map
+ * Outputs: plane - emptied
+ * Returns: void
+ */
+void cells_unmap(cell_plane* plane)
+{
+    if (plane->mapped)
+    {
+        munmap(plane->base, plane->bytes);
+    }
+    else
+    {
+        free(plane->base);
+    }
+    plane->base = NULL;
+    plane->bytes = 0;
+    plane->mapped = false;
+}
+
+/* cells_set_backing
+ *
+ * Backs later big planes with files in a directory.  Set it
+ * at startup, before boards are made.
+ *
+ * Inputs:  dir - directory for the files, NULL for memory
+ * Outputs: (none)
+ * Returns: void
+ */
+void cells_set_backing(const char* dir)
+{
+    backing_dir = (dir != NULL) ? dir : "";
+}
+
+/* cells_set_threads / cells_threads
+ *
+ * Threads cells_parallel may use
+ *
+ * Inputs:  threads - thread count, 0 for one per CPU
+ * Outputs: (none)
+ * Returns: cells_threads: the thread count in use
+ */
+void cells_set_threads(int threads)
+{
+    worker_threads.store(threads, std::memory_order_relaxed);
+}
+
+int cells_threads()
+{
+    int threads = worker_threads.load(std::memory_order_relaxed);
+
+    if (threads <= 0)
+    {
+        threads = (int) std::thread::hardware_concurrency();
+    }
+    return (threads > 0) ? threads : 1;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* map_anonymous
+ *
+ * Maps memory starting on a huge page boundary (over-map,
+ * then trim the ends) so every 2 MB of it can be one huge
+ * page
+ *
+ * Inputs:  bytes - size, a multiple of CELLS_HUGE_PAGE
+ * Outputs: (none)
+ * Returns: the memory, NULL on failure
+ */
+static void* map_anonymous(size_t bytes)
+{
+    uint8_t* raw;
+    uint8_t* base;
+    size_t head;
+
+    raw = (uint8_t*) mmap(NULL, bytes + CELLS_HUGE_PAGE,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                          -1, 0);
+    if (raw == MAP_FAILED)
+    {
+        PRINT_INFO("\nERROR: Cannot map %zu bytes for squares: %s\n",
+                   bytes, strerror(errno));
+        return NULL;
+    }
+
+    base = (uint8_t*) (((uintptr_t) raw + CELLS_HUGE_PAGE - 1) &
+                       ~((uintptr_t) CELLS_HUGE_PAGE - 1));
+    head = base - raw;
+    if (head > 0)
+    {
+        munmap(raw, head);
+    }
+    munmap(base + bytes, CELLS_HUGE_PAGE - head);
+
+#ifdef MADV_HUGEPAGE
+    /* Only a hint: without THP we still get working memory */
+    madvise(base, bytes, MADV_HUGEPAGE);
+#endif
+    return base;
+}
+
+/* map_backed
+ *
+ * Maps a new, already unlinked file in the backing
+ * directory, so it goes away with the mapping
+ *
+ * Inputs:  bytes - size
+ * Outputs: (none)
+ * Returns: the memory, NULL on failure
+ */
+static void* map_backed(size_t bytes)
+{
+    std::string path = backing_dir + "/squares-XXXXXX";
+    void* base;
+    int fd;
+
+    fd = mkstemp(&path[0]);
+    if (fd < 0)
+    {
+        PRINT_INFO("\nERROR: Cannot create %s: %s\n", path.c_str(),
+                   strerror(errno));
+        return NULL;
+    }
+    unlink(path.c_str());
+    if (ftruncate(fd, bytes) != 0)
+    {
+        PRINT_INFO("\nERROR: Cannot size %s: %s\n", path.c_str(),
+                   strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        PRINT_INFO("\nERROR: Cannot map %s: %s\n", path.c_str(),
+                   strerror(errno));
+        return NULL;
+    }
+    return base;
+}
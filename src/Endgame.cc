@@ -0,0 +1,716 @@
+/* src/Endgame.cc
+ *
+ * Implementation of the endgame advisor
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "Endgame.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t splitmix64(uint64_t* state);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Inputs:  _threads - threads to search root moves on
+ * Outputs: (none)
+ * Returns: EndgameSolver struct
+ */
+EndgameSolver::EndgameSolver(int _threads)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    int i, j;
+
+    threads = (_threads < 1) ? 1 : _threads;
+    max_unknown = ENDGAME_DEFAULT_UNKNOWN;
+    unknown = 0;
+    mines = 0;
+    for (i = 0; i < ENDGAME_MAX_UNKNOWN; i++)
+    {
+        for (j = 0; j <= NUM_NEIGHBORS; j++)
+        {
+            zobrist[i][j] = splitmix64(&state);
+        }
+    }
+    clear_table();
+}
+
+/* set_max_unknown
+ *
+ * Inputs:  _max_unknown - most unknown squares advise() will
+ *                         take on (at most ENDGAME_MAX_UNKNOWN)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EndgameSolver::set_max_unknown(int _max_unknown)
+{
+    max_unknown = (_max_unknown > ENDGAME_MAX_UNKNOWN) ?
+                  ENDGAME_MAX_UNKNOWN : _max_unknown;
+}
+
+/* advise
+ *
+ * Finds the reveal with the best chance of winning
+ *
+ * Inputs:  board  - game to advise on
+ * Outputs: advice - the move and its odds
+ * Returns: true if advice was given
+ *          false if the game is over, or too much is still
+ *          unknown to search
+ */
+bool EndgameSolver::advise(Board* board, endgame_advice* advice)
+{
+    std::vector<std::thread> workers;
+    std::atomic<int> next(0);
+    std::mutex best_lock;
+    struct timespec start, end;
+    int order[ENDGAME_MAX_UNKNOWN], safe[ENDGAME_MAX_UNKNOWN];
+    double values[ENDGAME_MAX_UNKNOWN];
+    double total, best = 0.0;
+    int count, choice, i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(advice, 0, sizeof(*advice));
+    if ( !read_board(board) )
+    {
+        advice->unknown = unknown;
+        return false;
+    }
+    advice->unknown = unknown;
+
+    layouts.clear();
+    if ( !enumerate(0, 0, 0, 0) || layouts.empty() )
+    {
+        advice->layouts = layouts.size();
+        return false;
+    }
+    advice->layouts = layouts.size();
+    total = (double) layouts.size();
+
+    clear_table();
+    count = rank_reveals(layouts, 0, order, safe);
+    if (safe[order[0]] == (int) layouts.size())
+    {
+        /* A square that is safe in every layout can't be beaten */
+        count = 1;
+    }
+
+    /* Root moves in parallel, best first, each skipped once
+     * its chance of being safe can't beat the best so far */
+    auto root = [&]()
+    {
+        double value, bound;
+        int n;
+
+        while ( (n = next.fetch_add(1)) < count )
+        {
+            bound = safe[order[n]] / total;
+            {
+                std::lock_guard<std::mutex> guard(best_lock);
+                if ( (n > 0) && (bound <= best) )
+                {
+                    values[n] = -1.0;
+                    continue;
+                }
+            }
+            value = reveal_value(layouts, 0, 0, order[n]);
+            values[n] = value;
+            std::lock_guard<std::mutex> guard(best_lock);
+            if (value > best)
+            {
+                best = value;
+            }
+        }
+    };
+    for (i = 1; (i < threads) && (i < count); i++)
+    {
+        workers.push_back(std::thread(root));
+    }
+    root();
+    for (i = 0; i < (int) workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    /* Ties go to the safer, then the lower, square */
+    choice = 0;
+    for (i = 1; i < count; i++)
+    {
+        if (values[i] > values[choice])
+        {
+            choice = i;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    advice->row = slot_cells[order[choice]] / board->get_columns();
+    advice->column = slot_cells[order[choice]] % board->get_columns();
+    advice->win_probability = values[choice];
+    advice->safe_probability = safe[order[choice]] / total;
+    for (i = 0; i < ENDGAME_TT_STRIPES; i++)
+    {
+        advice->positions += table[i].used;
+    }
+    advice->milliseconds = (end.tv_sec - start.tv_sec) * 1e3 +
+                           (end.tv_nsec - start.tv_nsec) / 1e6;
+    return true;
+}
+
+/* read_board
+ *
+ * Turns what the player sees into slots and constraints.
+ * Squares that are plainly mines (a number with just as
+ * many unrevealed neighbors) are taken out first, so in a
+ * typical endgame only the squares still in doubt become
+ * slots.  Every other unrevealed square is a slot, and every
+ * revealed number next to a slot is a constraint on them.
+ *
+ * Inputs:  board - game to read
+ * Outputs: (none)
+ * Returns: true if the position can be searched
+ */
+bool EndgameSolver::read_board(Board* board)
+{
+    int rows = board->get_rows(), columns = board->get_columns();
+    int cells = rows * columns;
+    board_topology topology = board->get_topology();
+    std::vector<int> cell_slot(cells, -1);
+    std::vector<uint8_t> known_mine(cells, 0);
+    int neighbors[NUM_NEIGHBORS];
+    uint64_t mask;
+    int i, j, count, open, flagged, value;
+    bool changed;
+
+    unknown = 0;
+    slot_cells.clear();
+    if (board->is_game_over())
+    {
+        return false;
+    }
+
+    mines = board->get_mines();
+    changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (i = 0; i < cells; i++)
+        {
+            if (board->get_square_state(i / columns, i % columns) != REVEALED)
+            {
+                continue;
+            }
+            count = board_neighbors(topology, rows, columns, i, neighbors);
+            open = 0;
+            flagged = 0;
+            for (j = 0; j < count; j++)
+            {
+                if (known_mine[neighbors[j]])
+                {
+                    flagged++;
+                }
+                else if (board->get_square_state(neighbors[j] / columns,
+                                                 neighbors[j] % columns) !=
+                         REVEALED)
+                {
+                    open++;
+                }
+            }
+            value = board->get_square_number(i / columns, i % columns);
+            if ( (open == 0) || (value - flagged != open) )
+            {
+                continue;
+            }
+            for (j = 0; j < count; j++)
+            {
+                if ( !known_mine[neighbors[j]] &&
+                     (board->get_square_state(neighbors[j] / columns,
+                                              neighbors[j] % columns) !=
+                      REVEALED)
+                   )
+                {
+                    known_mine[neighbors[j]] = 1;
+                    mines--;
+                }
+            }
+            changed = true;
+        }
+    }
+
+    for (i = 0; i < cells; i++)
+    {
+        if ( !known_mine[i] &&
+             (board->get_square_state(i / columns, i % columns) != REVEALED)
+           )
+        {
+            cell_slot[i] = unknown++;
+            slot_cells.push_back(i);
+        }
+    }
+    if ( (unknown > max_unknown) || (unknown > ENDGAME_MAX_UNKNOWN) ||
+         (unknown == 0)
+       )
+    {
+        return false;
+    }
+
+    for (i = 0; i < unknown; i++)
+    {
+        slot_neighbors[i] = 0;
+        count = board_neighbors(topology, rows, columns, slot_cells[i],
+                                neighbors);
+        for (j = 0; j < count; j++)
+        {
+            if (cell_slot[neighbors[j]] >= 0)
+            {
+                slot_neighbors[i] |= 1ull << cell_slot[neighbors[j]];
+            }
+        }
+    }
+
+    /* Constraints count only the mines still in doubt */
+    constraint_masks.clear();
+    constraint_values.clear();
+    slot_constraints.assign(unknown, std::vector<int>());
+    for (i = 0; i < cells; i++)
+    {
+        if (board->get_square_state(i / columns, i % columns) != REVEALED)
+        {
+            continue;
+        }
+        mask = 0;
+        value = board->get_square_number(i / columns, i % columns);
+        count = board_neighbors(topology, rows, columns, i, neighbors);
+        for (j = 0; j < count; j++)
+        {
+            if (cell_slot[neighbors[j]] >= 0)
+            {
+                mask |= 1ull << cell_slot[neighbors[j]];
+            }
+            value -= known_mine[neighbors[j]];
+        }
+        if (mask == 0)
+        {
+            continue;
+        }
+        for (j = 0; j < unknown; j++)
+        {
+            if (mask & (1ull << j))
+            {
+                slot_constraints[j].push_back(constraint_masks.size());
+            }
+        }
+        constraint_masks.push_back(mask);
+        constraint_values.push_back(value);
+    }
+    return true;
+}
+
+/* enumerate
+ *
+ * Lists every mine layout of the slots that agrees with the
+ * constraints and the mine count, slot by slot, dropping a
+ * branch as soon as a constraint it completes can't be met
+ *
+ * Inputs:  slot     - next slot to decide
+ *          assigned - slots decided so far
+ *          layout   - mines placed so far
+ *          placed   - number of them
+ * Outputs: (none)
+ * Returns: false if there are too many layouts
+ */
+bool EndgameSolver::enumerate(int slot, uint64_t assigned, uint64_t layout,
+                              int placed)
+{
+    uint64_t bit, next;
+    int mine, have, open, k;
+    size_t i;
+    bool fits;
+
+    if (layouts.size() > ENDGAME_MAX_LAYOUTS)
+    {
+        return false;
+    }
+    if (slot == unknown)
+    {
+        if (placed == mines)
+        {
+            layouts.push_back(layout);
+        }
+        return true;
+    }
+
+    bit = 1ull << slot;
+    assigned |= bit;
+    for (mine = 0; mine <= 1; mine++)
+    {
+        if ( (placed + mine > mines) ||
+             (placed + mine + (unknown - slot - 1) < mines)
+           )
+        {
+            continue;
+        }
+        next = layout | (mine ? bit : 0);
+        fits = true;
+        for (i = 0; fits && (i < slot_constraints[slot].size()); i++)
+        {
+            k = slot_constraints[slot][i];
+            have = __builtin_popcountll(next & constraint_masks[k]);
+            open = __builtin_popcountll(constraint_masks[k] & ~assigned);
+            fits = (have <= constraint_values[k]) &&
+                   (have + open >= constraint_values[k]);
+        }
+        if ( fits && !enumerate(slot + 1, assigned, next, placed + mine) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* solve
+ *
+ * Chance of winning from a position with best play
+ *
+ * Inputs:  candidates - layouts still possible
+ *          revealed   - slots revealed since the root
+ *          key        - Zobrist key of what they showed
+ * Outputs: (none)
+ * Returns: win probability
+ */
+double EndgameSolver::solve(const layout_list& candidates,
+                            uint64_t revealed, uint64_t key)
+{
+    int order[ENDGAME_MAX_UNKNOWN], safe[ENDGAME_MAX_UNKNOWN];
+    uint64_t all = (unknown == 64) ? ~0ull : ((1ull << unknown) - 1);
+    double total = (double) candidates.size();
+    double best = 0.0, value;
+    uint64_t sure;
+    int count, i;
+
+    /* Only mines left, or nothing left to guess */
+    if ( (__builtin_popcountll(all & ~revealed) == mines) ||
+         (candidates.size() == 1)
+       )
+    {
+        return 1.0;
+    }
+    if ( lookup(key, &value) )
+    {
+        return value;
+    }
+
+    count = rank_reveals(candidates, revealed, order, safe);
+    if (safe[order[count - 1]] == (int) candidates.size())
+    {
+        /* Every square is either sure or a sure mine */
+        store(key, 1.0);
+        return 1.0;
+    }
+    if (safe[order[0]] == (int) candidates.size())
+    {
+        /* Revealing sure squares never hurts, so take them
+         * all at once rather than one level each */
+        sure = 0;
+        for (i = 0; (i < count) &&
+                    (safe[order[i]] == (int) candidates.size()); i++)
+        {
+            sure |= 1ull << order[i];
+        }
+        best = reveal_sure(candidates, revealed, key, sure);
+        store(key, best);
+        return best;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        /* A reveal is never worth more than its chance of
+         * being safe, and they come safest first */
+        if (safe[order[i]] / total <= best)
+        {
+            break;
+        }
+        value = reveal_value(candidates, revealed, key, order[i]);
+        best = (value > best) ? value : best;
+        if (best >= 1.0)
+        {
+            break;
+        }
+    }
+
+    store(key, best);
+    return best;
+}
+
+/* reveal_value
+ *
+ * Chance of winning after revealing a slot: the layouts it
+ * is safe in are split by the number it would show
+ *
+ * Inputs:  candidates - layouts still possible
+ *          revealed   - slots revealed since the root
+ *          key        - Zobrist key of what they showed
+ *          slot       - slot to reveal
+ * Outputs: (none)
+ * Returns: win probability
+ */
+double EndgameSolver::reveal_value(const layout_list& candidates,
+                                   uint64_t revealed, uint64_t key,
+                                   int slot)
+{
+    layout_list outcomes[NUM_NEIGHBORS + 1];
+    uint64_t bit = 1ull << slot;
+    double sum = 0.0;
+    size_t i;
+    int n;
+
+    for (i = 0; i < candidates.size(); i++)
+    {
+        if ( !(candidates[i] & bit) )
+        {
+            n = __builtin_popcountll(candidates[i] & slot_neighbors[slot]);
+            outcomes[n].push_back(candidates[i]);
+        }
+    }
+    for (n = 0; n <= NUM_NEIGHBORS; n++)
+    {
+        if (!outcomes[n].empty())
+        {
+            sum += outcomes[n].size() *
+                   solve(outcomes[n], revealed | bit, key ^ zobrist[slot][n]);
+        }
+    }
+    return sum / candidates.size();
+}
+
+/* reveal_sure
+ *
+ * Chance of winning after revealing several squares that are
+ * safe in every layout: the layouts are split by what all
+ * of them would show together
+ *
+ * Inputs:  candidates - layouts still possible
+ *          revealed   - slots revealed since the root
+ *          key        - Zobrist key of what they showed
+ *          slots      - sure slots to reveal
+ * Outputs: (none)
+ * Returns: win probability
+ */
+double EndgameSolver::reveal_sure(const layout_list& candidates,
+                                  uint64_t revealed, uint64_t key,
+                                  uint64_t slots)
+{
+    std::vector< std::pair<uint64_t, uint64_t> > outcomes;
+    layout_list group;
+    uint64_t outcome, bits;
+    double sum = 0.0;
+    size_t i, j;
+    int slot;
+
+    outcomes.reserve(candidates.size());
+    for (i = 0; i < candidates.size(); i++)
+    {
+        outcome = key;
+        for (bits = slots; bits != 0; bits &= bits - 1)
+        {
+            slot = __builtin_ctzll(bits);
+            outcome ^= zobrist[slot][__builtin_popcountll(
+                           candidates[i] & slot_neighbors[slot])];
+        }
+        outcomes.push_back(std::make_pair(outcome, candidates[i]));
+    }
+    std::sort(outcomes.begin(), outcomes.end());
+
+    for (i = 0; i < outcomes.size(); i = j)
+    {
+        group.clear();
+        for (j = i; (j < outcomes.size()) &&
+                    (outcomes[j].first == outcomes[i].first); j++)
+        {
+            group.push_back(outcomes[j].second);
+        }
+        sum += group.size() *
+               solve(group, revealed | slots, outcomes[i].first);
+    }
+    return sum / candidates.size();
+}
+
+/* rank_reveals
+ *
+ * Counts the layouts each unrevealed slot is safe in and
+ * orders the slots that can be safe, safest first
+ *
+ * Inputs:  candidates - layouts still possible
+ *          revealed   - slots revealed since the root
+ * Outputs: order      - slots, safest first
+ *          safe       - per slot, layouts it is safe in
+ * Returns: number of slots in order
+ */
+int EndgameSolver::rank_reveals(const layout_list& candidates,
+                                uint64_t revealed, int* order, int* safe)
+{
+    uint64_t all = (unknown == 64) ? ~0ull : ((1ull << unknown) - 1);
+    uint64_t open = all & ~revealed;
+    uint64_t bits;
+    size_t i;
+    int count = 0, slot, j, k;
+
+    memset(safe, 0, unknown * sizeof(int));
+    for (i = 0; i < candidates.size(); i++)
+    {
+        bits = open & ~candidates[i];
+        while (bits != 0)
+        {
+            safe[__builtin_ctzll(bits)]++;
+            bits &= bits - 1;
+        }
+    }
+
+    /* Insertion sort, there are at most 64 */
+    for (slot = 0; slot < unknown; slot++)
+    {
+        if ( !(open & (1ull << slot)) || (safe[slot] == 0) )
+        {
+            continue;
+        }
+        for (j = count; (j > 0) && (safe[order[j - 1]] < safe[slot]); j--)
+        {
+            order[j] = order[j - 1];
+        }
+        order[j] = slot;
+        count++;
+    }
+    for (k = count; k < unknown; k++)
+    {
+        order[k] = -1;
+    }
+    return count;
+}
+
+/* lookup / store
+ *
+ * Transposition table access, one lock per stripe.  The
+ * low bits of a key pick the stripe, the high bits the
+ * entry within it.
+ *
+ * Inputs:  key   - Zobrist key of the position
+ *          value - its win probability (store)
+ * Outputs: value - its win probability (lookup)
+ * Returns: lookup: true if the position was found
+ */
+bool EndgameSolver::lookup(uint64_t key, double* value)
+{
+    endgame_stripe* stripe = &table[key % ENDGAME_TT_STRIPES];
+    std::lock_guard<std::mutex> guard(stripe->lock);
+    size_t mask = stripe->keys.size() - 1;
+    size_t i;
+
+    key = (key == 0) ? 1 : key;
+    for (i = (key >> 32) & mask; stripe->keys[i] != 0; i = (i + 1) & mask)
+    {
+        if (stripe->keys[i] == key)
+        {
+            *value = stripe->values[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void EndgameSolver::store(uint64_t key, double value)
+{
+    endgame_stripe* stripe = &table[key % ENDGAME_TT_STRIPES];
+    std::lock_guard<std::mutex> guard(stripe->lock);
+    std::vector<uint64_t> old_keys;
+    std::vector<double> old_values;
+    size_t mask, i, j;
+
+    key = (key == 0) ? 1 : key;
+
+    /* Keep it at most half full */
+    if (2 * (stripe->used + 1) > stripe->keys.size())
+    {
+        old_keys.swap(stripe->keys);
+        old_values.swap(stripe->values);
+        stripe->keys.assign(2 * old_keys.size(), 0);
+        stripe->values.assign(2 * old_keys.size(), 0.0);
+        mask = stripe->keys.size() - 1;
+        for (j = 0; j < old_keys.size(); j++)
+        {
+            if (old_keys[j] == 0)
+            {
+                continue;
+            }
+            for (i = (old_keys[j] >> 32) & mask; stripe->keys[i] != 0;
+                 i = (i + 1) & mask)
+            {
+            }
+            stripe->keys[i] = old_keys[j];
+            stripe->values[i] = old_values[j];
+        }
+    }
+
+    mask = stripe->keys.size() - 1;
+    for (i = (key >> 32) & mask; stripe->keys[i] != 0; i = (i + 1) & mask)
+    {
+        if (stripe->keys[i] == key)
+        {
+            stripe->values[i] = value;
+            return;
+        }
+    }
+    stripe->keys[i] = key;
+    stripe->values[i] = value;
+    stripe->used++;
+}
+
+/* clear_table
+ *
+ * Forgets every position, keys are only meaningful for the
+ * root they were made from
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EndgameSolver::clear_table()
+{
+    int i;
+
+    for (i = 0; i < ENDGAME_TT_STRIPES; i++)
+    {
+        table[i].keys.assign(ENDGAME_TT_MIN_SLOTS, 0);
+        table[i].values.assign(ENDGAME_TT_MIN_SLOTS, 0.0);
+        table[i].used = 0;
+    }
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* splitmix64
+ *
+ * Fills the Zobrist table
+ */
+static uint64_t splitmix64(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
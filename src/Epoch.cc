@@ -0,0 +1,201 @@
+/* src/Epoch.cc
+ *
+ * Implementation of epoch based reclamation
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include "Epoch.h"
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Sets up a domain with no readers
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: EpochDomain struct
+ */
+EpochDomain::EpochDomain()
+{
+    int i;
+
+    for (i = 0; i < EPOCH_MAX_READERS; i++)
+    {
+        slots[i].epoch = 0;
+        slots[i].taken = false;
+    }
+    current = 1;
+}
+
+/* Destructor
+ *
+ * Frees everything still retired.  Nobody may be reading
+ * any more.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+EpochDomain::~EpochDomain()
+{
+    size_t i;
+
+    for (i = 0; i < limbo.size(); i++)
+    {
+        limbo[i].release(limbo[i].item);
+    }
+}
+
+/* join
+ *
+ * Takes a reader slot, for use by one thread at a time
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: the slot, -1 if all EPOCH_MAX_READERS are taken
+ */
+int EpochDomain::join()
+{
+    bool free_slot;
+    int i;
+
+    for (i = 0; i < EPOCH_MAX_READERS; i++)
+    {
+        free_slot = false;
+        if (slots[i].taken.compare_exchange_strong(free_slot, true))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* leave
+ *
+ * Gives a reader slot back
+ *
+ * Inputs:  reader - slot from join, not inside a read
+ * Outputs: (none)
+ * Returns: void
+ */
+void EpochDomain::leave(int reader)
+{
+    slots[reader].epoch.store(0, std::memory_order_release);
+    slots[reader].taken.store(false, std::memory_order_release);
+}
+
+/* enter
+ *
+ * Starts a read.  Pointers to published data must be loaded
+ * after this (with a sequentially consistent load).
+ *
+ * Inputs:  reader - slot from join
+ * Outputs: (none)
+ * Returns: void
+ */
+void EpochDomain::enter(int reader)
+{
+    slots[reader].epoch.store(current.load());
+}
+
+/* exit
+ *
+ * Ends a read.  Nothing loaded since enter may be used
+ * after this.
+ *
+ * Inputs:  reader - slot from join
+ * Outputs: (none)
+ * Returns: void
+ */
+void EpochDomain::exit(int reader)
+{
+    slots[reader].epoch.store(0, std::memory_order_release);
+}
+
+/* advance (writer only)
+ *
+ * Starts a new epoch.  Call it after storing the pointer to
+ * a new version and before retiring what it replaced.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: the new epoch
+ */
+uint64_t EpochDomain::advance()
+{
+    return current.fetch_add(1) + 1;
+}
+
+/* retire (writer only)
+ *
+ * Hands over something no longer reachable from the latest
+ * version, to be released once no reader can still see it
+ *
+ * Inputs:  item    - what to free
+ *          release - how to free it
+ * Outputs: (none)
+ * Returns: void
+ */
+void EpochDomain::retire(void* item, void (*release)(void* item))
+{
+    epoch_retired retired;
+
+    retired.epoch = current.load(std::memory_order_relaxed);
+    retired.item = item;
+    retired.release = release;
+    limbo.push_back(retired);
+}
+
+/* reclaim (writer only)
+ *
+ * Releases what no reader can still see: everything
+ * retired in or before the oldest epoch a reader is in
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of items released
+ */
+size_t EpochDomain::reclaim()
+{
+    uint64_t oldest = UINT64_MAX, epoch;
+    size_t done = 0;
+    int reader;
+
+    if (limbo.empty())
+    {
+        return 0;
+    }
+    for (reader = 0; reader < EPOCH_MAX_READERS; reader++)
+    {
+        epoch = slots[reader].epoch.load();
+        if ( (epoch != 0) && (epoch < oldest) )
+        {
+            oldest = epoch;
+        }
+    }
+
+    while ( (done < limbo.size()) && (limbo[done].epoch <= oldest) )
+    {
+        limbo[done].release(limbo[done].item);
+        done++;
+    }
+    limbo.erase(limbo.begin(), limbo.begin() + done);
+    return done;
+}
+
+/* get_pending
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: items retired but not released yet
+ */
+size_t EpochDomain::get_pending()
+{
+    return limbo.size();
+}
@@ -0,0 +1,905 @@
+/* src/EventLog.cc
+ *
+ * Implementation of the binary event log writer and reader
+ * (see hdr/EventLog.h for the format)
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "common.h"
+#include "EventLog.h"
+#include "Varint.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t now_us();
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Sets up a closed log
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: EventLog struct
+ */
+EventLog::EventLog()
+{
+    fd = -1;
+    active = NULL;
+    used = 0;
+    last_us = 0;
+    current_game = 0;
+    last_row = last_column = 0;
+    dropped = events = 0;
+    buffers_allocated = 0;
+    hashes = false;
+    stopping = false;
+}
+
+/* Destructor
+ *
+ * Flushes and closes the log
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+EventLog::~EventLog()
+{
+    close();
+}
+
+/* open
+ *
+ * Creates (or truncates) a log file and starts the
+ * background writer
+ *
+ * Inputs:  path - file to write
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool EventLog::open(const char* path)
+{
+    close();
+
+    fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        PRINT_INFO("\nERROR: Cannot open event log %s: %s\n",
+                   path, strerror(errno));
+        return false;
+    }
+    if (write(fd, EVENTLOG_MAGIC, EVENTLOG_MAGIC_BYTES) !=
+        EVENTLOG_MAGIC_BYTES)
+    {
+        PRINT_INFO("\nERROR: Cannot write event log %s\n", path);
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    active = (uint8_t*) malloc(EVENTLOG_BUFFER_BYTES);
+    mem_note_alloc(MEM_LOG, EVENTLOG_BUFFER_BYTES);
+    buffers_allocated = 1;
+    used = 0;
+    last_us = now_us();
+    current_game = 0;
+    last_row = last_column = 0;
+    dropped = events = 0;
+    stopping = false;
+    writer = std::thread(&EventLog::writer_loop, this);
+    return true;
+}
+
+/* close
+ *
+ * Hands the last buffer to the writer, waits for
+ * everything to reach the file and closes it
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::close()
+{
+    size_t i;
+
+    if (fd < 0)
+    {
+        return;
+    }
+
+    if ( (active != NULL) && (used > 0) )
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        full.push_back(active);
+        full_used.push_back(used);
+        active = NULL;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    if (active != NULL)
+    {
+        free(active);
+        mem_note_free(MEM_LOG, EVENTLOG_BUFFER_BYTES);
+    }
+    active = NULL;
+    for (i = 0; i < free_buffers.size(); i++)
+    {
+        free(free_buffers[i]);
+        mem_note_free(MEM_LOG, EVENTLOG_BUFFER_BYTES);
+    }
+    free_buffers.clear();
+    buffers_allocated = 0;
+
+    ::close(fd);
+    fd = -1;
+}
+
+/* game_created
+ *
+ * Logs a new game
+ *
+ * Inputs:  game     - id of the game, unique within the log
+ *          rows, columns, mines, topology, seed - board setup
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::game_created(uint32_t game, int rows, int columns,
+                            int mines, int topology, uint32_t seed)
+{
+    if (!begin_record(EVENT_GAME_CREATE, game))
+    {
+        return;
+    }
+    put_varint(game);
+    put_varint(rows);
+    put_varint(columns);
+    put_varint(mines);
+    put_varint(topology);
+    put_varint(seed);
+    current_game = game;
+    last_row = last_column = 0;
+}
+
+/* move
+ *
+ * Logs a reveal and the size of its cascade
+ *
+ * Inputs:  game        - game the move belongs to
+ *          row, column - square revealed (0 based)
+ *          revealed    - squares revealed by the move
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::move(uint32_t game, int row, int column, int revealed)
+{
+    if (!begin_record(EVENT_MOVE, game))
+    {
+        return;
+    }
+    put_varint(zigzag_encode(row - last_row));
+    put_varint(zigzag_encode(column - last_column));
+    put_varint(revealed);
+    last_row = row;
+    last_column = column;
+}
+
+/* mark
+ *
+ * Logs a square being marked
+ *
+ * Inputs:  game        - game the mark belongs to
+ *          row, column - square marked (0 based)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::mark(uint32_t game, int row, int column)
+{
+    if (!begin_record(EVENT_MARK, game))
+    {
+        return;
+    }
+    put_varint(zigzag_encode(row - last_row));
+    put_varint(zigzag_encode(column - last_column));
+    last_row = row;
+    last_column = column;
+}
+
+/* unmark
+ *
+ * Logs a mark being taken off a square
+ *
+ * Inputs:  game        - game the unmark belongs to
+ *          row, column - square unmarked (0 based)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::unmark(uint32_t game, int row, int column)
+{
+    if (!begin_record(EVENT_UNMARK, game))
+    {
+        return;
+    }
+    put_varint(zigzag_encode(row - last_row));
+    put_varint(zigzag_encode(column - last_column));
+    last_row = row;
+    last_column = column;
+}
+
+/* chord
+ *
+ * Logs a chord (revealing the unmarked neighbors of a
+ * satisfied number) and how much it revealed
+ *
+ * Inputs:  game        - game the chord belongs to
+ *          row, column - numbered square chorded on (0 based)
+ *          revealed    - squares revealed by the chord
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::chord(uint32_t game, int row, int column, int revealed)
+{
+    if (!begin_record(EVENT_CHORD, game))
+    {
+        return;
+    }
+    put_varint(zigzag_encode(row - last_row));
+    put_varint(zigzag_encode(column - last_column));
+    put_varint(revealed);
+    last_row = row;
+    last_column = column;
+}
+
+/* outcome
+ *
+ * Logs the end of a game
+ *
+ * Inputs:  game - game that ended
+ *          won  - true if it was won
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::outcome(uint32_t game, bool won)
+{
+    if (!begin_record(EVENT_OUTCOME, game))
+    {
+        return;
+    }
+    active[used++] = won ? 1 : 0;
+}
+
+/* undo / redo
+ *
+ * Logs a move being taken back or made again
+ *
+ * Inputs:  game - game affected
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::undo(uint32_t game)
+{
+    begin_record(EVENT_UNDO, game);
+}
+
+void EventLog::redo(uint32_t game)
+{
+    begin_record(EVENT_REDO, game);
+}
+
+/* mine_hash / state_hash
+ *
+ * Logs a board's layout hash, or the hash of its square
+ * states after the move just logged
+ *
+ * Inputs:  game - game the hash belongs to
+ *          hash - the hash
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::mine_hash(uint32_t game, uint64_t hash)
+{
+    if (begin_record(EVENT_MINE_HASH, game))
+    {
+        put_hash(hash);
+    }
+}
+
+void EventLog::state_hash(uint32_t game, uint64_t hash)
+{
+    if (begin_record(EVENT_STATE_HASH, game))
+    {
+        put_hash(hash);
+    }
+}
+
+/* batch
+ *
+ * Logs that the last moves logged for a game were one
+ * batch, which undo and redo treat as a single move
+ *
+ * Inputs:  game  - game the batch belongs to
+ *          moves - moves in the batch
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::batch(uint32_t game, int moves)
+{
+    if (begin_record(EVENT_BATCH, game))
+    {
+        put_varint(moves);
+    }
+}
+
+/* set_hashes / get_hashes
+ *
+ * Whether boards should log hashes (off by default, they
+ * add a record to every move)
+ *
+ * Inputs:  _hashes - true to log them
+ * Outputs: (none)
+ * Returns: get_hashes: the setting
+ */
+void EventLog::set_hashes(bool _hashes)
+{
+    hashes = _hashes;
+}
+
+bool EventLog::get_hashes()
+{
+    return hashes;
+}
+
+/* get_events
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of records logged
+ */
+uint64_t EventLog::get_events()
+{
+    return events;
+}
+
+/* get_dropped
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: number of records dropped (because the writer fell
+ *          too far behind) and not yet reported in the log
+ */
+uint64_t EventLog::get_dropped()
+{
+    return dropped;
+}
+
+/* begin_record
+ *
+ * Makes room for a record and writes its type and time.
+ * Switching games and recovering from dropped records
+ * emit their own records first.
+ *
+ * Inputs:  type - record type
+ *          game - game the record belongs to
+ * Outputs: (none)
+ * Returns: true if the caller should write the payload
+ *          false if the record was dropped
+ */
+bool EventLog::begin_record(event_type type, uint32_t game)
+{
+    uint64_t now;
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    if ( (active == NULL) ||
+         (used + 3 * EVENTLOG_MAX_RECORD > EVENTLOG_BUFFER_BYTES)
+       )
+    {
+        flush_active();
+        if (active == NULL)
+        {
+            dropped++;
+            return false;
+        }
+    }
+
+    now = now_us();
+
+    if (dropped > 0)
+    {
+        active[used++] = EVENT_DROPPED;
+        put_varint(now - last_us);
+        put_varint(dropped);
+        dropped = 0;
+        last_us = now;
+        events++;
+    }
+
+    if ( (type != EVENT_GAME_CREATE) && (game != current_game) )
+    {
+        active[used++] = EVENT_GAME_SWITCH;
+        put_varint(now - last_us);
+        put_varint(game);
+        current_game = game;
+        last_row = last_column = 0;
+        last_us = now;
+        events++;
+    }
+
+    active[used++] = (uint8_t) type;
+    put_varint(now - last_us);
+    last_us = now;
+    events++;
+    return true;
+}
+
+/* put_varint
+ *
+ * Appends a varint to the active buffer.  begin_record
+ * already made sure there is room.
+ *
+ * Inputs:  value - value to append
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::put_varint(uint64_t value)
+{
+    used += varint_encode(value, active + used);
+}
+
+/* put_hash
+ *
+ * Appends a hash as 8 little endian bytes; hashes are
+ * random looking, a varint would only make them longer
+ *
+ * Inputs:  hash - value to append
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::put_hash(uint64_t hash)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        active[used++] = (uint8_t) (hash >> (8 * i));
+    }
+}
+
+/* flush_active
+ *
+ * Queues the active buffer for the writer and picks up a
+ * free one.  If the writer is so far behind that every
+ * buffer is in flight, active is left NULL and records are
+ * dropped (and counted) rather than stalling the engine.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::flush_active()
+{
+    bool queued = false;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if ( (active != NULL) && (used > 0) )
+        {
+            full.push_back(active);
+            full_used.push_back(used);
+            active = NULL;
+            queued = true;
+        }
+        if ( (active == NULL) && !free_buffers.empty() )
+        {
+            active = free_buffers.back();
+            free_buffers.pop_back();
+        }
+    }
+    if (queued)
+    {
+        wake.notify_one();
+    }
+
+    if ( (active == NULL) && (buffers_allocated < EVENTLOG_MAX_BUFFERS) )
+    {
+        active = (uint8_t*) malloc(EVENTLOG_BUFFER_BYTES);
+        mem_note_alloc(MEM_LOG, EVENTLOG_BUFFER_BYTES);
+        buffers_allocated++;
+    }
+    used = 0;
+}
+
+/* writer_loop
+ *
+ * Background thread: writes out full buffers and hands
+ * them back to the engine
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventLog::writer_loop()
+{
+    std::vector<uint8_t*> batch;
+    std::vector<size_t> batch_used;
+    size_t i, done;
+    ssize_t written;
+    bool last;
+
+    while (1)
+    {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while ( full.empty() && !stopping )
+            {
+                wake.wait(guard);
+            }
+            batch.swap(full);
+            batch_used.swap(full_used);
+            last = stopping;
+        }
+
+        for (i = 0; i < batch.size(); i++)
+        {
+            done = 0;
+            while (done < batch_used[i])
+            {
+                written = write(fd, batch[i] + done, batch_used[i] - done);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    PRINT_INFO("\nERROR: Event log write failed: %s\n",
+                               strerror(errno));
+                    break;
+                }
+                done += written;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            free_buffers.insert(free_buffers.end(), batch.begin(), batch.end());
+        }
+        batch.clear();
+        batch_used.clear();
+
+        if (last)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (full.empty())
+            {
+                break;
+            }
+        }
+    }
+}
+
+/* Constructor
+ *
+ * Sets up a closed reader
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: EventReader struct
+ */
+EventReader::EventReader()
+{
+    file = NULL;
+    start = end = 0;
+    eof = false;
+    time_us = 0;
+    current_game = 0;
+    last_row = last_column = 0;
+}
+
+/* Destructor
+ *
+ * Closes the reader
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+EventReader::~EventReader()
+{
+    close();
+}
+
+/* open
+ *
+ * Opens a log and checks its magic
+ *
+ * Inputs:  path - log to read
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool EventReader::open(const char* path)
+{
+    close();
+    file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    buffer.resize(EVENTLOG_BUFFER_BYTES);
+    start = end = 0;
+    eof = false;
+    time_us = 0;
+    current_game = 0;
+    last_row = last_column = 0;
+
+    if ( !fill(EVENTLOG_MAGIC_BYTES) ||
+         (memcmp(&buffer[start], EVENTLOG_MAGIC, EVENTLOG_MAGIC_BYTES) != 0)
+       )
+    {
+        close();
+        return false;
+    }
+    start += EVENTLOG_MAGIC_BYTES;
+    return true;
+}
+
+/* close
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void EventReader::close()
+{
+    if (file != NULL)
+    {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+/* next
+ *
+ * Decodes the next record
+ *
+ * Inputs:  (none)
+ * Outputs: event - decoded record
+ * Returns: true if a record was read
+ *          false at the end of the log (or a torn tail)
+ */
+bool EventReader::next(game_event* event)
+{
+    uint64_t value, v[6];
+    int i;
+
+    while (1)
+    {
+        if (!fill(1 + 3 * EVENTLOG_MAX_RECORD) && (start >= end))
+        {
+            return false;
+        }
+
+        memset(event, 0, sizeof(*event));
+        event->type = (event_type) buffer[start++];
+        if (!get_varint(&value))
+        {
+            return false;
+        }
+        time_us += value;
+        event->time_us = time_us;
+
+        switch (event->type)
+        {
+        case EVENT_GAME_CREATE:
+            for (i = 0; i < 6; i++)
+            {
+                if (!get_varint(&v[i]))
+                {
+                    return false;
+                }
+            }
+            current_game = (uint32_t) v[0];
+            event->rows = (int) v[1];
+            event->columns = (int) v[2];
+            event->mines = (int) v[3];
+            event->topology = (int) v[4];
+            event->seed = (uint32_t) v[5];
+            last_row = last_column = 0;
+            break;
+
+        case EVENT_GAME_SWITCH:
+            if (!get_varint(&value))
+            {
+                return false;
+            }
+            current_game = (uint32_t) value;
+            last_row = last_column = 0;
+            /* Not interesting to callers, keep going */
+            continue;
+
+        case EVENT_MOVE:
+        case EVENT_MARK:
+        case EVENT_UNMARK:
+        case EVENT_CHORD:
+            if (!get_varint(&v[0]) || !get_varint(&v[1]))
+            {
+                return false;
+            }
+            last_row += (int) zigzag_decode(v[0]);
+            last_column += (int) zigzag_decode(v[1]);
+            event->row = last_row;
+            event->column = last_column;
+            if ( ( (event->type == EVENT_MOVE) || (event->type == EVENT_CHORD) ) &&
+                 !get_varint(&event->count)
+               )
+            {
+                return false;
+            }
+            break;
+
+        case EVENT_OUTCOME:
+            if (start >= end)
+            {
+                return false;
+            }
+            event->won = (buffer[start++] != 0);
+            break;
+
+        case EVENT_DROPPED:
+        case EVENT_BATCH:
+            if (!get_varint(&event->count))
+            {
+                return false;
+            }
+            break;
+
+        case EVENT_UNDO:
+        case EVENT_REDO:
+            break;
+
+        case EVENT_MINE_HASH:
+        case EVENT_STATE_HASH:
+            if (start + 8 > end)
+            {
+                return false;
+            }
+            for (i = 0; i < 8; i++)
+            {
+                event->hash |= (uint64_t) buffer[start++] << (8 * i);
+            }
+            break;
+
+        default:
+            PRINT_ERROR("Corrupt event log record!");
+            return false;
+        }
+
+        event->game = current_game;
+        return true;
+    }
+}
+
+/* fill
+ *
+ * Makes sure at least `want` bytes are buffered, unless
+ * the file ends first
+ *
+ * Inputs:  want - bytes wanted
+ * Outputs: (none)
+ * Returns: true if that many bytes are buffered
+ *          false otherwise
+ */
+bool EventReader::fill(size_t want)
+{
+    size_t got;
+
+    if (end - start >= want)
+    {
+        return true;
+    }
+    if (eof || (file == NULL))
+    {
+        return false;
+    }
+    memmove(&buffer[0], &buffer[start], end - start);
+    end -= start;
+    start = 0;
+    got = fread(&buffer[end], 1, buffer.size() - end, file);
+    end += got;
+    if (got == 0)
+    {
+        eof = true;
+    }
+    return (end - start >= want);
+}
+
+/* get_varint
+ *
+ * Decodes a varint from the buffer
+ *
+ * Inputs:  (none)
+ * Outputs: value - decoded value
+ * Returns: true on success
+ *          false on a truncated record
+ */
+bool EventReader::get_varint(uint64_t* value)
+{
+    const uint8_t* next;
+
+    next = varint_decode(&buffer[start], &buffer[0] + end, value);
+    if (next == NULL)
+    {
+        return false;
+    }
+    start = next - &buffer[0];
+    return true;
+}
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* event_type_name
+ *
+ * Human readable name of a record type
+ */
+const char* event_type_name(event_type type)
+{
+    switch (type)
+    {
+    case EVENT_GAME_CREATE: return "create";
+    case EVENT_GAME_SWITCH: return "switch";
+    case EVENT_MOVE:        return "move";
+    case EVENT_MARK:        return "mark";
+    case EVENT_OUTCOME:     return "outcome";
+    case EVENT_UNDO:        return "undo";
+    case EVENT_REDO:        return "redo";
+    case EVENT_DROPPED:     return "dropped";
+    case EVENT_UNMARK:      return "unmark";
+    case EVENT_CHORD:       return "chord";
+    case EVENT_MINE_HASH:   return "mine_hash";
+    case EVENT_STATE_HASH:  return "state_hash";
+    case EVENT_BATCH:       return "batch";
+    default:                return "unknown";
+    }
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* now_us
+ *
+ * Monotonic time in microseconds
+ */
+static uint64_t now_us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
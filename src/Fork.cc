@@ -0,0 +1,624 @@
+/* src/Fork.cc
+ *
+ * Implementation of copy-on-write board forks
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <string.h>
+
+#include "Fork.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static inline int tile_of(const fork_layout* layout, int index, int* offset);
+static inline fork_tile* tile_at(const fork_table* table, int tile);
+static inline uint8_t state_at(const fork_layout* layout,
+                               const fork_table* table, int index);
+static void unref_layout(fork_layout* layout);
+static void unref_tile(fork_tile* tile);
+static void unref_page(fork_page* page);
+static void unref_table(fork_table* table);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Takes a snapshot of a live board.  This walks the whole
+ * board once; forks of the snapshot are then O(1).  Tiles
+ * with nothing revealed or marked all share one blank tile.
+ *
+ * Inputs:  board - board to snapshot
+ * Outputs: (none)
+ * Returns: BoardFork struct
+ */
+BoardFork::BoardFork(Board* board)
+{
+    int rows = board->get_rows(), columns = board->get_columns();
+    int cells = rows * columns;
+    std::vector<uint8_t> plane((cells + 7) / 8);
+    fork_tile* blank;
+    fork_tile* tile;
+    fork_page* page;
+    int i, j, t, count, offset, row, column;
+
+    layout = new fork_layout;
+
+    mem_note_alloc(MEM_SOLVER, sizeof(fork_layout));
+    layout->refs.store(1, std::memory_order_relaxed);
+    layout->rows = rows;
+    layout->columns = columns;
+    layout->mines = board->get_mines();
+    layout->topology = board->get_topology();
+    layout->tile_columns = (columns + FORK_TILE_SIDE - 1) >> FORK_TILE_SHIFT;
+    layout->tiles = layout->tile_columns *
+                    ((rows + FORK_TILE_SIDE - 1) >> FORK_TILE_SHIFT);
+    layout->pages = (layout->tiles + FORK_PAGE_TILES - 1) >> FORK_PAGE_SHIFT;
+
+    /* Numbers come from the mines, not from the Board's squares,
+     * so nothing here points back into the board */
+    layout->neighbors.resize(cells * NUM_NEIGHBORS);
+    layout->neighbor_count.resize(cells);
+    layout->number.resize(cells);
+    board->pack_mines(plane.data());
+    for (i = 0; i < cells; i++)
+    {
+        layout->neighbor_count[i] = (uint8_t)
+            board_neighbors(layout->topology, rows, columns, i,
+                            &layout->neighbors[i * NUM_NEIGHBORS]);
+    }
+    for (i = 0; i < cells; i++)
+    {
+        if ((plane[i >> 3] >> (i & 7)) & 1)
+        {
+            layout->number[i] = FORK_MINE;
+            continue;
+        }
+        count = 0;
+        for (j = 0; j < layout->neighbor_count[i]; j++)
+        {
+            t = layout->neighbors[i * NUM_NEIGHBORS + j];
+            count += (plane[t >> 3] >> (t & 7)) & 1;
+        }
+        layout->number[i] = (uint8_t) count;
+    }
+
+    blank = new fork_tile;
+
+    mem_note_alloc(MEM_SOLVER, sizeof(fork_tile));
+    blank->refs.store(1, std::memory_order_relaxed);
+    memset(blank->state, UNKNOWN, sizeof(blank->state));
+
+    table = new fork_table;
+
+    mem_note_alloc(MEM_SOLVER, sizeof(fork_table));
+    table->refs.store(1, std::memory_order_relaxed);
+    table->pages.resize(layout->pages);
+    for (i = 0; i < layout->pages; i++)
+    {
+        page = new fork_page;
+        mem_note_alloc(MEM_SOLVER, sizeof(fork_page));
+        page->refs.store(1, std::memory_order_relaxed);
+        for (j = 0; j < FORK_PAGE_TILES; j++)
+        {
+            blank->refs.fetch_add(1, std::memory_order_relaxed);
+            page->tiles[j] = blank;
+        }
+        table->pages[i] = page;
+    }
+
+    for (row = 0; row < rows; row++)
+    {
+        for (column = 0; column < columns; column++)
+        {
+            if (board->get_square_state(row, column) == UNKNOWN)
+            {
+                continue;
+            }
+            t = tile_of(layout, row * columns + column, &offset);
+            page = table->pages[t >> FORK_PAGE_SHIFT];
+            tile = page->tiles[t & (FORK_PAGE_TILES - 1)];
+            if (tile == blank)
+            {
+                tile = new fork_tile;
+                mem_note_alloc(MEM_SOLVER, sizeof(fork_tile));
+                tile->refs.store(1, std::memory_order_relaxed);
+                memset(tile->state, UNKNOWN, sizeof(tile->state));
+                page->tiles[t & (FORK_PAGE_TILES - 1)] = tile;
+                unref_tile(blank);
+            }
+            tile->state[offset] =
+                (uint8_t) board->get_square_state(row, column);
+        }
+    }
+    unref_tile(blank);
+
+    squares_revealed = board->get_squares_revealed();
+    game_over = board->is_game_over();
+    game_won = board->did_we_win();
+    tiles_copied = 0;
+}
+
+/* Copy constructor
+ *
+ * Forks: shares everything, copies nothing
+ *
+ * Inputs:  other - fork to branch from
+ * Outputs: (none)
+ * Returns: BoardFork struct
+ */
+BoardFork::BoardFork(const BoardFork& other)
+{
+    layout = other.layout;
+    table = other.table;
+    layout->refs.fetch_add(1, std::memory_order_relaxed);
+    table->refs.fetch_add(1, std::memory_order_relaxed);
+    squares_revealed = other.squares_revealed;
+    game_over = other.game_over;
+    game_won = other.game_won;
+    tiles_copied = 0;
+}
+
+/* operator=
+ *
+ * Drops this fork's state and shares other's instead
+ *
+ * Inputs:  other - fork to branch from
+ * Outputs: (none)
+ * Returns: this fork
+ */
+BoardFork& BoardFork::operator=(const BoardFork& other)
+{
+    if (this != &other)
+    {
+        other.layout->refs.fetch_add(1, std::memory_order_relaxed);
+        other.table->refs.fetch_add(1, std::memory_order_relaxed);
+        release();
+        layout = other.layout;
+        table = other.table;
+        squares_revealed = other.squares_revealed;
+        game_over = other.game_over;
+        game_won = other.game_won;
+    }
+    return *this;
+}
+
+/* Destructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+BoardFork::~BoardFork()
+{
+    release();
+}
+
+/* release
+ *
+ * Lets go of the layout and the tile table
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void BoardFork::release()
+{
+    unref_table(table);
+    unref_layout(layout);
+    table = NULL;
+    layout = NULL;
+}
+
+/* writable_state
+ *
+ * Gets a square's state ready to be changed, copying
+ * whichever of the table, its page and its tile are still
+ * shared with other forks
+ *
+ * Inputs:  index - square to change
+ * Outputs: (none)
+ * Returns: the square's state byte, owned by this fork alone
+ */
+uint8_t* BoardFork::writable_state(int index)
+{
+    fork_table* new_table;
+    fork_page* new_page;
+    fork_page** page;
+    fork_tile* new_tile;
+    fork_tile** tile;
+    int t, offset, i;
+
+    /* Only we hold these, so nobody can start sharing them
+     * behind our back: a count of 1 is safe to trust */
+    if (table->refs.load(std::memory_order_acquire) != 1)
+    {
+        new_table = new fork_table;
+        mem_note_alloc(MEM_SOLVER, sizeof(fork_table));
+        new_table->refs.store(1, std::memory_order_relaxed);
+        new_table->pages = table->pages;
+        for (i = 0; i < (int) table->pages.size(); i++)
+        {
+            table->pages[i]->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        unref_table(table);
+        table = new_table;
+    }
+
+    t = tile_of(layout, index, &offset);
+    page = &table->pages[t >> FORK_PAGE_SHIFT];
+    if ((*page)->refs.load(std::memory_order_acquire) != 1)
+    {
+        new_page = new fork_page;
+        mem_note_alloc(MEM_SOLVER, sizeof(fork_page));
+        new_page->refs.store(1, std::memory_order_relaxed);
+        for (i = 0; i < FORK_PAGE_TILES; i++)
+        {
+            new_page->tiles[i] = (*page)->tiles[i];
+            new_page->tiles[i]->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        unref_page(*page);
+        *page = new_page;
+    }
+
+    tile = &(*page)->tiles[t & (FORK_PAGE_TILES - 1)];
+    if ((*tile)->refs.load(std::memory_order_acquire) != 1)
+    {
+        new_tile = new fork_tile;
+        mem_note_alloc(MEM_SOLVER, sizeof(fork_tile));
+        new_tile->refs.store(1, std::memory_order_relaxed);
+        memcpy(new_tile->state, (*tile)->state, sizeof(new_tile->state));
+        unref_tile(*tile);
+        *tile = new_tile;
+        tiles_copied++;
+    }
+    return &(*tile)->state[offset];
+}
+
+/* flood_reveal
+ *
+ * Reveals a square, and everything around it if it's a zero
+ *
+ * Inputs:  index - square to reveal, not yet revealed
+ * Outputs: (none)
+ * Returns: number of safe squares revealed
+ */
+int BoardFork::flood_reveal(int index)
+{
+    static thread_local std::vector<int> stack;
+    const int* neighbor;
+    int revealed = 0, square, i;
+
+    *writable_state(index) = REVEALED;
+    if (layout->number[index] == FORK_MINE)
+    {
+        game_over = true;
+        game_won = false;
+        return 0;
+    }
+
+    stack.clear();
+    stack.push_back(index);
+    while (!stack.empty())
+    {
+        square = stack.back();
+        stack.pop_back();
+        revealed++;
+        if (layout->number[square] != 0)
+        {
+            continue;
+        }
+        /* Neighbors of a zero are never mines */
+        neighbor = &layout->neighbors[square * NUM_NEIGHBORS];
+        for (i = 0; i < layout->neighbor_count[square]; i++)
+        {
+            if (state_at(layout, table, neighbor[i]) == REVEALED)
+            {
+                continue;
+            }
+            *writable_state(neighbor[i]) = REVEALED;
+            stack.push_back(neighbor[i]);
+        }
+    }
+    squares_revealed += revealed;
+    return revealed;
+}
+
+/* finish_move
+ *
+ * Checks for a win after a move that didn't hit a mine
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void BoardFork::finish_move()
+{
+    if ( !game_over &&
+         (squares_revealed == layout->rows * layout->columns - layout->mines)
+       )
+    {
+        game_over = true;
+        game_won = true;
+    }
+}
+
+/* reveal
+ *
+ * Clicks a square, like Board::make_move.  Marked squares
+ * can be revealed; revealed ones, and any square after the
+ * game ended, are left alone.
+ *
+ * Inputs:  row, column - square to reveal (0 based)
+ * Outputs: (none)
+ * Returns: number of safe squares revealed
+ */
+int BoardFork::reveal(int row, int column)
+{
+    int revealed;
+
+    if ( game_over || (get_square_state(row, column) == REVEALED) )
+    {
+        return 0;
+    }
+    revealed = flood_reveal(row * layout->columns + column);
+    finish_move();
+    return revealed;
+}
+
+/* mark
+ *
+ * Puts a mark on an unknown square, or takes one off
+ *
+ * Inputs:  row, column - square to (un)mark (0 based)
+ *          on          - true to mark, false to unmark
+ * Outputs: (none)
+ * Returns: true if the square changed
+ */
+bool BoardFork::mark(int row, int column, bool on)
+{
+    square_state from = on ? UNKNOWN : MARKED;
+
+    if ( game_over || (get_square_state(row, column) != from) )
+    {
+        return false;
+    }
+    *writable_state(row * layout->columns + column) =
+        (uint8_t) (on ? MARKED : UNKNOWN);
+    return true;
+}
+
+/* chord
+ *
+ * Reveals the unknown neighbors of a revealed number that
+ * has exactly as many marks around it
+ *
+ * Inputs:  row, column - number to chord on (0 based)
+ * Outputs: (none)
+ * Returns: number of safe squares revealed, -1 if the
+ *          square can't be chorded
+ */
+int BoardFork::chord(int row, int column)
+{
+    int index = row * layout->columns + column;
+    const int* neighbor = &layout->neighbors[index * NUM_NEIGHBORS];
+    int count = layout->neighbor_count[index];
+    int marked = 0, revealed = 0, i;
+
+    if ( game_over || (get_square_state(row, column) != REVEALED) ||
+         (layout->number[index] == FORK_MINE) ||
+         (layout->number[index] == 0)
+       )
+    {
+        return -1;
+    }
+    for (i = 0; i < count; i++)
+    {
+        marked += (state_at(layout, table, neighbor[i]) == MARKED);
+    }
+    if (marked != layout->number[index])
+    {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (state_at(layout, table, neighbor[i]) == UNKNOWN)
+        {
+            revealed += flood_reveal(neighbor[i]);
+        }
+    }
+    finish_move();
+    return revealed;
+}
+
+/* get_rows / get_columns / get_mines
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: board size and mine count
+ */
+int BoardFork::get_rows()
+{
+    return layout->rows;
+}
+
+int BoardFork::get_columns()
+{
+    return layout->columns;
+}
+
+int BoardFork::get_mines()
+{
+    return layout->mines;
+}
+
+/* get_squares_revealed / is_game_over / did_we_win
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: state of the game in this fork
+ */
+int BoardFork::get_squares_revealed()
+{
+    return squares_revealed;
+}
+
+bool BoardFork::is_game_over()
+{
+    return game_over;
+}
+
+bool BoardFork::did_we_win()
+{
+    return game_won;
+}
+
+/* get_square_state
+ *
+ * Inputs:  row, column - square to look at (0 based)
+ * Outputs: (none)
+ * Returns: the square's state in this fork
+ */
+square_state BoardFork::get_square_state(int row, int column)
+{
+    return (square_state)
+           state_at(layout, table, row * layout->columns + column);
+}
+
+/* get_square_number
+ *
+ * Inputs:  row, column - square to look at (0 based)
+ * Outputs: (none)
+ * Returns: number of neighboring mines (FORK_MINE for a mine)
+ */
+int BoardFork::get_square_number(int row, int column)
+{
+    return layout->number[row * layout->columns + column];
+}
+
+/* is_mine
+ *
+ * Inputs:  row, column - square to look at (0 based)
+ * Outputs: (none)
+ * Returns: true if the square is a mine
+ */
+bool BoardFork::is_mine(int row, int column)
+{
+    return layout->number[row * layout->columns + column] == FORK_MINE;
+}
+
+/* get_tiles_copied
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: tiles this fork has had to copy so far
+ */
+uint64_t BoardFork::get_tiles_copied()
+{
+    return tiles_copied;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* tile_of
+ *
+ * Which tile a square is in, and where in the tile
+ */
+static inline int tile_of(const fork_layout* layout, int index, int* offset)
+{
+    int row = index / layout->columns;
+    int column = index % layout->columns;
+
+    *offset = ((row & (FORK_TILE_SIDE - 1)) << FORK_TILE_SHIFT) |
+              (column & (FORK_TILE_SIDE - 1));
+    return (row >> FORK_TILE_SHIFT) * layout->tile_columns +
+           (column >> FORK_TILE_SHIFT);
+}
+
+/* tile_at
+ *
+ * Looks a tile up through its page
+ */
+static inline fork_tile* tile_at(const fork_table* table, int tile)
+{
+    return table->pages[tile >> FORK_PAGE_SHIFT]->
+           tiles[tile & (FORK_PAGE_TILES - 1)];
+}
+
+/* state_at
+ *
+ * A square's state, by index
+ */
+static inline uint8_t state_at(const fork_layout* layout,
+                               const fork_table* table, int index)
+{
+    int offset;
+    int tile = tile_of(layout, index, &offset);
+
+    return tile_at(table, tile)->state[offset];
+}
+
+/* unref_layout / unref_tile / unref_page / unref_table
+ *
+ * Drops one reference, freeing the piece (and dropping what
+ * it holds) when it was the last
+ */
+static void unref_layout(fork_layout* layout)
+{
+    if ( (layout != NULL) &&
+         (layout->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+       )
+    {
+        mem_note_free(MEM_SOLVER, sizeof(fork_layout));
+        delete layout;
+    }
+}
+
+static void unref_tile(fork_tile* tile)
+{
+    if (tile->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        mem_note_free(MEM_SOLVER, sizeof(fork_tile));
+        delete tile;
+    }
+}
+
+static void unref_page(fork_page* page)
+{
+    int i;
+
+    if (page->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        for (i = 0; i < FORK_PAGE_TILES; i++)
+        {
+            unref_tile(page->tiles[i]);
+        }
+        mem_note_free(MEM_SOLVER, sizeof(fork_page));
+        delete page;
+    }
+}
+
+static void unref_table(fork_table* table)
+{
+    size_t i;
+
+    if ( (table != NULL) &&
+         (table->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+       )
+    {
+        for (i = 0; i < table->pages.size(); i++)
+        {
+            unref_page(table->pages[i]);
+        }
+        mem_note_free(MEM_SOLVER, sizeof(fork_table));
+        delete table;
+    }
+}
@@ -0,0 +1,537 @@
+/* src/GameLoop.cc
+ *
+ * Implementation of the pipelined game loop
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+#include "GameLoop.h"
+#include "Snapshot.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static void take_buffered_input(std::string* out);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Inputs:  _board         - board to play on
+ *          _viewport      - window onto the board
+ *          _snapshot_path - file to autosave to once input
+ *                           goes idle after moves, NULL
+ *                           for none
+ * Outputs: (none)
+ * Returns: GameLoop struct
+ */
+GameLoop::GameLoop(Board* _board, Viewport* _viewport,
+                   const char* _snapshot_path)
+    : advisor(std::thread::hardware_concurrency())
+{
+    board = _board;
+    viewport = _viewport;
+    snapshot_path = _snapshot_path;
+    frames_drawn = 0;
+    frames_skipped = 0;
+    stopping = false;
+    hint_done = false;
+    save_done = false;
+    unsaved = false;
+    sem_init(&engine_wake, 0, 0);
+    sem_init(&render_wake, 0, 0);
+    if (pipe2(quit_pipe, O_CLOEXEC) != 0)
+    {
+        quit_pipe[0] = -1;
+        quit_pipe[1] = -1;
+    }
+}
+
+/* Destructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+GameLoop::~GameLoop()
+{
+    sem_destroy(&engine_wake);
+    sem_destroy(&render_wake);
+    if (quit_pipe[0] >= 0)
+    {
+        close(quit_pipe[0]);
+        close(quit_pipe[1]);
+    }
+}
+
+/* run
+ *
+ * Plays until the game ends or input is closed.  The
+ * calling thread is the engine.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if the game ended
+ *          false if input was closed first
+ */
+bool GameLoop::run()
+{
+    std::vector<view_frame*> spare;
+    view_frame* frame;
+    std::string* line;
+    bool game_over = board->is_game_over();
+    bool closed = false;
+    bool dirty = true;
+    int i;
+
+    for (i = 0; i < GAME_LOOP_FRAMES; i++)
+    {
+        spare.push_back(&frames[i]);
+    }
+
+    board->set_messages(&messages);
+    viewport->set_messages(&messages);
+    std::thread renderer(&GameLoop::render_thread, this);
+    std::thread input(&GameLoop::input_thread, this);
+
+    while (1)
+    {
+        while (free_queue.pop(&frame))
+        {
+            spare.push_back(frame);
+        }
+
+        while ( !game_over && !closed && input_queue.pop(&line) )
+        {
+            if (line == NULL)
+            {
+                closed = true;
+                break;
+            }
+            if ( (*line == "H") || (*line == "h") )
+            {
+                hint();
+            }
+            else if ( !viewport->parse_input(*line) )
+            {
+                game_over = board->parse_input(*line);
+                unsaved = (snapshot_path != NULL);
+            }
+            delete line;
+            dirty = true;
+        }
+
+        /* Nothing left to apply: post finished jobs, and save
+         * if there were moves */
+        dirty = finish_jobs(false) || dirty;
+        if ( unsaved && !save_job.joinable() && !game_over && !closed )
+        {
+            save();
+        }
+
+        /* Capture only when the renderer gave a buffer back,
+         * everything that happened meanwhile is folded in */
+        if ( (dirty || game_over || closed) && !spare.empty() )
+        {
+            frame = spare.back();
+            spare.pop_back();
+            viewport->capture(frame);
+            frame->messages.assign(messages.begin(), messages.end());
+            messages.clear();
+            frame->last = game_over || closed;
+            ready_queue.push(frame);
+            sem_post(&render_wake);
+            dirty = false;
+            if (frame->last)
+            {
+                break;
+            }
+        }
+
+        sem_wait(&engine_wake);
+    }
+
+    /* Get the input thread out of its wait, and drop what
+     * it read after the game ended */
+    stopping = true;
+    if (write(quit_pipe[1], "", 1) < 0)
+    {
+        DEBUG_INFO("Cannot wake the input thread\n");
+    }
+    input.join();
+    while (input_queue.pop(&line))
+    {
+        delete line;
+    }
+
+    renderer.join();
+
+    /* Let the jobs finish, then save what the last moves did */
+    finish_jobs(true);
+    if (unsaved)
+    {
+        snapshot_save(board, snapshot_path);
+        unsaved = false;
+    }
+    board->set_messages(NULL);
+    viewport->set_messages(NULL);
+    return game_over;
+}
+
+/* get_frames_drawn / get_frames_skipped
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: frames drawn, and frames dropped in favor of a
+ *          newer one
+ */
+uint64_t GameLoop::get_frames_drawn()
+{
+    return frames_drawn;
+}
+
+uint64_t GameLoop::get_frames_skipped()
+{
+    return frames_skipped;
+}
+
+/* hint
+ *
+ * Starts the hint job on the position as it is now.  Its
+ * answer goes out with the first frame after it is done.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameLoop::hint()
+{
+    if (hint_job.joinable())
+    {
+        messages.append("Still working out the last hint\n");
+        return;
+    }
+    snapshot_pack(board, &hint_image);
+    hint_done = false;
+    hint_job = std::thread(&GameLoop::hint_thread, this);
+}
+
+/* hint_thread
+ *
+ * Hint job: rebuilds the position from hint_image and asks
+ * the endgame advisor for a move, if it can search it
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameLoop::hint_thread()
+{
+    endgame_advice advice;
+    char text[160];
+    Board* position;
+
+    hint_text.clear();
+    position = snapshot_board(hint_image.data(), hint_image.size());
+    if (position == NULL)
+    {
+        hint_text = "No hint, the position could not be copied\n";
+    }
+    else if ( advisor.advise(position, &advice) )
+    {
+        snprintf(text, sizeof(text), "Hint: (%d,%d), %.1f%% safe, %.1f%% "
+                 "to win with best play\n", advice.row + 1,
+                 advice.column + 1, 100.0 * advice.safe_probability,
+                 100.0 * advice.win_probability);
+        hint_text = text;
+    }
+    else if (!position->is_game_over())
+    {
+        snprintf(text, sizeof(text), "No hint yet, %d squares still in "
+                 "doubt (hints start at %d)\n", advice.unknown,
+                 ENDGAME_DEFAULT_UNKNOWN);
+        hint_text = text;
+    }
+    delete position;
+
+    hint_done = true;
+    sem_post(&engine_wake);
+}
+
+/* save
+ *
+ * Starts the save job on the board as it is now
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameLoop::save()
+{
+    snapshot_pack(board, &save_image);
+    unsaved = false;
+    save_done = false;
+    save_job = std::thread(&GameLoop::save_thread, this);
+}
+
+/* save_thread
+ *
+ * Save job: writes save_image out
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameLoop::save_thread()
+{
+    snapshot_write(save_image, snapshot_path);
+    save_done = true;
+    sem_post(&engine_wake);
+}
+
+/* finish_jobs
+ *
+ * Joins the jobs that are done, adding a hint's answer to
+ * the next frame's messages
+ *
+ * Inputs:  wait - true to wait for the ones still running
+ * Outputs: (none)
+ * Returns: true if a hint was answered
+ */
+bool GameLoop::finish_jobs(bool wait)
+{
+    bool answered = false;
+
+    if ( hint_job.joinable() && (wait || hint_done) )
+    {
+        hint_job.join();
+        messages.append(hint_text);
+        answered = true;
+    }
+    if ( save_job.joinable() && (wait || save_done) )
+    {
+        save_job.join();
+    }
+    return answered;
+}
+
+/* input_thread
+ *
+ * Reads the player's words (as std::cin >> would) and
+ * queues them for the engine, then NULL once stdin is
+ * closed.  Returns early once run() says stop.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameLoop::input_thread()
+{
+    struct pollfd fds[2];
+    char chunk[GAME_LOOP_READ_CHUNK];
+    std::string pending;
+    ssize_t got;
+
+    take_buffered_input(&pending);
+    fds[0].fd = STDIN_FILENO;
+    fds[0].events = POLLIN;
+    fds[1].fd = quit_pipe[0];
+    fds[1].events = POLLIN;
+
+    while ( queue_words(&pending, false) )
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents != 0)
+        {
+            return;
+        }
+        got = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (got > 0)
+        {
+            pending.append(chunk, got);
+        }
+        else if ( (got == 0) || ( (errno != EINTR) && (errno != EAGAIN) ) )
+        {
+            break;
+        }
+    }
+
+    /* Closed: a last word needs no whitespace after it */
+    if ( queue_words(&pending, true) )
+    {
+        queue_line(NULL);
+    }
+}
+
+/* queue_words
+ *
+ * Queues every whitespace separated word read so far
+ *
+ * Inputs:  pending - text read and not queued yet
+ *          all     - true to queue a word at the very end
+ *                    too (input closed), false to keep it
+ *                    in case more of it comes
+ * Outputs: pending - what is left
+ * Returns: true to go on reading
+ *          false if run() said stop
+ */
+bool GameLoop::queue_words(std::string* pending, bool all)
+{
+    static const char* whitespace = " \t\r\n\v\f";
+    size_t start, end;
+
+    while ( (start = pending->find_first_not_of(whitespace)) !=
+            std::string::npos )
+    {
+        end = pending->find_first_of(whitespace, start);
+        if ( (end == std::string::npos) && !all )
+        {
+            pending->erase(0, start);
+            return true;
+        }
+        end = (end == std::string::npos) ? pending->length() : end;
+        if ( !queue_line(new std::string(*pending, start, end - start)) )
+        {
+            return false;
+        }
+        pending->erase(0, end);
+    }
+    pending->clear();
+    return true;
+}
+
+/* queue_line
+ *
+ * Hands a line to the engine, waiting while its queue is
+ * full
+ *
+ * Inputs:  line - line to queue (taken over), NULL for end
+ *                 of input
+ * Outputs: (none)
+ * Returns: true if queued
+ *          false if run() said stop (the line is freed)
+ */
+bool GameLoop::queue_line(std::string* line)
+{
+    while ( !input_queue.push(line) )
+    {
+        if (stopping)
+        {
+            delete line;
+            return false;
+        }
+        /* Engine is behind, let it catch up */
+        usleep(1000);
+    }
+    sem_post(&engine_wake);
+    return true;
+}
+
+/* render_thread
+ *
+ * Draws the newest frame it has been given, handing older
+ * ones straight back
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameLoop::render_thread()
+{
+    std::string text;
+    view_frame* frame;
+    view_frame* next;
+    bool last;
+
+    while (1)
+    {
+        sem_wait(&render_wake);
+
+        frame = NULL;
+        while (ready_queue.pop(&next))
+        {
+            if (frame != NULL)
+            {
+                /* Its messages still get printed */
+                next->messages.insert(0, frame->messages);
+                frame->messages.clear();
+                free_queue.push(frame);
+                frames_skipped++;
+            }
+            frame = next;
+        }
+        if (frame == NULL)
+        {
+            continue;
+        }
+
+        frame_text(frame, &text);
+        text.insert(0, frame->messages.data(), frame->messages.size());
+        frame->messages.clear();
+        last = frame->last;
+        free_queue.push(frame);
+        sem_post(&engine_wake);
+
+        if (!last)
+        {
+            text += "Move: ";
+        }
+        fwrite(text.data(), 1, text.size(), stdout);
+        fflush(stdout);
+        frames_drawn++;
+
+        if (last)
+        {
+            return;
+        }
+    }
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* take_buffered_input
+ *
+ * Takes whatever stdio has already read from stdin (e.g.
+ * typed ahead while the board was being chosen), so the
+ * input thread can read the descriptor directly
+ *
+ * Inputs:  (none)
+ * Outputs: out - text appended
+ * Returns: void
+ */
+static void take_buffered_input(std::string* out)
+{
+    int flags = fcntl(STDIN_FILENO, F_GETFL);
+    int c;
+
+    /* Without blocking, getc stops where stdio's buffer
+     * (and what is ready on the descriptor) ends */
+    fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+    while ( (c = getc(stdin)) != EOF )
+    {
+        out->push_back((char) c);
+    }
+    clearerr(stdin);
+    fcntl(STDIN_FILENO, F_SETFL, flags);
+}
@@ -0,0 +1,311 @@
+/* src/Journal.cc
+ *
+ * Implementation of the undo/redo journal
+ *
+ * Entry layout (all varints, see hdr/Varint.h):
+ *   number of squares changed
+ *   zigzag(change in squares revealed)
+ *   game flags before, game flags after (one byte each)
+ *   per square, sorted by index:
+ *     (index - previous index) << 4 | old state << 2 | new state
+ *
+ * Cascades change runs of neighboring squares, so almost
+ * every square costs a single byte.
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <algorithm>
+
+#include "Journal.h"
+#include "Varint.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static bool change_before(const cell_change& a, const cell_change& b);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Sets up an empty journal
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: Journal struct
+ */
+Journal::Journal()
+{
+    cursor = 0;
+}
+
+/* record
+ *
+ * Appends a move.  Anything that had been undone is
+ * dropped, as in any editor.
+ *
+ * Inputs:  changes - squares changed by the move (gets sorted)
+ *          delta   - counters and flags of the move
+ * Outputs: (none)
+ * Returns: void
+ */
+void Journal::record(std::vector<cell_change>& changes, move_delta delta)
+{
+    uint8_t buffer[VARINT_MAX_BYTES];
+    size_t i, n;
+    int previous = 0;
+
+    /* Forget the redo tail */
+    if (cursor < entry_offsets.size())
+    {
+        bytes.resize(entry_offsets[cursor]);
+        entry_offsets.resize(cursor);
+    }
+
+    std::sort(changes.begin(), changes.end(), change_before);
+
+    entry_offsets.push_back(bytes.size());
+    cursor++;
+
+    n = varint_encode(changes.size(), buffer);
+    bytes.insert(bytes.end(), buffer, buffer + n);
+    n = varint_encode(zigzag_encode(delta.revealed_delta), buffer);
+    bytes.insert(bytes.end(), buffer, buffer + n);
+    bytes.push_back(delta.flags_before);
+    bytes.push_back(delta.flags_after);
+
+    for (i = 0; i < changes.size(); i++)
+    {
+        n = varint_encode( ( (uint64_t) (changes[i].index - previous) << 4 ) |
+                           ( changes[i].old_state << 2 ) |
+                           changes[i].new_state,
+                           buffer );
+        bytes.insert(bytes.end(), buffer, buffer + n);
+        previous = changes[i].index;
+    }
+}
+
+/* step_back
+ *
+ * Moves back over the last applied entry
+ *
+ * Inputs:  (none)
+ * Outputs: changes - squares the entry changed
+ *          delta   - counters and flags of the entry
+ * Returns: true if there was an entry to undo
+ *          false otherwise
+ */
+bool Journal::step_back(std::vector<cell_change>& changes, move_delta* delta)
+{
+    if (!can_undo())
+    {
+        return false;
+    }
+    cursor--;
+    return decode(cursor, changes, delta);
+}
+
+/* step_forward
+ *
+ * Moves forward over the next undone entry
+ *
+ * Inputs:  (none)
+ * Outputs: changes - squares the entry changed
+ *          delta   - counters and flags of the entry
+ * Returns: true if there was an entry to redo
+ *          false otherwise
+ */
+bool Journal::step_forward(std::vector<cell_change>& changes,
+                           move_delta* delta)
+{
+    if (!can_redo())
+    {
+        return false;
+    }
+    cursor++;
+    return decode(cursor - 1, changes, delta);
+}
+
+/* clear
+ *
+ * Forgets all entries
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Journal::clear()
+{
+    bytes.clear();
+    entry_offsets.clear();
+    cursor = 0;
+}
+
+/* swap
+ *
+ * Trades entries (and cursors) with another journal
+ *
+ * Inputs:  other - journal to trade with
+ * Outputs: (none)
+ * Returns: void
+ */
+void Journal::swap(Journal& other)
+{
+    size_t held = cursor;
+
+    bytes.swap(other.bytes);
+    entry_offsets.swap(other.entry_offsets);
+    cursor = other.cursor;
+    other.cursor = held;
+}
+
+/* trim
+ *
+ * Forgets the oldest entries until the journal fits in
+ * max_bytes.  Undone entries are only dropped (all of them)
+ * if it still does not fit once nothing is left to undo.
+ *
+ * Inputs:  max_bytes - most memory_bytes() may be afterwards
+ * Outputs: (none)
+ * Returns: void
+ */
+void Journal::trim(size_t max_bytes)
+{
+    size_t n = entry_offsets.size();
+    size_t drop = 0, start, i;
+
+    if (memory_bytes() <= max_bytes)
+    {
+        return;
+    }
+    while ( (drop < cursor) &&
+            ( bytes.size() - entry_offsets[drop] +
+              (n - drop) * sizeof(size_t) > max_bytes ) )
+    {
+        drop++;
+    }
+    if ( (drop == cursor) &&
+         ( (drop == n) ||
+           ( bytes.size() - entry_offsets[drop] +
+             (n - drop) * sizeof(size_t) > max_bytes ) ) )
+    {
+        clear();
+    }
+    else
+    {
+        start = entry_offsets[drop];
+        bytes.erase(bytes.begin(), bytes.begin() + start);
+        entry_offsets.erase(entry_offsets.begin(),
+                            entry_offsets.begin() + drop);
+        for (i = 0; i < entry_offsets.size(); i++)
+        {
+            entry_offsets[i] -= start;
+        }
+        cursor -= drop;
+    }
+    bytes.shrink_to_fit();
+    entry_offsets.shrink_to_fit();
+}
+
+/* can_undo
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if there is an entry to step back over
+ */
+bool Journal::can_undo()
+{
+    return (cursor > 0);
+}
+
+/* can_redo
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if there is an undone entry to step forward over
+ */
+bool Journal::can_redo()
+{
+    return (cursor < entry_offsets.size());
+}
+
+/* memory_bytes
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: bytes held by the journal
+ */
+size_t Journal::memory_bytes()
+{
+    return bytes.capacity() + entry_offsets.capacity() * sizeof(size_t);
+}
+
+/* decode
+ *
+ * Decodes one entry
+ *
+ * Inputs:  entry   - entry number
+ * Outputs: changes - squares the entry changed
+ *          delta   - counters and flags of the entry
+ * Returns: true if the entry decoded cleanly
+ *          false otherwise
+ */
+bool Journal::decode(size_t entry, std::vector<cell_change>& changes,
+                     move_delta* delta)
+{
+    const uint8_t* in = &bytes[0] + entry_offsets[entry];
+    const uint8_t* end = &bytes[0] + bytes.size();
+    uint64_t count, value;
+    cell_change change;
+    int index = 0;
+
+    changes.clear();
+
+    in = varint_decode(in, end, &count);
+    if (in == NULL)
+    {
+        return false;
+    }
+    in = varint_decode(in, end, &value);
+    if ( (in == NULL) || (in + 2 > end) )
+    {
+        return false;
+    }
+    delta->revealed_delta = (int) zigzag_decode(value);
+    delta->flags_before = *in++;
+    delta->flags_after = *in++;
+
+    changes.reserve(count);
+    while (count-- > 0)
+    {
+        in = varint_decode(in, end, &value);
+        if (in == NULL)
+        {
+            return false;
+        }
+        index += (int) (value >> 4);
+        change.index = index;
+        change.old_state = (value >> 2) & 3;
+        change.new_state = value & 3;
+        changes.push_back(change);
+    }
+    return true;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* change_before
+ *
+ * Sort order for changes: by square index
+ */
+static bool change_before(const cell_change& a, const cell_change& b)
+{
+    return a.index < b.index;
+}
@@ -0,0 +1,181 @@
+/* src/Layout.cc
+ *
+ * Implementation of board-free layout generation
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "Layout.h"
+#include "Mines.h"
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Builds the neighbor table once for every layout to come
+ *
+ * Inputs:  _rows, _columns - size of the boards
+ *          _mines          - mines per board
+ *          topology        - shape of the boards
+ * Outputs: (none)
+ * Returns: LayoutGenerator struct
+ */
+LayoutGenerator::LayoutGenerator(int _rows, int _columns, int _mines,
+                                 board_topology topology)
+{
+    int i;
+
+    rows = _rows;
+    columns = _columns;
+    mines = _mines;
+    cells = rows * columns;
+    bbbv = 0;
+    openings = 0;
+
+    neighbors.resize(cells * NUM_NEIGHBORS);
+    neighbor_count.resize(cells);
+    for (i = 0; i < cells; i++)
+    {
+        neighbor_count[i] = (uint8_t)
+            board_neighbors(topology, rows, columns, i,
+                            &neighbors[i * NUM_NEIGHBORS]);
+    }
+    mine.resize(cells);
+    number.resize(cells);
+    covered.resize(cells);
+    /* Every square is pushed at most once per layout */
+    stack.resize(cells);
+}
+
+/* generate
+ *
+ * Deals the mines Board::init would for this seed and
+ * scores the layout
+ *
+ * Inputs:  seed  - seed for mine placement
+ * Outputs: plane - (rows*columns+7)/8 bytes, bit i&7 of
+ *                  byte i>>3 set for mines
+ * Returns: void
+ */
+void LayoutGenerator::generate(unsigned int seed, uint8_t* plane)
+{
+    mines_place(cells, mines, seed, plane);
+    load(plane);
+}
+
+/* load
+ *
+ * Scores a layout given as a packed plane
+ *
+ * Inputs:  plane - packed mine bitplane
+ * Outputs: (none)
+ * Returns: void
+ */
+void LayoutGenerator::load(const uint8_t* plane)
+{
+    int i;
+
+    for (i = 0; i < cells; i++)
+    {
+        mine[i] = (plane[i >> 3] >> (i & 7)) & 1;
+    }
+    score();
+}
+
+/* get_3bv / get_openings
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: 3BV / number of openings of the last layout
+ */
+int LayoutGenerator::get_3bv()
+{
+    return bbbv;
+}
+
+int LayoutGenerator::get_openings()
+{
+    return openings;
+}
+
+/* score
+ *
+ * Counts neighbor mines, then floods each zero region once.
+ * 3BV is the number of regions plus the safe squares no
+ * region covers (see Board::index_openings).
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void LayoutGenerator::score()
+{
+    /* Plain pointers, byte stores through vectors would make
+     * the compiler reload them every time */
+    const int* table = &neighbors[0];
+    const uint8_t* degree = &neighbor_count[0];
+    const uint8_t* is_mine = &mine[0];
+    uint8_t* count = &number[0];
+    uint8_t* seen = &covered[0];
+    int* pending = &stack[0];
+    const int* neighbor;
+    int i, j, square, top;
+
+    /* Far fewer mines than squares, so count outwards from them */
+    memset(count, 0, cells);
+    for (i = 0; i < cells; i++)
+    {
+        if (!is_mine[i])
+        {
+            continue;
+        }
+        neighbor = &table[i * NUM_NEIGHBORS];
+        for (j = 0; j < degree[i]; j++)
+        {
+            count[neighbor[j]]++;
+        }
+    }
+
+    memset(seen, 0, cells);
+    openings = 0;
+    for (i = 0; i < cells; i++)
+    {
+        if ( seen[i] || is_mine[i] || (count[i] != 0) )
+        {
+            continue;
+        }
+        openings++;
+        seen[i] = 1;
+        pending[0] = i;
+        top = 1;
+        while (top > 0)
+        {
+            square = pending[--top];
+            if (count[square] != 0)
+            {
+                continue;
+            }
+            neighbor = &table[square * NUM_NEIGHBORS];
+            /* Branch free, whether a neighbor is new is a coin toss */
+            for (j = 0; j < degree[square]; j++)
+            {
+                pending[top] = neighbor[j];
+                top += !seen[neighbor[j]];
+                seen[neighbor[j]] = 1;
+            }
+        }
+    }
+
+    bbbv = openings;
+    for (i = 0; i < cells; i++)
+    {
+        bbbv += !seen[i] && !is_mine[i];
+    }
+}
@@ -0,0 +1,251 @@
+/* src/MemStats.cc
+ *
+ * Implementation of the memory accounting layer
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <atomic>
+
+#include "MemStats.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* Counters of one tag, on their own cache line */
+typedef struct
+{
+    alignas(64) std::atomic<int64_t> live;
+    std::atomic<int64_t> peak;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<int64_t> budget;        /* 0 for none */
+} mem_counter;
+
+/******************************************************
+                    LOCAL VARIABLES
+*******************************************************/
+static mem_counter counters[NUM_MEM_TAGS];
+static std::atomic<bool> enabled(false);
+static std::atomic<uint64_t> moves(0);
+
+static const char* tag_names[NUM_MEM_TAGS] =
+{
+    "board", "parser", "render", "solver", "log", "parked"
+};
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* mem_enable
+ *
+ * Inputs:  on - start (true) or stop (false) counting
+ * Outputs: (none)
+ * Returns: void
+ */
+void mem_enable(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+/* mem_enabled
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if allocations are being counted
+ */
+bool mem_enabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/* mem_note_alloc
+ *
+ * Counts an allocation
+ *
+ * Inputs:  tag   - subsystem that made it
+ *          bytes - its size
+ * Outputs: (none)
+ * Returns: void
+ */
+void mem_note_alloc(mem_tag tag, size_t bytes)
+{
+    mem_counter* counter = &counters[tag];
+    int64_t live, peak;
+
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    counter->allocations.fetch_add(1, std::memory_order_relaxed);
+    live = counter->live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    peak = counter->peak.load(std::memory_order_relaxed);
+    while ( (live > peak) &&
+            !counter->peak.compare_exchange_weak(peak, live,
+                                                 std::memory_order_relaxed) )
+    {
+    }
+}
+
+/* mem_note_free
+ *
+ * Counts a free
+ *
+ * Inputs:  tag   - subsystem that made the allocation
+ *          bytes - its size
+ * Outputs: (none)
+ * Returns: void
+ */
+void mem_note_free(mem_tag tag, size_t bytes)
+{
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    counters[tag].frees.fetch_add(1, std::memory_order_relaxed);
+    counters[tag].live.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+/* mem_note_retag
+ *
+ * Moves live bytes from one tag to another, for memory
+ * that changes hands without being reallocated.  Not
+ * counted as an allocation or a free.
+ *
+ * Inputs:  from  - tag counting the bytes now
+ *          to    - tag to count them under
+ *          bytes - how many
+ * Outputs: (none)
+ * Returns: void
+ */
+void mem_note_retag(mem_tag from, mem_tag to, size_t bytes)
+{
+    mem_counter* counter = &counters[to];
+    int64_t live, peak;
+
+    if (!enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    counters[from].live.fetch_sub(bytes, std::memory_order_relaxed);
+    live = counter->live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    peak = counter->peak.load(std::memory_order_relaxed);
+    while ( (live > peak) &&
+            !counter->peak.compare_exchange_weak(peak, live,
+                                                 std::memory_order_relaxed) )
+    {
+    }
+}
+
+/* mem_note_move
+ *
+ * Counts a move, for allocations per move
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void mem_note_move()
+{
+    if (enabled.load(std::memory_order_relaxed))
+    {
+        moves.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/* mem_get_stats
+ *
+ * Inputs:  (none)
+ * Outputs: stats - every tag's counters and the move count
+ * Returns: void
+ */
+void mem_get_stats(mem_stats* stats)
+{
+    int i;
+
+    for (i = 0; i < NUM_MEM_TAGS; i++)
+    {
+        stats->tag[i].live_bytes =
+            counters[i].live.load(std::memory_order_relaxed);
+        stats->tag[i].peak_bytes =
+            counters[i].peak.load(std::memory_order_relaxed);
+        stats->tag[i].allocations =
+            counters[i].allocations.load(std::memory_order_relaxed);
+        stats->tag[i].frees =
+            counters[i].frees.load(std::memory_order_relaxed);
+    }
+    stats->moves = moves.load(std::memory_order_relaxed);
+}
+
+/* mem_set_budget / mem_over_budget
+ *
+ * A budget is only checked, never enforced here: callers
+ * ask before taking on more work
+ *
+ * Inputs:  tag   - subsystem
+ *          bytes - live bytes allowed, 0 for no limit
+ * Outputs: (none)
+ * Returns: mem_over_budget: true if the tag has a budget and
+ *          is using more than it
+ */
+void mem_set_budget(mem_tag tag, int64_t bytes)
+{
+    counters[tag].budget.store(bytes, std::memory_order_relaxed);
+}
+
+bool mem_over_budget(mem_tag tag)
+{
+    int64_t budget = counters[tag].budget.load(std::memory_order_relaxed);
+
+    return (budget > 0) &&
+           (counters[tag].live.load(std::memory_order_relaxed) > budget);
+}
+
+/* mem_tag_name
+ *
+ * Inputs:  tag - subsystem
+ * Outputs: (none)
+ * Returns: its name
+ */
+const char* mem_tag_name(mem_tag tag)
+{
+    return tag_names[tag];
+}
+
+/* mem_report
+ *
+ * Formats one line per tag
+ *
+ * Inputs:  (none)
+ * Outputs: text - report appended
+ * Returns: void
+ */
+void mem_report(std::string* text)
+{
+    mem_stats stats;
+    char line[160];
+    int i;
+
+    mem_get_stats(&stats);
+    for (i = 0; i < NUM_MEM_TAGS; i++)
+    {
+        snprintf(line, sizeof(line),
+                 "%-7s live %10.1f KB  peak %10.1f KB  allocations %llu"
+                 " (%.2f per move)\n", tag_names[i],
+                 (stats.tag[i].live_bytes > 0 ?
+                  stats.tag[i].live_bytes : 0) / 1024.0,
+                 stats.tag[i].peak_bytes / 1024.0,
+                 (unsigned long long) stats.tag[i].allocations,
+                 (stats.moves > 0) ?
+                 (double) stats.tag[i].allocations / stats.moves : 0.0);
+        *text += line;
+    }
+    snprintf(line, sizeof(line), "%llu moves\n",
+             (unsigned long long) stats.moves);
+    *text += line;
+}
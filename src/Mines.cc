@@ -0,0 +1,327 @@
+/* src/Mines.cc
+ *
+ * Implementation of counter based mine placement
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <string.h>
+#include <vector>
+
+#include "Mines.h"
+#include "CellStore.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define PHILOX_M0       0xD2511F53u
+#define PHILOX_M1       0xCD9E8D57u
+#define PHILOX_W0       0x9E3779B9u
+#define PHILOX_W1       0xBB67AE85u
+#define PHILOX_ROUNDS   10
+
+/* Streams of the generator, so split draws and tile draws
+ * never share a counter */
+#define STREAM_SPLIT    0
+#define STREAM_TILE     1
+
+/* Hypergeometric tails lighter than this (relative to the
+ * mode) are left out */
+#define TAIL_CUTOFF     1e-18
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static void random_words(uint32_t seed, uint32_t stream, uint64_t id,
+                         uint32_t draw, uint32_t out[4]);
+static double random_unit(uint32_t seed, uint32_t stream, uint64_t id);
+static void split_tiles(std::vector<int>& counts, int first, int tiles,
+                        int64_t cells, int64_t mines, uint32_t seed,
+                        uint64_t node);
+static void fill_tile(uint8_t* bytes, int cells, int mines, uint32_t seed,
+                      int tile);
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* philox4x32
+ *
+ * Philox4x32-10 (Salmon et al., "Parallel random numbers:
+ * as easy as 1, 2, 3"): four random words from a counter
+ * and a key, with no state in between
+ *
+ * Inputs:  counter - which block of the stream
+ *          key     - which stream
+ * Outputs: out     - four random words
+ * Returns: void
+ */
+void philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1];
+    uint32_t c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    uint64_t p0, p1;
+    int round;
+
+    for (round = 0; round < PHILOX_ROUNDS; round++)
+    {
+        p0 = (uint64_t) PHILOX_M0 * c0;
+        p1 = (uint64_t) PHILOX_M1 * c2;
+        c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t) p1;
+        c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t) p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+/* mines_hypergeometric
+ *
+ * Number of good items among `draws` taken without
+ * replacement from `total` items of which `good` are good,
+ * by inversion: the probabilities are walked out from the
+ * mode using the ratio of neighboring terms, so no
+ * factorials (or lgamma, which is not thread safe) are
+ * needed.  Each side is walked until its terms drop below
+ * TAIL_CUTOFF, about nine standard deviations out, so the
+ * walk is O(standard deviation) long
+ *
+ * Inputs:  total, good, draws - the urn and the draw
+ *          u                  - uniform in [0, 1)
+ * Outputs: (none)
+ * Returns: good items drawn
+ */
+int64_t mines_hypergeometric(int64_t total, int64_t good, int64_t draws,
+                             double u)
+{
+    int64_t low = (draws - (total - good) > 0) ? draws - (total - good) : 0;
+    int64_t high = (draws < good) ? draws : good;
+    int64_t mode, k, bottom, top;
+    double weight, sum, target;
+
+    if (low >= high)
+    {
+        return low;
+    }
+    mode = (int64_t) ((double) (draws + 1) * (good + 1) / (total + 2));
+    mode = (mode < low) ? low : (mode > high) ? high : mode;
+
+    /* Total weight, relative to the mode's */
+    sum = 1.0;
+    weight = 1.0;
+    for (k = mode; (k > low) && (weight > TAIL_CUTOFF); k--)
+    {
+        weight *= (double) k / (good - k + 1) *
+                  (double) (total - good - draws + k) / (draws - k + 1);
+        sum += weight;
+    }
+    bottom = k;
+    weight = 1.0;
+    for (k = mode; (k < high) && (weight > TAIL_CUTOFF); k++)
+    {
+        weight *= (double) (good - k) / (k + 1) *
+                  (double) (draws - k) / (total - good - draws + k + 1);
+        sum += weight;
+    }
+    top = k;
+
+    /* Mode first, then down, then up */
+    target = u * sum - 1.0;
+    if (target < 0.0)
+    {
+        return mode;
+    }
+    weight = 1.0;
+    for (k = mode; k > bottom; k--)
+    {
+        weight *= (double) k / (good - k + 1) *
+                  (double) (total - good - draws + k) / (draws - k + 1);
+        target -= weight;
+        if (target < 0.0)
+        {
+            return k - 1;
+        }
+    }
+    weight = 1.0;
+    for (k = mode; k < top; k++)
+    {
+        weight *= (double) (good - k) / (k + 1) *
+                  (double) (draws - k) / (total - good - draws + k + 1);
+        target -= weight;
+        if (target < 0.0)
+        {
+            return k + 1;
+        }
+    }
+    return top;
+}
+
+/* mines_place
+ *
+ * Deals the mines of a board for a seed, on as many
+ * threads as cells_parallel uses
+ *
+ * Inputs:  cells - squares on the board
+ *          mines - mines to place
+ *          seed  - seed for placement
+ * Outputs: plane - (cells+7)/8 bytes, bit i&7 of byte i>>3
+ *                  set for mines
+ * Returns: void
+ */
+void mines_place(int cells, int mines, uint32_t seed, uint8_t* plane)
+{
+    int tiles = (cells + MINES_TILE_CELLS - 1) >> MINES_TILE_SHIFT;
+    std::vector<int> counts(tiles);
+
+    if (cells <= 0)
+    {
+        return;
+    }
+    mines = (mines < 0) ? 0 : (mines > cells) ? cells : mines;
+    split_tiles(counts, 0, tiles, cells, mines, seed, 1);
+
+    cells_parallel(cells, MINES_TILE_CELLS,
+                   [&](size_t begin, size_t end)
+                   {
+                       int tile, size;
+
+                       for (tile = (int) (begin >> MINES_TILE_SHIFT);
+                            (size_t) tile << MINES_TILE_SHIFT < end; tile++)
+                       {
+                           size = cells - (tile << MINES_TILE_SHIFT);
+                           size = (size < MINES_TILE_CELLS) ? size
+                                                            : MINES_TILE_CELLS;
+                           fill_tile(plane + ((size_t) tile <<
+                                              (MINES_TILE_SHIFT - 3)),
+                                     size, counts[tile], seed, tile);
+                       }
+                   });
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* random_words / random_unit
+ *
+ * Draws from stream (seed, stream, id)
+ *
+ * Inputs:  seed   - board seed
+ *          stream - STREAM_SPLIT or STREAM_TILE
+ *          id     - split node or tile number
+ *          draw   - block number within the stream
+ * Outputs: out    - four random words
+ * Returns: random_unit: a double in [0, 1)
+ */
+static void random_words(uint32_t seed, uint32_t stream, uint64_t id,
+                         uint32_t draw, uint32_t out[4])
+{
+    uint32_t counter[4] = { draw, (uint32_t) id, (uint32_t) (id >> 32), 0 };
+    uint32_t key[2] = { seed, stream };
+
+    philox4x32(counter, key, out);
+}
+
+static double random_unit(uint32_t seed, uint32_t stream, uint64_t id)
+{
+    uint32_t words[4];
+
+    random_words(seed, stream, id, 0, words);
+    return ( ((uint64_t) words[0] << 21) ^ (words[1] >> 11) ) *
+           (1.0 / 9007199254740992.0);
+}
+
+/* split_tiles
+ *
+ * Shares a range's mines between its two halves, and so on
+ * down to single tiles.  Only the last tile can be short,
+ * so the left half is always whole tiles.
+ *
+ * Inputs:  first, tiles - the range of tiles
+ *          cells, mines - squares and mines in it
+ *          seed         - board seed
+ *          node         - this range's number (root 1,
+ *                         children 2n and 2n+1)
+ * Outputs: counts       - mines per tile
+ * Returns: void
+ */
+static void split_tiles(std::vector<int>& counts, int first, int tiles,
+                        int64_t cells, int64_t mines, uint32_t seed,
+                        uint64_t node)
+{
+    int left = tiles / 2;
+    int64_t left_cells = (int64_t) left << MINES_TILE_SHIFT;
+    int64_t left_mines;
+
+    if (tiles == 1)
+    {
+        counts[first] = (int) mines;
+        return;
+    }
+    left_mines = mines_hypergeometric(cells, mines, left_cells,
+                                      random_unit(seed, STREAM_SPLIT, node));
+    split_tiles(counts, first, left, left_cells, left_mines, seed,
+                2 * node);
+    split_tiles(counts, first + left, tiles - left, cells - left_cells,
+                mines - left_mines, seed, 2 * node + 1);
+}
+
+/* fill_tile
+ *
+ * Places a tile's mines uniformly.  Past half full it
+ * places the gaps instead, so a draw hits a free square at
+ * least half of the time.
+ *
+ * Inputs:  cells - squares in the tile
+ *          mines - mines in the tile
+ *          seed  - board seed
+ *          tile  - tile number
+ * Outputs: bytes - the tile's (cells+7)/8 plane bytes
+ * Returns: void
+ */
+static void fill_tile(uint8_t* bytes, int cells, int mines, uint32_t seed,
+                      int tile)
+{
+    int size = (cells + 7) / 8;
+    bool invert = (mines * 2 > cells);
+    int wanted = invert ? cells - mines : mines;
+    uint32_t words[4];
+    uint32_t draw = 0;
+    int placed = 0, i, spot;
+
+    memset(bytes, 0, size);
+    while (placed < wanted)
+    {
+        random_words(seed, STREAM_TILE, tile, draw++, words);
+        for (i = 0; (i < 4) && (placed < wanted); i++)
+        {
+            spot = (int) (((uint64_t) words[i] * cells) >> 32);
+            if ( !(bytes[spot >> 3] & (1 << (spot & 7))) )
+            {
+                bytes[spot >> 3] |= (uint8_t) (1 << (spot & 7));
+                placed++;
+            }
+        }
+    }
+
+    if (invert)
+    {
+        for (i = 0; i < size; i++)
+        {
+            bytes[i] = (uint8_t) ~bytes[i];
+        }
+        if (cells & 7)
+        {
+            bytes[size - 1] &= (uint8_t) ((1 << (cells & 7)) - 1);
+        }
+    }
+}
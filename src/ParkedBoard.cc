@@ -0,0 +1,154 @@
+/* src/ParkedBoard.cc
+ *
+ * Implementation of parked (packed idle) boards
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <vector>
+
+#include "ParkedBoard.h"
+#include "Varint.h"
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Packs a board.  Its undo history moves here; the caller
+ * deletes the board afterwards.
+ *
+ * Inputs:  board - board to park
+ * Outputs: (none)
+ * Returns: ParkedBoard struct
+ */
+ParkedBoard::ParkedBoard(Board* board)
+{
+    std::vector<uint8_t> states, runs;
+    uint8_t buffer[VARINT_MAX_BYTES];
+    size_t n, plane_bytes, i, start;
+    uint8_t state;
+
+    rows = board->get_rows();
+    columns = board->get_columns();
+    mines = board->get_mines();
+    topology = board->get_topology();
+    seed = board->get_seed();
+    squares_revealed = board->get_squares_revealed();
+    game_over = board->is_game_over();
+    game_won = board->did_we_win();
+
+    n = (size_t) rows * columns;
+    states.resize((n + 3) / 4);
+    board->pack_states(states.data());
+
+    /* One varint per run of equal states */
+    start = 0;
+    for (i = 1; i <= n; i++)
+    {
+        state = (states[start >> 2] >> ((start & 3) * 2)) & 3;
+        if ( (i < n) &&
+             ( ((states[i >> 2] >> ((i & 3) * 2)) & 3) == state ) )
+        {
+            continue;
+        }
+        runs.insert(runs.end(), buffer,
+                    buffer + varint_encode(((uint64_t) (i - start - 1) << 2) |
+                                           state, buffer));
+        start = i;
+    }
+
+    plane_bytes = (n + 7) / 8;
+    bytes.reserve(plane_bytes + runs.size());
+    bytes.resize(plane_bytes);
+    board->pack_mines(bytes.data());
+    runs_offset = bytes.size();
+    bytes.insert(bytes.end(), runs.begin(), runs.end());
+
+    board->swap_journal(&journal);
+    mem_note_retag(MEM_BOARD, MEM_PARKED, journal.memory_bytes());
+}
+
+/* Destructor
+ *
+ * Frees a board that was never woken.  Its history goes
+ * back to MEM_BOARD first, which its allocator frees from.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+ParkedBoard::~ParkedBoard()
+{
+    mem_note_retag(MEM_PARKED, MEM_BOARD, journal.memory_bytes());
+}
+
+/* wake
+ *
+ * Builds the board back.  Call it once: the undo history
+ * goes with the board.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: new board in the state it was parked in (the
+ *          caller owns it)
+ */
+Board* ParkedBoard::wake()
+{
+    std::vector<uint8_t> states;
+    const uint8_t* in = bytes.data() + runs_offset;
+    const uint8_t* end = bytes.data() + bytes.size();
+    size_t n = (size_t) rows * columns;
+    size_t i = 0, stop;
+    uint64_t value;
+    Board* board;
+
+    /* Unknown squares are 0, so only other runs are set */
+    states.assign((n + 3) / 4, 0);
+    while ( (i < n) && ((in = varint_decode(in, end, &value)) != NULL) )
+    {
+        stop = i + (value >> 2) + 1;
+        stop = (stop < n) ? stop : n;
+        if ( (value & 3) == UNKNOWN )
+        {
+            i = stop;
+            continue;
+        }
+        for ( ; i < stop; i++)
+        {
+            states[i >> 2] |= (uint8_t) ((value & 3) << ((i & 3) * 2));
+        }
+    }
+
+    board = new Board(rows, columns, mines, topology, seed, bytes.data());
+    board->restore_states(states.data(), squares_revealed, game_over,
+                          game_won);
+    mem_note_retag(MEM_PARKED, MEM_BOARD, journal.memory_bytes());
+    board->swap_journal(&journal);
+    return board;
+}
+
+/* is_game_over
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if the board was parked after the game ended
+ */
+bool ParkedBoard::is_game_over()
+{
+    return game_over;
+}
+
+/* get_bytes
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: memory held while parked, history included
+ */
+size_t ParkedBoard::get_bytes()
+{
+    return sizeof(*this) + bytes.capacity() + journal.memory_bytes();
+}
@@ -0,0 +1,644 @@
+/* src/ReplayIndex.cc
+ *
+ * Writing replay indexes and seeking in them
+ * (see hdr/ReplayIndex.h for the format)
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "ReplayIndex.h"
+#include "Varint.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint8_t board_flags(Board* board);
+static bool write_all(int fd, const uint8_t* data, size_t bytes);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: ReplayIndexWriter struct
+ */
+ReplayIndexWriter::ReplayIndexWriter()
+{
+    fd = -1;
+    offset = 0;
+    plane_bytes = 0;
+    revealed = 0;
+    memset(&header, 0, sizeof(header));
+}
+
+/* Destructor
+ *
+ * Drops an index that was never closed
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+ReplayIndexWriter::~ReplayIndexWriter()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        unlink(temp_path.c_str());
+    }
+}
+
+/* open
+ *
+ * Starts the index of a game, with a checkpoint of the
+ * board as it is now (normally just dealt)
+ *
+ * Inputs:  _path    - index to write
+ *          board    - the game's board
+ *          game     - its id in the event log
+ *          interval - moves between checkpoints
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ReplayIndexWriter::open(const char* _path, Board* board, uint32_t game,
+                             int interval)
+{
+    if (interval < 1)
+    {
+        PRINT_ERROR("Checkpoint interval must be at least 1");
+        return false;
+    }
+
+    path = _path;
+    temp_path = path + ".tmp";
+    fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        PRINT_INFO("\nERROR: Cannot create %s: %s\n",
+                   temp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, REPLAY_INDEX_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_INDEX_VERSION;
+    header.header_size = sizeof(header);
+    header.rows = board->get_rows();
+    header.columns = board->get_columns();
+    header.mines = board->get_mines();
+    header.topology = board->get_topology();
+    header.seed = board->get_seed();
+    header.game = game;
+    header.interval = interval;
+
+    /* Counts and table offset are filled in by close() */
+    table.clear();
+    changed.clear();
+    seen.assign(header.rows * header.columns, 0);
+    plane_bytes = (header.rows * header.columns + 3) / 4;
+    revealed = board->get_squares_revealed();
+    pending.assign((const uint8_t*) &header,
+                   (const uint8_t*) &header + sizeof(header));
+    offset = 0;
+    checkpoint(board);
+    return true;
+}
+
+/* note_changes
+ *
+ * Adds the squares the board's last step changed to the
+ * move being built.  Call after every make_move,
+ * apply_moves, undo or redo the logged move took.
+ *
+ * Inputs:  board - the game's board
+ * Outputs: (none)
+ * Returns: void
+ */
+void ReplayIndexWriter::note_changes(Board* board)
+{
+    const std::vector<cell_change>& changes = board->get_last_changes();
+    size_t i;
+
+    for (i = 0; i < changes.size(); i++)
+    {
+        if (!seen[changes[i].index])
+        {
+            seen[changes[i].index] = 1;
+            changed.push_back(changes[i].index);
+        }
+    }
+}
+
+/* add_move
+ *
+ * Appends the move built by note_changes, and a checkpoint
+ * if one is due
+ *
+ * Inputs:  board - the game's board, after the move
+ * Outputs: (none)
+ * Returns: true on success
+ *          false if writing failed
+ */
+bool ReplayIndexWriter::add_move(Board* board)
+{
+    uint8_t bytes[VARINT_MAX_BYTES];
+    int columns = header.columns;
+    int previous = 0, index, now;
+    size_t i;
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    std::sort(changed.begin(), changed.end());
+    pending.insert(pending.end(), bytes,
+                   bytes + varint_encode(changed.size(), bytes));
+    for (i = 0; i < changed.size(); i++)
+    {
+        index = changed[i];
+        seen[index] = 0;
+        pending.insert(pending.end(), bytes, bytes + varint_encode(
+                           ( (uint64_t) (index - previous) << 2 ) |
+                           board->get_square_state(index / columns,
+                                                   index % columns),
+                           bytes));
+        previous = index;
+    }
+    now = board->get_squares_revealed();
+    pending.insert(pending.end(), bytes, bytes + varint_encode(
+                       (zigzag_encode(now - revealed) << 2) |
+                       board_flags(board), bytes));
+    revealed = now;
+    changed.clear();
+
+    header.moves++;
+    if ( (header.moves % header.interval) == 0 )
+    {
+        checkpoint(board);
+    }
+    if (pending.size() >= REPLAY_INDEX_WRITE_BUFFER)
+    {
+        return flush();
+    }
+    return true;
+}
+
+/* close
+ *
+ * Writes the checkpoint table, fills in the header and
+ * moves the index into place
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ReplayIndexWriter::close()
+{
+    bool success;
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    header.checkpoints = table.size();
+    header.table_offset = offset + pending.size();
+    pending.insert(pending.end(), (const uint8_t*) table.data(),
+                   (const uint8_t*) (table.data() + table.size()));
+
+    success = flush() &&
+              (pwrite(fd, &header, sizeof(header), 0) == sizeof(header));
+    success = (::close(fd) == 0) && success;
+    fd = -1;
+    if (success)
+    {
+        success = (rename(temp_path.c_str(), path.c_str()) == 0);
+    }
+    if (!success)
+    {
+        PRINT_INFO("\nERROR: Cannot write %s: %s\n",
+                   path.c_str(), strerror(errno));
+        unlink(temp_path.c_str());
+    }
+    return success;
+}
+
+/* get_bytes / get_checkpoint_bytes / get_moves
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: size of the index so far / of its checkpoints /
+ *          moves in it
+ */
+uint64_t ReplayIndexWriter::get_bytes()
+{
+    return offset + pending.size() + table.size() * sizeof(replay_checkpoint);
+}
+
+uint64_t ReplayIndexWriter::get_checkpoint_bytes()
+{
+    return table.size() * plane_bytes;
+}
+
+uint64_t ReplayIndexWriter::get_moves()
+{
+    return header.moves;
+}
+
+/* checkpoint
+ *
+ * Appends the board's state plane and its table entry
+ *
+ * Inputs:  board - the game's board
+ * Outputs: (none)
+ * Returns: void
+ */
+void ReplayIndexWriter::checkpoint(Board* board)
+{
+    replay_checkpoint entry;
+    size_t at = pending.size();
+
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = offset + at;
+    entry.squares_revealed = board->get_squares_revealed();
+    entry.flags = board_flags(board);
+    table.push_back(entry);
+
+    pending.resize(at + plane_bytes);
+    board->pack_states(pending.data() + at);
+}
+
+/* flush
+ *
+ * Writes out the gathered moves and checkpoints
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ReplayIndexWriter::flush()
+{
+    bool success = write_all(fd, pending.data(), pending.size());
+
+    offset += pending.size();
+    pending.clear();
+    return success;
+}
+
+/* Constructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: ReplayIndex struct
+ */
+ReplayIndex::ReplayIndex()
+{
+    image = NULL;
+    size = 0;
+    header = NULL;
+    table = NULL;
+    cells = 0;
+    plane_bytes = 0;
+    shown_board = NULL;
+    shown_hash = 0;
+}
+
+/* Destructor
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+ReplayIndex::~ReplayIndex()
+{
+    close();
+}
+
+/* open
+ *
+ * Maps an index and checks its header and table
+ *
+ * Inputs:  path - index to read
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool ReplayIndex::open(const char* path)
+{
+    struct stat st;
+    uint64_t checkpoints, i;
+    int fd;
+
+    close();
+    fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        PRINT_INFO("\nERROR: Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    if ( (fstat(fd, &st) != 0) ||
+         ((size_t) st.st_size < sizeof(replay_index_header))
+       )
+    {
+        PRINT_INFO("\nERROR: Replay index %s is truncated\n", path);
+        ::close(fd);
+        return false;
+    }
+
+    size = st.st_size;
+    image = (const uint8_t*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (image == MAP_FAILED)
+    {
+        PRINT_INFO("\nERROR: Cannot map replay index %s: %s\n",
+                   path, strerror(errno));
+        image = NULL;
+        return false;
+    }
+    /* Seeks jump around, don't read ahead */
+    madvise((void*) image, size, MADV_RANDOM);
+
+    header = (const replay_index_header*) image;
+    checkpoints = (header->interval == 0) ? 0 :
+                  header->moves / header->interval + 1;
+    if ( (memcmp(header->magic, REPLAY_INDEX_MAGIC,
+                 sizeof(header->magic)) != 0) ||
+         (header->version != REPLAY_INDEX_VERSION) ||
+         (header->header_size != sizeof(replay_index_header)) ||
+         (header->rows < 1) || (header->columns < 1) ||
+         ((uint64_t) header->rows * header->columns > INT_MAX) ||
+         (header->mines < 0) ||
+         (header->mines >= header->rows * header->columns) ||
+         (header->topology >= NUM_TOPOLOGIES) ||
+         (header->interval == 0) ||
+         (header->checkpoints != checkpoints) ||
+         (header->table_offset > size) ||
+         (header->checkpoints >
+          (size - header->table_offset) / sizeof(replay_checkpoint))
+       )
+    {
+        PRINT_INFO("\nERROR: %s is not a valid replay index\n", path);
+        close();
+        return false;
+    }
+
+    table = (const replay_checkpoint*) (image + header->table_offset);
+    cells = header->rows * header->columns;
+    plane_bytes = (cells + 3) / 4;
+    for (i = 0; i < header->checkpoints; i++)
+    {
+        if ( (table[i].offset < sizeof(replay_index_header)) ||
+             (table[i].offset > header->table_offset) ||
+             ((uint64_t) plane_bytes > header->table_offset - table[i].offset)
+           )
+        {
+            PRINT_INFO("\nERROR: Checkpoint %llu of %s is out of range\n",
+                       (unsigned long long) i, path);
+            close();
+            return false;
+        }
+    }
+    plane.resize(plane_bytes);
+    shown.resize(plane_bytes);
+    shown_board = NULL;
+    return true;
+}
+
+/* close
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void ReplayIndex::close()
+{
+    if (image != NULL)
+    {
+        munmap((void*) image, size);
+    }
+    image = NULL;
+    header = NULL;
+    table = NULL;
+}
+
+/* get_header
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: header of the open index, NULL if none
+ */
+const replay_index_header* ReplayIndex::get_header()
+{
+    return header;
+}
+
+/* new_board
+ *
+ * Deals the indexed game's board again, from its seed
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: a new board for seek, NULL if no index is open
+ */
+Board* ReplayIndex::new_board()
+{
+    Board* board;
+
+    if (header == NULL)
+    {
+        return NULL;
+    }
+    board = new Board(header->rows, header->columns, header->mines,
+                      (board_topology) header->topology, header->seed);
+    board->set_verbose(false);
+    return board;
+}
+
+/* read_state
+ *
+ * Works out the squares after a move: copies the last
+ * checkpoint at or before it and applies the moves since
+ *
+ * Inputs:  move     - moves made (0 for the board as dealt,
+ *                     up to the header's moves)
+ * Outputs: out      - 2 bit state plane (see
+ *                     Board::pack_states)
+ *          revealed - squares revealed then
+ *          over     - was the game over
+ *          won      - was it won
+ *          replayed - moves applied on top of the
+ *                     checkpoint (may be NULL)
+ * Returns: true on success
+ *          false if the move is out of range or the index
+ *          is corrupt
+ */
+bool ReplayIndex::read_state(uint64_t move, uint8_t* out, int* revealed,
+                             bool* over, bool* won, int* replayed)
+{
+    const replay_checkpoint* entry;
+    const uint8_t* p;
+    const uint8_t* end;
+    uint64_t m, count, value, c;
+    int index, flags, shift;
+
+    if ( (header == NULL) || (move > header->moves) )
+    {
+        return false;
+    }
+
+    entry = &table[move / header->interval];
+    memcpy(out, image + entry->offset, plane_bytes);
+    *revealed = entry->squares_revealed;
+    flags = entry->flags;
+
+    p = image + entry->offset + plane_bytes;
+    end = image + header->table_offset;
+    for (m = move - move % header->interval; m < move; m++)
+    {
+        if ( (p = varint_decode(p, end, &count)) == NULL )
+        {
+            break;
+        }
+        index = 0;
+        for (c = 0; (c < count) && (p != NULL); c++)
+        {
+            p = varint_decode(p, end, &value);
+            index += (int) (value >> 2);
+            if ( (p == NULL) || (index < 0) || (index >= cells) )
+            {
+                p = NULL;
+                break;
+            }
+            shift = (index & 3) * 2;
+            out[index >> 2] = (uint8_t) ( (out[index >> 2] & ~(3 << shift)) |
+                                          ((value & 3) << shift) );
+        }
+        if ( (p == NULL) || ((p = varint_decode(p, end, &value)) == NULL) )
+        {
+            break;
+        }
+        *revealed += (int) zigzag_decode(value >> 2);
+        flags = (int) (value & 3);
+    }
+    if (p == NULL)
+    {
+        PRINT_INFO("\nERROR: Replay index is corrupt before move %llu\n",
+                   (unsigned long long) m + 1);
+        return false;
+    }
+
+    *over = (flags & GAME_FLAG_OVER) != 0;
+    *won = (flags & GAME_FLAG_WON) != 0;
+    if (replayed != NULL)
+    {
+        *replayed = (int) (move % header->interval);
+    }
+    return true;
+}
+
+/* seek
+ *
+ * Puts a board into the state it was in after a move.  If
+ * the board is still as the last seek left it, only the
+ * squares that differ between the two moves are set.
+ *
+ * Inputs:  move     - moves made (see read_state)
+ *          board    - the game's board (see new_board)
+ * Outputs: board    - squares and outcome restored
+ *          replayed - moves applied on top of the
+ *                     checkpoint (may be NULL)
+ * Returns: true on success
+ *          false if the move is out of range, the board is
+ *          another size or the index is corrupt
+ */
+bool ReplayIndex::seek(uint64_t move, Board* board, int* replayed)
+{
+    int revealed;
+    bool over, won;
+
+    if ( (header == NULL) || (board->get_rows() != header->rows) ||
+         (board->get_columns() != header->columns) ||
+         !read_state(move, plane.data(), &revealed, &over, &won, replayed)
+       )
+    {
+        return false;
+    }
+    if ( (board == shown_board) &&
+         (board->get_state_hash() == shown_hash) )
+    {
+        board->restore_states(plane.data(), revealed, over, won,
+                              shown.data());
+    }
+    else
+    {
+        board->restore_states(plane.data(), revealed, over, won);
+    }
+    plane.swap(shown);
+    shown_board = board;
+    shown_hash = board->get_state_hash();
+    return true;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* board_flags
+ *
+ * Inputs:  board - a board
+ * Outputs: (none)
+ * Returns: its outcome as GAME_FLAG_OVER and GAME_FLAG_WON
+ */
+static uint8_t board_flags(Board* board)
+{
+    if (!board->is_game_over())
+    {
+        return 0;
+    }
+    return GAME_FLAG_OVER | (board->did_we_win() ? GAME_FLAG_WON : 0);
+}
+
+/* write_all
+ *
+ * write() until everything is out
+ */
+static bool write_all(int fd, const uint8_t* data, size_t bytes)
+{
+    ssize_t written;
+
+    while (bytes > 0)
+    {
+        written = write(fd, data, bytes);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        bytes -= written;
+    }
+    return true;
+}
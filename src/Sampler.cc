@@ -0,0 +1,731 @@
+/* src/Sampler.cc
+ *
+ * Implementation of the mine layout sampler
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <thread>
+
+#include "Sampler.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t splitmix64(uint64_t* state);
+static uint64_t now_ns();
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Inputs:  _threads - chains to run, one per thread
+ * Outputs: (none)
+ * Returns: MineSampler struct
+ */
+MineSampler::MineSampler(int _threads)
+{
+    threads = (_threads < 1) ? 1 : _threads;
+    columns = 0;
+    frontier = 0;
+    interior = 0;
+    mines = 0;
+}
+
+/* sample
+ *
+ * Estimates every unrevealed square's chance of being a
+ * mine, running the chains until the budget is spent
+ *
+ * Inputs:  board     - game to look at
+ *          budget_ms - how long to sample for
+ *          seed      - for the chains
+ * Outputs: result    - estimates and diagnostics
+ * Returns: true if probabilities were found
+ *          false if the game is over, or no chain found a
+ *          consistent layout in time
+ */
+bool MineSampler::sample(Board* board, double budget_ms, uint64_t seed,
+                         sampler_result* result)
+{
+    std::vector<std::thread> workers;
+    uint64_t start = now_ns();
+    uint64_t deadline = start + (uint64_t) (budget_ms * 1e6);
+    uint64_t state = seed;
+    int i;
+
+    memset(result, 0, sizeof(*result));
+    probabilities.clear();
+    if ( !read_board(board) )
+    {
+        return false;
+    }
+    result->frontier = frontier;
+    result->interior = interior;
+    result->constraints = constraint_values.size();
+    result->chains = threads;
+
+    chains.resize(threads);
+    for (i = 1; i < threads; i++)
+    {
+        workers.push_back(std::thread(&MineSampler::run_chain, this, i,
+                                      splitmix64(&state), deadline));
+    }
+    run_chain(0, splitmix64(&state), deadline);
+    for (i = 0; i < (int) workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    merge(result);
+    result->milliseconds = (now_ns() - start) / 1e6;
+    return (result->samples > 0);
+}
+
+/* get_probability
+ *
+ * Inputs:  row, column - square (0 based)
+ * Outputs: (none)
+ * Returns: its chance of being a mine by the last sample(),
+ *          0 if it is revealed, -1 if there is no estimate
+ */
+double MineSampler::get_probability(int row, int column)
+{
+    if (probabilities.empty())
+    {
+        return -1.0;
+    }
+    return probabilities[row * columns + column];
+}
+
+/* read_board
+ *
+ * Turns what the player sees into frontier slots and the
+ * numbers next to them
+ *
+ * Inputs:  board - game to read
+ * Outputs: (none)
+ * Returns: true if the position can be sampled
+ */
+bool MineSampler::read_board(Board* board)
+{
+    int rows = board->get_rows();
+    int cells, i, j, count;
+    board_topology topology = board->get_topology();
+    std::vector<int> cell_constraint;
+    int neighbors[NUM_NEIGHBORS];
+
+    columns = board->get_columns();
+    cells = rows * columns;
+    if (board->is_game_over())
+    {
+        return false;
+    }
+
+    /* Numbers next to an unrevealed square are constraints */
+    cell_constraint.assign(cells, -1);
+    constraint_values.clear();
+    for (i = 0; i < cells; i++)
+    {
+        if (board->get_square_state(i / columns, i % columns) != REVEALED)
+        {
+            continue;
+        }
+        count = board_neighbors(topology, rows, columns, i, neighbors);
+        for (j = 0; j < count; j++)
+        {
+            if (board->get_square_state(neighbors[j] / columns,
+                                        neighbors[j] % columns) != REVEALED)
+            {
+                cell_constraint[i] = constraint_values.size();
+                constraint_values.push_back(
+                    board->get_square_number(i / columns, i % columns));
+                break;
+            }
+        }
+    }
+
+    /* Unrevealed squares next to one are the frontier */
+    cell_slot.assign(cells, SAMPLER_REVEALED);
+    slot_cells.clear();
+    slot_start.clear();
+    slot_constraints.clear();
+    interior = 0;
+    for (i = 0; i < cells; i++)
+    {
+        if (board->get_square_state(i / columns, i % columns) == REVEALED)
+        {
+            continue;
+        }
+        count = board_neighbors(topology, rows, columns, i, neighbors);
+        slot_start.push_back(slot_constraints.size());
+        for (j = 0; j < count; j++)
+        {
+            if (cell_constraint[neighbors[j]] >= 0)
+            {
+                slot_constraints.push_back(cell_constraint[neighbors[j]]);
+            }
+        }
+        if (slot_constraints.size() == (size_t) slot_start.back())
+        {
+            slot_start.pop_back();
+            cell_slot[i] = SAMPLER_INTERIOR;
+            interior++;
+            continue;
+        }
+        cell_slot[i] = slot_cells.size();
+        slot_cells.push_back(i);
+    }
+    slot_start.push_back(slot_constraints.size());
+    frontier = slot_cells.size();
+
+    /* And the other way round, slots next to each number */
+    constraint_start.assign(constraint_values.size() + 1, 0);
+    for (i = 0; i < (int) slot_constraints.size(); i++)
+    {
+        constraint_start[slot_constraints[i] + 1]++;
+    }
+    for (i = 0; i < (int) constraint_values.size(); i++)
+    {
+        constraint_start[i + 1] += constraint_start[i];
+    }
+    constraint_slots.resize(slot_constraints.size());
+    cell_constraint.assign(constraint_values.size(), 0);
+    for (i = 0; i < frontier; i++)
+    {
+        for (j = slot_start[i]; j < slot_start[i + 1]; j++)
+        {
+            count = slot_constraints[j];
+            constraint_slots[constraint_start[count] +
+                             cell_constraint[count]++] = i;
+        }
+    }
+
+    /* Slots that share a number with each slot */
+    near_start.clear();
+    near_slots.clear();
+    cell_constraint.assign(frontier, -1);
+    for (i = 0; i < frontier; i++)
+    {
+        near_start.push_back(near_slots.size());
+        for (j = slot_start[i]; j < slot_start[i + 1]; j++)
+        {
+            for (count = constraint_start[slot_constraints[j]];
+                 count < constraint_start[slot_constraints[j] + 1]; count++)
+            {
+                if ( (constraint_slots[count] != i) &&
+                     (cell_constraint[constraint_slots[count]] != i) )
+                {
+                    cell_constraint[constraint_slots[count]] = i;
+                    near_slots.push_back(constraint_slots[count]);
+                }
+            }
+        }
+    }
+    near_start.push_back(near_slots.size());
+
+    mines = board->get_mines();
+    return (mines <= frontier + interior);
+}
+
+/* run_chain
+ *
+ * One chain, on its own thread.  It starts from a random
+ * layout and repairs broken numbers until it finds a
+ * consistent one: it picks a broken number and moves one of
+ * its mines away, or a mine onto it.  From there it walks
+ * by the Metropolis rule (see hdr/Sampler.h), proposing
+ * swaps uniformly from those that touch the frontier; a
+ * Hastings factor makes up for the number of such swaps
+ * changing with the interior mine count.  After burn in it
+ * counts a consistent layout every few steps until the
+ * deadline.  Counts go to the second half once half of the
+ * time left after burn in has passed.
+ *
+ * Inputs:  chain       - which chain
+ *          seed        - its random numbers
+ *          deadline_ns - CLOCK_MONOTONIC time to stop at
+ * Outputs: (none)
+ * Returns: void
+ */
+void MineSampler::run_chain(int chain, uint64_t seed, uint64_t deadline_ns)
+{
+    sampler_chain* out = &chains[chain];
+    int constraints = constraint_values.size();
+    int unknown = frontier + interior;
+    int free_squares = unknown - mines;
+    int thin = frontier / 8 + 1;
+    std::vector<uint8_t> is_mine(frontier, 0);
+    std::vector<int> mine_slots, free_slots, position(frontier);
+    std::vector<int> sums(constraints, 0);
+    std::vector<int> broken, broken_at(constraints, -1);
+    double accept[2 * SAMPLER_MAX_DELTA + 1];
+    double ratio, penalty;
+    uint64_t steps = 0, accepted = 0, consistent_steps = 0;
+    int tune_steps = 0, tune_consistent = 0;
+    uint64_t burn = 0, half_ns = 0, now;
+    int interior_mines, need, slot, taken, given, violation, delta;
+    int candidates[NUM_NEIGHBORS];
+    int half = 0, count, i, c;
+    bool counting = false, mixed = false, fewer;
+
+    /* Metropolis acceptance by change in how far off the
+     * numbers are, for a penalty kept within its bounds */
+    auto set_penalty = [&](double value)
+    {
+        int d;
+
+        penalty = (value < SAMPLER_MIN_PENALTY) ? SAMPLER_MIN_PENALTY :
+                  (value > SAMPLER_MAX_PENALTY) ? SAMPLER_MAX_PENALTY : value;
+        for (d = -SAMPLER_MAX_DELTA; d <= SAMPLER_MAX_DELTA; d++)
+        {
+            accept[SAMPLER_MAX_DELTA + d] = exp(-penalty * d);
+        }
+    };
+    set_penalty(SAMPLER_SEARCH_PENALTY);
+    for (i = 0; i < 2; i++)
+    {
+        out->mine_counts[i].assign(frontier, 0);
+        out->interior_mines[i] = 0;
+        out->samples[i] = 0;
+    }
+
+    /* Deal the mines over the unknown squares at random */
+    need = mines;
+    for (slot = 0; slot < frontier; slot++)
+    {
+        if ( (splitmix64(&seed) % (uint64_t) (unknown - slot)) <
+             (uint64_t) need )
+        {
+            need--;
+            is_mine[slot] = 1;
+            position[slot] = mine_slots.size();
+            mine_slots.push_back(slot);
+            for (i = slot_start[slot]; i < slot_start[slot + 1]; i++)
+            {
+                sums[slot_constraints[i]]++;
+            }
+        }
+        else
+        {
+            position[slot] = free_slots.size();
+            free_slots.push_back(slot);
+        }
+    }
+    interior_mines = need;
+    violation = 0;
+    for (c = 0; c < constraints; c++)
+    {
+        violation += abs(sums[c] - constraint_values[c]);
+        if (sums[c] != constraint_values[c])
+        {
+            broken_at[c] = broken.size();
+            broken.push_back(c);
+        }
+    }
+
+    /* Adds a mine to (1) or takes one off (-1) a slot's
+     * numbers, and returns how much further off they are */
+    auto shift = [&](int slot, int by)
+    {
+        int change = 0, k, before, after, last;
+
+        for (k = slot_start[slot]; k < slot_start[slot + 1]; k++)
+        {
+            c = slot_constraints[k];
+            before = abs(sums[c] - constraint_values[c]);
+            sums[c] += by;
+            after = abs(sums[c] - constraint_values[c]);
+            change += after - before;
+            if ( (after != 0) && (broken_at[c] < 0) )
+            {
+                broken_at[c] = broken.size();
+                broken.push_back(c);
+            }
+            else if ( (after == 0) && (broken_at[c] >= 0) )
+            {
+                last = broken.back();
+                broken[broken_at[c]] = last;
+                broken_at[last] = broken_at[c];
+                broken.pop_back();
+                broken_at[c] = -1;
+            }
+        }
+        return change;
+    };
+
+    /* A random mine or free square: a slot, or -1 for one in
+     * the interior */
+    auto any_mine = [&]()
+    {
+        int n = (int) (splitmix64(&seed) % mines);
+
+        return (n < interior_mines) ? -1 : mine_slots[n - interior_mines];
+    };
+    auto any_free = [&]()
+    {
+        int n = (int) (splitmix64(&seed) % free_squares);
+
+        return (n < interior - interior_mines) ? -1 :
+               free_slots[n - (interior - interior_mines)];
+    };
+
+    /* Swaps that touch the frontier, with so many interior
+     * mines */
+    auto swaps = [&](int inside)
+    {
+        return (double) mines * free_squares -
+               (double) inside * (interior - inside);
+    };
+
+    while (1)
+    {
+        if ( (steps % SAMPLER_CLOCK_STEPS) == 0 )
+        {
+            now = now_ns();
+            if (now >= deadline_ns)
+            {
+                break;
+            }
+            if ( counting && (half == 0) && (now >= half_ns) )
+            {
+                half = 1;
+            }
+        }
+        steps++;
+
+        taken = -1;
+        given = -1;
+        ratio = 1.0;
+        if (!mixed && !broken.empty())
+        {
+            /* Repair: move a mine off or onto a broken number */
+            c = broken[splitmix64(&seed) % broken.size()];
+            fewer = (sums[c] > constraint_values[c]);
+            count = 0;
+            for (i = constraint_start[c]; i < constraint_start[c + 1]; i++)
+            {
+                if (is_mine[constraint_slots[i]] == (fewer ? 1 : 0))
+                {
+                    candidates[count++] = constraint_slots[i];
+                }
+            }
+            if ( fewer && (free_squares > 0) )
+            {
+                taken = candidates[splitmix64(&seed) % count];
+                given = any_free();
+            }
+            else if ( !fewer && (mines > 0) )
+            {
+                given = candidates[splitmix64(&seed) % count];
+                taken = any_mine();
+            }
+        }
+        else if ( (frontier > 0) &&
+                  ((int) (splitmix64(&seed) & 3) < SAMPLER_LOCAL_QUARTERS) )
+        {
+            /* Swap two squares next to the same number.  Any
+             * pair is proposed with the same chance whatever the
+             * layout, and is a no-op unless one is a mine. */
+            slot = (int) (splitmix64(&seed) % frontier);
+            count = near_start[slot + 1] - near_start[slot];
+            i = (count == 0) ? slot :
+                near_slots[near_start[slot] +
+                           splitmix64(&seed) % (uint64_t) count];
+            if (is_mine[slot] != is_mine[i])
+            {
+                taken = is_mine[slot] ? slot : i;
+                given = is_mine[slot] ? i : slot;
+            }
+        }
+        else if ( (frontier > 0) && (mines > 0) && (free_squares > 0) )
+        {
+            do
+            {
+                taken = any_mine();
+                given = any_free();
+            } while ( (taken < 0) && (given < 0) );
+            if ( (taken < 0) != (given < 0) )
+            {
+                ratio = swaps(interior_mines) /
+                        swaps(interior_mines + ( (taken < 0) ? -1 : 1 ));
+            }
+        }
+        if ( (taken >= 0) || (given >= 0) )
+        {
+            delta = 0;
+            if (taken >= 0)
+            {
+                delta += shift(taken, -1);
+            }
+            if (given >= 0)
+            {
+                delta += shift(given, 1);
+            }
+            delta = (delta < -SAMPLER_MAX_DELTA) ? -SAMPLER_MAX_DELTA :
+                    (delta > SAMPLER_MAX_DELTA) ? SAMPLER_MAX_DELTA : delta;
+            if ( (splitmix64(&seed) >> 11) * (1.0 / 9007199254740992.0) >=
+                 accept[SAMPLER_MAX_DELTA + delta] * ratio )
+            {
+                if (taken >= 0)
+                {
+                    shift(taken, 1);
+                }
+                if (given >= 0)
+                {
+                    shift(given, -1);
+                }
+            }
+            else
+            {
+                accepted++;
+                violation += delta;
+                if (taken >= 0)
+                {
+                    /* Mine list loses it, free list gains it */
+                    slot = mine_slots.back();
+                    mine_slots[position[taken]] = slot;
+                    position[slot] = position[taken];
+                    mine_slots.pop_back();
+                    position[taken] = free_slots.size();
+                    free_slots.push_back(taken);
+                    is_mine[taken] = 0;
+                }
+                else
+                {
+                    interior_mines--;
+                }
+                if (given >= 0)
+                {
+                    slot = free_slots.back();
+                    free_slots[position[given]] = slot;
+                    position[slot] = position[given];
+                    free_slots.pop_back();
+                    position[given] = mine_slots.size();
+                    mine_slots.push_back(given);
+                    is_mine[given] = 1;
+                }
+                else
+                {
+                    interior_mines++;
+                }
+            }
+        }
+
+        if (!mixed)
+        {
+            if (!broken.empty())
+            {
+                continue;
+            }
+            mixed = true;
+            burn = steps + std::max( (uint64_t) SAMPLER_BURN_IN_SWEEPS *
+                                     (frontier + 1),
+                                     (uint64_t) SAMPLER_BURN_IN_TUNES *
+                                     SAMPLER_TUNE_STEPS );
+            set_penalty(SAMPLER_PENALTY);
+        }
+        consistent_steps += broken.empty() ? 1 : 0;
+        if (!counting)
+        {
+            /* Burn in, and tune the penalty so that a fair share
+             * of the layouts the chain visits are consistent */
+            tune_steps++;
+            tune_consistent += broken.empty() ? 1 : 0;
+            if (tune_steps == SAMPLER_TUNE_STEPS)
+            {
+                set_penalty(penalty +
+                            ( (tune_consistent < SAMPLER_TUNE_STEPS *
+                                                 SAMPLER_CONSISTENT) ?
+                              SAMPLER_PENALTY_STEP : -SAMPLER_PENALTY_STEP ));
+                tune_steps = 0;
+                tune_consistent = 0;
+            }
+            if (steps < burn)
+            {
+                continue;
+            }
+            counting = true;
+            now = now_ns();
+            half_ns = now + (deadline_ns - ( (now < deadline_ns) ?
+                                             now : deadline_ns )) / 2;
+        }
+        if ( broken.empty() && ((steps % thin) == 0) )
+        {
+            for (i = 0; i < (int) mine_slots.size(); i++)
+            {
+                out->mine_counts[half][mine_slots[i]]++;
+            }
+            out->interior_mines[half] += interior_mines;
+            out->samples[half]++;
+        }
+    }
+
+    out->steps = steps;
+    out->accepted = accepted;
+    out->consistent_steps = consistent_steps;
+    out->mixed = mixed;
+    out->penalty = penalty;
+}
+
+/* merge
+ *
+ * Adds up the chains' counts into probabilities, and works
+ * out the diagnostics
+ *
+ * Inputs:  (none)
+ * Outputs: result - everything but the frontier sizes and time
+ * Returns: void
+ */
+void MineSampler::merge(sampler_result* result)
+{
+    std::vector<double> means;
+    std::vector<uint64_t> lengths;
+    std::vector<uint64_t> totals(frontier, 0);
+    uint64_t interior_total = 0;
+    double n, mean, within, between, pooled, rhat;
+    size_t k;
+    int chain, half, slot, i;
+
+    for (chain = 0; chain < threads; chain++)
+    {
+        result->steps += chains[chain].steps;
+        result->accepted += chains[chain].accepted;
+        result->mixed += chains[chain].mixed ? 1 : 0;
+        result->consistent += chains[chain].consistent_steps;
+        for (half = 0; half < 2; half++)
+        {
+            result->samples += chains[chain].samples[half];
+            interior_total += chains[chain].interior_mines[half];
+            for (slot = 0; slot < frontier; slot++)
+            {
+                totals[slot] += chains[chain].mine_counts[half][slot];
+            }
+        }
+    }
+    result->consistent = (result->steps == 0) ? 0.0 :
+                         result->consistent / result->steps;
+    if (result->samples == 0)
+    {
+        return;
+    }
+
+    result->interior_probability = (interior == 0) ? 0.0 :
+        (double) interior_total / ((double) result->samples * interior);
+    probabilities.assign(cell_slot.size(), 0.0);
+    result->safest = 2.0;
+    for (i = 0; i < (int) cell_slot.size(); i++)
+    {
+        if (cell_slot[i] == SAMPLER_REVEALED)
+        {
+            continue;
+        }
+        probabilities[i] = (cell_slot[i] == SAMPLER_INTERIOR) ?
+                           result->interior_probability :
+                           (double) totals[cell_slot[i]] / result->samples;
+        if (probabilities[i] < result->safest)
+        {
+            result->safest = probabilities[i];
+            result->row = i / columns;
+            result->column = i % columns;
+        }
+    }
+
+    /* R-hat over the half chains with at least two samples */
+    result->max_rhat = 0.0;
+    for (slot = 0; slot < frontier; slot++)
+    {
+        means.clear();
+        lengths.clear();
+        for (chain = 0; chain < threads; chain++)
+        {
+            for (half = 0; half < 2; half++)
+            {
+                if (chains[chain].samples[half] >= 2)
+                {
+                    lengths.push_back(chains[chain].samples[half]);
+                    means.push_back(
+                        (double) chains[chain].mine_counts[half][slot] /
+                        chains[chain].samples[half]);
+                }
+            }
+        }
+        if (means.size() < 2)
+        {
+            break;
+        }
+
+        n = 0.0;
+        mean = 0.0;
+        within = 0.0;
+        for (k = 0; k < means.size(); k++)
+        {
+            n += lengths[k];
+            mean += means[k];
+            within += means[k] * (1.0 - means[k]) *
+                      lengths[k] / (lengths[k] - 1.0);
+        }
+        n /= means.size();
+        mean /= means.size();
+        within /= means.size();
+        between = 0.0;
+        for (k = 0; k < means.size(); k++)
+        {
+            between += (means[k] - mean) * (means[k] - mean);
+        }
+        between /= means.size() - 1;            /* B / n */
+        if (within <= 0.0)
+        {
+            /* Every half chain saw it always or never */
+            rhat = (between > 0.0) ? HUGE_VAL : 1.0;
+        }
+        else
+        {
+            pooled = (n - 1.0) / n * within + between;
+            rhat = sqrt(pooled / within);
+        }
+        if (rhat > result->max_rhat)
+        {
+            result->max_rhat = rhat;
+        }
+    }
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* splitmix64
+ *
+ * The chains' random numbers
+ */
+static uint64_t splitmix64(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* now_ns
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: CLOCK_MONOTONIC in nanoseconds
+ */
+static uint64_t now_ns()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
@@ -0,0 +1,1435 @@
+/* src/Server.cc
+ *
+ * Implementation of the multi-session game server
+ * (see hdr/Server.h for the protocol)
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "Server.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+#define WORKER_BITS       8
+#define WORKER_MASK       ((1 << WORKER_BITS) - 1)
+#define EVENTS_PER_WAIT   256
+#define READ_CHUNK        16384
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t now_ns();
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Sets up a worker and its epoll set
+ *
+ * Inputs:  _server - server the worker belongs to
+ *          _index  - worker number, also the low bits of
+ *                    every session id it hands out
+ * Outputs: (none)
+ * Returns: ServerWorker struct
+ */
+ServerWorker::ServerWorker(GameServer* _server, int _index)
+{
+    struct epoll_event ev;
+    int i;
+
+    server = _server;
+    index = _index;
+    next_session = 1;
+    next_park_check_ns = 0;
+    rand_state = (unsigned int) time(NULL) ^ (index * 0x9e3779b9u);
+    for (i = 0; i < NUM_SERVER_STATS; i++)
+    {
+        stats[i] = 0;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    inbox_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    /* Every worker waits on the listening socket, the kernel
+     * wakes only one of them per connection */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = NULL;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server->get_listen_fd(), &ev);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = this;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, inbox_fd, &ev);
+}
+
+/* Destructor
+ *
+ * Closes connections and frees every hosted board
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+ServerWorker::~ServerWorker()
+{
+    std::unordered_map<int, server_connection*>::iterator c;
+    size_t i;
+
+    while (!sessions.empty())
+    {
+        end_session(sessions.begin()->first);
+    }
+    for (c = connections.begin(); c != connections.end(); ++c)
+    {
+        unwatch(c->second);
+        close(c->second->fd);
+        delete c->second;
+    }
+    for (i = 0; i < inbox.size(); i++)
+    {
+        unwatch(inbox[i]);
+        close(inbox[i]->fd);
+        delete inbox[i];
+    }
+    close(inbox_fd);
+    close(epoll_fd);
+}
+
+/* run
+ *
+ * Worker event loop, returns once the server stops
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::run()
+{
+    struct epoll_event events[EVENTS_PER_WAIT];
+    server_connection* conn;
+    uint64_t park_after = server->get_park_after_ns();
+    uint64_t check_ms = park_after / SERVER_PARK_CHECKS / 1000000;
+    int i, n;
+
+    /* With parking on, wake up now and then to look for
+     * idle sessions even when no client says anything */
+    check_ms = (check_ms < 1) ? 1 : (check_ms > 1000) ? 1000 : check_ms;
+    while (!server->stopping)
+    {
+        n = epoll_wait(epoll_fd, events, EVENTS_PER_WAIT,
+                       (park_after > 0) ? (int) check_ms : -1);
+        if (park_after > 0)
+        {
+            park_idle();
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                accept_connections();
+                continue;
+            }
+            if (events[i].data.ptr == this)
+            {
+                drain_inbox();
+                continue;
+            }
+
+            conn = (server_connection*) events[i].data.ptr;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                drop_connection(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+            {
+                flush_output(conn);
+            }
+            if (events[i].events & EPOLLIN)
+            {
+                handle_input(conn);
+            }
+        }
+    }
+}
+
+/* wake
+ *
+ * Kicks the worker out of epoll_wait
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::wake()
+{
+    uint64_t one = 1;
+
+    if (write(inbox_fd, &one, sizeof(one)) < 0)
+    {
+        DEBUG_INFO("Worker %d already awake\n", index);
+    }
+}
+
+/* hand_over
+ *
+ * Called from another worker: this worker takes over a
+ * connection (with whatever input it has buffered)
+ *
+ * Inputs:  conn - connection, no longer in any epoll set
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::hand_over(server_connection* conn)
+{
+    {
+        std::lock_guard<std::mutex> guard(inbox_lock);
+        inbox.push_back(conn);
+    }
+    wake();
+}
+
+/* get_stats
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: this worker's counters
+ */
+server_stats ServerWorker::get_stats()
+{
+    server_stats out;
+    int i;
+
+    memset(&out, 0, sizeof(out));
+    for (i = 0; i < NUM_SERVER_STATS; i++)
+    {
+        out.value[i] = stats[i].load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+/* accept_connections
+ *
+ * Accepts every pending connection
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::accept_connections()
+{
+    server_connection* conn;
+    int fd, one = 1;
+
+    while (1)
+    {
+        fd = accept4(server->get_listen_fd(), NULL, NULL,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn = new server_connection;
+        conn->fd = fd;
+        conn->session = 0;
+        conn->want_write = false;
+        conn->watching = NULL;
+        conn->reader = -1;
+        conn->attaching = 0;
+        connections[fd] = conn;
+        watch(conn, EPOLL_CTL_ADD);
+        stats[STAT_CONNECTIONS]++;
+    }
+}
+
+/* drain_inbox
+ *
+ * Adopts connections handed over by other workers (or
+ * just clears a stop wakeup)
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::drain_inbox()
+{
+    std::vector<server_connection*> arrived;
+    uint64_t count;
+    size_t i;
+
+    if (read(inbox_fd, &count, sizeof(count)) < 0)
+    {
+        DEBUG_INFO("Spurious inbox wakeup\n");
+    }
+    {
+        std::lock_guard<std::mutex> guard(inbox_lock);
+        arrived.swap(inbox);
+    }
+
+    for (i = 0; i < arrived.size(); i++)
+    {
+        connections[arrived[i]->fd] = arrived[i];
+        watch(arrived[i], EPOLL_CTL_ADD);
+        /* Answer the ATTACH it came for, then go on with
+         * what the previous owner had buffered after it */
+        attach(arrived[i], arrived[i]->attaching);
+        arrived[i]->attaching = 0;
+        handle_input(arrived[i]);
+    }
+}
+
+/* handle_input
+ *
+ * Reads what the client sent and answers every complete
+ * line.  Stops early if the connection is handed over.
+ *
+ * Inputs:  conn - connection with input pending
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::handle_input(server_connection* conn)
+{
+    char chunk[READ_CHUNK];
+    std::string line;
+    size_t start = 0, newline;
+    ssize_t got;
+    bool closed = false;
+
+    while (1)
+    {
+        got = recv(conn->fd, chunk, sizeof(chunk), 0);
+        if (got > 0)
+        {
+            conn->in.append(chunk, got);
+            continue;
+        }
+        if ( (got == 0) ||
+             ( (errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+               (errno != EINTR) )
+           )
+        {
+            closed = true;
+        }
+        if ( (got < 0) && (errno == EINTR) )
+        {
+            continue;
+        }
+        break;
+    }
+
+    while ( (newline = conn->in.find('\n', start)) != std::string::npos )
+    {
+        line.assign(conn->in, start, newline - start);
+        if (!line.empty() && (line[line.length() - 1] == '\r'))
+        {
+            line.erase(line.length() - 1);
+        }
+        if (!handle_line(conn, line, newline + 1))
+        {
+            /* Handed over: conn belongs to another thread now */
+            return;
+        }
+        start = newline + 1;
+    }
+    conn->in.erase(0, start);
+
+    if (conn->in.length() > SERVER_MAX_LINE)
+    {
+        conn->out.append("ERR line too long\n");
+        conn->in.clear();
+    }
+
+    flush_output(conn);
+    if (closed)
+    {
+        drop_connection(conn);
+    }
+}
+
+/* handle_line
+ *
+ * Answers one request
+ *
+ * Inputs:  conn     - connection the request came in on
+ *          line     - request without its newline
+ *          consumed - length of conn->in up to and including
+ *                     this line's newline
+ * Outputs: (none)
+ * Returns: true if the connection stays with this worker
+ *          false if it was handed over to another one
+ */
+bool ServerWorker::handle_line(server_connection* conn, std::string& line,
+                               size_t consumed)
+{
+    const char* text = line.c_str();
+
+    stats[STAT_REQUESTS]++;
+
+    if (strncmp(text, "NEW", 3) == 0)
+    {
+        handle_new(conn, text + 3);
+    }
+    else if (strncmp(text, "ATTACH", 6) == 0)
+    {
+        return handle_attach(conn, text + 6, consumed);
+    }
+    else if (strcmp(text, "BOARD") == 0)
+    {
+        handle_board(conn);
+    }
+    else if (strcmp(text, "CLOSE") == 0)
+    {
+        handle_close(conn);
+    }
+    else if (strncmp(text, "WATCH", 5) == 0)
+    {
+        handle_watch(conn, text + 5);
+    }
+    else if (strcmp(text, "VIEW") == 0)
+    {
+        handle_view(conn);
+    }
+    else if (strcmp(text, "UNWATCH") == 0)
+    {
+        if (conn->watching == NULL)
+        {
+            conn->out.append("ERR not watching\n");
+        }
+        else
+        {
+            unwatch(conn);
+            conn->out.append("OK\n");
+        }
+    }
+    else if (!line.empty())
+    {
+        handle_moves(conn, line);
+    }
+    return true;
+}
+
+/* handle_new
+ *
+ * NEW <rows> <columns> <mines> [topology]
+ * Starts a game on this worker and attaches the
+ * connection to it.  A finished game the connection was
+ * attached to is thrown away.
+ *
+ * Inputs:  conn - connection the request came in on
+ *          args - text after the command
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::handle_new(server_connection* conn, const char* args)
+{
+    int rows, columns, mines, topology = TOPOLOGY_SQUARE;
+    server_session* session;
+    char reply[64];
+
+    if ( (sscanf(args, "%d %d %d %d", &rows, &columns, &mines, &topology) < 3) ||
+         (rows < 1) || (rows > SERVER_MAX_BOARD_SIDE) ||
+         (columns < 1) || (columns > SERVER_MAX_BOARD_SIDE) ||
+         (mines < 1) || (mines > rows*columns) ||
+         (topology < 0) || (topology >= NUM_TOPOLOGIES)
+       )
+    {
+        conn->out.append("ERR usage: NEW <rows> <columns> <mines> [topology]\n");
+        return;
+    }
+
+    session = find_session(conn->session);
+    if ( (session != NULL) &&
+         ( (session->board != NULL) ? session->board->is_game_over()
+                                    : session->parked->is_game_over() )
+       )
+    {
+        end_session(session->id);
+    }
+    if (mem_over_budget(MEM_BOARD))
+    {
+        conn->out.append("ERR memory budget\n");
+        return;
+    }
+    if ( (server->get_session_budget() > 0) &&
+         ( (size_t) rows * columns * sizeof(Square) >
+           server->get_session_budget() )
+       )
+    {
+        stats[STAT_OVER_BUDGET]++;
+        conn->out.append("ERR session memory budget\n");
+        return;
+    }
+
+    session = new server_session;
+    session->id = (next_session++ << WORKER_BITS) | index;
+    session->board = NULL;
+    session->parked = NULL;
+    session->last_used_ns = now_ns();
+    if (server->get_pool() != NULL)
+    {
+        session->board = server->get_pool()->take(index, rows, columns, mines,
+                                                  (board_topology) topology);
+    }
+    if (session->board == NULL)
+    {
+        session->board = new Board(rows, columns, mines,
+                                   (board_topology) topology,
+                                   rand_r(&rand_state));
+        session->board->set_verbose(false);
+    }
+    session->feed = NULL;
+    if (server->get_spectating())
+    {
+        session->feed = new SpectatorFeed(session->board);
+        session->board->set_spectators(session->feed);
+        server->share_feed(session->id, session->feed);
+    }
+    sessions[session->id] = session;
+    stats[STAT_SESSIONS]++;
+
+    conn->session = session->id;
+    snprintf(reply, sizeof(reply), "OK %llu\n",
+             (unsigned long long) session->id);
+    conn->out.append(reply);
+}
+
+/* handle_attach
+ *
+ * ATTACH <session>
+ * Attaches the connection to an existing session, handing
+ * the connection to the session's worker if needed.  The
+ * input is trimmed past this line before the hand over, and
+ * the new owner answers the ATTACH itself (see drain_inbox).
+ *
+ * Inputs:  conn     - connection the request came in on
+ *          args     - text after the command
+ *          consumed - length of conn->in up to and including
+ *                     this line's newline
+ * Outputs: (none)
+ * Returns: true if the connection stays with this worker
+ *          false if it was handed over
+ */
+bool ServerWorker::handle_attach(server_connection* conn, const char* args,
+                                 size_t consumed)
+{
+    unsigned long long id;
+    ServerWorker* owner;
+
+    if (sscanf(args, "%llu", &id) != 1)
+    {
+        conn->out.append("ERR usage: ATTACH <session>\n");
+        return true;
+    }
+
+    owner = server->owner_of(id);
+    if ( (owner != NULL) && (owner != this) )
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+        connections.erase(conn->fd);
+        conn->in.erase(0, consumed);
+        conn->attaching = id;
+        stats[STAT_HANDOFFS]++;
+        /* Last touch: the owner may run it from here on */
+        owner->hand_over(conn);
+        return false;
+    }
+
+    attach(conn, id);
+    return true;
+}
+
+/* attach
+ *
+ * Attaches the connection to a session of this worker and
+ * answers the ATTACH
+ *
+ * Inputs:  conn - connection
+ *          id   - session asked for
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::attach(server_connection* conn, uint64_t id)
+{
+    char reply[64];
+
+    if (find_session(id) == NULL)
+    {
+        conn->out.append("ERR no such session\n");
+        return;
+    }
+    conn->session = id;
+    snprintf(reply, sizeof(reply), "OK %llu\n", (unsigned long long) id);
+    conn->out.append(reply);
+}
+
+/* handle_moves
+ *
+ * Applies moves in the usual "(r,c),M(r,c)" syntax to the
+ * attached session
+ *
+ * Inputs:  conn - connection the request came in on
+ *          line - the moves
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::handle_moves(server_connection* conn, std::string& line)
+{
+    server_session* session = find_session(conn->session);
+    Board* board;
+    char reply[64];
+
+    if (session == NULL)
+    {
+        conn->out.append("ERR no session, use NEW or ATTACH\n");
+        return;
+    }
+    board = board_of(session);
+    if (board->is_game_over())
+    {
+        conn->out.append("ERR game over\n");
+        return;
+    }
+    if (server->get_session_budget() > 0)
+    {
+        board->trim_history(server->get_session_budget());
+    }
+    if ( (server->get_session_budget() > 0) &&
+         (board->get_memory_bytes() > server->get_session_budget()) )
+    {
+        stats[STAT_OVER_BUDGET]++;
+        conn->out.append("ERR session memory budget\n");
+        return;
+    }
+
+    board->parse_input(line);
+    stats[STAT_MOVES]++;
+
+    snprintf(reply, sizeof(reply), "OK %s %d\n",
+             !board->is_game_over() ? "PLAYING" :
+             (board->did_we_win() ? "WON" : "LOST"),
+             board->get_squares_revealed());
+    conn->out.append(reply);
+}
+
+/* handle_board
+ *
+ * BOARD
+ * Sends the attached board, one line per row, then END
+ *
+ * Inputs:  conn - connection the request came in on
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::handle_board(server_connection* conn)
+{
+    server_session* session = find_session(conn->session);
+    Board* board;
+    int row, column;
+
+    if (session == NULL)
+    {
+        conn->out.append("ERR no session, use NEW or ATTACH\n");
+        return;
+    }
+    board = board_of(session);
+    for (row = 0; row < board->get_rows(); row++)
+    {
+        for (column = 0; column < board->get_columns(); column++)
+        {
+            conn->out.push_back(board->square_char(row, column));
+        }
+        conn->out.push_back('\n');
+    }
+    conn->out.append("END\n");
+}
+
+/* handle_close
+ *
+ * CLOSE
+ * Ends the attached session
+ *
+ * Inputs:  conn - connection the request came in on
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::handle_close(server_connection* conn)
+{
+    if (find_session(conn->session) == NULL)
+    {
+        conn->out.append("ERR no session\n");
+        return;
+    }
+    end_session(conn->session);
+    conn->session = 0;
+    conn->out.append("OK\n");
+}
+
+/* handle_watch
+ *
+ * WATCH <session>
+ * Starts watching a session on any worker.  The
+ * connection stays where it is.
+ *
+ * Inputs:  conn - connection the request came in on
+ *          args - text after the command
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::handle_watch(server_connection* conn, const char* args)
+{
+    unsigned long long id;
+    SpectatorFeed* feed;
+    char reply[64];
+    int reader;
+
+    if (sscanf(args, "%llu", &id) != 1)
+    {
+        conn->out.append("ERR usage: WATCH <session>\n");
+        return;
+    }
+    if (!server->get_spectating())
+    {
+        conn->out.append("ERR spectating is off\n");
+        return;
+    }
+    feed = server->find_feed(id);
+    if (feed == NULL)
+    {
+        conn->out.append("ERR no such session\n");
+        return;
+    }
+    reader = feed->join();
+    if (reader < 0)
+    {
+        feed->release();
+        conn->out.append("ERR too many watchers\n");
+        return;
+    }
+
+    unwatch(conn);
+    conn->watching = feed;
+    conn->reader = reader;
+    stats[STAT_WATCHERS]++;
+    snprintf(reply, sizeof(reply), "OK %llu\n", id);
+    conn->out.append(reply);
+}
+
+/* handle_view
+ *
+ * VIEW
+ * Sends the latest frame of the watched session, one line
+ * per row, then END with its status, revealed count and
+ * frame number
+ *
+ * Inputs:  conn - connection the request came in on
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::handle_view(server_connection* conn)
+{
+    const spectate_frame* frame;
+    char reply[96];
+
+    if (conn->watching == NULL)
+    {
+        conn->out.append("ERR not watching, use WATCH\n");
+        return;
+    }
+
+    frame = conn->watching->enter(conn->reader);
+    spectate_text(frame, &conn->out);
+    snprintf(reply, sizeof(reply), "END %s %d %llu\n",
+             !frame->game_over ? "PLAYING" :
+             (frame->game_won ? "WON" : "LOST"),
+             frame->squares_revealed, (unsigned long long) frame->version);
+    conn->watching->exit(conn->reader);
+
+    conn->out.append(reply);
+    stats[STAT_VIEWS]++;
+}
+
+/* unwatch
+ *
+ * Stops watching, if the connection was
+ *
+ * Inputs:  conn - connection
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::unwatch(server_connection* conn)
+{
+    if (conn->watching == NULL)
+    {
+        return;
+    }
+    conn->watching->leave(conn->reader);
+    conn->watching->release();
+    conn->watching = NULL;
+    conn->reader = -1;
+    stats[STAT_WATCHERS]--;
+}
+
+/* end_session
+ *
+ * Frees a session's board.  Its watchers keep the last
+ * frame.
+ *
+ * Inputs:  id - session to end
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::end_session(uint64_t id)
+{
+    server_session* session = find_session(id);
+
+    if (session == NULL)
+    {
+        return;
+    }
+    sessions.erase(id);
+    if (session->feed != NULL)
+    {
+        server->unshare_feed(id);
+        if (session->board != NULL)
+        {
+            session->board->set_spectators(NULL);
+        }
+        session->feed->release();
+    }
+    if (session->parked != NULL)
+    {
+        stats[STAT_PARKED]--;
+        stats[STAT_PARKED_BYTES] -= session->parked->get_bytes();
+        delete session->parked;
+    }
+    delete session->board;
+    delete session;
+    stats[STAT_SESSIONS]--;
+}
+
+/* flush_output
+ *
+ * Sends as much pending output as the socket takes and
+ * waits for EPOLLOUT if some is left
+ *
+ * Inputs:  conn - connection to flush
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::flush_output(server_connection* conn)
+{
+    ssize_t sent;
+    size_t done = 0;
+
+    while (done < conn->out.length())
+    {
+        sent = send(conn->fd, conn->out.data() + done,
+                    conn->out.length() - done, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        done += sent;
+    }
+    conn->out.erase(0, done);
+
+    if (conn->want_write != !conn->out.empty())
+    {
+        conn->want_write = !conn->out.empty();
+        watch(conn, EPOLL_CTL_MOD);
+    }
+}
+
+/* drop_connection
+ *
+ * Closes a connection.  Its session stays hosted and can
+ * be attached to again.
+ *
+ * Inputs:  conn - connection to close
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::drop_connection(server_connection* conn)
+{
+    unwatch(conn);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    connections.erase(conn->fd);
+    close(conn->fd);
+    delete conn;
+}
+
+/* watch
+ *
+ * Adds a connection to (or updates it in) the epoll set
+ *
+ * Inputs:  conn - connection
+ *          op   - EPOLL_CTL_ADD or EPOLL_CTL_MOD
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::watch(server_connection* conn, int op)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | (conn->want_write ? EPOLLOUT : 0);
+    ev.data.ptr = conn;
+    epoll_ctl(epoll_fd, op, conn->fd, &ev);
+}
+
+/* find_session
+ *
+ * Inputs:  id - session id
+ * Outputs: (none)
+ * Returns: session hosted by this worker, NULL if none
+ */
+server_session* ServerWorker::find_session(uint64_t id)
+{
+    std::unordered_map<uint64_t, server_session*>::iterator it;
+
+    it = sessions.find(id);
+    if (it == sessions.end())
+    {
+        return NULL;
+    }
+    return it->second;
+}
+
+/* board_of
+ *
+ * Gets a session's board for a request, waking it if it
+ * was parked
+ *
+ * Inputs:  session - session the request is for
+ * Outputs: (none)
+ * Returns: the session's live board
+ */
+Board* ServerWorker::board_of(server_session* session)
+{
+    uint64_t start, took;
+
+    session->last_used_ns = now_ns();
+    if (session->board != NULL)
+    {
+        return session->board;
+    }
+
+    start = session->last_used_ns;
+    stats[STAT_PARKED]--;
+    stats[STAT_PARKED_BYTES] -= session->parked->get_bytes();
+    session->board = session->parked->wake();
+    session->board->set_verbose(false);
+    if (session->feed != NULL)
+    {
+        session->board->set_spectators(session->feed);
+    }
+    delete session->parked;
+    session->parked = NULL;
+
+    session->last_used_ns = now_ns();
+    took = session->last_used_ns - start;
+    stats[STAT_WAKES]++;
+    stats[STAT_WAKE_NS] += took;
+    if (took > stats[STAT_MAX_WAKE_NS])
+    {
+        stats[STAT_MAX_WAKE_NS] = took;
+    }
+    return session->board;
+}
+
+/* park_idle
+ *
+ * Parks every session that has been idle for the server's
+ * parking period.  Runs at most SERVER_PARK_CHECKS times
+ * per period, whatever the epoll loop is up to.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::park_idle()
+{
+    std::unordered_map<uint64_t, server_session*>::iterator it;
+    uint64_t park_after = server->get_park_after_ns();
+    uint64_t now = now_ns();
+
+    if (now < next_park_check_ns)
+    {
+        return;
+    }
+    next_park_check_ns = now + park_after / SERVER_PARK_CHECKS;
+
+    for (it = sessions.begin(); it != sessions.end(); ++it)
+    {
+        if ( (it->second->board != NULL) &&
+             (now - it->second->last_used_ns >= park_after) )
+        {
+            park(it->second);
+        }
+    }
+}
+
+/* park
+ *
+ * Packs a session's board and frees it.  Watchers keep
+ * the last frame until it wakes.
+ *
+ * Inputs:  session - session with a live board
+ * Outputs: (none)
+ * Returns: void
+ */
+void ServerWorker::park(server_session* session)
+{
+    session->board->set_spectators(NULL);
+    session->parked = new ParkedBoard(session->board);
+    delete session->board;
+    session->board = NULL;
+
+    stats[STAT_PARKED]++;
+    stats[STAT_PARKED_BYTES] += session->parked->get_bytes();
+    stats[STAT_PARKS]++;
+}
+
+/* Constructor
+ *
+ * Sets up a server that is not listening yet
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: GameServer struct
+ */
+GameServer::GameServer()
+{
+    listen_fd = -1;
+    num_workers = 0;
+    pool = NULL;
+    pool_threads = 1;
+    spectating = false;
+    park_after_ns = 0;
+    session_budget = 0;
+    stopping = false;
+}
+
+/* Destructor
+ *
+ * Stops the workers and frees everything
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+GameServer::~GameServer()
+{
+    stop();
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+    }
+}
+
+/* listen_tcp
+ *
+ * Listens on a TCP port on the loopback interface
+ *
+ * Inputs:  port - port to listen on
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool GameServer::listen_tcp(int port)
+{
+    struct sockaddr_in addr;
+    int one = 1;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        return false;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ( (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) ||
+         (listen(listen_fd, SOMAXCONN) != 0)
+       )
+    {
+        PRINT_INFO("\nERROR: Cannot listen on port %d: %s\n",
+                   port, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/* listen_unix
+ *
+ * Listens on a Unix domain socket
+ *
+ * Inputs:  path - socket path (replaced if it exists)
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool GameServer::listen_unix(const char* path)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        PRINT_ERROR("Socket path too long!");
+        return false;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if ( (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) ||
+         (listen(listen_fd, SOMAXCONN) != 0)
+       )
+    {
+        PRINT_INFO("\nERROR: Cannot listen on %s: %s\n",
+                   path, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/* start
+ *
+ * Starts the worker threads
+ *
+ * Inputs:  _num_workers - number of workers (1 to SERVER_MAX_WORKERS)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameServer::start(int _num_workers)
+{
+    int i;
+
+    num_workers = _num_workers;
+    if (num_workers < 1)
+    {
+        num_workers = 1;
+    }
+    if (num_workers > SERVER_MAX_WORKERS)
+    {
+        num_workers = SERVER_MAX_WORKERS;
+    }
+
+    stopping = false;
+    if (pool != NULL)
+    {
+        pool->start(num_workers, pool_threads);
+    }
+    for (i = 0; i < num_workers; i++)
+    {
+        workers.push_back(new ServerWorker(this, i));
+    }
+    for (i = 0; i < num_workers; i++)
+    {
+        threads.push_back(std::thread(&ServerWorker::run, workers[i]));
+    }
+}
+
+/* stop
+ *
+ * Stops the workers and frees every hosted game
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameServer::stop()
+{
+    size_t i;
+
+    stopping = true;
+    for (i = 0; i < workers.size(); i++)
+    {
+        workers[i]->wake();
+    }
+    for (i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+    for (i = 0; i < workers.size(); i++)
+    {
+        delete workers[i];
+    }
+    threads.clear();
+    workers.clear();
+    if (pool != NULL)
+    {
+        pool->stop();
+    }
+}
+
+/* set_spectating
+ *
+ * Makes sessions started from now on publish frames for
+ * watchers.  Set it before start.
+ *
+ * Inputs:  on - true to allow WATCH
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameServer::set_spectating(bool on)
+{
+    spectating = on;
+}
+
+/* set_pool
+ *
+ * Has NEW take boards from a pool, which start() fills
+ * with a queue per worker.  Set it before start; the pool
+ * must outlive the server.
+ *
+ * Inputs:  _pool   - pool with its presets added, NULL for none
+ *          threads - refill threads for it
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameServer::set_pool(BoardPool* _pool, int threads)
+{
+    pool = _pool;
+    pool_threads = threads;
+}
+
+/* get_pool
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: the board pool, NULL if there is none
+ */
+BoardPool* GameServer::get_pool()
+{
+    return pool;
+}
+
+/* set_park_after
+ *
+ * Parks sessions left idle for a while (see
+ * hdr/ParkedBoard.h).  Set it before start.
+ *
+ * Inputs:  seconds - idle time before parking, 0 to never park
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameServer::set_park_after(double seconds)
+{
+    park_after_ns = (seconds > 0.0) ? (uint64_t) (seconds * 1e9) : 0;
+}
+
+/* get_park_after_ns
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: idle time before parking in nanoseconds, 0 if
+ *          sessions are never parked
+ */
+uint64_t GameServer::get_park_after_ns()
+{
+    return park_after_ns;
+}
+
+/* set_session_budget
+ *
+ * Caps the memory of every session's board (see
+ * hdr/Server.h).  Set it before start.
+ *
+ * Inputs:  bytes - most a board may hold, 0 for no cap
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameServer::set_session_budget(size_t bytes)
+{
+    session_budget = bytes;
+}
+
+/* get_session_budget
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: most a session's board may hold, 0 if uncapped
+ */
+size_t GameServer::get_session_budget()
+{
+    return session_budget;
+}
+
+/* get_spectating
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: true if sessions publish frames
+ */
+bool GameServer::get_spectating()
+{
+    return spectating;
+}
+
+/* share_feed / unshare_feed
+ *
+ * Called by a session's worker to make its feed findable
+ * by WATCH on every worker, and to take it back.  The lock
+ * is only taken when sessions start, end and get watched,
+ * never on a move.
+ *
+ * Inputs:  session - session id
+ *          feed    - its feed
+ * Outputs: (none)
+ * Returns: void
+ */
+void GameServer::share_feed(uint64_t session, SpectatorFeed* feed)
+{
+    std::lock_guard<std::mutex> guard(feeds_lock);
+
+    feeds[session] = feed;
+}
+
+void GameServer::unshare_feed(uint64_t session)
+{
+    std::lock_guard<std::mutex> guard(feeds_lock);
+
+    feeds.erase(session);
+}
+
+/* find_feed
+ *
+ * Inputs:  session - session id
+ * Outputs: (none)
+ * Returns: the session's feed with a reference taken for
+ *          the caller, NULL if it has none
+ */
+SpectatorFeed* GameServer::find_feed(uint64_t session)
+{
+    std::lock_guard<std::mutex> guard(feeds_lock);
+    std::unordered_map<uint64_t, SpectatorFeed*>::iterator it;
+
+    it = feeds.find(session);
+    if (it == feeds.end())
+    {
+        return NULL;
+    }
+    it->second->retain();
+    return it->second;
+}
+
+/* get_listen_fd
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: listening socket
+ */
+int GameServer::get_listen_fd()
+{
+    return listen_fd;
+}
+
+/* owner_of
+ *
+ * Inputs:  session - session id
+ * Outputs: (none)
+ * Returns: worker that owns the session, NULL if the id
+ *          cannot belong to any worker
+ */
+ServerWorker* GameServer::owner_of(uint64_t session)
+{
+    int worker = (int) (session & WORKER_MASK);
+
+    if (worker >= (int) workers.size())
+    {
+        return NULL;
+    }
+    return workers[worker];
+}
+
+/* get_stats
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: counters summed over all workers
+ */
+server_stats GameServer::get_stats()
+{
+    server_stats total, one;
+    size_t i;
+    int j;
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < workers.size(); i++)
+    {
+        one = workers[i]->get_stats();
+        for (j = 0; j < NUM_SERVER_STATS; j++)
+        {
+            total.value[j] += one.value[j];
+        }
+        total.value[STAT_MAX_WAKE_NS] -= one.value[STAT_MAX_WAKE_NS];
+        if (one.value[STAT_MAX_WAKE_NS] > total.value[STAT_MAX_WAKE_NS])
+        {
+            total.value[STAT_MAX_WAKE_NS] = one.value[STAT_MAX_WAKE_NS];
+        }
+    }
+    mem_get_stats(&total.memory);
+    if (pool != NULL)
+    {
+        pool->get_stats(&total.pool);
+    }
+    return total;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* now_ns
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: CLOCK_MONOTONIC in nanoseconds
+ */
+static uint64_t now_ns()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
@@ -0,0 +1,316 @@
+/* src/Snapshot.cc
+ *
+ * Saving and restoring boards as binary snapshots
+ * (see hdr/Snapshot.h for the format)
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Snapshot.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t round_up_8(uint64_t n);
+static bool planes_agree(const snapshot_header* header, const uint8_t* image);
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* snapshot_save
+ *
+ * Writes a snapshot of the board (snapshot_pack, then
+ * snapshot_write)
+ *
+ * Inputs:  board - board to save
+ *          path  - file to write
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool snapshot_save(Board* board, const char* path)
+{
+    std::vector<uint8_t> image;
+
+    snapshot_pack(board, &image);
+    return snapshot_write(image, path);
+}
+
+/* snapshot_pack
+ *
+ * Builds the whole snapshot image of a board in memory.
+ * It only copies the planes, so the board can go on
+ * changing while the image is written out (or looked at)
+ * elsewhere.
+ *
+ * Inputs:  board - board to save
+ * Outputs: image - replaced with the snapshot
+ * Returns: void
+ */
+void snapshot_pack(Board* board, std::vector<uint8_t>* image)
+{
+    snapshot_header header;
+    uint64_t n;
+
+    n = (uint64_t) board->get_rows() * board->get_columns();
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.header_size = sizeof(header);
+    header.rows = board->get_rows();
+    header.columns = board->get_columns();
+    header.mines = board->get_mines();
+    header.topology = board->get_topology();
+    header.seed = board->get_seed();
+    header.flags = (board->is_game_over() ? SNAPSHOT_GAME_OVER : 0) |
+                   (board->did_we_win() ? SNAPSHOT_GAME_WON : 0);
+    header.squares_revealed = board->get_squares_revealed();
+    header.mine_plane_offset = round_up_8(sizeof(header));
+    header.mine_plane_bytes = (n + 7) / 8;
+    header.state_plane_offset = header.mine_plane_offset +
+                                round_up_8(header.mine_plane_bytes);
+    header.state_plane_bytes = (n + 3) / 4;
+
+    image->assign(header.state_plane_offset +
+                  round_up_8(header.state_plane_bytes), 0);
+    memcpy(image->data(), &header, sizeof(header));
+    board->pack_mines(image->data() + header.mine_plane_offset);
+    board->pack_states(image->data() + header.state_plane_offset);
+}
+
+/* snapshot_write
+ *
+ * Writes a snapshot image.  It is handed to the kernel in
+ * a single write(), into a temporary file that is synced
+ * and then renamed over the target so a crash never leaves
+ * a torn snapshot.
+ *
+ * Inputs:  image - built by snapshot_pack
+ *          path  - file to write
+ * Outputs: (none)
+ * Returns: true on success
+ *          false otherwise
+ */
+bool snapshot_write(const std::vector<uint8_t>& image, const char* path)
+{
+    std::string temp_path;
+    ssize_t written;
+    uint64_t done;
+    int fd;
+    bool success;
+
+    temp_path = std::string(path) + ".tmp";
+    fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        PRINT_INFO("\nERROR: Cannot open %s: %s\n",
+                   temp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    /* One write for the whole image, only loop on short writes */
+    done = 0;
+    while (done < image.size())
+    {
+        written = write(fd, image.data() + done, image.size() - done);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        done += written;
+    }
+    success = (done == image.size());
+
+    /* The data must be on disk before the rename is */
+    if (success && (fsync(fd) != 0))
+    {
+        success = false;
+    }
+    if (close(fd) != 0)
+    {
+        success = false;
+    }
+    if (success && (rename(temp_path.c_str(), path) != 0))
+    {
+        success = false;
+    }
+    if (!success)
+    {
+        PRINT_INFO("\nERROR: Cannot write snapshot %s: %s\n",
+                   path, strerror(errno));
+        unlink(temp_path.c_str());
+    }
+    return success;
+}
+
+/* snapshot_load
+ *
+ * Maps a snapshot into memory and builds a board straight
+ * from its planes
+ *
+ * Inputs:  path - file to read
+ * Outputs: (none)
+ * Returns: new board (caller deletes), NULL on error
+ */
+Board* snapshot_load(const char* path)
+{
+    const uint8_t* image;
+    struct stat st;
+    Board* board;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if ( (fstat(fd, &st) != 0) ||
+         ((size_t) st.st_size < sizeof(snapshot_header))
+       )
+    {
+        PRINT_INFO("\nERROR: Snapshot %s is truncated\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    image = (const uint8_t*) mmap(NULL, st.st_size, PROT_READ,
+                                  MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        PRINT_INFO("\nERROR: Cannot map snapshot %s: %s\n",
+                   path, strerror(errno));
+        return NULL;
+    }
+    madvise((void*) image, st.st_size, MADV_SEQUENTIAL);
+
+    board = snapshot_board(image, st.st_size);
+    if (board == NULL)
+    {
+        PRINT_INFO("\nERROR: %s is not a valid snapshot\n", path);
+    }
+    munmap((void*) image, st.st_size);
+    return board;
+}
+
+/* snapshot_board
+ *
+ * Builds a board straight from the planes of a snapshot
+ * image in memory, after checking it
+ *
+ * Inputs:  image - the snapshot
+ *          bytes - its size
+ * Outputs: (none)
+ * Returns: new board (caller deletes), NULL if the image
+ *          is not a valid snapshot
+ */
+Board* snapshot_board(const uint8_t* image, size_t bytes)
+{
+    const snapshot_header* header = (const snapshot_header*) image;
+    uint64_t n;
+    Board* board;
+
+    if (bytes < sizeof(snapshot_header))
+    {
+        return NULL;
+    }
+    n = (uint64_t) header->rows * header->columns;
+    if ( (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) ||
+         (header->version != SNAPSHOT_VERSION) ||
+         (header->header_size != sizeof(snapshot_header)) ||
+         (header->rows < 1) || (header->columns < 1) ||
+         (n > INT_MAX) ||
+         (header->mines < 0) || ((uint64_t) header->mines > n) ||
+         (header->squares_revealed < 0) ||
+         ((uint64_t) header->squares_revealed > n - header->mines) ||
+         (header->topology >= NUM_TOPOLOGIES) ||
+         (header->mine_plane_bytes < (n + 7) / 8) ||
+         (header->state_plane_bytes < (n + 3) / 4) ||
+         (header->mine_plane_offset > (uint64_t) bytes) ||
+         (header->mine_plane_bytes >
+          (uint64_t) bytes - header->mine_plane_offset) ||
+         (header->state_plane_offset > (uint64_t) bytes) ||
+         (header->state_plane_bytes >
+          (uint64_t) bytes - header->state_plane_offset) ||
+         !planes_agree(header, image)
+       )
+    {
+        return NULL;
+    }
+
+    board = new Board(header->rows, header->columns, header->mines,
+                      (board_topology) header->topology, header->seed,
+                      image + header->mine_plane_offset);
+    board->restore_states(image + header->state_plane_offset,
+                          (int) header->squares_revealed,
+                          (header->flags & SNAPSHOT_GAME_OVER) != 0,
+                          (header->flags & SNAPSHOT_GAME_WON) != 0);
+    return board;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* round_up_8
+ *
+ * Rounds up to the next multiple of 8
+ */
+static uint64_t round_up_8(uint64_t n)
+{
+    return (n + 7) & ~((uint64_t) 7);
+}
+
+/* planes_agree
+ *
+ * Checks the planes against the header: as many mines as
+ * it says, no state outside square_state, and as many
+ * revealed safe squares as it says (the win test counts on
+ * both).  Call it once the planes are known to be in the
+ * file.
+ *
+ * Inputs:  header - checked header
+ *          image  - mapped file
+ * Outputs: (none)
+ * Returns: true if they agree
+ */
+static bool planes_agree(const snapshot_header* header, const uint8_t* image)
+{
+    const uint8_t* mine_plane = image + header->mine_plane_offset;
+    const uint8_t* state_plane = image + header->state_plane_offset;
+    uint64_t n = (uint64_t) header->rows * header->columns;
+    uint64_t i, mines = 0, revealed = 0;
+    int state, mine;
+
+    for (i = 0; i < n; i++)
+    {
+        mine = (mine_plane[i >> 3] >> (i & 7)) & 1;
+        state = (state_plane[i >> 2] >> ((i & 3) * 2)) & 3;
+        if (state > MARKED)
+        {
+            return false;
+        }
+        mines += mine;
+        revealed += ( (state == REVEALED) && !mine ) ? 1 : 0;
+    }
+    return (mines == (uint64_t) header->mines) &&
+           (revealed == (uint64_t) header->squares_revealed);
+}
@@ -0,0 +1,508 @@
+/* src/Spectate.cc
+ *
+ * Implementation of live views for spectators
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "Spectate.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static spectate_frame* new_frame(Board* board, int tile_rows,
+                                 int tile_columns);
+static spectate_page* new_page();
+static const spectate_tile* frame_tile(const spectate_frame* frame, int tile);
+static const spectate_tile** tile_slot(spectate_frame* frame, int tile);
+static void free_frame(void* item);
+static void free_page(void* item);
+static void free_tile(void* item);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Sets up a feed and publishes the board as it is.  The
+ * caller holds the one reference.
+ *
+ * Inputs:  board - board the feed shows
+ * Outputs: (none)
+ * Returns: SpectatorFeed struct
+ */
+SpectatorFeed::SpectatorFeed(Board* board)
+{
+    spectate_frame* frame;
+    int tile, page;
+
+    columns = board->get_columns();
+    tile_columns = ( (columns - 1) >> SPECTATE_TILE_SHIFT ) + 1;
+    frame = new_frame(board,
+                      ( (board->get_rows() - 1) >> SPECTATE_TILE_SHIFT ) + 1,
+                      tile_columns);
+    frame->version = 0;
+    for (page = 0; page < frame->num_pages; page++)
+    {
+        frame->pages[page] = new_page();
+    }
+    tile_marks.assign(frame->tile_rows * tile_columns, 0);
+    for (tile = 0; tile < frame->tile_rows * tile_columns; tile++)
+    {
+        build_tile(board, frame, tile);
+    }
+    dirty.assign(frame->tile_rows * tile_columns, 0);
+    page_dirty.assign(frame->num_pages, 0);
+    reclaimed = 0;
+    refs = 1;
+    latest = frame;
+}
+
+/* Destructor
+ *
+ * Frees the latest frame, its pages and tiles (the domain
+ * frees the retired ones).  Only release() deletes a feed.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+SpectatorFeed::~SpectatorFeed()
+{
+    spectate_frame* frame = latest.load();
+    int tile, page;
+
+    for (tile = 0; tile < frame->tile_rows * frame->tile_columns; tile++)
+    {
+        free_tile((void*) frame_tile(frame, tile));
+    }
+    for (page = 0; page < frame->num_pages; page++)
+    {
+        free_page((void*) frame->pages[page]);
+    }
+    free_frame(frame);
+}
+
+/* publish (board owner)
+ *
+ * Publishes the board as it is now.  Tiles touched since
+ * the last frame, and the pages they are in, are copied
+ * and the changed squares drawn again.  Tiles with marks
+ * in them are drawn again whole when the game ends or
+ * comes back from the end, since wrong marks show
+ * differently then.  Does nothing if nothing changed.
+ *
+ * Inputs:  board - the board the feed was made for
+ * Outputs: (none)
+ * Returns: void
+ */
+void SpectatorFeed::publish(Board* board)
+{
+    spectate_frame* old = latest.load(std::memory_order_relaxed);
+    spectate_frame* frame;
+    int tiles = old->tile_rows * old->tile_columns;
+    bool ended = (board->is_game_over() != old->game_over);
+    size_t i;
+    int tile, page;
+
+    if (dirty_tiles.empty() && !ended)
+    {
+        return;
+    }
+
+    frame = new_frame(board, old->tile_rows, old->tile_columns);
+    frame->version = old->version + 1;
+    memcpy(frame->pages, old->pages,
+           frame->num_pages * sizeof(frame->pages[0]));
+    if (ended)
+    {
+        for (tile = 0; tile < tiles; tile++)
+        {
+            if (tile_marks[tile] > 0)
+            {
+                if (!dirty[tile])
+                {
+                    dirty_tiles.push_back(tile);
+                }
+                dirty[tile] = 2;
+            }
+        }
+    }
+    for (i = 0; i < dirty_tiles.size(); i++)
+    {
+        page = dirty_tiles[i] >> SPECTATE_PAGE_SHIFT;
+        if (!page_dirty[page])
+        {
+            page_dirty[page] = 1;
+            dirty_pages.push_back(page);
+            copy_page(old, frame, page);
+        }
+    }
+    for (i = 0; i < dirty_tiles.size(); i++)
+    {
+        if (dirty[dirty_tiles[i]] == 2)
+        {
+            build_tile(board, frame, dirty_tiles[i]);
+        }
+        else
+        {
+            copy_tile(old, frame, dirty_tiles[i]);
+        }
+    }
+    for (i = 0; i < touched.size(); i++)
+    {
+        draw_square(board, frame, touched[i]);
+    }
+
+    /* Readers that start from here on see the new frame;
+     * what only the old one used goes once they all have */
+    latest.store(frame);
+    epochs.advance();
+    epochs.retire(old, free_frame);
+    for (i = 0; i < dirty_tiles.size(); i++)
+    {
+        epochs.retire((void*) frame_tile(old, dirty_tiles[i]), free_tile);
+        dirty[dirty_tiles[i]] = 0;
+    }
+    for (i = 0; i < dirty_pages.size(); i++)
+    {
+        epochs.retire((void*) old->pages[dirty_pages[i]], free_page);
+        page_dirty[dirty_pages[i]] = 0;
+    }
+    dirty_tiles.clear();
+    dirty_pages.clear();
+    touched.clear();
+    reclaimed += epochs.reclaim();
+}
+
+/* get_reclaimed / get_pending (board owner)
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: frames and tiles freed so far / still waiting
+ *          for readers
+ */
+uint64_t SpectatorFeed::get_reclaimed()
+{
+    return reclaimed;
+}
+
+size_t SpectatorFeed::get_pending()
+{
+    return epochs.get_pending();
+}
+
+/* retain / release
+ *
+ * Takes or drops a reference.  The last release frees the
+ * feed.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void SpectatorFeed::retain()
+{
+    refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SpectatorFeed::release()
+{
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        delete this;
+    }
+}
+
+/* join / leave (readers)
+ *
+ * Takes or gives back a reader slot (see EpochDomain)
+ *
+ * Inputs:  reader - slot from join
+ * Outputs: (none)
+ * Returns: join: the slot, -1 if there are too many readers
+ */
+int SpectatorFeed::join()
+{
+    return epochs.join();
+}
+
+void SpectatorFeed::leave(int reader)
+{
+    epochs.leave(reader);
+}
+
+/* enter / exit (readers)
+ *
+ * Brackets a look at the latest frame.  The frame stays
+ * valid until exit, however many moves are made meanwhile.
+ *
+ * Inputs:  reader - slot from join
+ * Outputs: (none)
+ * Returns: enter: the latest frame
+ */
+const spectate_frame* SpectatorFeed::enter(int reader)
+{
+    epochs.enter(reader);
+    return latest.load();
+}
+
+void SpectatorFeed::exit(int reader)
+{
+    epochs.exit(reader);
+}
+
+/* build_tile (board owner)
+ *
+ * Draws one tile of a frame that is not published yet,
+ * on a page the frame has its own copy of
+ *
+ * Inputs:  board - the board
+ *          tile  - which tile
+ * Outputs: frame - gets the new tile
+ * Returns: void
+ */
+void SpectatorFeed::build_tile(Board* board, spectate_frame* frame, int tile)
+{
+    spectate_tile* out = (spectate_tile*) malloc(sizeof(spectate_tile));
+    int top = (tile / frame->tile_columns) << SPECTATE_TILE_SHIFT;
+    int left = (tile % frame->tile_columns) << SPECTATE_TILE_SHIFT;
+    int row, column, marks = 0;
+    char* square = out->squares;
+
+    mem_note_alloc(MEM_RENDER, sizeof(spectate_tile));
+    for (row = top; row < top + SPECTATE_TILE_SIDE; row++)
+    {
+        for (column = left; column < left + SPECTATE_TILE_SIDE; column++)
+        {
+            *square = ( (row < frame->rows) && (column < frame->columns) )
+                      ? board->square_char(row, column) : ' ';
+            marks += ( (*square == 'm') || (*square == 'x') ) ? 1 : 0;
+            square++;
+        }
+    }
+    *tile_slot(frame, tile) = out;
+    tile_marks[tile] = marks;
+}
+
+/* copy_tile (board owner)
+ *
+ * Gives a frame that is not published yet its own copy of
+ * a tile, to draw changes on.  The frame must have its own
+ * copy of the tile's page already.
+ *
+ * Inputs:  old   - frame the tile comes from
+ *          tile  - which tile
+ * Outputs: frame - gets the copy
+ * Returns: void
+ */
+void SpectatorFeed::copy_tile(const spectate_frame* old,
+                              spectate_frame* frame, int tile)
+{
+    spectate_tile* out = (spectate_tile*) malloc(sizeof(spectate_tile));
+
+    mem_note_alloc(MEM_RENDER, sizeof(spectate_tile));
+    memcpy(out, frame_tile(old, tile), sizeof(spectate_tile));
+    *tile_slot(frame, tile) = out;
+}
+
+/* copy_page (board owner)
+ *
+ * Gives a frame that is not published yet its own copy of
+ * a page, to put new tiles in
+ *
+ * Inputs:  old   - frame the page comes from
+ *          page  - which page
+ * Outputs: frame - gets the copy
+ * Returns: void
+ */
+void SpectatorFeed::copy_page(const spectate_frame* old,
+                              spectate_frame* frame, int page)
+{
+    spectate_page* out = new_page();
+
+    memcpy(out, old->pages[page], sizeof(spectate_page));
+    frame->pages[page] = out;
+}
+
+/* draw_square (board owner)
+ *
+ * Draws a square again, on a tile the frame has its own
+ * copy of
+ *
+ * Inputs:  board - the board
+ *          index - square (row-major)
+ * Outputs: frame - square drawn
+ * Returns: void
+ */
+void SpectatorFeed::draw_square(Board* board, spectate_frame* frame,
+                                int index)
+{
+    int row = index / columns, column = index % columns;
+    int tile = (row >> SPECTATE_TILE_SHIFT) * tile_columns +
+               (column >> SPECTATE_TILE_SHIFT);
+    char* square = &( (spectate_tile*) frame_tile(frame, tile) )->squares[
+                      ( (row & (SPECTATE_TILE_SIDE - 1)) <<
+                        SPECTATE_TILE_SHIFT ) +
+                      (column & (SPECTATE_TILE_SIDE - 1)) ];
+
+    tile_marks[tile] -= ( (*square == 'm') || (*square == 'x') ) ? 1 : 0;
+    *square = board->square_char(row, column);
+    tile_marks[tile] += ( (*square == 'm') || (*square == 'x') ) ? 1 : 0;
+}
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* spectate_square
+ *
+ * Inputs:  frame       - a frame, inside enter/exit
+ *          row, column - square (0 based)
+ * Outputs: (none)
+ * Returns: the square as Board::square_char drew it
+ */
+char spectate_square(const spectate_frame* frame, int row, int column)
+{
+    const spectate_tile* tile =
+        frame_tile(frame, (row >> SPECTATE_TILE_SHIFT) * frame->tile_columns +
+                          (column >> SPECTATE_TILE_SHIFT));
+
+    return tile->squares[ ( (row & (SPECTATE_TILE_SIDE - 1)) <<
+                            SPECTATE_TILE_SHIFT ) +
+                          (column & (SPECTATE_TILE_SIDE - 1)) ];
+}
+
+/* spectate_text
+ *
+ * Draws a frame the way the server's BOARD command does,
+ * one line per row
+ *
+ * Inputs:  frame - a frame, inside enter/exit
+ * Outputs: text  - the rows are appended
+ * Returns: void
+ */
+void spectate_text(const spectate_frame* frame, std::string* text)
+{
+    int row, column;
+
+    for (row = 0; row < frame->rows; row++)
+    {
+        for (column = 0; column < frame->columns; column++)
+        {
+            text->push_back(spectate_square(frame, row, column));
+        }
+        text->push_back('\n');
+    }
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* new_frame
+ *
+ * Allocates a frame with room for its page table, and
+ * fills in everything but the version and the pages
+ *
+ * Inputs:  board                   - board it shows
+ *          tile_rows, tile_columns - tile table size
+ * Outputs: (none)
+ * Returns: the frame
+ */
+static spectate_frame* new_frame(Board* board, int tile_rows,
+                                 int tile_columns)
+{
+    int num_pages = ( tile_rows * tile_columns + SPECTATE_PAGE_TILES - 1 ) >>
+                    SPECTATE_PAGE_SHIFT;
+    size_t bytes = sizeof(spectate_frame) +
+                   num_pages * sizeof(spectate_page*);
+    spectate_frame* frame = (spectate_frame*) malloc(bytes);
+
+    mem_note_alloc(MEM_RENDER, bytes);
+    frame->rows = board->get_rows();
+    frame->columns = board->get_columns();
+    frame->tile_rows = tile_rows;
+    frame->tile_columns = tile_columns;
+    frame->num_pages = num_pages;
+    frame->squares_revealed = board->get_squares_revealed();
+    frame->game_over = board->is_game_over();
+    frame->game_won = frame->game_over && board->did_we_win();
+    frame->pages = (const spectate_page**) (frame + 1);
+    return frame;
+}
+
+/* new_page
+ *
+ * Allocates a page with no tiles in it
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: the page
+ */
+static spectate_page* new_page()
+{
+    spectate_page* page = (spectate_page*) calloc(1, sizeof(spectate_page));
+
+    mem_note_alloc(MEM_RENDER, sizeof(spectate_page));
+    return page;
+}
+
+/* frame_tile / tile_slot
+ *
+ * A tile of a frame, looked up through its page.  Only the
+ * board owner writes through tile_slot, and only on pages
+ * of an unpublished frame that it has its own copy of.
+ *
+ * Inputs:  frame - the frame
+ *          tile  - which tile
+ * Outputs: (none)
+ * Returns: the tile / where the page keeps it
+ */
+static const spectate_tile* frame_tile(const spectate_frame* frame, int tile)
+{
+    return frame->pages[tile >> SPECTATE_PAGE_SHIFT]->tiles[
+               tile & (SPECTATE_PAGE_TILES - 1) ];
+}
+
+static const spectate_tile** tile_slot(spectate_frame* frame, int tile)
+{
+    return &( (spectate_page*) frame->pages[tile >> SPECTATE_PAGE_SHIFT] )->
+               tiles[ tile & (SPECTATE_PAGE_TILES - 1) ];
+}
+
+/* free_frame / free_page / free_tile
+ *
+ * Release functions for the epoch domain
+ *
+ * Inputs:  item - a frame (not its pages) / a page (not
+ *                 its tiles) / a tile
+ * Outputs: (none)
+ * Returns: void
+ */
+static void free_frame(void* item)
+{
+    spectate_frame* frame = (spectate_frame*) item;
+
+    mem_note_free(MEM_RENDER, sizeof(spectate_frame) +
+                              frame->num_pages * sizeof(spectate_page*));
+    free(frame);
+}
+
+static void free_page(void* item)
+{
+    mem_note_free(MEM_RENDER, sizeof(spectate_page));
+    free(item);
+}
+
+static void free_tile(void* item)
+{
+    mem_note_free(MEM_RENDER, sizeof(spectate_tile));
+    free(item);
+}
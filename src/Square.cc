@@ -110,108 +110,45 @@ square_state Square::get_state()
     return state;
 }
 
-/* set_top
+/* set_state
  * 
- * Sets the top neighbor
+ * Forces the state of the square, without cascading.
+ * Used when restoring a saved board
  *
- * Inputs:  s - Pointer to square on top
+ * Inputs:  s - new state
  * Outputs: (none)
  * Returns: void
  */
-void Square::set_top( Square* s )
+void Square::set_state( square_state s )
 {
-    neighbors[TOP] = s;
+    state = s;
 }
 
-/* set_bottom
+/* set_neighbor
  * 
- * Sets the bottom neighbor
+ * Sets the neighbor in one of the neighbor slots
  *
- * Inputs:  s - Pointer to square on bottom
+ * Inputs:  direction - slot (see neighbor_directions in hdr/common.h)
+ *          s         - Pointer to neighboring square
  * Outputs: (none)
  * Returns: void
  */
-void Square::set_bottom( Square* s )
+void Square::set_neighbor( int direction, Square* s )
 {
-    neighbors[BOTTOM] = s;
+    neighbors[direction] = s;
 }
 
-/* set_left
+/* get_neighbor
  * 
- * Sets the left neighbor
+ * Returns the neighbor in one of the neighbor slots
  *
- * Inputs:  s - Pointer to square to left
+ * Inputs:  direction - slot (see neighbor_directions in hdr/common.h)
  * Outputs: (none)
- * Returns: void
- */
-void Square::set_left( Square* s )
-{
-    neighbors[LEFT] = s;
-}
-
-/* set_right
- * 
- * Sets the right neighbor
- *
- * Inputs:  s - Pointer to square to right
- * Outputs: (none)
- * Returns: void
- */
-void Square::set_right( Square* s )
-{
-    neighbors[RIGHT] = s;
-}
-
-/* set_top_left
- * 
- * Sets the top-left neighbor
- *
- * Inputs:  s - Pointer to square on top-left
- * Outputs: (none)
- * Returns: void
+ * Returns: Pointer to neighboring square, NULL if there is none
  */
-void Square::set_top_left( Square* s )
+Square* Square::get_neighbor( int direction )
 {
-    neighbors[TOP_LEFT] = s;
-}
-
-/* set_top_right
- * 
- * Sets the top-right neighbor
- *
- * Inputs:  s - Pointer to square on top-right
- * Outputs: (none)
- * Returns: void
- */
-void Square::set_top_right( Square* s )
-{
-    neighbors[TOP_RIGHT] = s;
-}
-
-/* set_bottom_left
- * 
- * Sets the bottom-left neighbor
- *
- * Inputs:  s - Pointer to square on bottom-left
- * Outputs: (none)
- * Returns: void
- */
-void Square::set_bottom_left( Square* s )
-{
-    neighbors[BOTTOM_LEFT] = s;
-}
-
-/* set_bottom_right
- * 
- * Sets the bottom-right neighbor
- *
- * Inputs:  s - Pointer to square on bottom-right
- * Outputs: (none)
- * Returns: void
- */
-void Square::set_bottom_right( Square* s )
-{
-    neighbors[BOTTOM_RIGHT] = s;
+    return neighbors[direction];
 }
 
 /* get_neighbor_mines
@@ -278,86 +215,6 @@ void Square::mark()
     state = MARKED;
 }
 
-/* reveal
- * 
- * Reveals the square
- * Calls private recursive function
- *
- * Inputs:  (none)
- * Outputs: (none)
- * Returns: Number of revealed squares
- */
-int Square::reveal()
-{
-    return this->reveal_recurse(0);
-}
-
-/* reveal_recurse
- * 
- * Private function for recursively revealing
- * squares when there are 0 neighboring mines
- *
- * Inputs:  num_revealed - number of squares already revealed
- * Outputs: (none)
- * Returns: number of squares revealed
- */
-int Square::reveal_recurse(int num_revealed)
-{
-    int i;
-    
-    /* Just return if already revealed */
-    if (state == REVEALED)
-    {
-        DEBUG_INFO("%d.%d) Already revealed!\n",
-                    my_row, my_column
-                  );
-        return 0;
-    }
-    
-    /* Change state */
-    state = REVEALED;
-    
-    /* It's a mine!  Oh no! */
-    if (mine)
-    {
-        /* Oh no! */
-        DEBUG_INFO("%d.%d) revealed a mine!\n",
-                    my_row, my_column
-                  );
-        return 0;
-    }
-    
-    /* I have neighbors ... return just myself */
-    if (num_neighbor_mines != 0)
-    {
-        DEBUG_INFO("%d.%d) has %d neighbor mines\n", 
-                    my_row, my_column,
-                    num_neighbor_mines
-                  );
-        return 1;
-    }
-    
-    DEBUG_INFO("%d.%d) 0 neighbor mines\n",
-                my_row, my_column
-              );
-    num_revealed = 1;
-    /* There are no neighboring mines */
-    /* Recurively reveal the rest */
-    for (i = 0; i < NUM_NEIGHBORS; i++)
-    {
-        if ( neighbors[i] != NULL )
-        {        
-            num_revealed += neighbors[i]->reveal();
-        }
-    }
-
-    DEBUG_INFO("%d.%d) revealed %d\n", 
-                my_row, my_column,
-                num_revealed
-              );
-    return num_revealed;    
-}
-
 #ifdef DEBUG_PRINTS
 /* set_rows
  * 
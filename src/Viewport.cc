@@ -0,0 +1,534 @@
+/* src/Viewport.cc
+ *
+ * Implementation of the window onto a large board
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "Viewport.h"
+
+/******************************************************
+                        DEFINES
+*******************************************************/
+/* Minimap shades, from nothing revealed to all revealed */
+#define MINIMAP_RAMP        ".:-=+*#%"
+#define MINIMAP_RAMP_LEN    ( (int) sizeof(MINIMAP_RAMP) - 1 )
+
+/* Minimap cells the window currently covers */
+#define MINIMAP_VIEW        '@'
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static int digits(int value);
+static void draw_header(const view_frame* frame, std::string* text);
+static void draw_row(const view_frame* frame, int line, std::string* text);
+
+/******************************************************
+             CLASS FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* Constructor
+ *
+ * Sets up a window at the top left of a board, sized
+ * for the current terminal
+ *
+ * Inputs:  _board - board to look at
+ * Outputs: (none)
+ * Returns: Viewport struct
+ */
+Viewport::Viewport(Board* _board)
+{
+    board = _board;
+    top = 0;
+    left = 0;
+    messages = NULL;
+    fit_terminal();
+}
+
+/* fit_terminal
+ *
+ * Resizes the window to the terminal's current size
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::fit_terminal()
+{
+    struct winsize size;
+
+    if ( (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) &&
+         (size.ws_row > 0) && (size.ws_col > 0)
+       )
+    {
+        resize(size.ws_row, size.ws_col);
+    }
+    else
+    {
+        resize(VIEWPORT_DEFAULT_ROWS, VIEWPORT_DEFAULT_COLUMNS);
+    }
+}
+
+/* resize
+ *
+ * Resizes the window for a terminal of the given size
+ *
+ * Inputs:  _term_rows    - lines in the terminal
+ *          _term_columns - characters per line
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::resize(int _term_rows, int _term_columns)
+{
+    term_rows = _term_rows;
+    term_columns = _term_columns;
+    layout();
+}
+
+/* scroll
+ *
+ * Moves the window, stopping at the edges of the board
+ *
+ * Inputs:  d_rows, d_columns - squares to move by
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::scroll(int d_rows, int d_columns)
+{
+    top += d_rows;
+    left += d_columns;
+    clamp();
+}
+
+/* jump
+ *
+ * Centers the window on a square, as far as the edges
+ * of the board allow
+ *
+ * Inputs:  row, column - square to center on (0 based)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::jump(int row, int column)
+{
+    top = row - view_rows / 2;
+    left = column - view_columns / 2;
+    clamp();
+}
+
+/* set_messages
+ *
+ * Collects navigation errors in a string instead of
+ * printing them (see Board::set_messages)
+ *
+ * Inputs:  out - string to append to, NULL to print again
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::set_messages(std::string* out)
+{
+    messages = out;
+}
+
+/* parse_input
+ *
+ * Handles navigation input (see hdr/Viewport.h).
+ * Anything else is left for Board::parse_input.
+ *
+ * Inputs:  user_input - what the player typed
+ * Outputs: (none)
+ * Returns: true if the input was navigation
+ *          false otherwise
+ */
+bool Viewport::parse_input(std::string user_input)
+{
+    size_t i;
+    int row, column;
+    char c;
+
+    if (user_input.empty())
+    {
+        return false;
+    }
+
+    if (user_input.find_first_not_of("WwAaSsDd") == std::string::npos)
+    {
+        for (i = 0; i < user_input.length(); i++)
+        {
+            c = user_input.at(i);
+            switch (c)
+            {
+            case 'W': case 'w': scroll(-(view_rows + 1) / 2, 0);    break;
+            case 'S': case 's': scroll((view_rows + 1) / 2, 0);     break;
+            case 'A': case 'a': scroll(0, -(view_columns + 1) / 2); break;
+            default:            scroll(0, (view_columns + 1) / 2);  break;
+            }
+        }
+        return true;
+    }
+
+    c = user_input.at(0);
+    if ( (c == 'G') || (c == 'g') )
+    {
+        if ( (sscanf(user_input.c_str() + 1, "(%d,%d)", &row, &column) != 2) ||
+             (row < 1) || (row > board->get_rows()) ||
+             (column < 1) || (column > board->get_columns())
+           )
+        {
+            if (messages != NULL)
+            {
+                messages->append("\nERROR: Invalid square to go to!\n\n");
+            }
+            else
+            {
+                PRINT_ERROR("Invalid square to go to!\n");
+            }
+        }
+        else
+        {
+            jump(row - 1, column - 1);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/* render
+ *
+ * Captures the window and draws it in one write.  Work is
+ * proportional to the window, not the board.
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::render()
+{
+    capture(&snapshot);
+    frame_text(&snapshot, &text);
+    PRINT_INFO("%s", text.c_str());
+}
+
+/* capture
+ *
+ * Copies what the window shows into a frame, so it can be
+ * drawn later (or on another thread) without touching
+ * the board
+ *
+ * Inputs:  (none)
+ * Outputs: frame - filled in, buffers reused
+ * Returns: void
+ */
+void Viewport::capture(view_frame* frame)
+{
+    int line, j;
+
+    fit_terminal();
+
+    frame->top = top;
+    frame->left = left;
+    frame->view_rows = view_rows;
+    frame->view_columns = view_columns;
+    frame->board_rows = board->get_rows();
+    frame->board_columns = board->get_columns();
+    frame->label_width = label_width;
+    frame->cell_width = cell_width;
+    frame->max_indent = board->row_indent(1) * (cell_width / 2);
+    frame->map_rows = map_rows;
+    frame->map_columns = map_columns;
+    frame->last = false;
+
+    frame->squares.resize(view_rows * view_columns);
+    frame->indents.resize(view_rows);
+    for (line = 0; line < view_rows; line++)
+    {
+        frame->indents[line] = board->row_indent(top + line) * (cell_width / 2);
+        for (j = 0; j < view_columns; j++)
+        {
+            frame->squares[line * view_columns + j] =
+                board->square_char(top + line, left + j);
+        }
+    }
+
+    board->set_overview(map_rows, map_columns);
+    frame->minimap.resize(map_rows * map_columns);
+    for (line = 0; line < map_rows; line++)
+    {
+        for (j = 0; j < map_columns; j++)
+        {
+            frame->minimap[line * map_columns + j] = minimap_char(line, j);
+        }
+    }
+}
+
+/* get_top / get_left
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: first row / column in the window (0 based)
+ */
+int Viewport::get_top()
+{
+    return top;
+}
+
+int Viewport::get_left()
+{
+    return left;
+}
+
+/* get_view_rows / get_view_columns
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: size of the window in squares
+ */
+int Viewport::get_view_rows()
+{
+    return view_rows;
+}
+
+int Viewport::get_view_columns()
+{
+    return view_columns;
+}
+
+/* layout
+ *
+ * Works out how many squares fit in the terminal, and
+ * whether a minimap is needed
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::layout()
+{
+    int rows = board->get_rows();
+    int columns = board->get_columns();
+    int indent, available;
+
+    label_width = digits(rows) > 2 ? digits(rows) : 2;
+    cell_width = digits(columns) + 1 > 3 ? digits(columns) + 1 : 3;
+    indent = board->row_indent(1) * (cell_width / 2);
+
+    view_rows = term_rows - VIEWPORT_RESERVED_ROWS;
+    view_rows = view_rows < 1 ? 1 : (view_rows > rows ? rows : view_rows);
+
+    available = term_columns - (label_width + 3) - indent;
+    view_columns = available / cell_width;
+
+    map_rows = 0;
+    map_columns = 0;
+    if ( (view_rows < rows) || (view_columns < columns) )
+    {
+        /* Make room for the minimap (and its borders) on the right */
+        map_columns = board->get_block_columns();
+        if (map_columns > MINIMAP_MAX_COLUMNS)
+        {
+            map_columns = MINIMAP_MAX_COLUMNS;
+        }
+        map_rows = board->get_block_rows();
+        if (map_rows > view_rows)
+        {
+            map_rows = view_rows;
+        }
+        view_columns = (available - map_columns - 2) / cell_width;
+    }
+    view_columns = view_columns < 1 ? 1 :
+                   (view_columns > columns ? columns : view_columns);
+
+    clamp();
+}
+
+/* clamp
+ *
+ * Keeps the window on the board
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+void Viewport::clamp()
+{
+    int max_top = board->get_rows() - view_rows;
+    int max_left = board->get_columns() - view_columns;
+
+    top = top > max_top ? max_top : top;
+    top = top < 0 ? 0 : top;
+    left = left > max_left ? max_left : left;
+    left = left < 0 ? 0 : left;
+}
+
+/* minimap_char
+ *
+ * Shade of one minimap cell.  Each cell covers a range of
+ * the board's overview blocks, whose revealed total the
+ * board keeps per cell (see Board::set_overview), so a
+ * cell costs one lookup.
+ *
+ * Inputs:  map_row, map_column - minimap cell
+ * Outputs: (none)
+ * Returns: MINIMAP_VIEW if the window covers the cell,
+ *          otherwise a shade from MINIMAP_RAMP
+ */
+char Viewport::minimap_char(int map_row, int map_column)
+{
+    int block_rows = board->get_block_rows();
+    int block_columns = board->get_block_columns();
+    int b_top = map_row * block_rows / map_rows;
+    int b_bottom = (map_row + 1) * block_rows / map_rows;
+    int b_left = map_column * block_columns / map_columns;
+    int b_right = (map_column + 1) * block_columns / map_columns;
+    int s_top = b_top << BOARD_BLOCK_SHIFT;
+    int s_bottom = b_bottom << BOARD_BLOCK_SHIFT;
+    int s_left = b_left << BOARD_BLOCK_SHIFT;
+    int s_right = b_right << BOARD_BLOCK_SHIFT;
+    int revealed, squares;
+
+    s_bottom = s_bottom > board->get_rows() ? board->get_rows() : s_bottom;
+    s_right = s_right > board->get_columns() ? board->get_columns() : s_right;
+
+    if ( (s_top < top + view_rows) && (top < s_bottom) &&
+         (s_left < left + view_columns) && (left < s_right)
+       )
+    {
+        return MINIMAP_VIEW;
+    }
+
+    revealed = board->get_overview_revealed(map_row, map_column);
+    if (revealed == 0)
+    {
+        return MINIMAP_RAMP[0];
+    }
+    squares = (s_bottom - s_top) * (s_right - s_left);
+    return MINIMAP_RAMP[1 + revealed * (MINIMAP_RAMP_LEN - 2) / squares];
+}
+
+/******************************************************
+                 FUNCTION IMPLEMENTATION
+*******************************************************/
+
+/* frame_text
+ *
+ * Turns a captured frame into text for the terminal
+ *
+ * Inputs:  frame - captured by Viewport::capture
+ * Outputs: text  - replaced with the frame's text
+ * Returns: void
+ */
+void frame_text(const view_frame* frame, std::string* text)
+{
+    int line;
+    char status[160];
+
+    text->clear();
+    draw_header(frame, text);
+    for (line = 0; line < frame->view_rows; line++)
+    {
+        draw_row(frame, line, text);
+    }
+
+    if (frame->map_rows > 0)
+    {
+        snprintf(status, sizeof(status),
+                 "Rows %d-%d of %d, columns %d-%d of %d.  "
+                 "W/A/S/D scroll, G(row,column) jumps\n",
+                 frame->top + 1, frame->top + frame->view_rows,
+                 frame->board_rows, frame->left + 1,
+                 frame->left + frame->view_columns, frame->board_columns);
+        *text += status;
+    }
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* draw_header
+ *
+ * Adds the column numbers to the text
+ *
+ * Inputs:  frame - frame being drawn
+ * Outputs: text  - appended to
+ * Returns: void
+ */
+static void draw_header(const view_frame* frame, std::string* text)
+{
+    int j;
+    char number[16];
+
+    /* Last digit lines up with the squares below */
+    text->append(frame->label_width + 5 - frame->cell_width, ' ');
+    for (j = frame->left; j < frame->left + frame->view_columns; j++)
+    {
+        snprintf(number, sizeof(number), "%*d ", frame->cell_width - 1, j + 1);
+        *text += number;
+    }
+    *text += "\n\n";
+}
+
+/* draw_row
+ *
+ * Adds one row of the window to the text, followed by
+ * the matching minimap line
+ *
+ * Inputs:  frame - frame being drawn
+ *          line  - line of the window (0 based)
+ * Outputs: text  - appended to
+ * Returns: void
+ */
+static void draw_row(const view_frame* frame, int line, std::string* text)
+{
+    const char* squares = &frame->squares[line * frame->view_columns];
+    int j;
+    char label[16];
+
+    snprintf(label, sizeof(label), "%*d   ", frame->label_width,
+             frame->top + line + 1);
+    *text += label;
+    text->append(frame->indents[line], ' ');
+    for (j = 0; j < frame->view_columns; j++)
+    {
+        *text += squares[j];
+        text->append(frame->cell_width - 1, ' ');
+    }
+
+    if (line < frame->map_rows)
+    {
+        /* Line the minimap up past the widest (indented) row */
+        text->append(frame->max_indent - frame->indents[line], ' ');
+        *text += '|';
+        text->append(&frame->minimap[line * frame->map_columns],
+                     frame->map_columns);
+        *text += '|';
+    }
+    *text += '\n';
+}
+
+/* digits
+ *
+ * Inputs:  value - positive number
+ * Outputs: (none)
+ * Returns: number of decimal digits in value
+ */
+static int digits(int value)
+{
+    int count = 1;
+
+    while (value >= 10)
+    {
+        value /= 10;
+        count++;
+    }
+    return count;
+}
@@ -4,16 +4,153 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <time.h>
+#include <unistd.h>
 
 #include "Board.h"
+#include "Snapshot.h"
+#include "EventLog.h"
+#include "Viewport.h"
+#include "GameLoop.h"
 
-int main ()
+/******************************************************
+                        DEFINES
+*******************************************************/
+/* Largest custom board side, bigger boards are shown
+ * through a scrolling viewport */
+#define MAX_BOARD_SIDE  1000
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static Board* choose_board();
+static void report_memory();
+
+/******************************************************
+                         MAIN
+*******************************************************/
+
+/* main
+ * 
+ * Usage: minesweeper [-l event_log] [-M] [snapshot_file]
+ * If a snapshot file is given, the game in it is resumed
+ * (or a new one started if it does not exist yet) and the
+ * game is saved back to it as it is played.
+ * With -l, the game's events are logged in binary form
+ * (read them back with bin/log_reader).
+ * With -M, memory use is counted and reported at the end.
+ */
+int main (int argc, char** argv)
 {
     bool game_over = false;
+    struct Board *board = NULL;
+    const char* snapshot_path = NULL;
+    const char* log_path = NULL;
+    EventLog event_log;
+    int opt;
+    
+    while ( (opt = getopt(argc, argv, "l:M")) != -1 )
+    {
+        if (opt == 'l')
+        {
+            log_path = optarg;
+        }
+        else if (opt == 'M')
+        {
+            mem_enable(true);
+        }
+        else
+        {
+            PRINT_INFO("Usage: %s [-l event_log] [-M] [snapshot_file]\n",
+                       argv[0]);
+            return 1;
+        }
+    }
+    
+    if (optind < argc)
+    {
+        snapshot_path = argv[optind];
+        board = snapshot_load(snapshot_path);
+        if (board != NULL)
+        {
+            PRINT_INFO("Resumed %s board %dx%d with %d mines from %s\n",
+                       topology_name(board->get_topology()),
+                       board->get_rows(), board->get_columns(),
+                       board->get_mines(), snapshot_path);
+            game_over = board->is_game_over();
+        }
+    }
+    
+    if (board == NULL)
+    {
+        board = choose_board();
+    }
+    
+    if ( (log_path != NULL) && event_log.open(log_path) )
+    {
+        board->set_event_log(&event_log, 0);
+    }
+    
+    Viewport viewport(board);
+    
+    PRINT_INFO("\n\nINSTRUCTIONS\n");
+    PRINT_INFO("(row,column) makes a move on a spot.  M(row," \
+               "column) will mark a spot as a mine\n");
+    PRINT_INFO("U(row,column) takes a mark off, C(row,column) reveals " \
+               "around a number that has all its mines marked\n");
+    PRINT_INFO("Moves can also be comma separated if you want " \
+               "to make multiple moves at a time\n");
+    PRINT_INFO("Z undoes the last move, Y redoes it\n");
+    PRINT_INFO("H asks for a hint once only a few squares are " \
+               "left in doubt\n");
+    PRINT_INFO("On big boards W/A/S/D scroll the view and " \
+               "G(row,column) centers it on a spot\n\n");
+  
+    GameLoop game_loop(board, &viewport, snapshot_path);
+    if ( !game_over && !game_loop.run() )
+    {
+        /* Input closed, leave the game as it is */
+        PRINT_INFO("\n");
+        report_memory();
+        return 0;
+    }
+    if (game_over)
+    {
+        /* Resumed a finished game, just show it */
+        viewport.render();
+    }
+    
+    if (board->did_we_win())
+    {
+        PRINT_INFO("Congratulations, you won!  :D\n");
+    }
+    else
+    {
+        PRINT_INFO("Sorry, you lost :'(\n");
+    }
+    report_memory();
+  
+    return 0;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* choose_board
+ * 
+ * Runs the menus for picking a new board
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: new board
+ */
+static Board* choose_board()
+{
     bool selection_valid = false;
-    int board_select, rows, cols, mines;
+    int board_select, rows = 0, cols = 0, mines = 0;
+    board_topology topology;
     std::string user_input;
-    struct Board *board;
     int temp;
     
     while (!selection_valid)
@@ -63,10 +200,10 @@ int main ()
         selection_valid = false;
         while (!selection_valid)
         {
-            PRINT_INFO("Enter number of rows (min 1, max 25): ");
+            PRINT_INFO("Enter number of rows (min 1, max %d): ", MAX_BOARD_SIDE);
             std::cin >> user_input;
             rows = atoi(user_input.c_str());
-            if ( (rows < 1) || (rows > 25) )
+            if ( (rows < 1) || (rows > MAX_BOARD_SIDE) )
             {
                 PRINT_ERROR("Invalid number of rows!  Try again!\n");
             }
@@ -79,10 +216,10 @@ int main ()
         selection_valid = false;
         while (!selection_valid)
         {
-            PRINT_INFO("Enter number of columns (min 1, max 25): ");
+            PRINT_INFO("Enter number of columns (min 1, max %d): ", MAX_BOARD_SIDE);
             std::cin >> user_input;
             cols = atoi(user_input.c_str());
-            if ( (cols < 1) || (rows > 25) )
+            if ( (cols < 1) || (cols > MAX_BOARD_SIDE) )
             {
                 PRINT_ERROR("Invalid number of columns!  Try again!\n");
             }
@@ -111,34 +248,49 @@ int main ()
         break;
     }
     
-    PRINT_INFO("Your board is %dx%d and has %d mines.\n", rows, cols, mines);
-    
-    board = new Board(rows, cols, mines);
-    
-    PRINT_INFO("\n\nINSTRUCTIONS\n");
-    PRINT_INFO("(row,column) makes a move on a spot.  M(row," \
-               "column) will mark a spot as a mine\n");
-    PRINT_INFO("Moves can also be comma separated if you want " \
-               "to make multiple moves at a time\n\n"
-              );
-  
-    while (!game_over)
+    selection_valid = false;
+    while (!selection_valid)
     {
-        board->print_board();
-        PRINT_INFO("Move: ");
+        PRINT_INFO("Select a board shape (Enter number only):\n" \
+                   "1) Square (8 neighbors)\n" \
+                   "2) Torus  (8 neighbors, edges wrap around)\n" \
+                   "3) Hex    (6 neighbors, odd rows shifted right)\n"
+                  );
+        PRINT_INFO("Enter your selection: ");
         std::cin >> user_input;
-        game_over = board->parse_input(user_input);
+        temp = atoi(user_input.c_str());
+        if ( (temp < 1) || (temp > NUM_TOPOLOGIES) )
+        {
+            PRINT_ERROR("Invalid board shape!\n");
+        }
+        else
+        {
+            topology = (board_topology) (temp - 1);
+            selection_valid = true;
+        }
     }
     
-    board->print_board();
-    if (board->did_we_win())
-    {
-        PRINT_INFO("Congratulations, you won!  :D\n");
-    }
-    else
+    PRINT_INFO("Your %s board is %dx%d and has %d mines.\n", 
+               topology_name(topology), rows, cols, mines);
+    
+    return new Board(rows, cols, mines, topology, (unsigned int) time(NULL));
+}
+
+/* report_memory
+ * 
+ * Prints memory use by subsystem, if it was counted (-M)
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: void
+ */
+static void report_memory()
+{
+    std::string memory;
+    
+    if (mem_enabled())
     {
-        PRINT_INFO("Sorry, you lost :'(\n");
+        mem_report(&memory);
+        PRINT_INFO("\n%s", memory.c_str());
     }
-  
-    return 0;
-}
\ No newline at end of file
+}
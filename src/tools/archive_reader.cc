@@ -0,0 +1,141 @@
+/* src/tools/archive_reader.cc
+ *
+ * Describes a board archive (see hdr/Archive.h), checks it,
+ * or prints single boards out of it
+ *
+ * Usage: archive_reader [-v] [-b id] <archive>
+ *        -v     verify every block checksum
+ *        -b id  print board id
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+
+#include "Archive.h"
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    ArchiveReader reader;
+    const archive_header* header;
+    const char* path;
+    bool verify = false;
+    long long board_id = -1;
+    uint64_t block, bad, total = 0;
+    int min_3bv = 0, max_3bv = 0;
+    struct timespec start, end;
+    double seconds;
+    Board* board;
+    int opt, i, count, row, column;
+
+    while ( (opt = getopt(argc, argv, "vb:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'v': verify = true;             break;
+        case 'b': board_id = atoll(optarg);  break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        PRINT_INFO("Usage: %s [-v] [-b id] <archive>\n", argv[0]);
+        return 1;
+    }
+    path = argv[optind];
+    if (!reader.open(path))
+    {
+        return 1;
+    }
+    header = reader.get_header();
+
+    PRINT_INFO("%s: %llu %dx%d %s boards, %d mines, seeds %u..%llu\n",
+               path, (unsigned long long) header->boards, header->rows,
+               header->columns,
+               topology_name((board_topology) header->topology),
+               header->mines, header->base_seed,
+               (unsigned long long) header->base_seed + header->boards - 1);
+    PRINT_INFO("%llu blocks of up to %u boards, %.2f bytes per board\n",
+               (unsigned long long) header->blocks, header->block_boards,
+               (double) (header->index_offset - header->header_size) /
+               (header->boards > 0 ? header->boards : 1));
+
+    /* Difficulty comes from the block headers alone */
+    std::vector<int> bbbv(header->block_boards);
+    for (block = 0; block < header->blocks; block++)
+    {
+        count = reader.read_block_3bv(block, bbbv.data());
+        for (i = 0; i < count; i++)
+        {
+            if (total == 0)
+            {
+                min_3bv = max_3bv = bbbv[i];
+            }
+            min_3bv = (bbbv[i] < min_3bv) ? bbbv[i] : min_3bv;
+            max_3bv = (bbbv[i] > max_3bv) ? bbbv[i] : max_3bv;
+            total += bbbv[i];
+        }
+    }
+    PRINT_INFO("3BV min %d, average %.1f, max %d\n", min_3bv,
+               (double) total / (header->boards > 0 ? header->boards : 1),
+               max_3bv);
+
+    if (verify)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        reader.verify(&bad);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) +
+                  (end.tv_nsec - start.tv_nsec) / 1e9;
+        PRINT_INFO("%llu of %llu blocks bad (checked in %.3f s)\n",
+                   (unsigned long long) bad,
+                   (unsigned long long) header->blocks, seconds);
+        if (bad != 0)
+        {
+            return 1;
+        }
+    }
+
+    if (board_id >= 0)
+    {
+        board = reader.load_board(board_id);
+        if (board == NULL)
+        {
+            PRINT_INFO("\nERROR: Cannot read board %lld\n", board_id);
+            return 1;
+        }
+        PRINT_INFO("Board %lld (seed %llu), 3BV %d, %d openings\n",
+                   board_id,
+                   (unsigned long long) header->base_seed + board_id,
+                   board->get_3bv(), board->get_openings());
+        delete board;
+
+        /* The layout itself, '*' for a mine */
+        std::vector<uint8_t> plane((header->rows * header->columns + 7) / 8);
+        reader.read_board(board_id, plane.data(), NULL);
+        for (row = 0; row < header->rows; row++)
+        {
+            PRINT_INFO("%*s", (header->topology == TOPOLOGY_HEX) ?
+                              (row & 1) : 0, "");
+            for (column = 0; column < header->columns; column++)
+            {
+                i = row * header->columns + column;
+                PRINT_INFO("%c ", ((plane[i >> 3] >> (i & 7)) & 1) ?
+                                  '*' : '.');
+            }
+            PRINT_INFO("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+/* src/tools/corpus.cc
+ *
+ * Corpus generator: deals boards on several threads and
+ * streams them, in id order, into a board archive
+ * (see hdr/Archive.h)
+ *
+ * Usage: corpus -o archive [-n boards] [-r rows] [-c columns]
+ *               [-m mines] [-t topology] [-s base_seed]
+ *               [-j threads] [-b block_boards]
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Archive.h"
+#include "Layout.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+
+/* One encoded block waiting to be written */
+typedef struct
+{
+    std::vector<uint8_t> payload;
+    archive_block entry;
+    bool ready;
+} corpus_slot;
+
+/* Shared between the writer and the workers */
+typedef struct
+{
+    int rows, columns, mines;
+    board_topology topology;
+    uint32_t base_seed;
+    uint64_t boards;
+    int block_boards;
+    uint64_t blocks;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<corpus_slot> ring;
+    uint64_t next_block;            /* next block to claim */
+    uint64_t written;               /* blocks written so far */
+    uint64_t bbbv;
+} corpus_job;
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static void worker(corpus_job* job);
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    const char* path = NULL;
+    long long boards = 1000000;
+    int rows = 16, columns = 30, mines = 99, topology = TOPOLOGY_SQUARE;
+    int threads = std::thread::hardware_concurrency();
+    int block_boards = ARCHIVE_BLOCK_BOARDS;
+    uint32_t base_seed = 1;
+    std::vector<std::thread> workers;
+    ArchiveWriter writer;
+    corpus_job job;
+    corpus_slot* slot;
+    struct timespec start, end;
+    double seconds, megabytes;
+    uint64_t block;
+    bool success = true;
+    int opt, i;
+
+    while ( (opt = getopt(argc, argv, "o:n:r:c:m:t:s:j:b:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'o': path = optarg;                           break;
+        case 'n': boards = atoll(optarg);                  break;
+        case 'r': rows = atoi(optarg);                     break;
+        case 'c': columns = atoi(optarg);                  break;
+        case 'm': mines = atoi(optarg);                    break;
+        case 't': topology = atoi(optarg);                 break;
+        case 's': base_seed = strtoul(optarg, NULL, 0);    break;
+        case 'j': threads = atoi(optarg);                  break;
+        case 'b': block_boards = atoi(optarg);             break;
+        default:
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL)
+    {
+        PRINT_INFO("Usage: %s -o archive [-n boards] [-r rows] "
+                   "[-c columns] [-m mines] [-t topology] "
+                   "[-s base_seed] [-j threads] [-b block_boards]\n",
+                   argv[0]);
+        return 1;
+    }
+    if ( (rows < 1) || (columns < 1) || (mines < 1) ||
+         (mines >= rows*columns) || (topology < 0) ||
+         (topology >= NUM_TOPOLOGIES) || (boards < 1) ||
+         (block_boards < 1)
+       )
+    {
+        PRINT_ERROR("Invalid corpus settings!");
+        return 1;
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+
+    job.rows = rows;
+    job.columns = columns;
+    job.mines = mines;
+    job.topology = (board_topology) topology;
+    job.base_seed = base_seed;
+    job.boards = boards;
+    job.block_boards = block_boards;
+    job.blocks = (job.boards + block_boards - 1) / block_boards;
+    /* Two blocks in flight per worker keeps everyone busy
+     * while the writer waits on the oldest */
+    job.ring.resize(2 * threads);
+    for (i = 0; i < (int) job.ring.size(); i++)
+    {
+        job.ring[i].ready = false;
+    }
+    job.next_block = 0;
+    job.written = 0;
+    job.bbbv = 0;
+
+    if ( !writer.open(path, rows, columns, mines, job.topology,
+                      base_seed, block_boards) )
+    {
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < threads; i++)
+    {
+        workers.push_back(std::thread(worker, &job));
+    }
+
+    /* Write blocks strictly in order as they come in */
+    for (block = 0; block < job.blocks; block++)
+    {
+        slot = &job.ring[block % job.ring.size()];
+        {
+            std::unique_lock<std::mutex> guard(job.lock);
+            job.changed.wait(guard, [slot] { return slot->ready; });
+        }
+        success = success && writer.write_block(slot->payload, slot->entry);
+        {
+            std::lock_guard<std::mutex> guard(job.lock);
+            slot->ready = false;
+            job.written++;
+        }
+        job.changed.notify_all();
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].join();
+    }
+    success = success && writer.close();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (!success)
+    {
+        return 1;
+    }
+    seconds = (end.tv_sec - start.tv_sec) +
+              (end.tv_nsec - start.tv_nsec) / 1e9;
+    megabytes = writer.get_bytes() / 1e6;
+    PRINT_INFO("%lld %dx%d %s boards (%d mines) in %.3f s "
+               "(%.0f boards/s)\n", boards, rows, columns,
+               topology_name(job.topology), mines, seconds,
+               boards / seconds);
+    PRINT_INFO("%.1f MB written (%.1f MB/s), %.2f bytes per board, "
+               "%llu blocks\n", megabytes, megabytes / seconds,
+               writer.get_bytes() / (double) boards,
+               (unsigned long long) job.blocks);
+    PRINT_INFO("Average 3BV %.1f\n", (double) job.bbbv / boards);
+    return 0;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* worker
+ *
+ * Claims blocks one at a time, deals and scores their
+ * boards and encodes them into the block's ring slot
+ *
+ * Inputs:  job - corpus being generated
+ * Outputs: (none)
+ * Returns: void
+ */
+static void worker(corpus_job* job)
+{
+    LayoutGenerator layouts(job->rows, job->columns, job->mines,
+                            job->topology);
+    int cells = job->rows * job->columns;
+    int plane_bytes = (cells + 7) / 8;
+    std::vector<uint8_t> planes((size_t) job->block_boards * plane_bytes);
+    std::vector<int> bbbv(job->block_boards);
+    corpus_slot* slot;
+    uint64_t block, first, total;
+    int boards, i;
+
+    while (1)
+    {
+        {
+            std::unique_lock<std::mutex> guard(job->lock);
+            /* Don't run further ahead of the writer than the ring */
+            job->changed.wait(guard, [job] {
+                return (job->next_block >= job->blocks) ||
+                       (job->next_block < job->written + job->ring.size());
+            });
+            if (job->next_block >= job->blocks)
+            {
+                return;
+            }
+            block = job->next_block++;
+        }
+
+        first = block * job->block_boards;
+        boards = (int) std::min<uint64_t>(job->block_boards,
+                                          job->boards - first);
+        total = 0;
+        for (i = 0; i < boards; i++)
+        {
+            layouts.generate(job->base_seed + (uint32_t) (first + i),
+                             &planes[(size_t) i * plane_bytes]);
+            bbbv[i] = layouts.get_3bv();
+            total += bbbv[i];
+        }
+
+        slot = &job->ring[block % job->ring.size()];
+        archive_encode_block(planes.data(), bbbv.data(), boards, cells,
+                             job->mines, &slot->payload, &slot->entry);
+        {
+            std::lock_guard<std::mutex> guard(job->lock);
+            slot->ready = true;
+            job->bbbv += total;
+        }
+        job->changed.notify_all();
+    }
+}
@@ -0,0 +1,138 @@
+/* src/tools/endgame.cc
+ *
+ * Endgame advisor benchmark: opens safe squares of boards
+ * until at most `unknown` squares are in doubt, then lets the
+ * advisor (hdr/Endgame.h) finish each game.  Reports how
+ * long advice takes, and how often the advisor wins next to
+ * how often it expected to.
+ *
+ * Usage: endgame [-g games] [-u unknown] [-j threads]
+ *                [-r rows] [-c columns] [-m mines]
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+#include "Board.h"
+#include "Endgame.h"
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    int games = 100, unknown = 20, rows = 16, columns = 30, mines = 99;
+    int threads = std::thread::hardware_concurrency();
+    unsigned int rand_state = 1;
+    endgame_advice advice;
+    Board* board;
+    int opt, game, i, cells, played = 0, won = 0;
+    bool advised;
+    double expected = 0.0, total_ms = 0.0, worst_ms = 0.0, root_ms = 0.0;
+    uint64_t layouts = 0, doubt = 0;
+
+    while ( (opt = getopt(argc, argv, "g:u:j:r:c:m:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'g': games = atoi(optarg);   break;
+        case 'u': unknown = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        case 'r': rows = atoi(optarg);    break;
+        case 'c': columns = atoi(optarg); break;
+        case 'm': mines = atoi(optarg);   break;
+        default:
+            PRINT_INFO("Usage: %s [-g games] [-u unknown] [-j threads] "
+                       "[-r rows] [-c columns] [-m mines]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ( (rows < 1) || (columns < 1) || (mines < 1) ||
+         (mines >= rows*columns) || (unknown < 1) ||
+         (unknown > ENDGAME_MAX_UNKNOWN)
+       )
+    {
+        PRINT_ERROR("Invalid settings!");
+        return 1;
+    }
+
+    EndgameSolver solver(threads);
+    solver.set_max_unknown(unknown);
+    cells = rows * columns;
+    std::vector<uint8_t> plane((cells + 7) / 8);
+
+    for (game = 0; game < games; game++)
+    {
+        board = new Board(rows, columns, mines, TOPOLOGY_SQUARE,
+                          (unsigned int) game + 1);
+        board->set_verbose(false);
+        board->pack_mines(plane.data());
+
+        /* Open safe squares until the advisor can take over */
+        advised = false;
+        while (!board->is_game_over())
+        {
+            if ( (cells - mines - board->get_squares_revealed() <= unknown) &&
+                 solver.advise(board, &advice)
+               )
+            {
+                advised = true;
+                break;
+            }
+            i = rand_r(&rand_state) % cells;
+            if ( !((plane[i >> 3] >> (i & 7)) & 1) )
+            {
+                board->make_move(i / columns, i % columns, false);
+            }
+        }
+        if (!advised)
+        {
+            /* Opened up to a win already */
+            delete board;
+            continue;
+        }
+
+        /* First advice covers the whole endgame */
+        played++;
+        expected += advice.win_probability;
+        root_ms += advice.milliseconds;
+        layouts += advice.layouts;
+        doubt += advice.unknown;
+        while (1)
+        {
+            total_ms += advice.milliseconds;
+            worst_ms = (advice.milliseconds > worst_ms) ?
+                       advice.milliseconds : worst_ms;
+            board->make_move(advice.row, advice.column, false);
+            if ( board->is_game_over() || !solver.advise(board, &advice) )
+            {
+                break;
+            }
+        }
+        won += board->did_we_win() ? 1 : 0;
+        delete board;
+    }
+
+    if (played == 0)
+    {
+        PRINT_INFO("No endgames reached\n");
+        return 0;
+    }
+    PRINT_INFO("%d endgames, %.1f squares in doubt on average "
+               "(%dx%d, %d mines), %d threads\n", played,
+               (double) doubt / played, rows, columns, mines, threads);
+    PRINT_INFO("Won %d (%.1f%%), expected %.1f%%\n", won,
+               100.0 * won / played, 100.0 * expected / played);
+    PRINT_INFO("First advice %.2f ms average, %.0f layouts; "
+               "slowest advice %.2f ms, %.2f ms per game\n",
+               root_ms / played, (double) layouts / played, worst_ms,
+               total_ms / played);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/* src/tools/env_bench.cc
+ *
+ * Throughput check of the batched environment: steps a batch
+ * with random reveal actions and reports steps per second
+ *
+ * Usage: env_bench [-b boards] [-s steps] [-t threads]
+ *                  [-r rows] [-c columns] [-m mines]
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+
+#include "common.h"
+#include "minesweeper.h"
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    int boards = 4096, steps = 1000, threads = 1;
+    int rows = 9, columns = 9, mines = 10;
+    ms_batch* batch;
+    unsigned int rand_state = 1;
+    int opt, step, i, cells;
+    struct timespec start, end;
+    double seconds, total;
+
+    while ( (opt = getopt(argc, argv, "b:s:t:r:c:m:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'b': boards = atoi(optarg);  break;
+        case 's': steps = atoi(optarg);   break;
+        case 't': threads = atoi(optarg); break;
+        case 'r': rows = atoi(optarg);    break;
+        case 'c': columns = atoi(optarg); break;
+        case 'm': mines = atoi(optarg);   break;
+        default:
+            PRINT_INFO("Usage: %s [-b boards] [-s steps] [-t threads] "
+                       "[-r rows] [-c columns] [-m mines]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    cells = rows * columns;
+    std::vector<int8_t> observations((size_t) boards * cells);
+    std::vector<int32_t> actions(boards);
+    std::vector<float> rewards(boards);
+    std::vector<uint8_t> dones(boards);
+
+    batch = ms_batch_create(boards, rows, columns, mines,
+                            MS_TOPOLOGY_SQUARE, 1, observations.data());
+    if (batch == NULL)
+    {
+        PRINT_ERROR("Invalid batch!");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (step = 0; step < steps; step++)
+    {
+        for (i = 0; i < boards; i++)
+        {
+            actions[i] = rand_r(&rand_state) % cells;
+        }
+        ms_batch_step(batch, actions.data(), rewards.data(),
+                      dones.data(), threads);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    seconds = (end.tv_sec - start.tv_sec) +
+              (end.tv_nsec - start.tv_nsec) / 1e9;
+    total = (double) boards * steps;
+    PRINT_INFO("%.0f steps in %.3f s (%.0f steps/s), %llu games, "
+               "%llu won\n", total, seconds, total / seconds,
+               (unsigned long long) ms_batch_games_played(batch),
+               (unsigned long long) ms_batch_games_won(batch));
+
+    ms_batch_destroy(batch);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/* src/tools/fork_bench.cc
+ *
+ * Speculative play benchmark: plays a board part way, then
+ * branches it over and over, trying one random click per
+ * branch.  Compares BoardFork (hdr/Fork.h) with rebuilding
+ * a Board and restoring its packed state for every branch.
+ *
+ * Usage: fork_bench [-n branches] [-r rows] [-c columns]
+ *                   [-m mines] [-s seed] [-p percent_revealed]
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+
+#include "Board.h"
+#include "Fork.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static double seconds_since(const struct timespec* start);
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    int branches = 100000, rows = 16, columns = 30, mines = 99;
+    int percent = 30;
+    unsigned int seed = 1, rand_state = 1;
+    Board* board;
+    Board* copy;
+    struct timespec start;
+    double fork_seconds, copy_seconds;
+    uint64_t revealed = 0, tiles = 0;
+    int opt, i, row, column, cells, target;
+
+    while ( (opt = getopt(argc, argv, "n:r:c:m:s:p:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'n': branches = atoi(optarg);  break;
+        case 'r': rows = atoi(optarg);      break;
+        case 'c': columns = atoi(optarg);   break;
+        case 'm': mines = atoi(optarg);     break;
+        case 's': seed = atoi(optarg);      break;
+        case 'p': percent = atoi(optarg);   break;
+        default:
+            PRINT_INFO("Usage: %s [-n branches] [-r rows] [-c columns] "
+                       "[-m mines] [-s seed] [-p percent_revealed]\n",
+                       argv[0]);
+            return 1;
+        }
+    }
+    if ( (rows < 1) || (columns < 1) || (mines < 1) ||
+         (mines >= rows*columns) || (branches < 1)
+       )
+    {
+        PRINT_ERROR("Invalid board size!");
+        return 1;
+    }
+
+    /* Play safe squares until enough of the board is open */
+    cells = rows * columns;
+    std::vector<uint8_t> mine_plane((cells + 7) / 8);
+    board = new Board(rows, columns, mines, TOPOLOGY_SQUARE, seed);
+    board->set_verbose(false);
+    board->pack_mines(mine_plane.data());
+    target = (cells - mines) * percent / 100;
+    while ( (board->get_squares_revealed() < target) &&
+            !board->is_game_over() )
+    {
+        i = rand_r(&rand_state) % cells;
+        if ( !((mine_plane[i >> 3] >> (i & 7)) & 1) )
+        {
+            board->make_move(i / columns, i % columns, false);
+        }
+    }
+    PRINT_INFO("%dx%d board, %d mines, %d of %d safe squares open\n",
+               rows, columns, mines, board->get_squares_revealed(),
+               cells - mines);
+
+    /* Branch by forking */
+    BoardFork base(board);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < branches; i++)
+    {
+        BoardFork branch(base);
+        row = rand_r(&rand_state) % rows;
+        column = rand_r(&rand_state) % columns;
+        revealed += branch.reveal(row, column);
+        tiles += branch.get_tiles_copied();
+    }
+    fork_seconds = seconds_since(&start);
+
+    /* Branch by rebuilding a board */
+    std::vector<uint8_t> state_plane((cells + 3) / 4);
+    board->pack_states(state_plane.data());
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < branches; i++)
+    {
+        copy = new Board(rows, columns, mines, TOPOLOGY_SQUARE, seed,
+                         mine_plane.data());
+        copy->set_verbose(false);
+        copy->restore_states(state_plane.data(),
+                             board->get_squares_revealed(),
+                             board->is_game_over(), board->did_we_win());
+        row = rand_r(&rand_state) % rows;
+        column = rand_r(&rand_state) % columns;
+        copy->make_move(row, column, false);
+        delete copy;
+    }
+    copy_seconds = seconds_since(&start);
+
+    PRINT_INFO("fork:  %d branches in %.3f s (%.0f branches/s), "
+               "%.2f tiles copied per branch\n", branches, fork_seconds,
+               branches / fork_seconds, (double) tiles / branches);
+    PRINT_INFO("board: %d branches in %.3f s (%.0f branches/s)\n",
+               branches, copy_seconds, branches / copy_seconds);
+    PRINT_INFO("Average %.1f squares revealed per branch\n",
+               (double) revealed / branches);
+
+    delete board;
+    return 0;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* seconds_since
+ *
+ * Inputs:  start - earlier CLOCK_MONOTONIC reading
+ * Outputs: (none)
+ * Returns: seconds elapsed since then
+ */
+static double seconds_since(const struct timespec* start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,372 @@
+/* src/tools/loadgen.cc
+ *
+ * Load generator for the game server.  Opens one connection
+ * per session, plays random moves closed-loop (one request
+ * in flight per session) and reports move and game start
+ * (NEW) latency percentiles.
+ *
+ * Usage: loadgen [-p port | -u socket_path] [-s sessions]
+ *                [-t threads] [-d seconds] [-r rows]
+ *                [-c columns] [-m mines]
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "common.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef struct
+{
+    int fd;
+    std::string in;
+    uint64_t sent_ns;
+    bool in_game;
+    unsigned int rand_state;
+} client;
+
+typedef struct
+{
+    std::vector<uint32_t> latencies_us;
+    std::vector<uint32_t> start_latencies_us;
+    uint64_t games;
+    uint64_t errors;
+    int connected;
+} thread_result;
+
+/******************************************************
+                    LOCAL VARIABLES
+*******************************************************/
+static int port = 7777;
+static const char* socket_path = NULL;
+static int rows = 9, columns = 9, mines = 10;
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t now_ns();
+static int connect_server();
+static void send_line(client* c, const char* line);
+static void send_request(client* c);
+static void run_clients(int count, double seconds, thread_result* result);
+static void print_latencies(const char* what, std::vector<uint32_t>& all);
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    int sessions = 10000, threads = 4;
+    double seconds = 10;
+    std::vector<thread_result> results;
+    std::vector<std::thread> workers;
+    std::vector<uint32_t> all, starts;
+    struct rlimit limit;
+    uint64_t games = 0, errors = 0;
+    int opt, i, connected = 0;
+
+    while ( (opt = getopt(argc, argv, "p:u:s:t:d:r:c:m:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'p': port = atoi(optarg);        break;
+        case 'u': socket_path = optarg;       break;
+        case 's': sessions = atoi(optarg);    break;
+        case 't': threads = atoi(optarg);     break;
+        case 'd': seconds = atof(optarg);     break;
+        case 'r': rows = atoi(optarg);        break;
+        case 'c': columns = atoi(optarg);     break;
+        case 'm': mines = atoi(optarg);       break;
+        default:
+            PRINT_INFO("Usage: %s [-p port | -u socket_path] [-s sessions] "
+                       "[-t threads] [-d seconds] [-r rows] [-c columns] "
+                       "[-m mines]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    results.resize(threads);
+    for (i = 0; i < threads; i++)
+    {
+        workers.push_back(std::thread(run_clients,
+                                      sessions / threads +
+                                      (i < sessions % threads ? 1 : 0),
+                                      seconds, &results[i]));
+    }
+    for (i = 0; i < threads; i++)
+    {
+        workers[i].join();
+        all.insert(all.end(), results[i].latencies_us.begin(),
+                   results[i].latencies_us.end());
+        starts.insert(starts.end(), results[i].start_latencies_us.begin(),
+                      results[i].start_latencies_us.end());
+        games += results[i].games;
+        errors += results[i].errors;
+        connected += results[i].connected;
+    }
+
+    if (all.empty())
+    {
+        PRINT_ERROR("No moves completed!");
+        return 1;
+    }
+    PRINT_INFO("%d sessions connected, %llu moves, %llu games, %llu errors "
+               "in %.1f s (%.0f moves/s)\n", connected,
+               (unsigned long long) all.size(), (unsigned long long) games,
+               (unsigned long long) errors, seconds, all.size() / seconds);
+    print_latencies("move", all);
+    if (!starts.empty())
+    {
+        print_latencies("start", starts);
+    }
+    return 0;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* run_clients
+ *
+ * One load thread: connects its share of sessions, then
+ * plays until the time is up
+ *
+ * Inputs:  count   - sessions to drive
+ *          seconds - how long to play
+ * Outputs: result  - latencies and counters
+ * Returns: void
+ */
+static void run_clients(int count, double seconds, thread_result* result)
+{
+    std::vector<client> clients(count);
+    struct epoll_event ev, events[256];
+    char chunk[4096];
+    uint64_t deadline;
+    size_t newline;
+    ssize_t got;
+    client* c;
+    int epoll_fd, i, n;
+
+    result->games = result->errors = 0;
+    result->connected = 0;
+    epoll_fd = epoll_create1(0);
+
+    for (i = 0; i < count; i++)
+    {
+        c = &clients[i];
+        c->fd = connect_server();
+        c->in_game = false;
+        c->rand_state = (unsigned int) i * 7919 + 1;
+        if (c->fd < 0)
+        {
+            result->errors++;
+            continue;
+        }
+        result->connected++;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+        send_request(c);
+    }
+
+    deadline = now_ns() + (uint64_t) (seconds * 1e9);
+    while (now_ns() < deadline)
+    {
+        n = epoll_wait(epoll_fd, events, 256, 100);
+        for (i = 0; i < n; i++)
+        {
+            c = (client*) events[i].data.ptr;
+            got = recv(c->fd, chunk, sizeof(chunk), 0);
+            if (got <= 0)
+            {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+                result->errors++;
+                continue;
+            }
+            c->in.append(chunk, got);
+
+            while ( (newline = c->in.find('\n')) != std::string::npos )
+            {
+                if (c->in.compare(0, 3, "ERR") == 0)
+                {
+                    result->errors++;
+                    c->in_game = false;
+                }
+                else if (c->in_game)
+                {
+                    result->latencies_us.push_back(
+                        (uint32_t) ((now_ns() - c->sent_ns) / 1000) );
+                    if (c->in.compare(0, 10, "OK PLAYING") != 0)
+                    {
+                        /* Won or lost, start over */
+                        c->in_game = false;
+                        result->games++;
+                    }
+                }
+                else
+                {
+                    result->start_latencies_us.push_back(
+                        (uint32_t) ((now_ns() - c->sent_ns) / 1000) );
+                    c->in_game = true;
+                }
+                c->in.erase(0, newline + 1);
+                send_request(c);
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (clients[i].fd >= 0)
+        {
+            close(clients[i].fd);
+        }
+    }
+    close(epoll_fd);
+}
+
+/* print_latencies
+ *
+ * Prints percentiles of a set of latencies (sorting it)
+ */
+static void print_latencies(const char* what, std::vector<uint32_t>& all)
+{
+    std::sort(all.begin(), all.end());
+    PRINT_INFO("%s latency us: p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+               what, all[all.size() * 50 / 100], all[all.size() * 90 / 100],
+               all[all.size() * 99 / 100], all[all.size() * 999 / 1000],
+               all[all.size() - 1]);
+}
+
+/* send_request
+ *
+ * Sends the next request of a client: a new game, or a
+ * random move in the current one
+ */
+static void send_request(client* c)
+{
+    char line[64];
+
+    if (!c->in_game)
+    {
+        snprintf(line, sizeof(line), "NEW %d %d %d\n", rows, columns, mines);
+    }
+    else
+    {
+        snprintf(line, sizeof(line), "(%d,%d)\n",
+                 rand_r(&c->rand_state) % rows + 1,
+                 rand_r(&c->rand_state) % columns + 1);
+    }
+    c->sent_ns = now_ns();
+    send_line(c, line);
+}
+
+/* send_line
+ *
+ * Blocking-ish send of a short request
+ */
+static void send_line(client* c, const char* line)
+{
+    size_t done = 0, length = strlen(line);
+    ssize_t sent;
+
+    while (done < length)
+    {
+        sent = send(c->fd, line + done, length - done, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        done += sent;
+    }
+}
+
+/* connect_server
+ *
+ * Opens a connection to the server
+ */
+static int connect_server()
+{
+    struct sockaddr_in in_addr;
+    struct sockaddr_un un_addr;
+    int fd, one = 1;
+
+    if (socket_path != NULL)
+    {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        memset(&un_addr, 0, sizeof(un_addr));
+        un_addr.sun_family = AF_UNIX;
+        strncpy(un_addr.sun_path, socket_path, sizeof(un_addr.sun_path) - 1);
+        if ( (fd >= 0) &&
+             (connect(fd, (struct sockaddr*) &un_addr, sizeof(un_addr)) != 0)
+           )
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&in_addr, 0, sizeof(in_addr));
+    in_addr.sin_family = AF_INET;
+    in_addr.sin_port = htons(port);
+    in_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ( (fd >= 0) &&
+         (connect(fd, (struct sockaddr*) &in_addr, sizeof(in_addr)) != 0)
+       )
+    {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/* now_ns
+ *
+ * Monotonic time in nanoseconds
+ */
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,147 @@
+/* src/tools/log_reader.cc
+ *
+ * Streams an event log (see hdr/EventLog.h) back out as
+ * text, or just summarizes it
+ *
+ * Usage: log_reader [-s] <event_log>
+ *        -s  only print a summary
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "EventLog.h"
+#include "Topology.h"
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    EventReader reader;
+    game_event event;
+    const char* path = NULL;
+    bool summary_only = false;
+    uint64_t counts[NUM_EVENT_TYPES];
+    uint64_t total = 0, revealed = 0, won = 0;
+    struct timespec start, end;
+    double seconds;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-s") == 0)
+        {
+            summary_only = true;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (path == NULL)
+    {
+        PRINT_INFO("Usage: %s [-s] <event_log>\n", argv[0]);
+        return 1;
+    }
+    if (!reader.open(path))
+    {
+        PRINT_INFO("\nERROR: %s is not an event log\n", path);
+        return 1;
+    }
+
+    memset(counts, 0, sizeof(counts));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (reader.next(&event))
+    {
+        total++;
+        counts[event.type]++;
+
+        switch (event.type)
+        {
+        case EVENT_MOVE:
+        case EVENT_CHORD:
+            revealed += event.count;
+            break;
+        case EVENT_OUTCOME:
+            won += event.won ? 1 : 0;
+            break;
+        default:
+            break;
+        }
+
+        if (summary_only)
+        {
+            continue;
+        }
+
+        PRINT_INFO("%12llu us  game %-6u %-10s ", 
+                   (unsigned long long) event.time_us, event.game,
+                   event_type_name(event.type));
+        switch (event.type)
+        {
+        case EVENT_GAME_CREATE:
+            PRINT_INFO("%s %dx%d, %d mines, seed %u", 
+                       topology_name((board_topology) event.topology),
+                       event.rows, event.columns, event.mines, event.seed);
+            break;
+        case EVENT_MOVE:
+        case EVENT_CHORD:
+            PRINT_INFO("(%d,%d) revealed %llu", event.row + 1, 
+                       event.column + 1, (unsigned long long) event.count);
+            break;
+        case EVENT_MARK:
+        case EVENT_UNMARK:
+            PRINT_INFO("(%d,%d)", event.row + 1, event.column + 1);
+            break;
+        case EVENT_OUTCOME:
+            PRINT_INFO("%s", event.won ? "won" : "lost");
+            break;
+        case EVENT_DROPPED:
+            PRINT_INFO("%llu records", (unsigned long long) event.count);
+            break;
+        case EVENT_BATCH:
+            PRINT_INFO("%llu moves", (unsigned long long) event.count);
+            break;
+        case EVENT_MINE_HASH:
+        case EVENT_STATE_HASH:
+            PRINT_INFO("%016llx", (unsigned long long) event.hash);
+            break;
+        default:
+            break;
+        }
+        PRINT_INFO("\n");
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + 
+              (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    PRINT_INFO("%llu records: %llu games, %llu moves, %llu chords (%llu "
+               "squares revealed), %llu marks, %llu unmarks, %llu outcomes "
+               "(%llu won), %llu dropped records\n",
+               (unsigned long long) total,
+               (unsigned long long) counts[EVENT_GAME_CREATE],
+               (unsigned long long) counts[EVENT_MOVE],
+               (unsigned long long) counts[EVENT_CHORD],
+               (unsigned long long) revealed,
+               (unsigned long long) counts[EVENT_MARK],
+               (unsigned long long) counts[EVENT_UNMARK],
+               (unsigned long long) counts[EVENT_OUTCOME],
+               (unsigned long long) won,
+               (unsigned long long) counts[EVENT_DROPPED]);
+    if (seconds > 0)
+    {
+        PRINT_INFO("Decoded in %.3f s (%.1f M records/s)\n", 
+                   seconds, total / seconds / 1e6);
+    }
+    return 0;
+}
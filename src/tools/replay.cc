@@ -0,0 +1,491 @@
+/* src/tools/replay.cc
+ *
+ * Replays every game of an event log (see hdr/EventLog.h)
+ * on fresh boards dealt from the logged seeds.  If the log
+ * was written with hashes, the replayed boards' layout and
+ * state hashes are checked against the logged ones and the
+ * first move each game diverges on is reported.  With -v
+ * the replayed hash of every move is printed, so the
+ * output of two runs can also be diffed directly.
+ *
+ * Every logged move is replayed on its own.  Moves that were
+ * applied as one batch (see EVENT_BATCH) were undone as one,
+ * so the replay keeps its own undo stack of how many of its
+ * moves each logged undo takes back.
+ *
+ * With -i the replay also writes a replay index of one game
+ * (see hdr/ReplayIndex.h), so any of its moves can be
+ * looked at later without replaying the ones before it
+ * (see seek).  If the game id is created again, the index
+ * stops at the first game.
+ *
+ * Records the logger dropped under back pressure (see
+ * EVENT_DROPPED) leave a gap in every game that was live at
+ * the time (a finished one only if it is logged again, say
+ * undone, after the gap).  Those games are still replayed,
+ * but their hashes are no longer checked and they are
+ * counted apart from the verified ones; an index is not
+ * written across such a gap.
+ *
+ * Usage: replay [-v] [-i index [-g game] [-K interval]] <event_log>
+ *        -v  print every move's hash
+ *        -i  write a replay index of one game
+ *        -g  game to index (default: the first one created)
+ *        -K  moves between checkpoints (default 1024)
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "Board.h"
+#include "EventLog.h"
+#include "ReplayIndex.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef struct
+{
+    Board* board;
+    uint64_t moves;         /* moves replayed */
+    game_event last;        /* the last one */
+    bool diverged;
+    bool unverifiable;      /* records of it were dropped */
+    bool gap;               /* finished before a drop */
+    
+    /* Board undos per logged undo (or redo), and whether each
+     * move since the last batch or undo changed the board */
+    std::vector<int> undo_steps;
+    std::vector<int> redo_steps;
+    std::vector<bool> recent;
+    
+    /* Index being written of this game, NULL if none */
+    ReplayIndexWriter* index;
+} replay_game;
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static void replay_move(replay_game* game, const game_event* event);
+static void replay_batch(replay_game* game, int moves);
+static void report(const replay_game* game, uint32_t id, const char* what,
+                   uint64_t logged, uint64_t replayed);
+static bool finish_index(ReplayIndexWriter* writer, uint32_t id);
+static bool lose_records(replay_game* game, uint32_t id,
+                         const char* index_path, uint64_t* unverifiable);
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    EventReader reader;
+    game_event event;
+    std::unordered_map<uint32_t, replay_game> games;
+    std::unordered_map<uint32_t, replay_game>::iterator it;
+    replay_game* game;
+    ReplayIndexWriter writer;
+    const char* path = NULL;
+    const char* index_path = NULL;
+    bool verbose = false, indexed = false;
+    int64_t index_game = -1;
+    int interval = REPLAY_INDEX_INTERVAL;
+    uint64_t moves = 0, checked = 0, diverged = 0;
+    uint64_t dropped = 0, unverifiable = 0;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if ( (strcmp(argv[i], "-i") == 0) && (i + 1 < argc) )
+        {
+            index_path = argv[++i];
+        }
+        else if ( (strcmp(argv[i], "-g") == 0) && (i + 1 < argc) )
+        {
+            index_game = strtoll(argv[++i], NULL, 10);
+        }
+        else if ( (strcmp(argv[i], "-K") == 0) && (i + 1 < argc) )
+        {
+            interval = atoi(argv[++i]);
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if ( (path == NULL) || (interval < 1) )
+    {
+        PRINT_INFO("Usage: %s [-v] [-i index [-g game] [-K interval]] "
+                   "<event_log>\n", argv[0]);
+        return 1;
+    }
+    if (!reader.open(path))
+    {
+        PRINT_INFO("\nERROR: %s is not an event log\n", path);
+        return 1;
+    }
+
+    while (reader.next(&event))
+    {
+        if (event.type == EVENT_GAME_CREATE)
+        {
+            game = &games[event.game];
+            if (game->index != NULL)
+            {
+                game->index = NULL;
+                if (!finish_index(&writer, event.game))
+                {
+                    return 1;
+                }
+            }
+            delete game->board;
+            game->board = new Board(event.rows, event.columns, event.mines,
+                                    (board_topology) event.topology,
+                                    event.seed);
+            game->board->set_verbose(false);
+            game->moves = 0;
+            game->diverged = false;
+            game->unverifiable = false;
+            game->gap = false;
+            game->undo_steps.clear();
+            game->redo_steps.clear();
+            game->recent.clear();
+            if ( (index_path != NULL) && !indexed &&
+                 ((index_game < 0) || (index_game == event.game)) )
+            {
+                if (!writer.open(index_path, game->board, event.game,
+                                 interval))
+                {
+                    return 1;
+                }
+                game->index = &writer;
+                indexed = true;
+            }
+            continue;
+        }
+
+        if (event.type == EVENT_DROPPED)
+        {
+            dropped += event.count;
+            for (it = games.begin(); it != games.end(); it++)
+            {
+                if (it->second.board->is_game_over())
+                {
+                    it->second.gap = true;
+                }
+                else if (!lose_records(&it->second, it->first, index_path,
+                                       &unverifiable))
+                {
+                    return 1;
+                }
+            }
+            continue;
+        }
+
+        it = games.find(event.game);
+        if (it == games.end())
+        {
+            /* Created before a dropped stretch of the log */
+            continue;
+        }
+        game = &it->second;
+        if (game->gap)
+        {
+            game->gap = false;
+            if (!lose_records(game, event.game, index_path, &unverifiable))
+            {
+                return 1;
+            }
+        }
+
+        switch (event.type)
+        {
+        case EVENT_MOVE:
+        case EVENT_MARK:
+        case EVENT_UNMARK:
+        case EVENT_CHORD:
+        case EVENT_UNDO:
+        case EVENT_REDO:
+            replay_move(game, &event);
+            moves++;
+            if ( (game->index != NULL) && !game->index->add_move(game->board) )
+            {
+                PRINT_INFO("\nERROR: Cannot write %s\n", index_path);
+                return 1;
+            }
+            if (verbose)
+            {
+                PRINT_INFO("game %-6u move %-6llu %-7s (%d,%d) %016llx\n",
+                           event.game, (unsigned long long) game->moves,
+                           event_type_name(event.type), event.row + 1,
+                           event.column + 1, (unsigned long long)
+                           game->board->get_state_hash());
+            }
+            break;
+
+        case EVENT_BATCH:
+            replay_batch(game, (int) event.count);
+            break;
+
+        case EVENT_MINE_HASH:
+        case EVENT_STATE_HASH:
+            if (game->unverifiable)
+            {
+                break;
+            }
+            checked++;
+            if (game->diverged)
+            {
+                break;
+            }
+            if (event.type == EVENT_MINE_HASH)
+            {
+                game->diverged =
+                    (event.hash != game->board->get_mine_hash());
+                if (game->diverged)
+                {
+                    report(game, event.game, "mine layouts", event.hash,
+                           game->board->get_mine_hash());
+                }
+            }
+            else if (event.hash != game->board->get_state_hash())
+            {
+                game->diverged = true;
+                report(game, event.game, "squares", event.hash,
+                       game->board->get_state_hash());
+            }
+            diverged += game->diverged ? 1 : 0;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    for (it = games.begin(); it != games.end(); it++)
+    {
+        if ( (it->second.index != NULL) && !finish_index(&writer, it->first) )
+        {
+            return 1;
+        }
+        delete it->second.board;
+    }
+    if ( (index_path != NULL) && !indexed )
+    {
+        PRINT_INFO("\nERROR: No game to index in %s\n", path);
+        return 1;
+    }
+
+    PRINT_INFO("%llu games, %llu moves replayed, %llu hashes checked, "
+               "%llu games diverged\n", (unsigned long long) games.size(),
+               (unsigned long long) moves, (unsigned long long) checked,
+               (unsigned long long) diverged);
+    if (dropped > 0)
+    {
+        PRINT_INFO("%llu records dropped, %llu games unverifiable\n",
+                   (unsigned long long) dropped,
+                   (unsigned long long) unverifiable);
+    }
+    if ( (checked == 0) && (moves > 0) )
+    {
+        PRINT_INFO("The log has no hashes (log with EventLog::set_hashes, "
+                   "e.g. simulate -H)\n");
+    }
+    return (diverged > 0) ? 1 : 0;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* replay_move
+ *
+ * Makes a logged move again.  Every move goes through
+ * apply_moves on its own, which applies (and logs) the same
+ * moves as make_move.  A move is only journaled if it
+ * changed a square, which is when its hash changes.
+ *
+ * Inputs:  game  - game to replay it on
+ *          event - the logged move
+ * Outputs: game  - board, undo stacks and move count updated,
+ *                  squares changed noted for the index
+ * Returns: void
+ */
+static void replay_move(replay_game* game, const game_event* event)
+{
+    board_move move;
+    uint64_t before = game->board->get_state_hash();
+    bool undo = (event->type == EVENT_UNDO);
+    std::vector<int>* from = undo ? &game->undo_steps : &game->redo_steps;
+    std::vector<int>* to = undo ? &game->redo_steps : &game->undo_steps;
+    int i, steps;
+
+    if ( undo || (event->type == EVENT_REDO) )
+    {
+        if (!from->empty())
+        {
+            steps = from->back();
+            from->pop_back();
+            for (i = 0; i < steps; i++)
+            {
+                if (undo)
+                {
+                    game->board->undo();
+                }
+                else
+                {
+                    game->board->redo();
+                }
+                if (game->index != NULL)
+                {
+                    game->index->note_changes(game->board);
+                }
+            }
+            to->push_back(steps);
+        }
+        game->recent.clear();
+    }
+    else
+    {
+        move.row = event->row;
+        move.column = event->column;
+        move.type = (event->type == EVENT_MARK)   ? MOVE_MARK :
+                    (event->type == EVENT_UNMARK) ? MOVE_UNMARK :
+                    (event->type == EVENT_CHORD)  ? MOVE_CHORD : MOVE_REVEAL;
+        game->board->apply_moves(&move, 1);
+        if (game->index != NULL)
+        {
+            game->index->note_changes(game->board);
+        }
+        game->recent.push_back(game->board->get_state_hash() != before);
+        if (game->recent.back())
+        {
+            game->undo_steps.push_back(1);
+            game->redo_steps.clear();
+        }
+    }
+    game->moves++;
+    game->last = *event;
+}
+
+/* replay_batch
+ *
+ * Folds the journal entries of the last moves, which were
+ * one batch, into a single undo step
+ *
+ * Inputs:  game  - game the batch belongs to
+ *          moves - moves in the batch
+ * Outputs: game  - undo stack updated
+ * Returns: void
+ */
+static void replay_batch(replay_game* game, int moves)
+{
+    int i, steps = 0;
+
+    for (i = 0; (i < moves) && !game->recent.empty(); i++)
+    {
+        if (game->recent.back())
+        {
+            steps++;
+            game->undo_steps.pop_back();
+        }
+        game->recent.pop_back();
+    }
+    if (steps > 0)
+    {
+        game->undo_steps.push_back(steps);
+    }
+    game->recent.clear();
+}
+
+/* report
+ *
+ * Prints where a game first diverged
+ *
+ * Inputs:  game     - the game
+ *          id       - its id in the log
+ *          what     - what differs
+ *          logged   - hash in the log
+ *          replayed - hash of the replay
+ * Outputs: (none)
+ * Returns: void
+ */
+static void report(const replay_game* game, uint32_t id, const char* what,
+                   uint64_t logged, uint64_t replayed)
+{
+    if (game->moves == 0)
+    {
+        PRINT_INFO("game %u: %s differ from the start: logged %016llx, "
+                   "replayed %016llx\n", id, what,
+                   (unsigned long long) logged,
+                   (unsigned long long) replayed);
+        return;
+    }
+    PRINT_INFO("game %u: %s first differ after move %llu (%s (%d,%d)): "
+               "logged %016llx, replayed %016llx\n", id, what,
+               (unsigned long long) game->moves,
+               event_type_name(game->last.type), game->last.row + 1,
+               game->last.column + 1, (unsigned long long) logged,
+               (unsigned long long) replayed);
+}
+
+/* finish_index
+ *
+ * Closes the index of a game and says what it holds
+ *
+ * Inputs:  writer - the game's index
+ *          id     - its id in the log
+ * Outputs: (none)
+ * Returns: true if the index was written
+ */
+static bool finish_index(ReplayIndexWriter* writer, uint32_t id)
+{
+    PRINT_INFO("Indexed game %u: %llu moves, %llu bytes, %llu of them "
+               "checkpoints\n", id, (unsigned long long) writer->get_moves(),
+               (unsigned long long) writer->get_bytes(),
+               (unsigned long long) writer->get_checkpoint_bytes());
+    return writer->close();
+}
+
+/* lose_records
+ *
+ * Marks a game as missing records: its hashes are not
+ * checked from here on
+ *
+ * Inputs:  game         - the game
+ *          id           - its id in the log
+ *          index_path   - index being written, if any
+ *          unverifiable - games marked so far
+ * Outputs: game         - marked
+ *          unverifiable - counts it if it was not marked yet
+ * Returns: false if the game is being indexed (the index
+ *          would skip the lost moves)
+ */
+static bool lose_records(replay_game* game, uint32_t id,
+                         const char* index_path, uint64_t* unverifiable)
+{
+    if (game->index != NULL)
+    {
+        PRINT_INFO("\nERROR: Records of game %u were dropped, not writing "
+                   "%s\n", id, index_path);
+        return false;
+    }
+    if (!game->unverifiable)
+    {
+        game->unverifiable = true;
+        (*unverifiable)++;
+    }
+    return true;
+}
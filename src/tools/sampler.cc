@@ -0,0 +1,156 @@
+/* src/tools/sampler.cc
+ *
+ * Mine sampler benchmark: opens random safe squares of
+ * boards until there is a wide frontier, then has the
+ * sampler (hdr/Sampler.h) estimate every unrevealed
+ * square's chance of being a mine within a time budget.
+ * Reports the chains' diagnostics, and scores the estimates
+ * against the real mines next to the plain guess of
+ * mines left over squares left for every square.
+ *
+ * Usage: sampler [-g games] [-j threads] [-b budget_ms]
+ *                [-o opened] [-r rows] [-c columns] [-m mines]
+ *        -o  safe squares to click before sampling
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+
+#include "Board.h"
+#include "Sampler.h"
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    int games = 10, opened = 40, rows = 200, columns = 200, mines = 7000;
+    int threads = std::thread::hardware_concurrency();
+    double budget_ms = 1000.0;
+    unsigned int rand_state = 1;
+    sampler_result result;
+    Board* board;
+    int opt, game, i, clicks, cells, sampled = 0, safe = 0;
+    int row, column, unknown;
+    double probability, plain, brier, plain_brier, worst_rhat = 0.0;
+    double total_brier = 0.0, total_plain = 0.0;
+    bool mine;
+
+    while ( (opt = getopt(argc, argv, "g:j:b:o:r:c:m:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'g': games = atoi(optarg);     break;
+        case 'j': threads = atoi(optarg);   break;
+        case 'b': budget_ms = atof(optarg); break;
+        case 'o': opened = atoi(optarg);    break;
+        case 'r': rows = atoi(optarg);      break;
+        case 'c': columns = atoi(optarg);   break;
+        case 'm': mines = atoi(optarg);     break;
+        default:
+            PRINT_INFO("Usage: %s [-g games] [-j threads] [-b budget_ms] "
+                       "[-o opened] [-r rows] [-c columns] [-m mines]\n",
+                       argv[0]);
+            return 1;
+        }
+    }
+    if ( (rows < 1) || (columns < 1) || (mines < 1) ||
+         (mines >= rows*columns) || (opened < 1) || (budget_ms <= 0.0)
+       )
+    {
+        PRINT_ERROR("Invalid settings!");
+        return 1;
+    }
+
+    MineSampler sampler(threads);
+    cells = rows * columns;
+    std::vector<uint8_t> plane((cells + 7) / 8);
+
+    for (game = 0; game < games; game++)
+    {
+        board = new Board(rows, columns, mines, TOPOLOGY_SQUARE,
+                          (unsigned int) game + 1);
+        board->set_verbose(false);
+        board->pack_mines(plane.data());
+
+        clicks = 0;
+        while ( (clicks < opened) && !board->is_game_over() )
+        {
+            i = rand_r(&rand_state) % cells;
+            if ( !((plane[i >> 3] >> (i & 7)) & 1) &&
+                 (board->get_square_state(i / columns, i % columns) ==
+                  UNKNOWN) )
+            {
+                board->make_move(i / columns, i % columns, false);
+                clicks++;
+            }
+        }
+        if ( !sampler.sample(board, budget_ms, game + 1, &result) )
+        {
+            PRINT_INFO("game %-3d no consistent layout found in %.0f ms\n",
+                       game + 1, budget_ms);
+            delete board;
+            continue;
+        }
+
+        /* Score against the real mines */
+        unknown = cells - board->get_squares_revealed();
+        plain = (double) mines / unknown;
+        brier = 0.0;
+        plain_brier = 0.0;
+        for (i = 0; i < cells; i++)
+        {
+            row = i / columns;
+            column = i % columns;
+            if (board->get_square_state(row, column) == REVEALED)
+            {
+                continue;
+            }
+            mine = (plane[i >> 3] >> (i & 7)) & 1;
+            probability = sampler.get_probability(row, column);
+            brier += (probability - mine) * (probability - mine);
+            plain_brier += (plain - mine) * (plain - mine);
+        }
+        brier /= unknown;
+        plain_brier /= unknown;
+        i = result.row * columns + result.column;
+        safe += ((plane[i >> 3] >> (i & 7)) & 1) ? 0 : 1;
+        sampled++;
+        total_brier += brier;
+        total_plain += plain_brier;
+        worst_rhat = (result.max_rhat > worst_rhat) ? result.max_rhat :
+                     worst_rhat;
+
+        PRINT_INFO("game %-3d frontier %-5d interior %-6d %d/%d chains "
+                   "mixed, %llu samples, %.1fM steps/s, %.0f%% accepted, "
+                   "%.0f%% consistent, R-hat %.3f, Brier %.4f (plain "
+                   "%.4f), safest %.3f at (%d,%d) %s\n", game + 1,
+                   result.frontier, result.interior, result.mixed,
+                   result.chains, (unsigned long long) result.samples,
+                   result.steps / result.milliseconds / 1e3,
+                   100.0 * result.accepted / result.steps,
+                   100.0 * result.consistent, result.max_rhat, brier,
+                   plain_brier, result.safest, result.row + 1,
+                   result.column + 1,
+                   ((plane[i >> 3] >> (i & 7)) & 1) ? "MINE" : "safe");
+        delete board;
+    }
+
+    if (sampled > 0)
+    {
+        PRINT_INFO("%d positions sampled for %.0f ms on %d threads: "
+                   "Brier %.4f (plain %.4f), worst R-hat %.3f, safest "
+                   "square safe %d times\n", sampled, budget_ms, threads,
+                   total_brier / sampled, total_plain / sampled,
+                   worst_rhat, safe);
+    }
+    return 0;
+}
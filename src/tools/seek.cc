@@ -0,0 +1,155 @@
+/* src/tools/seek.cc
+ *
+ * Looks at moves of a recorded game through its replay
+ * index (see hdr/ReplayIndex.h, written by replay -i).
+ * Every move asked for is restored from the checkpoint
+ * before it, and its state hash printed the way replay -v
+ * prints it, so the two can be compared.  With -b, times
+ * that many seeks to random moves instead.
+ *
+ * Usage: seek [-p] [-b seeks] <index> [move ...]
+ *        -p  print the board after each move asked for
+ *        -b  time this many random seeks
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "common.h"
+#include "Board.h"
+#include "ReplayIndex.h"
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static uint64_t now_ns();
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    ReplayIndex index;
+    const replay_index_header* header;
+    Board* board;
+    std::vector<uint64_t> moves;
+    const char* path = NULL;
+    bool print = false;
+    int seeks = 0, replayed, most = 0, i;
+    unsigned int rand_state = 1;
+    uint64_t move, start, took, total = 0, slowest = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+        {
+            print = true;
+        }
+        else if ( (strcmp(argv[i], "-b") == 0) && (i + 1 < argc) )
+        {
+            seeks = atoi(argv[++i]);
+        }
+        else if (path == NULL)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            moves.push_back(strtoull(argv[i], NULL, 10));
+        }
+    }
+    if ( (path == NULL) || (seeks < 0) )
+    {
+        PRINT_INFO("Usage: %s [-p] [-b seeks] <index> [move ...]\n",
+                   argv[0]);
+        return 1;
+    }
+    if (!index.open(path))
+    {
+        return 1;
+    }
+
+    header = index.get_header();
+    board = index.new_board();
+    PRINT_INFO("game %u: %dx%d, %d mines, seed %u, %llu moves, "
+               "checkpoints every %u moves\n", header->game, header->rows,
+               header->columns, header->mines, header->seed,
+               (unsigned long long) header->moves, header->interval);
+
+    for (i = 0; i < (int) moves.size(); i++)
+    {
+        start = now_ns();
+        if (!index.seek(moves[i], board, &replayed))
+        {
+            PRINT_INFO("\nERROR: Cannot seek to move %llu\n",
+                       (unsigned long long) moves[i]);
+            delete board;
+            return 1;
+        }
+        took = now_ns() - start;
+        PRINT_INFO("move %-6llu %016llx  %d revealed%s, %d moves after "
+                   "the checkpoint, %.1f us\n",
+                   (unsigned long long) moves[i],
+                   (unsigned long long) board->get_state_hash(),
+                   board->get_squares_revealed(),
+                   !board->is_game_over() ? "" :
+                   board->did_we_win() ? ", won" : ", lost",
+                   replayed, took / 1e3);
+        if (print)
+        {
+            board->print_board();
+        }
+    }
+
+    for (i = 0; i < seeks; i++)
+    {
+        move = ( ((uint64_t) rand_r(&rand_state) << 31) ^
+                 rand_r(&rand_state) ) % (header->moves + 1);
+        start = now_ns();
+        if (!index.seek(move, board, &replayed))
+        {
+            PRINT_INFO("\nERROR: Cannot seek to move %llu\n",
+                       (unsigned long long) move);
+            delete board;
+            return 1;
+        }
+        took = now_ns() - start;
+        total += took;
+        slowest = (took > slowest) ? took : slowest;
+        most = (replayed > most) ? replayed : most;
+    }
+    if (seeks > 0)
+    {
+        PRINT_INFO("%d random seeks: %.1f us mean, %.1f us slowest, at "
+                   "most %d moves replayed\n", seeks,
+                   total / 1e3 / seeks, slowest / 1e3, most);
+    }
+
+    delete board;
+    return 0;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* now_ns
+ *
+ * Inputs:  (none)
+ * Outputs: (none)
+ * Returns: CLOCK_MONOTONIC in nanoseconds
+ */
+static uint64_t now_ns()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
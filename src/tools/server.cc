@@ -0,0 +1,274 @@
+/* src/tools/server.cc
+ *
+ * Runs the multi-session game server (see hdr/Server.h)
+ *
+ * Usage: server [-p port | -u socket_path] [-w workers]
+ *               [-M] [-B board_budget_mb] [-L session_budget_kb] [-S]
+ *               [-P rows,columns,mines[,topology][:depth]]...
+ *               [-T refill_threads] [-I idle_seconds]
+ *
+ * -M counts memory use by subsystem and adds it to the
+ * periodic report.  -B (which implies -M) refuses new games
+ * while boards use more than the given megabytes, over all
+ * sessions.  -L caps each session's board at the given
+ * kilobytes: bigger NEWs, and moves on boards that outgrew
+ * it, are refused.  -S lets clients WATCH other sessions.
+ *
+ * Each -P keeps depth (default 4) boards of that size ready
+ * for every worker, built by -T background threads (default
+ * 1), so NEW for that size does not build a board.
+ *
+ * -I parks sessions nobody touched for that many seconds
+ * (see hdr/ParkedBoard.h) and reports how many are parked,
+ * what they hold and how long waking them took.
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <thread>
+#include <sys/resource.h>
+
+#include "Server.h"
+
+/******************************************************
+                    LOCAL VARIABLES
+*******************************************************/
+static volatile sig_atomic_t stop_requested = 0;
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static void on_signal(int sig);
+static bool add_preset(BoardPool* pool, const char* text);
+static void print_pool(const pool_stats* stats);
+static void print_parking(const server_stats* stats);
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    BoardPool pool;         /* outlives the server */
+    GameServer server;
+    server_stats stats;
+    struct rlimit limit;
+    const char* socket_path = NULL;
+    int port = 7777;
+    int workers = (int) std::thread::hardware_concurrency();
+    int opt, ticks = 0, refill_threads = 1;
+    bool pooled = false;
+    double idle_seconds = 0.0;
+    long long session_kb = 0;
+    std::string memory;
+
+    while ( (opt = getopt(argc, argv, "p:u:w:MB:L:SP:T:I:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'p': port = atoi(optarg);    break;
+        case 'u': socket_path = optarg;   break;
+        case 'w': workers = atoi(optarg); break;
+        case 'M': mem_enable(true);       break;
+        case 'B':
+            mem_enable(true);
+            mem_set_budget(MEM_BOARD, atoll(optarg) << 20);
+            break;
+        case 'L': session_kb = atoll(optarg);  break;
+        case 'S': server.set_spectating(true); break;
+        case 'T': refill_threads = atoi(optarg); break;
+        case 'I': idle_seconds = atof(optarg);   break;
+        case 'P':
+            if (!add_preset(&pool, optarg))
+            {
+                PRINT_INFO("\nERROR: Bad pool preset %s\n", optarg);
+                return 1;
+            }
+            pooled = true;
+            break;
+        default:
+            PRINT_INFO("Usage: %s [-p port | -u socket_path] [-w workers] "
+                       "[-M] [-B board_budget_mb] [-L session_budget_kb] "
+                       "[-S]\n"
+                       "       [-P rows,columns,mines[,topology][:depth]]... "
+                       "[-T refill_threads] [-I idle_seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    /* Every session may come with its own connection */
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    if ( (socket_path != NULL) ? !server.listen_unix(socket_path)
+                               : !server.listen_tcp(port) )
+    {
+        return 1;
+    }
+
+    if (pooled)
+    {
+        server.set_pool(&pool, refill_threads);
+    }
+    server.set_park_after(idle_seconds);
+    if (session_kb > 0)
+    {
+        server.set_session_budget((size_t) session_kb << 10);
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    server.start(workers);
+    if (socket_path != NULL)
+    {
+        PRINT_INFO("Serving on %s with %d workers\n", socket_path, workers);
+    }
+    else
+    {
+        PRINT_INFO("Serving on 127.0.0.1:%d with %d workers\n", port, workers);
+    }
+
+    while (!stop_requested)
+    {
+        sleep(1);
+        if (++ticks % 10 == 0)
+        {
+            stats = server.get_stats();
+            PRINT_INFO("connections %llu, sessions %llu, requests %llu, "
+                       "moves %llu, handoffs %llu, watchers %llu, "
+                       "views %llu\n",
+                       (unsigned long long) stats.value[STAT_CONNECTIONS],
+                       (unsigned long long) stats.value[STAT_SESSIONS],
+                       (unsigned long long) stats.value[STAT_REQUESTS],
+                       (unsigned long long) stats.value[STAT_MOVES],
+                       (unsigned long long) stats.value[STAT_HANDOFFS],
+                       (unsigned long long) stats.value[STAT_WATCHERS],
+                       (unsigned long long) stats.value[STAT_VIEWS]);
+            if (pooled)
+            {
+                print_pool(&stats.pool);
+            }
+            if (idle_seconds > 0.0)
+            {
+                print_parking(&stats);
+            }
+            if (session_kb > 0)
+            {
+                PRINT_INFO("session budget %lld KB: %llu requests refused\n",
+                           session_kb,
+                           (unsigned long long) stats.value[STAT_OVER_BUDGET]);
+            }
+            if (mem_enabled())
+            {
+                memory.clear();
+                mem_report(&memory);
+                PRINT_INFO("%s", memory.c_str());
+            }
+            fflush(stdout);
+        }
+    }
+
+    server.stop();
+    if (socket_path != NULL)
+    {
+        unlink(socket_path);
+    }
+    return 0;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* on_signal
+ *
+ * Asks the main loop to shut the server down
+ */
+static void on_signal(int sig)
+{
+    stop_requested = 1;
+}
+
+/* add_preset
+ *
+ * Adds a -P preset to the pool
+ *
+ * Inputs:  pool - the pool
+ *          text - "rows,columns,mines[,topology][:depth]"
+ * Outputs: (none)
+ * Returns: true if the preset was good
+ */
+static bool add_preset(BoardPool* pool, const char* text)
+{
+    int rows, columns, mines, topology = TOPOLOGY_SQUARE, depth = 4;
+    const char* colon = strchr(text, ':');
+
+    if (sscanf(text, "%d,%d,%d,%d", &rows, &columns, &mines, &topology) < 3)
+    {
+        return false;
+    }
+    if ( (colon != NULL) && (sscanf(colon + 1, "%d", &depth) != 1) )
+    {
+        return false;
+    }
+    return pool->add_preset(rows, columns, mines, (board_topology) topology,
+                            depth);
+}
+
+/* print_pool
+ *
+ * Reports how well the pool keeps up
+ *
+ * Inputs:  stats - pool counters
+ * Outputs: (none)
+ * Returns: void
+ */
+static void print_pool(const pool_stats* stats)
+{
+    uint64_t takes = stats->hits + stats->misses;
+
+    PRINT_INFO("pool: %llu hits, %llu misses (%.1f%% hit rate), %llu ready\n",
+               (unsigned long long) stats->hits,
+               (unsigned long long) stats->misses,
+               (takes > 0) ? 100.0 * stats->hits / takes : 0.0,
+               (unsigned long long) stats->ready);
+    PRINT_INFO("pool: build avg %.2f ms max %.2f ms, "
+               "refill avg %.2f ms max %.2f ms\n",
+               (stats->built > 0) ? stats->build_ns / 1e6 / stats->built : 0.0,
+               stats->max_build_ns / 1e6,
+               (stats->refills > 0) ? stats->refill_ns / 1e6 / stats->refills
+                                    : 0.0,
+               stats->max_refill_ns / 1e6);
+}
+
+/* print_parking
+ *
+ * Prints the idle session counters
+ *
+ * Inputs:  stats - server counters
+ * Outputs: (none)
+ * Returns: void
+ */
+static void print_parking(const server_stats* stats)
+{
+    uint64_t parked = stats->value[STAT_PARKED];
+    uint64_t wakes = stats->value[STAT_WAKES];
+
+    PRINT_INFO("parking: %llu parked (%.1f KB each), %llu parks, %llu wakes, "
+               "wake %.3f ms mean, %.3f ms slowest\n",
+               (unsigned long long) parked,
+               (parked > 0) ? stats->value[STAT_PARKED_BYTES] / 1024.0 /
+                              parked : 0.0,
+               (unsigned long long) stats->value[STAT_PARKS],
+               (unsigned long long) wakes,
+               (wakes > 0) ? stats->value[STAT_WAKE_NS] / 1e6 / wakes : 0.0,
+               stats->value[STAT_MAX_WAKE_NS] / 1e6);
+}
@@ -0,0 +1,125 @@
+/* src/tools/simulate.cc
+ *
+ * Headless simulator: plays random games as fast as it
+ * can, optionally logging every event
+ *
+ * Usage: simulate [-g games] [-r rows] [-c columns]
+ *                 [-m mines] [-l event_log] [-H] [-M] [-F dir]
+ *
+ * -H adds board hashes to the event log, for bin/replay.
+ * -F keeps big boards' squares in files under dir (see
+ * hdr/CellStore.h).  -M counts memory use by subsystem and reports it, with
+ * allocations per move
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "Board.h"
+#include "EventLog.h"
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    int games = 1000, rows = 16, columns = 30, mines = 99;
+    const char* log_path = NULL;
+    EventLog log;
+    Board* board;
+    unsigned int rand_state = 1;
+    int opt, game, row, column;
+    uint64_t moves = 0, won = 0, bbbv = 0;
+    struct timespec start, end;
+    double seconds;
+    std::string memory;
+
+    while ( (opt = getopt(argc, argv, "g:r:c:m:l:HMF:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'g': games = atoi(optarg);   break;
+        case 'r': rows = atoi(optarg);    break;
+        case 'c': columns = atoi(optarg); break;
+        case 'm': mines = atoi(optarg);   break;
+        case 'l': log_path = optarg;      break;
+        case 'H': log.set_hashes(true);   break;
+        case 'M': mem_enable(true);       break;
+        case 'F': cells_set_backing(optarg); break;
+        default:
+            PRINT_INFO("Usage: %s [-g games] [-r rows] [-c columns] "
+                       "[-m mines] [-l event_log] [-H] [-M] [-F dir]\n",
+                       argv[0]);
+            return 1;
+        }
+    }
+    if ( (rows < 1) || (columns < 1) || (mines < 1) || 
+         (mines >= rows*columns)
+       )
+    {
+        PRINT_ERROR("Invalid board size!");
+        return 1;
+    }
+    if ( (log_path != NULL) && !log.open(log_path) )
+    {
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (game = 0; game < games; game++)
+    {
+        board = new Board(rows, columns, mines, TOPOLOGY_SQUARE, 
+                          (unsigned int) game + 1);
+        board->set_verbose(false);
+        bbbv += board->get_3bv();
+        if (log_path != NULL)
+        {
+            board->set_event_log(&log, game);
+        }
+
+        /* Click random unrevealed squares until it's over */
+        while (!board->is_game_over())
+        {
+            row = rand_r(&rand_state) % rows;
+            column = rand_r(&rand_state) % columns;
+            if (board->get_square_state(row, column) != UNKNOWN)
+            {
+                continue;
+            }
+            board->make_move(row, column, false);
+            moves++;
+        }
+        won += board->did_we_win() ? 1 : 0;
+        delete board;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    log.close();
+
+    seconds = (end.tv_sec - start.tv_sec) + 
+              (end.tv_nsec - start.tv_nsec) / 1e9;
+    PRINT_INFO("%d games, %llu moves, %llu won in %.3f s "
+               "(%.0f moves/s)\n", games, (unsigned long long) moves,
+               (unsigned long long) won, seconds, moves / seconds);
+    PRINT_INFO("Average 3BV %.1f\n", (double) bbbv / games);
+    if (log_path != NULL)
+    {
+        PRINT_INFO("%llu events logged (%.0f events/s), %llu dropped\n",
+                   (unsigned long long) log.get_events(),
+                   log.get_events() / seconds,
+                   (unsigned long long) log.get_dropped());
+    }
+    if (mem_enabled())
+    {
+        mem_report(&memory);
+        PRINT_INFO("%s", memory.c_str());
+    }
+    return 0;
+}
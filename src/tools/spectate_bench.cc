@@ -0,0 +1,254 @@
+/* src/tools/spectate_bench.cc
+ *
+ * Spectator benchmark: plays random safe moves on one
+ * thread while watcher threads read the
+ * latest frame (see hdr/Spectate.h) as fast as they can.
+ * The same moves are played without a feed, with a feed
+ * but no watchers, and with watchers, so the cost of
+ * publishing and of being watched can be told apart.
+ * Watchers check every frame they read is whole: its
+ * revealed numbers must add up to its revealed count.
+ *
+ * Usage: spectate_bench [-n moves] [-w watchers] [-r rows]
+ *                       [-c columns] [-m mines] [-s seed]
+ *
+ */
+
+/******************************************************
+                        INCLUDES
+*******************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Board.h"
+#include "Spectate.h"
+
+/******************************************************
+                   TYPEDEFS AND ENUMS
+*******************************************************/
+typedef struct
+{
+    uint64_t views;
+    uint64_t torn;          /* frames that did not add up */
+} watcher_result;
+
+/******************************************************
+                    LOCAL VARIABLES
+*******************************************************/
+static std::atomic<bool> playing;
+
+/******************************************************
+              LOCAL FUNCTIONS DEFINITION
+*******************************************************/
+static double play(Board* board, int moves, unsigned int seed, int* made);
+static void watch(SpectatorFeed* feed, watcher_result* result);
+static double seconds_since(const struct timespec* start);
+
+/******************************************************
+                         MAIN
+*******************************************************/
+int main(int argc, char** argv)
+{
+    int moves = 200000, watchers = 4, rows = 1000, columns = 1000;
+    int mines = 150000;
+    unsigned int seed = 1;
+    Board* board;
+    SpectatorFeed* feed;
+    std::vector<std::thread> threads;
+    std::vector<watcher_result> results;
+    double plain_seconds, feed_seconds, watched_seconds;
+    uint64_t views = 0, torn = 0, reclaimed;
+    size_t pending;
+    int opt, i, made;
+
+    while ( (opt = getopt(argc, argv, "n:w:r:c:m:s:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'n': moves = atoi(optarg);     break;
+        case 'w': watchers = atoi(optarg);  break;
+        case 'r': rows = atoi(optarg);      break;
+        case 'c': columns = atoi(optarg);   break;
+        case 'm': mines = atoi(optarg);     break;
+        case 's': seed = atoi(optarg);      break;
+        default:
+            PRINT_INFO("Usage: %s [-n moves] [-w watchers] [-r rows] "
+                       "[-c columns] [-m mines] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ( (rows < 1) || (columns < 1) || (mines < 1) ||
+         (mines >= rows*columns) || (moves < 1) || (watchers < 0) ||
+         (watchers > EPOCH_MAX_READERS)
+       )
+    {
+        PRINT_ERROR("Invalid arguments!");
+        return 1;
+    }
+
+    /* Without a feed */
+    board = new Board(rows, columns, mines, TOPOLOGY_SQUARE, seed);
+    board->set_verbose(false);
+    plain_seconds = play(board, moves, seed, &made);
+    delete board;
+
+    /* Publishing, nobody watching */
+    board = new Board(rows, columns, mines, TOPOLOGY_SQUARE, seed);
+    board->set_verbose(false);
+    feed = new SpectatorFeed(board);
+    board->set_spectators(feed);
+    feed_seconds = play(board, moves, seed, &made);
+    board->set_spectators(NULL);
+    feed->release();
+    delete board;
+
+    /* Publishing while watched */
+    board = new Board(rows, columns, mines, TOPOLOGY_SQUARE, seed);
+    board->set_verbose(false);
+    feed = new SpectatorFeed(board);
+    board->set_spectators(feed);
+    results.resize(watchers);
+    playing = true;
+    for (i = 0; i < watchers; i++)
+    {
+        threads.push_back(std::thread(watch, feed, &results[i]));
+    }
+    watched_seconds = play(board, moves, seed, &made);
+    playing = false;
+    for (i = 0; i < watchers; i++)
+    {
+        threads[i].join();
+        views += results[i].views;
+        torn += results[i].torn;
+    }
+    reclaimed = feed->get_reclaimed();
+    pending = feed->get_pending();
+    board->set_spectators(NULL);
+    feed->release();
+    delete board;
+
+    PRINT_INFO("%dx%d board, %d mines, %d moves\n", rows, columns, mines,
+               made);
+    PRINT_INFO("no feed:       %.3f s (%.0f moves/s)\n", plain_seconds,
+               made / plain_seconds);
+    PRINT_INFO("feed:          %.3f s (%.0f moves/s)\n", feed_seconds,
+               made / feed_seconds);
+    PRINT_INFO("%2d watchers:   %.3f s (%.0f moves/s), %llu frames read "
+               "(%.0f/s), %llu torn\n", watchers, watched_seconds,
+               made / watched_seconds, (unsigned long long) views,
+               views / watched_seconds, (unsigned long long) torn);
+    PRINT_INFO("Reclaimed %llu frames and tiles, %zu still waiting at "
+               "the end\n", (unsigned long long) reclaimed, pending);
+    return (torn == 0) ? 0 : 1;
+}
+
+/******************************************************
+             LOCAL FUNCTION IMPLEMENTATIONS
+*******************************************************/
+
+/* play
+ *
+ * Plays like a player who never loses: reveals random safe
+ * squares and marks some mines, taking every 16th move
+ * back and making it again
+ *
+ * Inputs:  board - board to play on
+ *          moves - most moves to make
+ *          seed  - for picking squares
+ * Outputs: made  - moves made (fewer if the game is won)
+ * Returns: seconds taken
+ */
+static double play(Board* board, int moves, unsigned int seed, int* made)
+{
+    struct timespec start;
+    unsigned int rand_state = seed;
+    int rows = board->get_rows(), columns = board->get_columns();
+    std::vector<uint8_t> mine_plane((rows * columns + 7) / 8);
+    int i = 0, index, row, column;
+    bool mine;
+
+    board->pack_mines(mine_plane.data());
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ( (i < moves) && !board->is_game_over() )
+    {
+        index = rand_r(&rand_state) % (rows * columns);
+        row = index / columns;
+        column = index % columns;
+        if (board->get_square_state(row, column) != UNKNOWN)
+        {
+            continue;
+        }
+        mine = (mine_plane[index >> 3] >> (index & 7)) & 1;
+        if ( mine && (rand_r(&rand_state) & 3) )
+        {
+            continue;
+        }
+        board->make_move(row, column, mine);
+        if ((++i & 15) == 0)
+        {
+            board->undo();
+            board->redo();
+            i += 2;
+        }
+    }
+    *made = i;
+    return seconds_since(&start);
+}
+
+/* watch
+ *
+ * Watcher thread: reads frames until play stops
+ *
+ * Inputs:  feed   - feed to watch
+ * Outputs: result - what it saw
+ * Returns: void
+ */
+static void watch(SpectatorFeed* feed, watcher_result* result)
+{
+    const spectate_frame* frame;
+    int reader = feed->join();
+    int row, column, revealed;
+    char square;
+
+    result->views = 0;
+    result->torn = 0;
+    feed->retain();
+    while (playing)
+    {
+        frame = feed->enter(reader);
+        revealed = 0;
+        for (row = 0; row < frame->rows; row++)
+        {
+            for (column = 0; column < frame->columns; column++)
+            {
+                square = spectate_square(frame, row, column);
+                revealed += ( (square >= '0') && (square <= '8') ) ? 1 : 0;
+            }
+        }
+        result->torn += (revealed != frame->squares_revealed) ? 1 : 0;
+        feed->exit(reader);
+        result->views++;
+    }
+    feed->leave(reader);
+    feed->release();
+}
+
+/* seconds_since
+ *
+ * Inputs:  start - earlier CLOCK_MONOTONIC reading
+ * Outputs: (none)
+ * Returns: seconds elapsed since then
+ */
+static double seconds_since(const struct timespec* start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) / 1e9;
+}